@@ -12,6 +12,10 @@ from typing import (
     Tuple,
 )
 
+from . import _base58 as base58
+from . import segwit_addr
+from .common import Chain
+
 
 def is_opreturn(script: bytes) -> bool:
     """
@@ -152,3 +156,28 @@ def parse_multisig(script: bytes) -> Optional[Tuple[int, Sequence[bytes]]]:
         return None
 
     return (m, pubkeys)
+
+
+def script_to_address(script: bytes, chain: Chain) -> str:
+    """
+    Computes the address of an output script.
+
+    :param script: The output script; it must be P2PKH, P2SH or a segwit output script
+    :param chain: The network of the address
+    :returns: The address
+    :raises: ValueError: if the script has no address
+    """
+    is_mainnet = chain == Chain.MAIN
+    if is_p2pkh(script):
+        return base58.to_address(script[3:23], b"\x00" if is_mainnet else b"\x6f")
+    if is_p2sh(script):
+        return base58.to_address(script[2:22], b"\x05" if is_mainnet else b"\xc4")
+
+    is_wit, wit_ver, wit_prog = is_witness(script)
+    if is_wit and 2 <= len(wit_prog) <= 40:
+        hrp = {Chain.MAIN: "bc", Chain.TEST: "tb", Chain.REGTEST: "bcrt", Chain.SIGNET: "tb"}[chain]
+        # same as segwit_addr.encode, without decoding the result again to validate it
+        spec = segwit_addr.Encoding.BECH32 if wit_ver == 0 else segwit_addr.Encoding.BECH32M
+        return segwit_addr.bech32_encode(hrp, [wit_ver] + segwit_addr.convertbits(wit_prog, 8, 5), spec)
+
+    raise ValueError(f"The script {script.hex()} has no address")
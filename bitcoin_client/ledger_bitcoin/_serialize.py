@@ -19,8 +19,10 @@ import struct
 from typing import (
     List,
     Sequence,
+    Tuple,
     TypeVar,
     Callable,
+    Union,
 )
 from typing_extensions import Protocol
 
@@ -37,6 +39,30 @@ class Serializable(Protocol):
         ...
 
 
+class BufferReader:
+    """
+    A byte stream over a bytes-like object, that does not copy it.
+
+    `read` returns new `bytes` like any other byte stream; `read_view` returns a `memoryview` of the
+    underlying buffer instead, and should be used for the large values that do not need to be copied.
+    """
+
+    def __init__(self, data: Union[bytes, bytearray, memoryview]) -> None:
+        self._view = memoryview(data)
+        self._pos = 0
+
+    def read(self, n: int = -1) -> bytes:
+        return bytes(self.read_view(n))
+
+    def read_view(self, n: int = -1) -> memoryview:
+        start = self._pos
+        self._pos = len(self._view) if n < 0 else min(start + n, len(self._view))
+        return self._view[start:self._pos]
+
+    def tell(self) -> int:
+        return self._pos
+
+
 # Serialization/deserialization tools
 def ser_compact_size(size: int) -> bytes:
     """
@@ -82,6 +108,38 @@ def deser_string(f: Readable) -> bytes:
     nit = deser_compact_size(f)
     return f.read(nit)
 
+def deser_string_view(f: Readable) -> Union[bytes, memoryview]:
+    """
+    Same as `deser_string`, but returns a view of the buffer without copying it if `f` is a
+    :class:`BufferReader`.
+
+    :param f: The byte stream
+    :returns: The byte string that was serialized
+    """
+    nit = deser_compact_size(f)
+    if isinstance(f, BufferReader):
+        return f.read_view(nit)
+    return f.read(nit)
+
+def deser_compact_size_at(buf: memoryview, pos: int) -> Tuple[int, int]:
+    """
+    Deserialize a compact size unsigned integer at the given position of a buffer.
+
+    :param buf: The buffer
+    :param pos: The position of the compact size in the buffer
+    :returns: The integer that was serialized, and the position that follows it
+    :raises: ValueError: if the buffer is too short
+    """
+    if pos >= len(buf):
+        raise ValueError("Unexpected end of buffer")
+    nit = buf[pos]
+    size = {253: 2, 254: 4, 255: 8}.get(nit, 0)
+    if size == 0:
+        return nit, pos + 1
+    if pos + 1 + size > len(buf):
+        raise ValueError("Unexpected end of buffer")
+    return int.from_bytes(buf[pos + 1:pos + 1 + size], byteorder="little"), pos + 1 + size
+
 def ser_string(s: bytes) -> bytes:
     """
     Serialize a byte string with Bitcoin's variable length string serialization.
@@ -67,6 +67,10 @@ class btchip:
 	OPERATION_MODE_SERVER = 0x04
 	OPERATION_MODE_DEVELOPER = 0x08
 
+	GET_TRUSTED_INPUT_P2_MULTIPLE_OUTPUTS = 0x01
+	MAX_TRUSTED_INPUT_TARGETS = 4
+	TRUSTED_INPUT_LENGTH = 56
+
 	FEATURE_UNCOMPRESSED_KEYS = 0x01
 	FEATURE_RFC6979 = 0x02
 	FEATURE_FREE_SIGHASHTYPE = 0x04
@@ -107,9 +111,32 @@ class btchip:
 
 	def getTrustedInput(self, transaction, index):
 		result = {}
+		response = self._getTrustedInputResponse(transaction, bytearray.fromhex("%.8x" % (index)), 0x00)
+		result['trustedInput'] = True
+		result['value'] = response
+		return result
+
+	def getTrustedInputs(self, transaction, indexes):
+		# Trusted inputs of several outputs of the same transaction, that is only streamed once.
+		# The indexes must be in increasing order, and at most MAX_TRUSTED_INPUT_TARGETS at once
+		if len(indexes) == 0 or len(indexes) > self.MAX_TRUSTED_INPUT_TARGETS:
+			raise BTChipException("Invalid number of outputs")
+		header = bytearray([len(indexes)])
+		for index in indexes:
+			header.extend(bytearray.fromhex("%.8x" % (index)))
+		response = self._getTrustedInputResponse(transaction, header, self.GET_TRUSTED_INPUT_P2_MULTIPLE_OUTPUTS)
+		if len(response) != self.TRUSTED_INPUT_LENGTH * len(indexes):
+			raise BTChipException("Invalid trusted inputs length")
+		result = []
+		for i in range(len(indexes)):
+			value = response[i * self.TRUSTED_INPUT_LENGTH : (i + 1) * self.TRUSTED_INPUT_LENGTH]
+			result.append({'trustedInput': True, 'value': value})
+		return result
+
+	def _getTrustedInputResponse(self, transaction, header, p2):
 		# Header
-		apdu = [ self.BTCHIP_CLA, self.BTCHIP_INS_GET_TRUSTED_INPUT, 0x00, 0x00 ]
-		params = bytearray.fromhex("%.8x" % (index))
+		apdu = [ self.BTCHIP_CLA, self.BTCHIP_INS_GET_TRUSTED_INPUT, 0x00, p2 ]
+		params = bytearray(header)
 		params.extend(transaction.version)
 		writeVarint(len(transaction.inputs), params)
 		apdu.append(len(params))
@@ -169,10 +196,7 @@ class btchip:
 		# Locktime
 		apdu = [ self.BTCHIP_CLA, self.BTCHIP_INS_GET_TRUSTED_INPUT, 0x80, 0x00, len(transaction.lockTime) ]
 		apdu.extend(transaction.lockTime)
-		response = self.dongle.exchange(bytearray(apdu))
-		result['trustedInput'] = True
-		result['value'] = response
-		return result
+		return self.dongle.exchange(bytearray(apdu))
 
 	def startUntrustedTransaction(self, newTransaction, inputIndex, outputList, redeemScript, version=0x01, cashAddr=False, continueSegwit=False):
 		# Start building a fake transaction with the passed inputs
@@ -3,14 +3,13 @@ import base64
 from io import BytesIO, BufferedReader
 
 from .command_builder import BitcoinCommandBuilder, BitcoinInsType
-from .common import Chain, read_varint
+from .common import Chain, bip32_path_from_string, read_varint
 from .client_command import ClientCommandInterpreter
 from .client_base import Client, TransportClient
 from .client_legacy import LegacyClient
 from .exception import DeviceException
-from .merkle import get_merkleized_map_commitment
 from .wallet import Wallet, WalletType, PolicyMapWallet
-from .psbt import PSBT
+from .psbt import PSBT, parse_map_spans
 from ._serialize import deser_string
 
 
@@ -32,10 +31,23 @@ def parse_stream_to_map(f: BufferedReader) -> Mapping[bytes, bytes]:
     return result
 
 
+# Status word returned by the app for unknown commands
+SW_INS_NOT_SUPPORTED = 0x6D00
+
+# Maximum number of paths in a single GET_EXTENDED_PUBKEYS request
+MAX_N_EXTENDED_PUBKEYS_PATHS = 16
+
+
 class NewClient(Client):
     # internal use for testing: if set to True, sign_psbt will not clone the psbt before converting to psbt version 2
     _no_clone_psbt: bool = False
 
+    # whether the app supports SIGN_MESSAGE_STREAMED; None until the first request
+    _supports_sign_message_streamed: Optional[bool] = None
+
+    # whether the app supports SIGN_PSBT_BATCHED; None until the first request
+    _supports_sign_psbt_batched: Optional[bool] = None
+
     def __init__(self, comm_client: TransportClient, chain: Chain = Chain.MAIN, debug: bool = False) -> None:
         super().__init__(comm_client, chain, debug)
         self.builder = BitcoinCommandBuilder()
@@ -65,13 +77,44 @@ class NewClient(Client):
 
         return response.decode()
 
+    def get_extended_pubkeys(self, paths: List[str], display: bool = False) -> List[str]:
+        # the paths are split in batches that fit in a single APDU
+        batches: List[List[str]] = [[]]
+        batch_len = 2
+        for path in paths:
+            path_len = 1 + 4 * len(bip32_path_from_string(path))
+            if len(batches[-1]) == MAX_N_EXTENDED_PUBKEYS_PATHS or batch_len + path_len > 255:
+                batches.append([])
+                batch_len = 2
+            batches[-1].append(path)
+            batch_len += path_len
+
+        result: List[str] = []
+        for batch in batches:
+            if len(batch) == 0:
+                continue
+
+            client_intepreter = ClientCommandInterpreter()
+
+            sw, _ = self._make_request(self.builder.get_extended_pubkeys(batch, display), client_intepreter)
+
+            if sw != 0x9000:
+                raise DeviceException(error_code=sw, ins=BitcoinInsType.GET_EXTENDED_PUBKEYS)
+
+            if len(client_intepreter.yielded) != len(batch):
+                raise RuntimeError("Invalid response")
+
+            result.extend(pubkey.decode() for pubkey in client_intepreter.yielded)
+
+        return result
+
     def register_wallet(self, wallet: Wallet) -> Tuple[bytes, bytes]:
-        if wallet.type != WalletType.POLICYMAP:
-            raise ValueError("wallet type must be POLICYMAP")
+        if wallet.type not in (WalletType.POLICYMAP, WalletType.POLICYMAP_BINARY_KEYS):
+            raise ValueError("wallet type must be POLICYMAP or POLICYMAP_BINARY_KEYS")
 
         client_intepreter = ClientCommandInterpreter()
         client_intepreter.add_known_preimage(wallet.serialize())
-        client_intepreter.add_known_list([k.encode() for k in wallet.keys_info])
+        client_intepreter.add_known_list(wallet.keys_info_leaves)
 
         sw, response = self._make_request(
             self.builder.register_wallet(wallet), client_intepreter
@@ -97,16 +140,14 @@ class NewClient(Client):
         display: bool,
     ) -> str:
 
-        if wallet.type != WalletType.POLICYMAP or not isinstance(
-            wallet, PolicyMapWallet
-        ):
-            raise ValueError("wallet type must be POLICYMAP")
+        if not isinstance(wallet, PolicyMapWallet):
+            raise ValueError("wallet type must be POLICYMAP or POLICYMAP_BINARY_KEYS")
 
         if change != 0 and change != 1:
             raise ValueError("Invalid change")
 
         client_intepreter = ClientCommandInterpreter()
-        client_intepreter.add_known_list([k.encode() for k in wallet.keys_info])
+        client_intepreter.add_known_list(wallet.keys_info_leaves)
         client_intepreter.add_known_preimage(wallet.serialize())
 
         sw, response = self._make_request(
@@ -145,74 +186,120 @@ class NewClient(Client):
         Mapping[int, bytes]
             A mapping that has as keys the indexes of inputs that the Hardware Wallet signed, and the corresponding signatures as values.
         """
+        client_intepreter, commitments = self._prepare_sign_psbt(psbt, wallet)
+
+        # SIGN_PSBT_BATCHED yields several signatures at once; it is not supported by older
+        # versions of the app, that are detected with the first request
+        batched = self._supports_sign_psbt_batched is not False
+        sw, _ = self._make_request(
+            self.builder.sign_psbt(*commitments, wallet, wallet_hmac, batched),
+            client_intepreter,
+        )
+
+        if batched and sw == SW_INS_NOT_SUPPORTED:
+            self._supports_sign_psbt_batched = batched = False
+            sw, _ = self._make_request(
+                self.builder.sign_psbt(*commitments, wallet, wallet_hmac),
+                client_intepreter,
+            )
+        elif batched:
+            self._supports_sign_psbt_batched = True
+
+        if sw != 0x9000:
+            raise DeviceException(error_code=sw, ins=BitcoinInsType.SIGN_PSBT)
+
+        return self._parse_signatures(client_intepreter.yielded, batched)
+
+    def resume_sign_psbt(self, psbt: PSBT, wallet: Wallet, wallet_hmac: Optional[bytes]) -> Mapping[int, bytes]:
+        client_intepreter, commitments = self._prepare_sign_psbt(psbt, wallet)
+
+        sw, _ = self._make_request(
+            self.builder.sign_psbt(*commitments, wallet, wallet_hmac, resume=True),
+            client_intepreter,
+        )
+
+        if sw != 0x9000:
+            raise DeviceException(error_code=sw, ins=BitcoinInsType.RESUME_SIGN_PSBT)
+
+        # the signatures are always yielded in batches
+        return self._parse_signatures(client_intepreter.yielded, True)
+
+    def _prepare_sign_psbt(
+        self, psbt: PSBT, wallet: Wallet
+    ) -> Tuple[ClientCommandInterpreter, Tuple[bytes, List[bytes], List[bytes]]]:
+        """Returns the client interpreter that can answer all the queries of the app about the psbt and the wallet
+        policy, and the Merkleized map commitments of the global map, of the input maps and of the output maps of the
+        psbt."""
+
         if psbt.version != 2:
             if self._no_clone_psbt:
                 psbt.convert_to_v2()
                 psbt_v2 = psbt
             else:
                 psbt_v2 = PSBT()
-                psbt_v2.deserialize(psbt.serialize())  # clone psbt
+                psbt_v2.deserialize_bytes(psbt.serialize_bytes())  # clone psbt
                 psbt_v2.convert_to_v2()
         else:
             psbt_v2 = psbt
 
-        psbt_bytes = base64.b64decode(psbt_v2.serialize())
-        f = BytesIO(psbt_bytes)
+        psbt_bytes = memoryview(psbt_v2.serialize_bytes())
 
         # We parse the individual maps (global map, each input map, and each output map) from the psbt serialized as a
         # sequence of bytes, in order to produce the serialized Merkleized map commitments. Moreover, we prepare the
         # client interpreter to respond on queries on all the relevant Merkle trees and pre-images in the psbt.
+        # The values of the maps are views of psbt_bytes, in order to avoid copying large values.
 
-        assert f.read(5) == b"psbt\xff"
+        assert psbt_bytes[:5] == b"psbt\xff"
 
         client_intepreter = ClientCommandInterpreter()
-        client_intepreter.add_known_list([k.encode() for k in wallet.keys_info])
+        client_intepreter.add_known_list(wallet.keys_info_leaves)
         client_intepreter.add_known_preimage(wallet.serialize())
 
-        global_map: Mapping[bytes, bytes] = parse_stream_to_map(f)
-        client_intepreter.add_known_mapping(global_map)
+        global_map, pos = parse_map_spans(psbt_bytes, 5)
+        global_commitment = client_intepreter.add_known_mapping(global_map)
 
-        input_maps: List[Mapping[bytes, bytes]] = []
+        input_commitments: List[bytes] = []
         for _ in range(len(psbt_v2.inputs)):
-            input_maps.append(parse_stream_to_map(f))
-        for m in input_maps:
-            client_intepreter.add_known_mapping(m)
+            input_map, pos = parse_map_spans(psbt_bytes, pos)
+            input_commitments.append(client_intepreter.add_known_mapping(input_map))
 
-        output_maps: List[Mapping[bytes, bytes]] = []
+        output_commitments: List[bytes] = []
         for _ in range(len(psbt_v2.outputs)):
-            output_maps.append(parse_stream_to_map(f))
-        for m in output_maps:
-            client_intepreter.add_known_mapping(m)
+            output_map, pos = parse_map_spans(psbt_bytes, pos)
+            output_commitments.append(client_intepreter.add_known_mapping(output_map))
 
         # We also add the Merkle tree of the input (resp. output) map commitments as a known tree
-        input_commitments = [get_merkleized_map_commitment(m_in) for m_in in input_maps]
-        output_commitments = [get_merkleized_map_commitment(m_out) for m_out in output_maps]
-
         client_intepreter.add_known_list(input_commitments)
         client_intepreter.add_known_list(output_commitments)
 
-        sw, _ = self._make_request(
-            self.builder.sign_psbt(
-                global_map, input_maps, output_maps, wallet, wallet_hmac
-            ),
-            client_intepreter,
-        )
-
-        if sw != 0x9000:
-            raise DeviceException(error_code=sw, ins=BitcoinInsType.SIGN_PSBT)
-
-        # parse results and return a structured version instead
-        results = client_intepreter.yielded
+        return client_intepreter, (global_commitment, input_commitments, output_commitments)
 
+    def _parse_signatures(self, results: List[bytes], batched: bool) -> Mapping[int, bytes]:
         if any(len(x) <= 1 for x in results):
             raise RuntimeError("Invalid response")
 
-        results_map = {}
+        # each yielded element is either <input_index> <signature>, or a batch of
+        # <input_index> <signature length> <signature>
+        signatures: List[Tuple[int, bytes]] = []
         for res in results:
             res_buffer = BytesIO(res)
-            input_index = read_varint(res_buffer)
-            signature = res_buffer.read()
+            if not batched:
+                input_index = read_varint(res_buffer)
+                signatures.append((input_index, res_buffer.read()))
+                continue
+
+            while res_buffer.tell() < len(res):
+                input_index = read_varint(res_buffer)
+                signature_len = res_buffer.read(1)
+                if len(signature_len) != 1:
+                    raise RuntimeError("Invalid response")
+                signature = res_buffer.read(signature_len[0])
+                if len(signature) != signature_len[0]:
+                    raise RuntimeError("Invalid response")
+                signatures.append((input_index, signature))
 
+        results_map = {}
+        for input_index, signature in signatures:
             if input_index in results_map:
                 raise RuntimeError(f"Multiple signatures produced for the same input: {input_index}")
 
@@ -234,6 +321,25 @@ class NewClient(Client):
         else:
             message_bytes = message
 
+        # SIGN_MESSAGE_STREAMED sends the message in as few APDUs as possible; it is not supported
+        # by older versions of the app, that are detected with the first request
+        if self._supports_sign_message_streamed is not False:
+            client_intepreter = ClientCommandInterpreter()
+            client_intepreter.add_known_preimage(b'\0' + message_bytes)
+
+            sw, response = self._make_request(
+                self.builder.sign_message_streamed(message_bytes, bip32_path), client_intepreter)
+
+            if sw != SW_INS_NOT_SUPPORTED:
+                self._supports_sign_message_streamed = True
+
+                if sw != 0x9000:
+                    raise DeviceException(error_code=sw, ins=BitcoinInsType.SIGN_MESSAGE_STREAMED)
+
+                return base64.b64encode(response).decode('utf-8')
+
+            self._supports_sign_message_streamed = False
+
         chunks = [message_bytes[64 * i: 64 * i + 64] for i in range((len(message_bytes) + 63) // 64)]
 
         client_intepreter = ClientCommandInterpreter()
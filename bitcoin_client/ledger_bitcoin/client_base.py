@@ -1,5 +1,6 @@
-from typing import Tuple, Mapping, Optional, Union, Literal
+from typing import List, Tuple, Mapping, Optional, Union, Literal
 from io import BytesIO
+import random
 
 from ledgercomm import Transport
 
@@ -146,6 +147,26 @@ class Client:
 
         raise NotImplementedError
 
+    def get_extended_pubkeys(self, paths: List[str], display: bool = False) -> List[str]:
+        """Gets the serialized extended public keys for several BIP32 paths. Optionally, validate with the user.
+
+        The default implementation requests each pubkey separately.
+
+        Parameters
+        ----------
+        paths : List[str]
+            BIP32 paths of the public keys you want.
+        display : bool
+            Whether you want to display each pubkey and ask confirmation on the device.
+
+        Returns
+        -------
+        List[str]
+            The requested serialized extended public keys, in the same order as the paths.
+        """
+
+        return [self.get_extended_pubkey(path, display) for path in paths]
+
     def register_wallet(self, wallet: Wallet) -> Tuple[bytes, bytes]:
         """Registers a wallet policy with the user. After approval returns the wallet id and hmac to be stored on the client.
 
@@ -199,6 +220,62 @@ class Client:
 
         raise NotImplementedError
 
+    def verify_wallet_addresses(
+        self,
+        wallet: Wallet,
+        wallet_hmac: Optional[bytes],
+        change: int,
+        start: int,
+        addresses: List[str],
+        n_samples: int = 8,
+        rng: Optional[random.Random] = None,
+    ) -> List[int]:
+        """Checks addresses derived locally (e.g. with `PolicyMapWallet.derive_addresses`) against the ones returned by
+        the device for a sample of their indexes: the first one, the last one, and `n_samples` others chosen at random.
+
+        Parameters
+        ----------
+        wallet : Wallet
+            The registered wallet policy, or a standard wallet policy.
+
+        wallet_hmac: Optional[bytes]
+            For a registered wallet, the hmac obtained at wallet registration. `None` for a standard wallet policy.
+
+        change: int
+            0 for receive addresses, 1 for change addresses.
+
+        start: int
+            The address index of `addresses[0]`.
+
+        addresses: List[str]
+            The addresses to check, with consecutive address indexes.
+
+        n_samples: int
+            The number of addresses to check, in addition to the first and the last one.
+
+        rng: Optional[random.Random]
+            The random generator used to choose the samples.
+
+        Returns
+        -------
+        List[int]
+            The address indexes of the sampled addresses that differ from the ones returned by the device; it is empty
+            if all the sampled addresses match.
+        """
+
+        if len(addresses) == 0:
+            return []
+
+        rng = rng or random.Random()
+        positions = {0, len(addresses) - 1}
+        positions.update(rng.sample(range(len(addresses)), min(n_samples, len(addresses))))
+
+        return [
+            start + pos
+            for pos in sorted(positions)
+            if self.get_wallet_address(wallet, wallet_hmac, change, start + pos, False) != addresses[pos]
+        ]
+
     def sign_psbt(self, psbt: PSBT, wallet: Wallet, wallet_hmac: Optional[bytes]) -> Mapping[int, bytes]:
         """Signs a PSBT using a registered wallet (or a standard wallet that does not need registration).
 
@@ -226,6 +303,30 @@ class Client:
 
         raise NotImplementedError
 
+    def resume_sign_psbt(self, psbt: PSBT, wallet: Wallet, wallet_hmac: Optional[bytes]) -> Mapping[int, bytes]:
+        """Continues a call to sign_psbt that was interrupted after the user approved the transaction, for example
+        because the connection with the device was lost. No further approval is required.
+
+        Parameters
+        ----------
+        psbt : PSBT
+            The same PSBT as in the interrupted call.
+
+        wallet : Wallet
+            The same wallet policy as in the interrupted call.
+
+        wallet_hmac: Optional[bytes]
+            The same hmac as in the interrupted call.
+
+        Returns
+        -------
+        Mapping[int, bytes]
+            A mapping from the indexes of the inputs to their signatures, only for the signatures that the interrupted
+            call did not receive.
+        """
+
+        raise NotImplementedError
+
     def get_master_fingerprint(self) -> bytes:
         """Gets the fingerprint of the master public key, as per BIP-32.
 
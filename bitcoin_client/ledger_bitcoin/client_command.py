@@ -12,6 +12,7 @@ class ClientCommandCode(IntEnum):
     GET_PREIMAGE = 0x40
     GET_MERKLE_LEAF_PROOF = 0x41
     GET_MERKLE_LEAF_INDEX = 0x42
+    GET_MERKLE_LEAVES = 0x43
     GET_MORE_ELEMENTS = 0xA0
 
 
@@ -164,6 +165,54 @@ class GetMerkleLeafIndexCommand(ClientCommand):
         return found.to_bytes(1, byteorder="big") + write_varint(leaf_index)
 
 
+class GetMerkleLeavesCommand(ClientCommand):
+    def __init__(self, known_trees: Mapping[bytes, MerkleTree], known_preimages: Mapping[bytes, bytes]):
+        self.known_trees = known_trees
+        self.known_preimages = known_preimages
+
+    @property
+    def code(self) -> int:
+        return ClientCommandCode.GET_MERKLE_LEAVES
+
+    def execute(self, request: bytes) -> bytes:
+        req = ByteStreamParser(request[1:])
+
+        root = req.read_bytes(32)
+        tree_size = req.read_varint()
+        start_index = req.read_varint()
+        req.assert_empty()
+
+        if root not in self.known_trees:
+            raise ValueError(f"Unknown Merkle root: {root.hex()}.")
+
+        mt: MerkleTree = self.known_trees[root]
+
+        if start_index >= tree_size or len(mt) != tree_size:
+            raise ValueError(f"Invalid index or tree size.")
+
+        # as many complete leaf preimages (without the b'\0' prefix) as fit in 255 bytes
+        response = bytearray(1)
+        n_leaves = 0
+        for leaf_index in range(start_index, tree_size):
+            leaf_hash = mt.get(leaf_index)
+            if leaf_hash not in self.known_preimages:
+                raise RuntimeError(f"Requested unknown preimage for: {leaf_hash.hex()}")
+
+            element = self.known_preimages[leaf_hash][1:]
+            if n_leaves == 255 or len(response) + 1 + len(element) > 255:
+                break
+
+            response.append(len(element))
+            response.extend(element)
+            n_leaves += 1
+
+        if n_leaves == 0:
+            raise ValueError("The leaf is too long to fit in a response.")
+
+        response[0] = n_leaves
+        return bytes(response)
+
+
 class GetMoreElementsCommand(ClientCommand):
     def __init__(self, queue: "deque[bytes]"):
         self.queue = queue
@@ -240,6 +289,7 @@ class ClientCommandInterpreter:
             GetPreimageCommand(self.known_preimages, queue),
             GetMerkleLeafIndexCommand(self.known_trees),
             GetMerkleLeafProofCommand(self.known_trees, queue),
+            GetMerkleLeavesCommand(self.known_trees, self.known_preimages),
             GetMoreElementsCommand(queue),
         ]
 
@@ -288,7 +338,7 @@ class ClientCommandInterpreter:
 
         self.known_preimages[sha256(element)] = element
 
-    def add_known_list(self, elements: List[bytes]) -> None:
+    def add_known_list(self, elements: List[bytes]) -> bytes:
         """Adds a known Merkleized list.
 
         Builds the Merkle tree of `elements`, and adds it to the Merkle trees known to the client
@@ -297,23 +347,34 @@ class ClientCommandInterpreter:
 
         If `el` is one of `elements`, the client must respond with b'\0' + `el` when a GET_PREIMAGE
         client command is sent with `sha256(b'\0' + el)`.
-        Moreover, the commands GET_MERKLE_LEAF_INDEX and GET_MERKLE_LEAF_PROOF must correctly answer
-        queries relative to the Merkle whose root is `mt_root`.
+        Moreover, the commands GET_MERKLE_LEAF_INDEX, GET_MERKLE_LEAF_PROOF and GET_MERKLE_LEAVES must
+        correctly answer queries relative to the Merkle whose root is `mt_root`.
 
         Parameters
         ----------
         elements : List[bytes]
-            A list of `bytes` corresponding to the leafs of the Merkle tree.
+            A list of `bytes` (or other bytes-like objects) corresponding to the leafs of the Merkle tree.
+
+        Returns
+        -------
+        bytes
+            The Merkle root `mt_root`.
         """
 
+        # each leaf is hashed once, both for the preimage and for the Merkle tree
+        leaf_hashes: List[bytes] = []
         for el in elements:
-            self.add_known_preimage(b"\x00" + el)
+            preimage = b"\x00" + el
+            leaf_hash = sha256(preimage)
+            self.known_preimages[leaf_hash] = preimage
+            leaf_hashes.append(leaf_hash)
 
-        mt = MerkleTree(element_hash(el) for el in elements)
+        mt = MerkleTree(leaf_hashes)
 
         self.known_trees[mt.root] = mt
+        return mt.root
 
-    def add_known_mapping(self, mapping: Mapping[bytes, bytes]) -> None:
+    def add_known_mapping(self, mapping: Mapping[bytes, bytes]) -> bytes:
         """Adds the Merkle trees of keys, and the Merkle tree of values (ordered by key)
         of a mapping of bytes to bytes.
 
@@ -323,12 +384,16 @@ class ClientCommandInterpreter:
         Parameters
         ----------
         mapping : Mapping[bytes, bytes]
-            A mapping whose keys and values are `bytes`.
-        """
+            A mapping whose keys are `bytes`, and values are `bytes` (or other bytes-like objects).
 
-        items_sorted = list(sorted(mapping.items()))
+        Returns
+        -------
+        bytes
+            The serialized Merkleized map commitment of the mapping, as returned by `get_merkleized_map_commitment`.
+        """
 
-        keys = [i[0] for i in items_sorted]
-        values = [i[1] for i in items_sorted]
-        self.add_known_list(keys)
-        self.add_known_list(values)
+        keys = sorted(mapping.keys())
+        values = [mapping[k] for k in keys]
+        keys_root = self.add_known_list(keys)
+        values_root = self.add_known_list(values)
+        return write_varint(len(keys)) + keys_root + values_root
@@ -11,8 +11,9 @@ import re
 import base64
 
 from .client import Client, TransportClient
+from .client_base import ApduException
 
-from typing import List, Tuple, Mapping, Optional, Union
+from typing import Dict, List, Tuple, Mapping, Optional, Union
 
 from .common import AddressType, Chain, hash160
 from .key import ExtendedKey, parse_path
@@ -182,6 +183,32 @@ class LegacyClient(Client):
         version = self.app.getFirmwareVersion()
         use_trusted_segwit = (version['major_version'] == 1 and version['minor_version'] >= 4) or version['major_version'] > 1
 
+        # Recent versions of the app return the trusted inputs of several outputs of the same
+        # transaction at once; in that case, all the outputs of a previous transaction that are spent
+        # are requested together, so that the previous transaction is only streamed once per batch.
+        # Older versions reject the first request with SW_INCORRECT_P1_P2, and each output is then
+        # requested separately
+        use_multiple_trusted_inputs = version['major_version'] >= 2
+        trusted_inputs: Dict[Tuple[int, int], dict] = {}
+
+        def get_trusted_input(prevtx: bitcoinTransaction, prevout_hash: int, prevout_n: int) -> dict:
+            nonlocal use_multiple_trusted_inputs
+            if (prevout_hash, prevout_n) not in trusted_inputs and use_multiple_trusted_inputs:
+                indexes = sorted({txin.prevout.n for txin in c_tx.vin if txin.prevout.hash == prevout_hash})
+                try:
+                    for i in range(0, len(indexes), btchip.MAX_TRUSTED_INPUT_TARGETS):
+                        batch = indexes[i:i + btchip.MAX_TRUSTED_INPUT_TARGETS]
+                        for n, trusted_input in zip(batch, self.app.getTrustedInputs(prevtx, batch)):
+                            trusted_inputs[(prevout_hash, n)] = trusted_input
+                except ApduException as e:
+                    if e.sw != 0x6b00:
+                        raise
+                    use_multiple_trusted_inputs = False
+            if (prevout_hash, prevout_n) not in trusted_inputs:
+                trusted_inputs[(prevout_hash, prevout_n)] = self.app.getTrustedInput(prevtx, prevout_n)
+            # the caller may modify the result
+            return dict(trusted_inputs[(prevout_hash, prevout_n)])
+
         # NOTE: We only support signing Segwit inputs, where we can skip over non-segwit
         # inputs, or non-segwit inputs, where *all* inputs are non-segwit. This is due
         # to Ledger's mutually exclusive signing steps for each type.
@@ -249,13 +276,13 @@ class LegacyClient(Client):
                 # later
                 assert psbt_in.non_witness_utxo is not None
                 ledger_prevtx = bitcoinTransaction(psbt_in.non_witness_utxo.serialize())
-                legacy_inputs.append(self.app.getTrustedInput(ledger_prevtx, txin.prevout.n))
+                legacy_inputs.append(get_trusted_input(ledger_prevtx, txin.prevout.hash, txin.prevout.n))
                 legacy_inputs[-1]["sequence"] = seq_hex
                 has_legacy = True
 
             if psbt_in.non_witness_utxo and use_trusted_segwit:
                 ledger_prevtx = bitcoinTransaction(psbt_in.non_witness_utxo.serialize())
-                segwit_inputs[-1].update(self.app.getTrustedInput(ledger_prevtx, txin.prevout.n))
+                segwit_inputs[-1].update(get_trusted_input(ledger_prevtx, txin.prevout.hash, txin.prevout.n))
 
             pubkeys = []
             signature_attempts = []
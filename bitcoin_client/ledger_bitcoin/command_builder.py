@@ -2,7 +2,7 @@ import enum
 from typing import List, Tuple, Mapping, Union, Iterator, Optional
 
 from .common import bip32_path_from_string, AddressType, sha256, hash256, write_varint
-from .merkle import get_merkleized_map_commitment, MerkleTree, element_hash
+from .merkle import MerkleTree, element_hash
 from .wallet import Wallet
 
 
@@ -34,12 +34,21 @@ class BitcoinInsType(enum.IntEnum):
     GET_WALLET_ADDRESS = 0x03
     SIGN_PSBT = 0x04
     GET_MASTER_FINGERPRINT = 0x05
+    GET_EXTENDED_PUBKEYS = 0x06
+    SIGN_PSBT_BATCHED = 0x07
+    RESUME_SIGN_PSBT = 0x08
     SIGN_MESSAGE = 0x10
+    SIGN_MESSAGE_STREAMED = 0x11
 
 class FrameworkInsType(enum.IntEnum):
     CONTINUE_INTERRUPTED = 0x01
 
 
+class ClientFeature(enum.IntFlag):
+    # bits of P2 declaring the optional client commands supported by the ClientCommandInterpreter
+    GET_MERKLE_LEAVES = 0x01
+
+
 class BitcoinCommandBuilder:
     """APDU command builder for the Bitcoin application."""
 
@@ -94,6 +103,25 @@ class BitcoinCommandBuilder:
             cdata=cdata,
         )
 
+    def get_extended_pubkeys(self, bip32_paths: List[str], display: bool = False):
+        serialized_paths: List[bytes] = []
+        for path in bip32_paths:
+            bip32_path: List[bytes] = bip32_path_from_string(path)
+            serialized_paths.append(len(bip32_path).to_bytes(1, byteorder="big"))
+            serialized_paths.extend(bip32_path)
+
+        cdata: bytes = b"".join([
+            b'\1' if display else b'\0',
+            len(bip32_paths).to_bytes(1, byteorder="big"),
+            *serialized_paths
+        ])
+
+        return self.serialize(
+            cla=self.CLA_BITCOIN,
+            ins=BitcoinInsType.GET_EXTENDED_PUBKEYS,
+            cdata=cdata,
+        )
+
     def register_wallet(self, wallet: Wallet):
         wallet_bytes = wallet.serialize()
 
@@ -129,37 +157,44 @@ class BitcoinCommandBuilder:
 
     def sign_psbt(
         self,
-        global_mapping: Mapping[bytes, bytes],
-        input_mappings: List[Mapping[bytes, bytes]],
-        output_mappings: List[Mapping[bytes, bytes]],
+        global_commitment: bytes,
+        input_commitments: List[bytes],
+        output_commitments: List[bytes],
         wallet: Wallet,
         wallet_hmac: Optional[bytes],
+        batched: bool = False,
+        resume: bool = False,
     ):
+        # the commitments are the serialized Merkleized map commitments of the global map, and of each input and
+        # output map of the psbt (see get_merkleized_map_commitment)
 
         cdata = bytearray()
-        cdata += get_merkleized_map_commitment(global_mapping)
+        cdata += global_commitment
 
-        cdata += write_varint(len(input_mappings))
+        cdata += write_varint(len(input_commitments))
         cdata += MerkleTree(
-            [
-                element_hash(get_merkleized_map_commitment(m_in))
-                for m_in in input_mappings
-            ]
+            [element_hash(c) for c in input_commitments]
         ).root
 
-        cdata += write_varint(len(output_mappings))
+        cdata += write_varint(len(output_commitments))
         cdata += MerkleTree(
-            [
-                element_hash(get_merkleized_map_commitment(m_out))
-                for m_out in output_mappings
-            ]
+            [element_hash(c) for c in output_commitments]
         ).root
 
         cdata += wallet.id
         cdata += wallet_hmac if wallet_hmac is not None else b'\0' * 32
 
+        if resume:
+            ins = BitcoinInsType.RESUME_SIGN_PSBT
+        elif batched:
+            ins = BitcoinInsType.SIGN_PSBT_BATCHED
+        else:
+            ins = BitcoinInsType.SIGN_PSBT
         return self.serialize(
-            cla=self.CLA_BITCOIN, ins=BitcoinInsType.SIGN_PSBT, cdata=bytes(cdata)
+            cla=self.CLA_BITCOIN,
+            ins=ins,
+            p2=ClientFeature.GET_MERKLE_LEAVES,
+            cdata=bytes(cdata)
         )
 
     def get_master_fingerprint(self):
@@ -190,6 +225,23 @@ class BitcoinCommandBuilder:
             cdata=bytes(cdata)
         )
 
+    def sign_message_streamed(self, message: bytes, bip32_path: str):
+        cdata = bytearray()
+
+        bip32_path: List[bytes] = bip32_path_from_string(bip32_path)
+
+        cdata += len(bip32_path).to_bytes(1, byteorder="big")
+        cdata += b''.join(bip32_path)
+
+        # the whole message is a single leaf
+        cdata += element_hash(message)
+
+        return self.serialize(
+            cla=self.CLA_BITCOIN,
+            ins=BitcoinInsType.SIGN_MESSAGE_STREAMED,
+            cdata=bytes(cdata)
+        )
+
     def continue_interrupted(self, cdata: bytes):
         """Command builder for CONTINUE.
 
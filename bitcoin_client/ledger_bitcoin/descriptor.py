@@ -15,7 +15,7 @@ Descriptors can be parsed, however the actual scripts are not generated.
 """
 
 
-from .key import ExtendedKey, KeyOriginInfo, parse_path
+from .key import ExtendedKey, KeyOriginInfo, get_taproot_output_key, parse_path
 from .common import hash160, sha256
 
 from binascii import unhexlify
@@ -168,7 +168,7 @@ class PubkeyProvider(object):
             if self.deriv_path is not None:
                 path_str = self.deriv_path[1:]
                 if path_str[-1] == "*":
-                    path_str = path_str[-1] + str(pos)
+                    path_str = path_str[:-1] + str(pos)
                 path = parse_path(path_str)
                 child_key = self.extkey.derive_pub_path(path)
                 return child_key.pubkey
@@ -432,6 +432,12 @@ class TRDescriptor(Descriptor):
         r += ")"
         return r
 
+    def expand(self, pos: int) -> "ExpandedScripts":
+        if len(self.subdescriptors) > 0:
+            raise NotImplementedError("Only the key path spending of tr() descriptors is supported")
+        script = b"\x51\x20" + get_taproot_output_key(self.pubkeys[0].get_pubkey_bytes(pos))
+        return ExpandedScripts(script, None, None)
+
 def _get_func_expr(s: str) -> Tuple[str, str]:
     """
     Get the function name and then the expression inside
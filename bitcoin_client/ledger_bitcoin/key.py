@@ -24,6 +24,7 @@ from .errors import BadArgumentError
 import binascii
 import hmac
 import hashlib
+import os
 import struct
 from typing import (
     Dict,
@@ -70,13 +71,268 @@ def point_add(p1: Point, p2: Point) -> Point:
     return (x3, (lam * (p1[0] - x3) - p1[1]) % p)
 
 
-def point_mul(p: Point, n: int) -> Point:
-    r = None
-    for i in range(256):
-        if ((n >> i) & 1):
-            r = point_add(r, p)
-        p = point_add(p, p)
-    return r
+# Scalar multiplications are done in Jacobian coordinates: (X, Y, Z) represents the affine point
+# (X/Z^2, Y/Z^3), and Z == 0 represents the point at infinity. This avoids a modular inversion at
+# each addition; only one is needed to convert the result back to affine coordinates.
+
+JacobianPoint = Tuple[int, int, int]
+
+_JACOBIAN_INFINITY: JacobianPoint = (1, 1, 0)
+
+
+def _jacobian_double(P: JacobianPoint) -> JacobianPoint:
+    X, Y, Z = P
+    if Z == 0 or Y == 0:
+        return _JACOBIAN_INFINITY
+    YY = Y * Y % p
+    S = 4 * X * YY % p
+    M = 3 * X * X % p
+    X3 = (M * M - 2 * S) % p
+    return (X3, (M * (S - X3) - 8 * YY * YY) % p, 2 * Y * Z % p)
+
+
+def _jacobian_add(P: JacobianPoint, Q: JacobianPoint) -> JacobianPoint:
+    X1, Y1, Z1 = P
+    X2, Y2, Z2 = Q
+    if Z1 == 0:
+        return Q
+    if Z2 == 0:
+        return P
+    Z1Z1 = Z1 * Z1 % p
+    Z2Z2 = Z2 * Z2 % p
+    U1 = X1 * Z2Z2 % p
+    U2 = X2 * Z1Z1 % p
+    S1 = Y1 * Z2 * Z2Z2 % p
+    S2 = Y2 * Z1 * Z1Z1 % p
+    H = (U2 - U1) % p
+    R = (S2 - S1) % p
+    if H == 0:
+        return _jacobian_double(P) if R == 0 else _JACOBIAN_INFINITY
+    HH = H * H % p
+    HHH = H * HH % p
+    V = U1 * HH % p
+    X3 = (R * R - HHH - 2 * V) % p
+    return (X3, (R * (V - X3) - S1 * HHH) % p, Z1 * Z2 * H % p)
+
+
+def _jacobian_add_affine(P: JacobianPoint, x2: int, y2: int) -> JacobianPoint:
+    # Same as _jacobian_add, for a second point with Z == 1
+    X1, Y1, Z1 = P
+    if Z1 == 0:
+        return (x2, y2, 1)
+    Z1Z1 = Z1 * Z1 % p
+    H = (x2 * Z1Z1 - X1) % p
+    R = (y2 * Z1 * Z1Z1 - Y1) % p
+    if H == 0:
+        return _jacobian_double(P) if R == 0 else _JACOBIAN_INFINITY
+    HH = H * H % p
+    HHH = H * HH % p
+    V = X1 * HH % p
+    X3 = (R * R - HHH - 2 * V) % p
+    return (X3, (R * (V - X3) - Y1 * HHH) % p, Z1 * H % p)
+
+
+# pow(a, -1, p) is much faster than pow(a, p - 2, p), but it requires python 3.8
+try:
+    pow(2, -1, p)
+
+    def _modinv(a: int) -> int:
+        return pow(a, -1, p)
+except ValueError:
+    def _modinv(a: int) -> int:
+        return pow(a, p - 2, p)
+
+
+def _jacobian_to_affine(P: JacobianPoint) -> Point:
+    X, Y, Z = P
+    if Z == 0:
+        return None
+    z_inv = _modinv(Z)
+    z_inv2 = z_inv * z_inv % p
+    return (X * z_inv2 % p, Y * z_inv2 * z_inv % p)
+
+
+def _wnaf(k: int, w: int) -> List[int]:
+    """
+    Returns the width-w non-adjacent form of k, least significant digit first: each digit is either
+    0 or odd in the range (-2^(w-1), 2^(w-1)), and any w consecutive digits have at most one nonzero.
+    """
+    digits: List[int] = []
+    while k > 0:
+        if k & 1:
+            d = k & ((1 << w) - 1)
+            if d >= 1 << (w - 1):
+                d -= 1 << w
+            k -= d
+        else:
+            d = 0
+        digits.append(d)
+        k >>= 1
+    return digits
+
+
+# Window width of the wNAF used for the multiplication of an arbitrary point.
+POINT_MUL_WNAF_WIDTH = 5
+
+
+def _py_point_mul_jacobian(P: Tuple[int, int], k: int) -> JacobianPoint:
+    # odd multiples P, 3P, 5P, ..., (2^(w-1) - 1)P
+    table = [(P[0], P[1], 1)]
+    P2 = _jacobian_double(table[0])
+    for _ in range((1 << (POINT_MUL_WNAF_WIDTH - 2)) - 1):
+        table.append(_jacobian_add(table[-1], P2))
+
+    R = _JACOBIAN_INFINITY
+    for d in reversed(_wnaf(k, POINT_MUL_WNAF_WIDTH)):
+        R = _jacobian_double(R)
+        if d > 0:
+            R = _jacobian_add(R, table[d >> 1])
+        elif d < 0:
+            X, Y, Z = table[(-d) >> 1]
+            R = _jacobian_add(R, (X, p - Y, Z))
+    return R
+
+
+# Multiplications by the generator use a precomputed table, and no doubling: the scalar is written
+# in radix 2^w with signed digits in [-2^(w-1) + 1, 2^(w-1)], and the table holds the affine points
+# j * 2^(w*i) * G for every position i and every 1 <= j <= 2^(w-1). A negative digit adds the
+# negation of the corresponding point, which is free in affine coordinates.
+
+# Window width of the precomputed table of the generator.
+GENERATOR_TABLE_WIDTH = 5
+
+_generator_table: Optional[List[List[Tuple[int, int]]]] = None
+
+
+def _get_generator_table() -> List[List[Tuple[int, int]]]:
+    global _generator_table
+
+    if _generator_table is None:
+        w = GENERATOR_TABLE_WIDTH
+        n_windows = (256 + w) // w  # one more digit than 256 bits, for the last carry
+        half = 1 << (w - 1)
+
+        points: List[JacobianPoint] = []
+        base: JacobianPoint = (G[0], G[1], 1)
+        for _ in range(n_windows):
+            Q = base
+            for _ in range(half):
+                points.append(Q)
+                Q = _jacobian_add(Q, base)
+            # base <- 2^w * base = 2 * (2^(w-1) * base)
+            base = _jacobian_double(points[-1])
+
+        # convert all the points to affine coordinates with a single modular inversion
+        prefix = [1] * len(points)
+        acc = 1
+        for i, (_, _, Z) in enumerate(points):
+            prefix[i] = acc
+            acc = acc * Z % p
+        acc_inv = _modinv(acc)
+        affine: List[Tuple[int, int]] = [(0, 0)] * len(points)
+        for i in range(len(points) - 1, -1, -1):
+            X, Y, Z = points[i]
+            z_inv = acc_inv * prefix[i] % p
+            acc_inv = acc_inv * Z % p
+            z_inv2 = z_inv * z_inv % p
+            affine[i] = (X * z_inv2 % p, Y * z_inv2 * z_inv % p)
+
+        _generator_table = [affine[i * half:(i + 1) * half] for i in range(n_windows)]
+
+    return _generator_table
+
+
+def _py_generator_mul_jacobian(k: int) -> JacobianPoint:
+    table = _get_generator_table()
+    w = GENERATOR_TABLE_WIDTH
+    mask = (1 << w) - 1
+    half = 1 << (w - 1)
+
+    R = _JACOBIAN_INFINITY
+    i = 0
+    while k > 0:
+        d = k & mask
+        if d > half:
+            d -= 1 << w
+        k = (k - d) >> w
+        if d > 0:
+            x, y = table[i][d - 1]
+            R = _jacobian_add_affine(R, x, y)
+        elif d < 0:
+            x, y = table[i][-d - 1]
+            R = _jacobian_add_affine(R, x, p - y)
+        i += 1
+    return R
+
+
+def _py_point_mul(P: Point, k: int) -> Point:
+    k %= n
+    if P is None or k == 0:
+        return None
+    if P == G:
+        return _jacobian_to_affine(_py_generator_mul_jacobian(k))
+    return _jacobian_to_affine(_py_point_mul_jacobian(P, k))
+
+
+def _py_pubkey_tweak_add(pubkey: bytes, t: int) -> bytes:
+    P = bytes_to_point(pubkey)
+    R = _jacobian_to_affine(_jacobian_add_affine(_py_generator_mul_jacobian(t % n), P[0], P[1]))
+    if R is None:
+        raise ValueError("The tweaked public key is the point at infinity")
+    return point_to_bytes(R)
+
+
+def _coincurve_point_mul(P: Point, k: int) -> Point:
+    k %= n
+    if P is None or k == 0:
+        return None
+    if P == G:
+        return _coincurve.PublicKey.from_valid_secret(k.to_bytes(32, byteorder="big")).point()
+    return _coincurve.PublicKey.from_point(P[0], P[1]).multiply(k.to_bytes(32, byteorder="big")).point()
+
+
+def _coincurve_pubkey_tweak_add(pubkey: bytes, t: int) -> bytes:
+    key = _coincurve.PublicKey(pubkey)
+    t %= n
+    if t != 0:
+        try:
+            key = key.add(t.to_bytes(32, byteorder="big"))
+        except ValueError:
+            raise ValueError("The tweaked public key is the point at infinity")
+    return key.format(compressed=True)
+
+
+# The backend for the scalar multiplications is selected at import time: libsecp256k1 (via the
+# coincurve package) if it is installed, otherwise the pure Python implementation above.
+# Setting the environment variable LEDGER_BITCOIN_EC_BACKEND to "python" forces the latter.
+try:
+    if os.environ.get("LEDGER_BITCOIN_EC_BACKEND", "").lower() == "python":
+        raise ImportError
+    import coincurve as _coincurve
+    EC_BACKEND = "coincurve"
+except ImportError:
+    EC_BACKEND = "python"
+
+
+def point_mul(P: Point, k: int) -> Point:
+    """
+    Returns the point k*P.
+    """
+    if EC_BACKEND == "coincurve":
+        return _coincurve_point_mul(P, k)
+    return _py_point_mul(P, k)
+
+
+def pubkey_tweak_add(pubkey: bytes, t: int) -> bytes:
+    """
+    Returns the compressed serialization of the point P + t*G, where P is the point serialized in
+    pubkey (compressed or uncompressed).
+
+    Raises ValueError if the result is the point at infinity.
+    """
+    if EC_BACKEND == "coincurve":
+        return _coincurve_pubkey_tweak_add(pubkey, t)
+    return _py_pubkey_tweak_add(pubkey, t)
 
 
 def deserialize_point(b: bytes) -> Point:
@@ -120,8 +376,9 @@ def taproot_tweak_pubkey(pubkey: bytes, h: bytes) -> Tuple[int, bytes]:
     t = int_from_bytes(tagged_hash("TapTweak", pubkey + h))
     if t >= p:
         raise ValueError
-    Q = point_add(lift_x(int_from_bytes(pubkey)), point_mul(G, t))
-    return 0 if Q[1] & 1 == 0 else 1, Q[0].to_bytes(32, byteorder="big")
+    # b'\x02' + pubkey is the compressed serialization of lift_x(pubkey)
+    Q = pubkey_tweak_add(b'\x02' + pubkey, t)
+    return Q[0] & 1, Q[1:]
 
 
 def get_taproot_output_key(derived_key: bytes) -> bytes:
@@ -298,10 +555,9 @@ class ExtendedKey(object):
 
         # Construct curve point Il*G+K
         Il_int = int(binascii.hexlify(Il), 16)
-        child_pubkey = point_add(point_mul(G, Il_int), bytes_to_point(self.pubkey))
+        pubkey = pubkey_tweak_add(self.pubkey, Il_int)
 
         # Construct and return a new BIP32Key
-        pubkey = point_to_bytes(child_pubkey)
         chaincode = Ir
         fingerprint = hash160(self.pubkey)[0:4]
         return ExtendedKey(ExtendedKey.TESTNET_PUBLIC if self.is_testnet else ExtendedKey.MAINNET_PUBLIC, self.depth + 1, fingerprint, i, chaincode, None, pubkey)
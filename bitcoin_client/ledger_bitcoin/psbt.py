@@ -11,6 +11,7 @@ import struct
 
 from io import BytesIO, BufferedReader
 from typing import (
+    Any,
     Dict,
     List,
     Mapping,
@@ -19,6 +20,7 @@ from typing import (
     Sequence,
     Set,
     Tuple,
+    Union,
 )
 
 from .key import KeyOriginInfo
@@ -29,10 +31,14 @@ from .tx import (
     CTxIn,
     CTxInWitness,
     CTxOut,
+    get_txid_from_serialized,
 )
 from ._serialize import (
+    BufferReader,
     deser_compact_size,
+    deser_compact_size_at,
     deser_string,
+    deser_string_view,
     Readable,
     ser_compact_size,
     ser_string,
@@ -81,6 +87,33 @@ def SerializeHDKeypath(hd_keypaths: Mapping[bytes, KeyOriginInfo], type: bytes)
         r += ser_string(packed)
     return r
 
+def parse_map_spans(buf: memoryview, pos: int) -> Tuple[Dict[bytes, memoryview], int]:
+    """
+    :meta private:
+
+    Parses a serialized PSBT map at the given position of a buffer, without copying the values.
+
+    :param buf: The buffer containing the serialized PSBT.
+    :param pos: The position of the first key-value pair of the map in the buffer.
+    :returns: The mapping of the keys to views of the corresponding values in the buffer, and the position that
+        follows the separator at the end of the map.
+    """
+    mapping: Dict[bytes, memoryview] = {}
+    try:
+        while True:
+            key_len, pos = deser_compact_size_at(buf, pos)
+            if key_len == 0:
+                return mapping, pos
+            key = bytes(buf[pos:pos + key_len])
+            value_len, pos = deser_compact_size_at(buf, pos + key_len)
+            if pos + value_len > len(buf):
+                raise ValueError("Unexpected end of buffer")
+            mapping[key] = buf[pos:pos + value_len]
+            pos += value_len
+    except ValueError:
+        raise PSBTSerializationError("Invalid PSBT map")
+
+
 class PartiallySignedInput:
     """
     An object for a PSBT input map.
@@ -108,7 +141,10 @@ class PartiallySignedInput:
     PSBT_IN_TAP_MERKLE_ROOT = 0x18
 
     def __init__(self, version: int) -> None:
-        self.non_witness_utxo: Optional[CTransaction] = None
+        # the non-witness UTXO is only deserialized when it is accessed; until then, it is kept
+        # serialized (possibly as a view of the buffer of the whole PSBT)
+        self._non_witness_utxo: Optional[CTransaction] = None
+        self._non_witness_utxo_bytes: Optional[Union[bytes, memoryview]] = None
         self.witness_utxo: Optional[CTxOut] = None
         self.partial_sigs: Dict[bytes, bytes] = {}
         self.sighash: Optional[int] = None
@@ -132,6 +168,45 @@ class PartiallySignedInput:
 
         self.version: int = version
 
+    @property
+    def non_witness_utxo(self) -> Optional[CTransaction]:
+        if self._non_witness_utxo is None and self._non_witness_utxo_bytes is not None:
+            tx = CTransaction()
+            tx.deserialize(BufferReader(self._non_witness_utxo_bytes))
+            tx.rehash()
+            # the transaction might be modified by the caller, so the serialization is dropped
+            self._non_witness_utxo = tx
+            self._non_witness_utxo_bytes = None
+        return self._non_witness_utxo
+
+    @non_witness_utxo.setter
+    def non_witness_utxo(self, tx: Optional[CTransaction]) -> None:
+        self._non_witness_utxo = tx
+        self._non_witness_utxo_bytes = None
+
+    def has_non_witness_utxo(self) -> bool:
+        """
+        Whether the non-witness UTXO is present, without deserializing it.
+        """
+        return self._non_witness_utxo is not None or self._non_witness_utxo_bytes is not None
+
+    def get_non_witness_utxo_bytes(self) -> Optional[Union[bytes, memoryview]]:
+        """
+        Returns the non-witness UTXO serialized with witnesses, without deserializing it if it was not accessed.
+        """
+        if self._non_witness_utxo_bytes is not None:
+            return self._non_witness_utxo_bytes
+        if self._non_witness_utxo is not None:
+            return self._non_witness_utxo.serialize_with_witness()
+        return None
+
+    def __getstate__(self) -> Dict[str, Any]:
+        # memoryviews cannot be pickled (or deep-copied)
+        state = self.__dict__.copy()
+        if isinstance(state["_non_witness_utxo_bytes"], memoryview):
+            state["_non_witness_utxo_bytes"] = bytes(state["_non_witness_utxo_bytes"])
+        return state
+
     def set_null(self) -> None:
         """
         Clear all values in this PSBT input map.
@@ -185,10 +260,8 @@ class PartiallySignedInput:
                     raise PSBTSerializationError("Duplicate Key, input non witness utxo already provided")
                 elif len(key) != 1:
                     raise PSBTSerializationError("non witness utxo key is more than one byte type")
-                self.non_witness_utxo = CTransaction()
-                utxo_bytes = BufferedReader(BytesIO(deser_string(f))) # type: ignore
-                self.non_witness_utxo.deserialize(utxo_bytes)
-                self.non_witness_utxo.rehash()
+                self.non_witness_utxo = None
+                self._non_witness_utxo_bytes = deser_string_view(f)
             elif key_type == PartiallySignedInput.PSBT_IN_WITNESS_UTXO:
                 if key in key_lookup:
                     raise PSBTSerializationError("Duplicate Key, input witness utxo already provided")
@@ -377,10 +450,11 @@ class PartiallySignedInput:
         """
         r = b""
 
-        if self.non_witness_utxo:
+        tx = self.get_non_witness_utxo_bytes()
+        if tx is not None:
             r += ser_string(ser_compact_size(PartiallySignedInput.PSBT_IN_NON_WITNESS_UTXO))
-            tx = self.non_witness_utxo.serialize_with_witness()
-            r += ser_string(tx)
+            r += ser_compact_size(len(tx))
+            r += tx
 
         if self.witness_utxo:
             r += ser_string(ser_compact_size(PartiallySignedInput.PSBT_IN_WITNESS_UTXO))
@@ -707,9 +781,19 @@ class PSBT(object):
 
         :param psbt: A base 64 PSBT.
         """
-        psbt_bytes = base64.b64decode(psbt.strip())
-        f = BufferedReader(BytesIO(psbt_bytes)) # type: ignore
-        end = len(psbt_bytes)
+        self.deserialize_bytes(base64.b64decode(psbt.strip()))
+
+    def deserialize_bytes(self, psbt_bytes: Union[bytes, bytearray, memoryview]) -> None:
+        """
+        Deserialize a binary PSBT.
+
+        The buffer is not copied: the large values (the non-witness UTXOs) are kept as views of it, and only
+        deserialized when they are accessed. Therefore, the buffer must not be modified afterwards.
+
+        :param psbt_bytes: The PSBT.
+        """
+        f = BufferReader(psbt_bytes)
+        end = len(memoryview(psbt_bytes))
 
         # Read the magic bytes
         magic = f.read(5)
@@ -860,9 +944,13 @@ class PSBT(object):
             else:
                 prev_txid = ser_uint256(self.tx.vin[i].prevout.hash)
 
-            if psbt_in.non_witness_utxo:
-                psbt_in.non_witness_utxo.rehash()
-                if psbt_in.non_witness_utxo.hash != prev_txid:
+            utxo_bytes = psbt_in.get_non_witness_utxo_bytes()
+            if utxo_bytes is not None:
+                try:
+                    utxo_txid = get_txid_from_serialized(utxo_bytes)
+                except ValueError:
+                    raise PSBTSerializationError("Invalid non-witness UTXO")
+                if utxo_txid != prev_txid:
                     raise PSBTSerializationError("Non-witness UTXO does not match outpoint hash")
 
         if (len(self.inputs) != input_count):
@@ -889,6 +977,14 @@ class PSBT(object):
 
         :returns: The base 64 encoded string.
         """
+        return base64.b64encode(self.serialize_bytes()).decode()
+
+    def serialize_bytes(self) -> bytes:
+        """
+        Serialize the PSBT in binary.
+
+        :returns: The serialized PSBT.
+        """
         r = b""
 
         # magic bytes
@@ -937,16 +1033,8 @@ class PSBT(object):
         # separator
         r += b"\x00"
 
-        # inputs
-        for input in self.inputs:
-            r += input.serialize()
-
-        # outputs
-        for output in self.outputs:
-            r += output.serialize()
-
-        # return hex string
-        return base64.b64encode(r).decode()
+        # the inputs and outputs are joined at once, as they can be large
+        return b"".join([r] + [input.serialize() for input in self.inputs] + [output.serialize() for output in self.outputs])
 
     def cache_unsigned_tx_pieces(self) -> None:
         """
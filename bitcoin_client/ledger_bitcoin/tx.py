@@ -15,6 +15,7 @@ CTransaction,CTxIn, CTxOut, etc....:
 """
 
 import copy
+import hashlib
 import struct
 
 from .common import (
@@ -29,6 +30,7 @@ from ._script import (
     is_p2wsh,
 )
 from ._serialize import (
+    deser_compact_size_at,
     deser_uint256,
     deser_string,
     deser_string_vector,
@@ -45,6 +47,7 @@ from typing import (
     List,
     Optional,
     Tuple,
+    Union,
 )
 
 # Objects that map to bitcoind objects, which can be serialized/deserialized
@@ -298,3 +301,40 @@ class CTransaction(object):
     def __repr__(self) -> str:
         return "CTransaction(nVersion=%i vin=%s vout=%s wit=%s nLockTime=%i)" \
             % (self.nVersion, repr(self.vin), repr(self.vout), repr(self.wit), self.nLockTime)
+
+
+def get_txid_from_serialized(tx: Union[bytes, memoryview]) -> bytes:
+    """
+    Computes the txid (in the same byte order as CTransaction.hash) of a serialized transaction, with or without
+    witnesses, without deserializing it.
+
+    :param tx: The serialized transaction
+    :returns: The hash256 of the transaction serialized without witnesses
+    :raises: ValueError: if the transaction is malformed
+    """
+    view = memoryview(tx)
+    if len(view) < 10:
+        raise ValueError("Transaction too short")
+
+    # the segwit marker (an empty list of inputs) and a nonzero flag
+    if view[4] != 0 or view[5] == 0:
+        return hash256(view)
+
+    # find the end of the outputs, where the witnesses start
+    pos = 6
+    n_inputs, pos = deser_compact_size_at(view, pos)
+    for _ in range(n_inputs):
+        script_len, pos = deser_compact_size_at(view, pos + 36)
+        pos += script_len + 4
+    n_outputs, pos = deser_compact_size_at(view, pos)
+    for _ in range(n_outputs):
+        script_len, pos = deser_compact_size_at(view, pos + 8)
+        pos += script_len
+    if pos + 4 > len(view):
+        raise ValueError("Unexpected end of transaction")
+
+    h = hashlib.sha256()
+    h.update(view[:4])
+    h.update(view[6:pos])
+    h.update(view[-4:])
+    return hashlib.sha256(h.digest()).digest()
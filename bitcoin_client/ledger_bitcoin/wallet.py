@@ -1,13 +1,64 @@
+import struct
+from concurrent.futures import ProcessPoolExecutor
 from enum import IntEnum
 from typing import List
 
 from hashlib import sha256
 
-from .common import serialize_str, AddressType, write_varint
+from . import _base58 as base58
+from ._script import script_to_address
+from .common import serialize_str, AddressType, Chain, write_varint, hash256
+from .descriptor import parse_descriptor
+from .key import ExtendedKey, KeyOriginInfo, HARDENED_FLAG
 from .merkle import MerkleTree, element_hash
 
 class WalletType(IntEnum):
     POLICYMAP = 1
+    POLICYMAP_BINARY_KEYS = 2
+
+
+KEY_INFO_BINARY_HAS_KEY_ORIGIN = 0x01
+KEY_INFO_BINARY_HAS_WILDCARD = 0x02
+
+
+def serialize_key_info_binary(key_info: str) -> bytes:
+    """
+    Converts a key information (e.g. "[d34db33f/48'/1'/0'/2']tpub.../**") to the binary encoding used
+    by the POLICYMAP_BINARY_KEYS wallets:
+       - 1 byte   : flags (KEY_INFO_BINARY_HAS_KEY_ORIGIN, KEY_INFO_BINARY_HAS_WILDCARD)
+       - 4 bytes  : fingerprint (only if there is the key origin)
+       - 1 byte   : number of derivation steps (only if there is the key origin)
+       - (var)    : derivation steps, 4 bytes little-endian each (only if there is the key origin)
+       - 78 bytes : the serialized extended pubkey, without the base58check encoding
+    """
+    flags = 0
+    origin = b""
+    if key_info.startswith("["):
+        end = key_info.index("]")
+        origin_info = KeyOriginInfo.from_string(key_info[1:end])
+        flags |= KEY_INFO_BINARY_HAS_KEY_ORIGIN
+        origin = b"".join([
+            origin_info.fingerprint,
+            len(origin_info.path).to_bytes(1, byteorder="little"),
+            struct.pack("<" + "I" * len(origin_info.path), *origin_info.path)
+        ])
+        key_info = key_info[end + 1:]
+
+    if key_info.endswith("/**"):
+        flags |= KEY_INFO_BINARY_HAS_WILDCARD
+        key_info = key_info[:-3]
+
+    ext_pubkey = base58.decode(key_info)
+    if len(ext_pubkey) != 78 + 4 or hash256(ext_pubkey[:78])[:4] != ext_pubkey[78:]:
+        raise ValueError(f"Invalid extended pubkey: {key_info}")
+
+    return bytes([flags]) + origin + ext_pubkey[:78]
+
+
+def _derive_addresses(descriptor: str, chain: Chain, start: int, count: int) -> List[str]:
+    # Module-level function, so that it can be run in the worker processes of derive_addresses
+    desc = parse_descriptor(descriptor)
+    return [script_to_address(desc.expand(pos).output_script, chain) for pos in range(start, start + count)]
 
 
 # should not be instantiated directly
@@ -40,10 +91,15 @@ class PolicyMapWallet(Wallet):
        - 32-bytes : root of the Merkle tree of all the keys information.
 
     The specific format of the keys is deferred to subclasses.
+
+    If binary_keys is True, the wallet type is POLICYMAP_BINARY_KEYS, and the leaves of the Merkle
+    tree are the key informations in the binary encoding (see serialize_key_info_binary), so that
+    the device does not need to decode the base58check-encoded extended pubkeys.
     """
 
-    def __init__(self, name: str, policy_map: str, keys_info: List[str]):
-        super().__init__(name, WalletType.POLICYMAP)
+    def __init__(self, name: str, policy_map: str, keys_info: List[str], binary_keys: bool = False):
+        super().__init__(
+            name, WalletType.POLICYMAP_BINARY_KEYS if binary_keys else WalletType.POLICYMAP)
         self.policy_map = policy_map
         self.keys_info = keys_info
 
@@ -51,8 +107,15 @@ class PolicyMapWallet(Wallet):
     def n_keys(self) -> int:
         return len(self.keys_info)
 
+    @property
+    def keys_info_leaves(self) -> List[bytes]:
+        """The key informations, as sent to the device."""
+        if self.type == WalletType.POLICYMAP_BINARY_KEYS:
+            return [serialize_key_info_binary(k) for k in self.keys_info]
+        return [k.encode("latin-1") for k in self.keys_info]
+
     def serialize(self) -> bytes:
-        keys_info_hashes = map(lambda k: element_hash(k.encode("latin-1")), self.keys_info)
+        keys_info_hashes = map(lambda k: element_hash(k), self.keys_info_leaves)
 
         return b"".join([
             super().serialize(),
@@ -71,8 +134,47 @@ class PolicyMapWallet(Wallet):
             desc = desc.replace(f"@{i}", key)
         return desc
 
+    def derive_addresses(self, change: bool, start: int, count: int, chain: Chain = Chain.MAIN, processes: int = 1) -> List[str]:
+        """
+        Derives locally the addresses of the wallet at the indexes start, start + 1, ..., start + count - 1, without
+        using the device.
+
+        The extended pubkeys at the change level are derived only once; then, each address only needs one derivation
+        step per key.
+
+        :param change: Whether to derive the change addresses, rather than the receive addresses
+        :param start: The index of the first address
+        :param count: The number of addresses
+        :param chain: The network of the addresses
+        :param processes: If larger than 1, the addresses are derived in parallel by this number of processes
+        :return: The list of the `count` addresses
+        """
+        if start < 0 or count < 0 or start + count > HARDENED_FLAG:
+            raise ValueError("Invalid range of address indexes")
+
+        desc = self.policy_map
+        for i in reversed(range(self.n_keys)):
+            key = self.keys_info[i]
+            if key.endswith("/**"):
+                # the key origin is not needed for the scripts
+                xpub = key[key.index("]") + 1:-3] if key.startswith("[") else key[:-3]
+                change_xpub = ExtendedKey.deserialize(xpub).derive_pub(1 if change else 0)
+                key = change_xpub.to_string() + "/*"
+            desc = desc.replace(f"@{i}", key)
+
+        if processes <= 1 or count < 2 * processes:
+            return _derive_addresses(desc, chain, start, count)
+
+        chunk_size = (count + processes - 1) // processes
+        with ProcessPoolExecutor(max_workers=processes) as executor:
+            futures = [
+                executor.submit(_derive_addresses, desc, chain, chunk_start, min(chunk_size, start + count - chunk_start))
+                for chunk_start in range(start, start + count, chunk_size)
+            ]
+            return [address for future in futures for address in future.result()]
+
 class MultisigWallet(PolicyMapWallet):
-    def __init__(self, name: str, address_type: AddressType, threshold: int, keys_info: List[str], sorted: bool = True) -> None:
+    def __init__(self, name: str, address_type: AddressType, threshold: int, keys_info: List[str], sorted: bool = True, binary_keys: bool = False) -> None:
         n_keys = len(keys_info)
 
         if not (1 <= threshold <= n_keys <= 15):
@@ -99,6 +201,6 @@ class MultisigWallet(PolicyMapWallet):
             policy_suffix
         ])
 
-        super().__init__(name, policy_map, keys_info)
+        super().__init__(name, policy_map, keys_info, binary_keys)
 
         self.threshold = threshold
@@ -139,6 +139,15 @@ describe("test AppClient", () => {
     expect(result).toEqual("tpubDGnetmJDCL18TyaaoyRAYbkSE9wbHktSdTS4mfsR6inC8c2r6TjdBt3wkqEQhHYPtXpa46xpxDaCXU2PRNUGVvDzAHPG6hHRavYbwAGfnFr")
   });
 
+  it("can get several extended pubkeys", async () => {
+    const result = await app.getExtendedPubkeys(["m/44'/1'/0'", "m/49'/1'/1'/1/3"], false);
+
+    expect(result).toEqual([
+      "tpubDCwYjpDhUdPGP5rS3wgNg13mTrrjBuG8V9VpWbyptX6TRPbNoZVXsoVUSkCjmQ8jJycjuDKBb9eataSymXakTTaGifxR6kmVsfFehH1ZgJT",
+      "tpubDGnetmJDCL18TyaaoyRAYbkSE9wbHktSdTS4mfsR6inC8c2r6TjdBt3wkqEQhHYPtXpa46xpxDaCXU2PRNUGVvDzAHPG6hHRavYbwAGfnFr",
+    ]);
+  });
+
   it("can get wallet addresses", async () => {
     const testcases: {
       policy: WalletPolicy,
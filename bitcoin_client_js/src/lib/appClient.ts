@@ -6,17 +6,25 @@ import { MerkelizedPsbt } from './merkelizedPsbt';
 import { hashLeaf, Merkle } from './merkle';
 import { WalletPolicy } from './policy';
 import { PsbtV2 } from './psbtv2';
-import { createVarint } from './varint';
+import { createVarint, parseVarint, sanitizeBigintToNumber } from './varint';
 
 const CLA_BTC = 0xe1;
+
 const CLA_FRAMEWORK = 0xf8;
 
+const SW_INS_NOT_SUPPORTED = 0x6d00;
+
+// Maximum number of paths in a single GET_EXTENDED_PUBKEYS request
+const MAX_PATHS_PER_GET_PUBKEYS = 16;
+
 enum BitcoinIns {
   GET_PUBKEY = 0x00,
   REGISTER_WALLET = 0x02,
   GET_WALLET_ADDRESS = 0x03,
   SIGN_PSBT = 0x04,
   GET_MASTER_FINGERPRINT = 0x05,
+  GET_PUBKEYS = 0x06,
+  SIGN_PSBT_BATCHED = 0x07,
   SIGN_MESSAGE = 0x10,
 }
 
@@ -24,6 +32,11 @@ enum FrameworkIns {
   CONTINUE_INTERRUPTED = 0x01,
 }
 
+// Bits of P2 declaring the optional client commands that the ClientCommandInterpreter supports
+enum ClientFeature {
+  GET_MERKLE_LEAVES = 0x01,
+}
+
 /**
  * This class encapsulates the APDU protocol documented at
  * https://github.com/LedgerHQ/app-bitcoin-new/blob/master/doc/bitcoin.md
@@ -31,6 +44,9 @@ enum FrameworkIns {
 export class AppClient {
   readonly transport: Transport;
 
+  // whether the app supports SIGN_PSBT_BATCHED; undefined until the first signPsbt call
+  private supportsSignPsbtBatched?: boolean;
+
   constructor(transport: Transport) {
     this.transport = transport;
   }
@@ -38,13 +54,14 @@ export class AppClient {
   private async makeRequest(
     ins: BitcoinIns,
     data: Buffer,
-    cci?: ClientCommandInterpreter
+    cci?: ClientCommandInterpreter,
+    p2: number = 0
   ): Promise<Buffer> {
     let response: Buffer = await this.transport.send(
       CLA_BTC,
       ins,
       0,
-      0,
+      p2,
       data,
       [0x9000, 0xe000]
     );
@@ -97,6 +114,71 @@ export class AppClient {
     return response.toString('ascii');
   }
 
+  /**
+   * Requests the BIP-32 extended pubkeys for several paths to the hardware wallet. The result is the same
+   * as calling `getExtendedPubkey` for each path, but several paths are sent in each request, and the
+   * hardware wallet only derives once the ancestors that the paths have in common.
+   * If `display` is `false`, only standard paths will be accepted; an error is returned if any unusual path
+   * is requested.
+   * If `display` is `true`, each requested path is shown on screen for user verification.
+   *
+   * @param paths the requested BIP-32 paths as strings
+   * @param display `false` to silently retrieve the pubkeys for standard paths, `true` to display each path on
+   * screen
+   * @returns the base58-encoded serialized extended pubkeys (xpubs), in the same order as `paths`
+   */
+  async getExtendedPubkeys(
+    paths: readonly string[],
+    display: boolean = false
+  ): Promise<string[]> {
+    // the paths are split in batches that fit in a single APDU
+    const batches: Buffer[][] = [[]];
+    let batchLength = 2;
+    for (const path of paths) {
+      const pathElements = pathStringToArray(path);
+      if (pathElements.length > 6) {
+        throw new Error('Path too long. At most 6 levels allowed.');
+      }
+      const serializedPath = pathElementsToBuffer(pathElements);
+      const batch = batches[batches.length - 1];
+      if (
+        batch.length == MAX_PATHS_PER_GET_PUBKEYS ||
+        batchLength + serializedPath.length > 255
+      ) {
+        batches.push([]);
+        batchLength = 2;
+      }
+      batches[batches.length - 1].push(serializedPath);
+      batchLength += serializedPath.length;
+    }
+
+    const result: string[] = [];
+    for (const batch of batches) {
+      if (batch.length == 0) {
+        continue;
+      }
+
+      const clientInterpreter = new ClientCommandInterpreter();
+      await this.makeRequest(
+        BitcoinIns.GET_PUBKEYS,
+        Buffer.concat([
+          Buffer.from([display ? 1 : 0, batch.length]),
+          ...batch,
+        ]),
+        clientInterpreter
+      );
+
+      const yielded = clientInterpreter.getYielded();
+      if (yielded.length != batch.length) {
+        throw new Error(
+          `Invalid response. Expected ${batch.length} pubkeys, got ${yielded.length}`
+        );
+      }
+      result.push(...yielded.map((pubkey) => pubkey.toString('ascii')));
+    }
+    return result;
+  }
+
   /**
    * Registers a `WalletPolicy`, after interactive verification from the user.
    * On success, after user's approval, this function returns the id (which is the same that can be computed with
@@ -113,9 +195,7 @@ export class AppClient {
 
     const clientInterpreter = new ClientCommandInterpreter();
     clientInterpreter.addKnownPreimage(serializedWalletPolicy);
-    clientInterpreter.addKnownList(
-      walletPolicy.keys.map((k) => Buffer.from(k, 'ascii'))
-    );
+    clientInterpreter.addKnownList(walletPolicy.getKeyLeaves());
 
     const response = await this.makeRequest(
       BitcoinIns.REGISTER_WALLET,
@@ -163,9 +243,7 @@ export class AppClient {
     }
 
     const clientInterpreter = new ClientCommandInterpreter();
-    clientInterpreter.addKnownList(
-      walletPolicy.keys.map((k) => Buffer.from(k, 'ascii'))
-    );
+    clientInterpreter.addKnownList(walletPolicy.getKeyLeaves());
     clientInterpreter.addKnownPreimage(walletPolicy.serialize());
 
     const addressIndexBuffer = Buffer.alloc(4);
@@ -193,7 +271,7 @@ export class AppClient {
    * @param psbt an instance of `PsbtV2`
    * @param walletPolicy the `WalletPolicy` to use for signing
    * @param walletHMAC the 32-byte hmac obtained during wallet policy registration, or `null` for a standard policy
-   * @param progressCallback optionally, a callback that will be called every time a signature is produced during
+   * @param progressCallback optionally, a callback that will be called every time signatures are received during
    * the signing process. The callback does not receive any argument, but can be used to track progress.
    * @returns a map from numbers to signatures. For each input index `i` that is a key of the returned map, the
    * corresponding value is the signature for the `i`-th input of the `psbt`.
@@ -213,9 +291,7 @@ export class AppClient {
     const clientInterpreter = new ClientCommandInterpreter(progressCallback);
 
     // prepare ClientCommandInterpreter
-    clientInterpreter.addKnownList(
-      walletPolicy.keys.map((k) => Buffer.from(k, 'ascii'))
-    );
+    clientInterpreter.addKnownList(walletPolicy.getKeyLeaves());
     clientInterpreter.addKnownPreimage(walletPolicy.serialize());
 
     clientInterpreter.addKnownMapping(merkelizedPsbt.globalMerkleMap);
@@ -235,25 +311,69 @@ export class AppClient {
       merkelizedPsbt.outputMapCommitments.map((m) => hashLeaf(m))
     ).getRoot();
 
-    await this.makeRequest(
-      BitcoinIns.SIGN_PSBT,
-      Buffer.concat([
-        merkelizedPsbt.getGlobalKeysValuesRoot(),
-        createVarint(merkelizedPsbt.getGlobalInputCount()),
-        inputMapsRoot,
-        createVarint(merkelizedPsbt.getGlobalOutputCount()),
-        outputMapsRoot,
-        walletPolicy.getId(),
-        walletHMAC || Buffer.alloc(32, 0),
-      ]),
-      clientInterpreter
-    );
+    const data = Buffer.concat([
+      merkelizedPsbt.getGlobalKeysValuesRoot(),
+      createVarint(merkelizedPsbt.getGlobalInputCount()),
+      inputMapsRoot,
+      createVarint(merkelizedPsbt.getGlobalOutputCount()),
+      outputMapsRoot,
+      walletPolicy.getId(),
+      walletHMAC || Buffer.alloc(32, 0),
+    ]);
+
+    // SIGN_PSBT_BATCHED yields several signatures at once; older versions of the app reject it
+    // with SW_INS_NOT_SUPPORTED before executing anything, and we fall back to SIGN_PSBT.
+    let batched = this.supportsSignPsbtBatched !== false;
+    if (batched) {
+      try {
+        await this.makeRequest(
+          BitcoinIns.SIGN_PSBT_BATCHED,
+          data,
+          clientInterpreter,
+          ClientFeature.GET_MERKLE_LEAVES
+        );
+        this.supportsSignPsbtBatched = true;
+      } catch (e) {
+        if ((e as { statusCode?: number }).statusCode !== SW_INS_NOT_SUPPORTED) {
+          throw e;
+        }
+        this.supportsSignPsbtBatched = batched = false;
+      }
+    }
+    if (!batched) {
+      await this.makeRequest(
+        BitcoinIns.SIGN_PSBT,
+        data,
+        clientInterpreter,
+        ClientFeature.GET_MERKLE_LEAVES
+      );
+    }
 
     const yielded = clientInterpreter.getYielded();
 
     const ret: Map<number, Buffer> = new Map();
-    for (const inputAndSig of yielded) {
-      ret.set(inputAndSig[0], inputAndSig.slice(1));
+    for (const response of yielded) {
+      let offset = 0;
+      do {
+        const [inputIndex, indexLen] = parseVarint(response, offset);
+        offset += indexLen;
+        let sigLen = response.length - offset;
+        if (batched) {
+          if (offset >= response.length) {
+            throw new Error('Invalid signatures batch');
+          }
+          sigLen = response[offset];
+          offset += 1;
+        }
+        if (offset + sigLen > response.length) {
+          throw new Error('Invalid signatures batch');
+        }
+        ret.set(
+          sanitizeBigintToNumber(inputIndex),
+          response.slice(offset, offset + sigLen)
+        );
+        offset += sigLen;
+      } while (offset < response.length);
     }
     return ret;
   }
@@ -10,6 +10,7 @@ enum ClientCommandCode {
   GET_PREIMAGE = 0x40,
   GET_MERKLE_LEAF_PROOF = 0x41,
   GET_MERKLE_LEAF_INDEX = 0x42,
+  GET_MERKLE_LEAVES = 0x43,
   GET_MORE_ELEMENTS = 0xa0,
 }
 
@@ -220,6 +221,84 @@ export class GetMerkleLeafIndexCommand extends ClientCommand {
   }
 }
 
+export class GetMerkleLeavesCommand extends ClientCommand {
+  private readonly known_trees: ReadonlyMap<string, Merkle>;
+  private readonly known_preimages: ReadonlyMap<string, Buffer>;
+
+  readonly code = ClientCommandCode.GET_MERKLE_LEAVES;
+
+  constructor(
+    known_trees: ReadonlyMap<string, Merkle>,
+    known_preimages: ReadonlyMap<string, Buffer>
+  ) {
+    super();
+    this.known_trees = known_trees;
+    this.known_preimages = known_preimages;
+  }
+
+  execute(request: Buffer): Buffer {
+    const req = Buffer.from(request.subarray(1));
+
+    if (req.length < 32 + 1 + 1) {
+      throw new Error('Invalid request, expected at least 34 bytes');
+    }
+
+    const reqBuf = new BufferReader(req);
+    const hash = reqBuf.readSlice(32);
+    const hash_hex = hash.toString('hex');
+
+    let tree_size: number;
+    let start_index: number;
+    try {
+      tree_size = sanitizeBigintToNumber(reqBuf.readVarInt());
+      start_index = sanitizeBigintToNumber(reqBuf.readVarInt());
+    } catch (e) {
+      throw new Error(
+        "Invalid request, couldn't parse tree_size or start_index"
+      );
+    }
+
+    if (reqBuf.available() != 0) {
+      throw new Error('Invalid request, unexpected trailing data');
+    }
+
+    const mt = this.known_trees.get(hash_hex);
+    if (!mt) {
+      throw Error(`Requested Merkle leaves for unknown tree: ${hash_hex}`);
+    }
+
+    if (start_index >= tree_size || mt.size() != tree_size) {
+      throw Error('Invalid index or tree size.');
+    }
+
+    // as many complete leaf preimages (without the 0x00 prefix) as fit in 255 bytes
+    const response: Buffer[] = [];
+    let response_len = 1;
+    let n_leaves = 0;
+    for (let i = start_index; i < tree_size && n_leaves < 255; i++) {
+      const leaf_hash_hex = mt.getLeafHash(i).toString('hex');
+      const preimage = this.known_preimages.get(leaf_hash_hex);
+      if (!preimage) {
+        throw Error(`Requested unknown preimage for: ${leaf_hash_hex}`);
+      }
+
+      const element = preimage.subarray(1);
+      if (response_len + 1 + element.length > 255) {
+        break;
+      }
+      response.push(Buffer.from([element.length]), element);
+      response_len += 1 + element.length;
+      n_leaves++;
+    }
+
+    if (n_leaves == 0) {
+      throw Error('The leaf is too long to fit in a response.');
+    }
+
+    return Buffer.concat([Buffer.from([n_leaves]), ...response]);
+  }
+}
+
 export class GetMoreElementsCommand extends ClientCommand {
   queue: Buffer[];
 
@@ -291,6 +370,7 @@ export class ClientCommandInterpreter {
       new GetPreimageCommand(this.preimages, this.queue),
       new GetMerkleLeafIndexCommand(this.roots),
       new GetMerkleLeafProofCommand(this.roots, this.queue),
+      new GetMerkleLeavesCommand(this.roots, this.preimages),
       new GetMoreElementsCommand(this.queue),
     ];
 
@@ -1,8 +1,65 @@
+import bs58check from 'bs58check';
 import { crypto } from 'bitcoinjs-lib';
 
+import { pathStringToArray } from './bip32';
 import { BufferWriter } from './buffertools';
 import { hashLeaf, Merkle } from './merkle';
 
+const WALLET_TYPE_POLICY_MAP = 0x01;
+const WALLET_TYPE_POLICY_MAP_BINARY_KEYS = 0x02;
+
+const KEY_INFO_BINARY_HAS_KEY_ORIGIN = 0x01;
+const KEY_INFO_BINARY_HAS_WILDCARD = 0x02;
+
+/**
+ * Converts a key (e.g. "[d34db33f/48'/1'/0'/2']tpub.../**") to the binary encoding used by the
+ * wallet policies with binaryKeys: a byte of flags, then (only if there is the key origin) the
+ * fingerprint, the number of derivation steps as a byte and each step as a 4-byte little-endian
+ * integer, and finally the 78-byte serialized extended pubkey.
+ * @param key the key, with the key derivation information
+ * @returns the binary encoding of the key
+ */
+export function serializeKeyInfoBinary(key: string): Buffer {
+  let flags = 0;
+  let fingerprint: Buffer | undefined;
+  let path: readonly number[] = [];
+
+  if (key.startsWith('[')) {
+    const end = key.indexOf(']');
+    if (end < 0) {
+      throw new Error(`Invalid key origin: ${key}`);
+    }
+    const [fingerprintHex, ...steps] = key.slice(1, end).split('/');
+    fingerprint = Buffer.from(fingerprintHex, 'hex');
+    if (fingerprint.length != 4) {
+      throw new Error(`Invalid fingerprint: ${key}`);
+    }
+    path = pathStringToArray(steps.join('/'));
+    flags |= KEY_INFO_BINARY_HAS_KEY_ORIGIN;
+    key = key.slice(end + 1);
+  }
+
+  if (key.endsWith('/**')) {
+    flags |= KEY_INFO_BINARY_HAS_WILDCARD;
+    key = key.slice(0, -3);
+  }
+
+  const extPubkey: Buffer = bs58check.decode(key);
+  if (extPubkey.length != 78) {
+    throw new Error(`Invalid extended pubkey: ${key}`);
+  }
+
+  const buf = new BufferWriter();
+  buf.writeUInt8(flags);
+  if (fingerprint) {
+    buf.writeSlice(fingerprint);
+    buf.writeUInt8(path.length);
+    path.forEach((step) => buf.writeUInt32(step));
+  }
+  buf.writeSlice(extPubkey);
+  return buf.buffer();
+}
+
 /**
  * The Bitcon hardware app uses a descriptors-like thing to describe
  * how to construct output scripts from keys. A "Wallet Policy" consists
@@ -15,20 +72,37 @@ export class WalletPolicy {
   readonly name: string;
   readonly descriptorTemplate: string;
   readonly keys: readonly string[];
+  readonly binaryKeys: boolean;
   /**
    * Creates and instance of a wallet policy.
    * @param name an ascii string, up to 16 bytes long; it must be an empty string for default wallet policies
    * @param descriptorTemplate the wallet policy template
    * @param keys and array of the keys, with the key derivation information
+   * @param binaryKeys if true, the keys are sent to the hardware wallet in the binary encoding
+   * (see serializeKeyInfoBinary), that spares the device the base58 decoding of the extended
+   * pubkeys. This is a different wallet policy, with a different id, than the one with the same
+   * keys in the string encoding.
    */
   constructor(
     name: string,
     descriptorTemplate: string,
-    keys: readonly string[]
+    keys: readonly string[],
+    binaryKeys = false
   ) {
     this.name = name;
     this.descriptorTemplate = descriptorTemplate;
     this.keys = keys;
+    this.binaryKeys = binaryKeys;
+  }
+
+  /**
+   * Returns the keys as sent to the hardware wallet, that are the leaves of the Merkle tree
+   * committed to in the serialized wallet policy.
+   */
+  getKeyLeaves(): Buffer[] {
+    return this.keys.map((k) =>
+      this.binaryKeys ? serializeKeyInfoBinary(k) : Buffer.from(k, 'ascii')
+    );
   }
 
   /**
@@ -43,13 +117,14 @@ export class WalletPolicy {
    * @returns the serialized wallet policy
    */
   serialize(): Buffer {
-    const keyBuffers = this.keys.map((k) => {
-      return Buffer.from(k, 'ascii');
-    });
-    const m = new Merkle(keyBuffers.map((k) => hashLeaf(k)));
+    const m = new Merkle(this.getKeyLeaves().map((k) => hashLeaf(k)));
 
     const buf = new BufferWriter();
-    buf.writeUInt8(0x01); // wallet type (policy map)
+    buf.writeUInt8(
+      this.binaryKeys
+        ? WALLET_TYPE_POLICY_MAP_BINARY_KEYS
+        : WALLET_TYPE_POLICY_MAP
+    ); // wallet type
     buf.writeVarSlice(Buffer.from(this.name, 'ascii'));
     buf.writeVarSlice(Buffer.from(this.descriptorTemplate, 'ascii'));
     buf.writeVarInt(this.keys.length);
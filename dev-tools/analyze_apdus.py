@@ -0,0 +1,228 @@
+import argparse
+import io
+import json
+import statistics
+import sys
+
+from contextlib import redirect_stdout
+from dataclasses import dataclass, field
+from typing import Dict, List, Optional, Tuple
+
+from bitcoin_client.ledger_bitcoin.client_command import ClientCommandCode
+from bitcoin_client.ledger_bitcoin.command_builder import BitcoinInsType, BitcoinCommandBuilder
+
+from test_utils.transcript import Exchange, Transcript
+
+from tag_apdus import ApduTagger
+
+"""
+Analyzes a transcript of APDUs recorded with test_utils.transcript.RecordingTransport (or a textual transcript in the
+format accepted by tag_apdus.py, in which case no timing information is available), and reports:
+
+- for each app command and client command, the number of round trips and a histogram of their duration. A round trip
+  is attributed to the command that the host sends in the APDU: the app command for the first APDU, or the client
+  command answered by a CONTINUE_INTERRUPTED APDU;
+- the client command requests that the app repeated identically during the same command, which point to fetches that
+  could be cached on the device.
+
+Usage, from the root of the repository:
+
+    python dev-tools/analyze_apdus.py transcript.json [--top 20] [--json report.json]
+"""
+
+
+# upper bounds (in milliseconds) of the buckets of the histograms; the last bucket is unbounded
+HISTOGRAM_BUCKETS_MS = [1, 2, 5, 10, 20, 50, 100, 200, 500]
+
+HISTOGRAM_WIDTH = 40
+
+
+@dataclass
+class RepeatedRequest:
+    command: str  # the app command during which the request was sent
+    description: str  # the request, as formatted by tag_apdus.py
+    count: int = 0
+    total_time: float = 0.0
+
+
+@dataclass
+class Report:
+    n_exchanges: int = 0
+    has_timings: bool = False
+    round_trips: Dict[str, List[float]] = field(default_factory=dict)
+    repeated_requests: List[RepeatedRequest] = field(default_factory=list)
+
+
+def load_transcript(path: str) -> Transcript:
+    if path == "-":
+        content = sys.stdin.read()
+    else:
+        with open(path) as f:
+            content = f.read()
+
+    if content.lstrip().startswith("{"):
+        return Transcript.from_dict(json.loads(content))
+
+    # textual transcript, as accepted by tag_apdus.py
+    lines = [line.strip().split(' ') for line in content.splitlines() if line.strip() != ""]
+    if len(lines) % 2 != 0:
+        raise ValueError("The transcript must contain an even number of lines")
+
+    exchanges: List[Exchange] = []
+    for (dir_in, apdu_hex), (dir_out, response_hex) in zip(lines[0::2], lines[1::2]):
+        assert dir_in == "=>" and dir_out == "<="
+        response_raw = bytes.fromhex(response_hex)
+        exchanges.append(Exchange(bytes.fromhex(apdu_hex), response_raw[:-2],
+                                  int.from_bytes(response_raw[-2:], byteorder="big")))
+    return Transcript(exchanges)
+
+
+def command_name(code: int, names) -> str:
+    try:
+        return names(code).name
+    except ValueError:
+        return f"0x{code:02x}"
+
+
+def tag(tagger_fn, raw: bytes) -> str:
+    """Returns the output of tag_apdus.py for a single APDU or response."""
+    out = io.StringIO()
+    with redirect_stdout(out):
+        tagger_fn(raw)
+    return out.getvalue().strip()
+
+
+def analyze(transcript: Transcript) -> Report:
+    report = Report(n_exchanges=len(transcript.exchanges),
+                    has_timings=any(e.rtt > 0 for e in transcript.exchanges))
+
+    tagger = ApduTagger()
+
+    current_command: Optional[str] = None
+    # client command requests of the currently running app command
+    seen_requests: Dict[Tuple[str, bytes], RepeatedRequest] = {}
+    # the client command currently being answered, and the request it was part of
+    pending_request: Optional[RepeatedRequest] = None
+    pending_client_command: Optional[str] = None
+
+    for e in transcript.exchanges:
+        if e.apdu[0] == BitcoinCommandBuilder.CLA_BITCOIN:
+            current_command = command_name(e.apdu[1], BitcoinInsType)
+            category = current_command
+        elif pending_client_command is not None:
+            category = pending_client_command
+        else:
+            category = f"cla=0x{e.apdu[0]:02x},ins=0x{e.apdu[1]:02x}"
+
+        report.round_trips.setdefault(category, []).append(e.rtt)
+
+        if pending_request is not None:
+            pending_request.total_time += e.rtt
+
+        tag(tagger.tag_apdu, e.apdu)
+        description = tag(tagger.tag_response, e.response + e.sw.to_bytes(2, byteorder="big"))
+
+        pending_request = None
+        pending_client_command = None
+
+        if e.sw == 0xE000 and len(e.response) > 0:
+            pending_client_command = command_name(e.response[0], ClientCommandCode)
+
+            key = (current_command, e.response)
+            if key not in seen_requests:
+                seen_requests[key] = RepeatedRequest(current_command, description)
+            pending_request = seen_requests[key]
+            pending_request.count += 1
+        else:
+            # the app command is done; requests are only compared within the same command
+            report.repeated_requests.extend(r for r in seen_requests.values() if r.count > 1)
+            seen_requests = {}
+            current_command = None
+
+    report.repeated_requests.extend(r for r in seen_requests.values() if r.count > 1)
+    report.repeated_requests.sort(key=lambda r: (-r.count, r.description))
+
+    return report
+
+
+def format_histogram(values: List[float]) -> List[str]:
+    counts = [0] * (len(HISTOGRAM_BUCKETS_MS) + 1)
+    for v in values:
+        ms = v * 1000
+        bucket = next((i for i, bound in enumerate(HISTOGRAM_BUCKETS_MS) if ms < bound), len(HISTOGRAM_BUCKETS_MS))
+        counts[bucket] += 1
+
+    max_count = max(counts)
+    lines = []
+    for i, count in enumerate(counts):
+        if count == 0:
+            continue
+        label = f"< {HISTOGRAM_BUCKETS_MS[i]} ms" if i < len(HISTOGRAM_BUCKETS_MS) else f">= {HISTOGRAM_BUCKETS_MS[-1]} ms"
+        bar = "#" * max(1, round(HISTOGRAM_WIDTH * count / max_count))
+        lines.append(f"    {label:>10} | {bar} {count}")
+    return lines
+
+
+def print_report(report: Report, top: int):
+    print(f"{report.n_exchanges} APDUs exchanged")
+    print()
+
+    print("Round trips per command:")
+    for category, rtts in sorted(report.round_trips.items(), key=lambda item: -sum(item[1])):
+        if report.has_timings:
+            print(f"  {category}: {len(rtts)} round trips, total {sum(rtts):.3f} s, "
+                  f"mean {1000 * statistics.mean(rtts):.2f} ms, median {1000 * statistics.median(rtts):.2f} ms, "
+                  f"max {1000 * max(rtts):.2f} ms")
+            for line in format_histogram(rtts):
+                print(line)
+        else:
+            print(f"  {category}: {len(rtts)} round trips")
+    print()
+
+    n_redundant = sum(r.count - 1 for r in report.repeated_requests)
+    print(f"Repeated identical requests: {len(report.repeated_requests)} distinct, {n_redundant} redundant round trips")
+    for r in report.repeated_requests[:top]:
+        time_str = f", {r.total_time:.3f} s" if report.has_timings else ""
+        print(f"  {r.count}x during {r.command}{time_str}: {r.description}")
+    if len(report.repeated_requests) > top:
+        print(f"  ... and {len(report.repeated_requests) - top} more")
+
+
+def report_to_dict(report: Report) -> dict:
+    return {
+        "n_exchanges": report.n_exchanges,
+        "round_trips": {
+            category: {
+                "count": len(rtts),
+                "total_s": sum(rtts),
+                "max_s": max(rtts),
+            } for category, rtts in report.round_trips.items()
+        },
+        "repeated_requests": [
+            {
+                "command": r.command,
+                "request": r.description,
+                "count": r.count,
+                "total_s": r.total_time,
+            } for r in report.repeated_requests
+        ],
+    }
+
+
+def run():
+    parser = argparse.ArgumentParser(description="Analyzes a transcript of APDUs.")
+    parser.add_argument("transcript", help="JSON or textual transcript, or - to read from standard input")
+    parser.add_argument("--top", type=int, default=20, help="number of repeated requests to show")
+    parser.add_argument("--json", help="also write the report as JSON to this file")
+    args = parser.parse_args()
+
+    report = analyze(load_transcript(args.transcript))
+    print_report(report, args.top)
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(report_to_dict(report), f, indent=2)
+
+
+if __name__ == "__main__":
+    run()
@@ -427,6 +427,29 @@ class GetMerkleLeafIndexClientCommandFormatter(ClientCommandFormatter):
         print(f"=> ▶ <found:{found}><leaf_index:{leaf_index}>")
 
 
+class GetMerkleLeavesClientCommandFormatter(ClientCommandFormatter):
+    code = ClientCommandCode.GET_MERKLE_LEAVES
+
+    @staticmethod
+    def format_cmd_request(response: bytes, stream: ByteStreamParser, context: CommandContext):
+        root = stream.read_bytes(32)
+        tree_size = stream.read_varint()
+        start_index = stream.read_varint()
+        stream.assert_empty()
+
+        print(
+            f"<= ⏸ GET_MERKLE_LEAVES(root={format_merkle_root(root, context)},tree_size={tree_size},start_index={start_index})")
+
+    @staticmethod
+    def format_cmd_response(apdu: APDU, stream: ByteStreamParser, context: CommandContext):
+        n_leaves = stream.read_bytes(1)[0]
+        leaves = [stream.read_bytes(stream.read_bytes(1)[0])
+                  for _ in range(n_leaves)]
+        stream.assert_empty()
+        leaves_str = f"[{','.join(leaf.hex() for leaf in leaves)}]"
+        print(f"=> ▶ <n_leaves:{n_leaves}><leaves:{leaves_str}>")
+
+
 class GetMoreElementsClientCommandFormatter(ClientCommandFormatter):
     code = ClientCommandCode.GET_MORE_ELEMENTS
 
@@ -447,119 +470,144 @@ class GetMoreElementsClientCommandFormatter(ClientCommandFormatter):
 
 
 client_command_formatters: List[ClientCommandFormatter] = [YieldClientCommandFormatter, GetPreimageClientCommandFormatter,
-                                                           GetMerkleLeafProofClientCommandFormatter, GetMerkleLeafIndexClientCommandFormatter, GetMoreElementsClientCommandFormatter]
+                                                           GetMerkleLeafProofClientCommandFormatter, GetMerkleLeafIndexClientCommandFormatter, GetMerkleLeavesClientCommandFormatter,
+                                                           GetMoreElementsClientCommandFormatter]
 
 client_command_formatters_map: Mapping[ClientCommandCode, ClientCommandFormatter] = {
     f.code: f for f in client_command_formatters
 }
 
 
-def run():
-    # True if expecting an APDU going to the HWW (line starting with '=>'),
-    # False if expecting a response (line starting with '<=')
-    reading_apdu_in = True
+class ApduTagger:
+    """
+    Formats the APDUs of a transcript, keeping track of the state of the currently running command.
+    The APDUs and the responses must be given alternately, in the same order as in the transcript.
+    """
 
-    processing_command: Optional[int] = None
+    def __init__(self):
+        # the currently running command, if any
+        self.processing_command: Optional[int] = None
 
-    processing_client_command: Optional[int] = None
+        # the client command currently being answered, if any
+        self.processing_client_command: Optional[int] = None
 
-    # context specific to the currently running command (if any)
-    context = CommandContext()
+        # context specific to the currently running command (if any)
+        self.context = CommandContext()
 
-    for line in sys.stdin:
-        line_pieces = line.strip().split(' ')
+    def tag_apdu(self, apdu_raw: bytes):
+        """Prints the formatted APDU request."""
 
-        assert len(line_pieces) == 2
+        apdu = APDU.from_raw(apdu_raw)
+        context = self.context
 
-        apdu_raw = bytes.fromhex(line_pieces[1])
+        if apdu.cla == BitcoinCommandBuilder.CLA_BITCOIN:
+            try:
+                ins_type = BitcoinInsType(apdu.ins)
+            except ValueError:
+                ins_type = None
 
-        if reading_apdu_in:
-            # APDU request
-            assert line_pieces[0] == '=>'
+            self.processing_command = ins_type
+            context.clear()
+
+            stream = ByteStreamParser(apdu.data)
 
-            apdu = APDU.from_raw(apdu_raw)
+            if ins_type in bitcoin_command_formatters_map:
+                bitcoin_command_formatters_map[ins_type].format_request(
+                    apdu, stream, context)
+            else:
+                print(f"=> {apdu.serialize().hex()}")
 
-            if apdu.cla == BitcoinCommandBuilder.CLA_BITCOIN:
-                try:
-                    ins_type = BitcoinInsType(apdu.ins)
-                except ValueError:
-                    ins_type = None
+        elif apdu.cla == BitcoinCommandBuilder.CLA_FRAMEWORK:
+            try:
+                ins_type = FrameworkInsType(apdu.ins)
+            except ValueError:
+                ins_type = None
 
-                processing_command = ins_type
-                context.clear()
+            if ins_type == FrameworkInsType.CONTINUE_INTERRUPTED:
+                if self.processing_client_command == None:
+                    raise RuntimeError(
+                        "Unexpected CONTINUE_INTERRUPTED with no interrupted command")
 
                 stream = ByteStreamParser(apdu.data)
 
-                if ins_type in bitcoin_command_formatters_map:
-                    bitcoin_command_formatters_map[ins_type].format_request(
+                if self.processing_client_command in client_command_formatters_map:
+                    client_command_formatters_map[self.processing_client_command].format_cmd_response(
                         apdu, stream, context)
                 else:
-                    print(f"=> {apdu.serialize().hex()}")
+                    # unknown command
+                    print(f"=> ▶ {apdu.data.hex()}")
 
-            elif apdu.cla == BitcoinCommandBuilder.CLA_FRAMEWORK:
-                try:
-                    ins_type = FrameworkInsType(apdu.ins)
-                except ValueError:
-                    ins_type = None
+                self.processing_client_command = None
+            else:
+                # Unknown command, invalid logs or this tool needs to be updated!
+                raise RuntimeError("Unknown framework APDU")
+        else:
+            print(f"=> {apdu.serialize().hex()}")
 
-                if ins_type == FrameworkInsType.CONTINUE_INTERRUPTED:
-                    if processing_client_command == None:
-                        raise RuntimeError(
-                            "Unexpected CONTINUE_INTERRUPTED with no interrupted command")
+    def tag_response(self, apdu_raw: bytes):
+        """Prints the formatted response, including the status word."""
 
-                    stream = ByteStreamParser(apdu.data)
+        assert len(apdu_raw) >= 2
 
-                    if processing_client_command in client_command_formatters_map:
-                        client_command_formatters_map[processing_client_command].format_cmd_response(
-                            apdu, stream, context)
-                    else:
-                        # unknown command
-                        print(f"=> ▶ {apdu.data.hex()}")
+        context = self.context
 
-                    processing_client_command = None
-                else:
-                    # Unknown command, invalid logs or this tool needs to be updated!
-                    raise RuntimeError("Unknown framework APDU")
+        sw = int.from_bytes(apdu_raw[-2:], byteorder="big")
+        response = apdu_raw[:-2]
+
+        if sw == 0xE000:
+            if self.processing_command is None:
+                raise RuntimeError(
+                    "Unexpected INTERRUPTED_EXECUTION when no command was running")
+
+            assert len(response) > 0
+            stream = ByteStreamParser(response)
+            self.processing_client_command = stream.read_bytes(1)[0]
+
+            if self.processing_client_command in client_command_formatters_map:
+                client_command_formatters_map[self.processing_client_command].format_cmd_request(
+                    response, stream, context)
             else:
-                print(f"=> {apdu.serialize().hex()}")
+                # unknown command
+                print(f"<= ⏸ {response.hex()}")
+
         else:
-            # APDU response
-            assert line_pieces[0] == '<='
-            assert len(apdu_raw) >= 2
+            assert self.processing_command is not None
 
-            sw = int.from_bytes(apdu_raw[-2:], byteorder="big")
-            response = apdu_raw[:-2]
+            if self.processing_command in bitcoin_command_formatters_map:
+                bitcoin_command_formatters_map[self.processing_command].format_response(
+                    response, sw, context)
+            else:
+                if len(response) == 0:
+                    print("<= {:04x}".format(sw))
+                else:
+                    print("<= {} {:04x}".format(response.hex(), sw))
 
-            if sw == 0xE000:
-                if processing_command is None:
-                    raise RuntimeError(
-                        "Unexpected INTERRUPTED_EXECUTION when no command was running")
+            # Either an error or a success response; either way the command is done
+            self.processing_command = None
 
-                assert len(response) > 0
-                stream = ByteStreamParser(response)
-                processing_client_command = stream.read_bytes(1)[0]
 
-                if processing_client_command in client_command_formatters_map:
-                    client_command_formatters_map[processing_client_command].format_cmd_request(
-                        response, stream, context)
-                else:
-                    # unknown command
-                    print(f"<= ⏸ {response.hex()}")
+def run():
+    # True if expecting an APDU going to the HWW (line starting with '=>'),
+    # False if expecting a response (line starting with '<=')
+    reading_apdu_in = True
 
-            else:
-                assert processing_command is not None
+    tagger = ApduTagger()
 
-                if processing_command in bitcoin_command_formatters_map:
-                    bitcoin_command_formatters_map[processing_command].format_response(
-                        response, sw, context)
-                else:
-                    if len(response) == 0:
-                        print("<= {:04x}".format(sw))
-                    else:
-                        print("<= {} {:04x}".format(response.hex(), sw))
+    for line in sys.stdin:
+        line_pieces = line.strip().split(' ')
+
+        assert len(line_pieces) == 2
 
-                # Either an error or a success response; either way the command is done
-                processing_command = None
+        apdu_raw = bytes.fromhex(line_pieces[1])
+
+        if reading_apdu_in:
+            # APDU request
+            assert line_pieces[0] == '=>'
+            tagger.tag_apdu(apdu_raw)
+        else:
+            # APDU response
+            assert line_pieces[0] == '<='
+            tagger.tag_response(apdu_raw)
 
         reading_apdu_in = not reading_apdu_in
 
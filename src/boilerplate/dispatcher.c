@@ -36,10 +36,15 @@ struct {
     bool paused;
     uint16_t sw;
     bool had_ux_flow;  // set to true if there was any UX flow during the APDU processing
+    uint8_t command_p2;  // P2 of the APDU that started the current command
 } G_dispatcher_state;
 
 static void dispatcher_loop();
 
+uint8_t dispatcher_get_command_p2() {
+    return G_dispatcher_state.command_p2;
+}
+
 static void next(command_processor_t next_processor) {
     G_dispatcher_context.machine_context_ptr->next_processor = next_processor;
 }
@@ -181,6 +186,7 @@ void apdu_dispatcher(command_descriptor_t const cmd_descriptors[],
         // received, the interrupted command is discarded.
 
         G_dispatcher_context.machine_context_ptr = top_context;
+        G_dispatcher_state.command_p2 = cmd->p2;
 
         // Safety measure: reset to 0 the entire context before starting.
         explicit_bzero(top_context, top_context_size);
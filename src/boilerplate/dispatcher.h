@@ -121,6 +121,12 @@ void apdu_dispatcher(command_descriptor_t const cmd_descriptors[],
                      void (*termination_cb)(void),
                      const command_t *cmd);
 
+/**
+ * Returns the P2 of the APDU that started the command being processed. The commands that are
+ * continued with INS_CONTINUE (whose P1 and P2 must be 0) keep the P2 of their first APDU.
+ */
+uint8_t dispatcher_get_command_p2();
+
 // Debug utilities
 
 #if DEBUG == 0
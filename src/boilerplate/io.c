@@ -22,12 +22,14 @@
 #include "ux.h"
 
 #include "io.h"
+#include "crypto.h"
 #include "globals.h"
 #include "sw.h"
 #include "common/buffer.h"
 #include "common/write.h"
 
 #include "dispatcher.h"
+#include "handler/sign_psbt.h"
 
 extern dispatcher_context_t G_dispatcher_context;
 extern command_processor_t G_command_continuation;
@@ -101,6 +103,13 @@ uint8_t io_event(uint8_t channel) {
         case SEPROXYHAL_TAG_TICKER_EVENT:
             ++G_ticks;
 
+            // The cached keys and the signing session must not survive a lock, as unlocking with a
+            // different PIN might give access to a different seed
+            if (os_global_pin_is_validated() != BOLOS_UX_OK) {
+                crypto_clear_cache();
+                sign_psbt_clear_session();
+            }
+
             if (G_is_timeout_active.processing &&
                 G_ticks - G_processing_timeout_start_tick >= PROCESSING_TIMEOUT_TICKS) {
                 io_clear_processing_timeout();
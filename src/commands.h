@@ -4,10 +4,12 @@
 #include "constants.h"
 #include "handler/get_master_fingerprint.h"
 #include "handler/get_extended_pubkey.h"
+#include "handler/get_extended_pubkeys.h"
 #include "handler/get_wallet_address.h"
 #include "handler/register_wallet.h"
 #include "handler/sign_psbt.h"
 #include "handler/sign_message.h"
+#include "handler/get_stack_profile.h"
 
 /**
  * Enumeration with expected INS of APDU commands.
@@ -18,7 +20,12 @@ typedef enum {
     GET_WALLET_ADDRESS = 0x03,
     SIGN_PSBT = 0x04,
     GET_MASTER_FINGERPRINT = 0x05,
+    GET_EXTENDED_PUBKEYS = 0x06,
+    SIGN_PSBT_BATCHED = 0x07,
+    RESUME_SIGN_PSBT = 0x08,
     SIGN_MESSAGE = 0x10,
+    SIGN_MESSAGE_STREAMED = 0x11,
+    GET_STACK_PROFILE = 0xF0,  // debug only, see get_stack_profile.h
 } command_e;
 
 /**
@@ -27,6 +34,7 @@ typedef enum {
 typedef union {
     get_master_fingerprint_t get_master_fingerprint;
     get_extended_pubkey_state_t get_extended_pubkey_state;
+    get_extended_pubkeys_state_t get_extended_pubkeys_state;
     register_wallet_state_t register_wallet_state;
     get_wallet_address_state_t get_wallet_address_state;
     sign_psbt_state_t sign_psbt_state;
@@ -16,7 +16,7 @@
 
 #include <stddef.h>   // size_t
 #include <stdint.h>   // uint*_t
-#include <string.h>   // memmove, memset
+#include <string.h>   // memset
 #include <stdbool.h>  // bool
 
 #include "base58.h"
@@ -54,99 +54,120 @@ char const BASE58_ALPHABET[] = {
     'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z'             //
 };
 
+// The numbers are processed in 32-bit limbs, in order to handle several base58 digits or several
+// bytes in each step. 58^5 is the largest power of 58 that fits in 32 bits.
+#define BASE58_POW5 656356768u  // 58^5
+
+// The encoder uses limbs in base 58^4 instead, and consumes one byte in each step: the intermediate
+// values are at most 58^4 * 2^8 < 2^32, therefore they are divided with 32-bit operations only.
+// The Cortex-M0 of Nano S has no division instruction, and no 64-bit multiplication.
+#define BASE58_POW4 11316496u  // 58^4
+
+/**
+ * Number of 32-bit limbs of the largest number decoded by base58_decode. Each base58 digit is
+ * log2(58) < 5.86 bits.
+ */
+#define MAX_DEC_LIMBS ((MAX_DEC_INPUT_SIZE * 586 / 100 + 31) / 32)
+
+/**
+ * Number of base 58^4 limbs of the largest number encoded by base58_encode. Each limb holds more
+ * than 23 bits.
+ */
+#define MAX_ENC_LIMBS ((MAX_ENC_INPUT_SIZE * 8 + 22) / 23)
+
 int base58_decode(const char *in, size_t in_len, uint8_t *out, size_t out_len) {
 #ifdef USE_CXRAM_SECTION
-    // allocate buffers inside the cxram section; safe as there are no syscalls here
-    uint8_t *tmp = get_cxram_buffer();                          // MAX_DEC_INPUT_SIZE bytes buffer
-    uint8_t *buffer = get_cxram_buffer() + MAX_DEC_INPUT_SIZE;  // MAX_DEC_INPUT_SIZE bytes buffer
+    // allocate the limbs inside the cxram section (which is suitably aligned); safe as there are
+    // no syscalls here
+    uint32_t *limbs = (uint32_t *) get_cxram_buffer();  // MAX_DEC_LIMBS limbs
 #else
-    uint8_t tmp[MAX_DEC_INPUT_SIZE] = {0};
-    uint8_t buffer[MAX_DEC_INPUT_SIZE] = {0};
+    uint32_t limbs[MAX_DEC_LIMBS];
 #endif
 
-    memset(tmp, 0, MAX_DEC_INPUT_SIZE);
-    memset(buffer, 0, MAX_DEC_INPUT_SIZE);
-
-    uint8_t j;
-    uint8_t start_at;
-    uint8_t zero_count = 0;
-
     if (in_len > MAX_DEC_INPUT_SIZE || in_len < 2) {
         return -1;
     }
 
-    memmove(tmp, in, in_len);
+    size_t zero_count = 0;
+    while (zero_count < in_len && in[zero_count] == BASE58_ALPHABET[0]) {
+        ++zero_count;
+    }
+
+    // the number as little-endian 32-bit limbs; only the first n_limbs are used
+    size_t n_limbs = 0;
 
-    // uses a trimmed version of BASE58_TABLE to save space, while staying functionally equivalent
-    for (uint8_t i = 0; i < in_len; i++) {
+    // digits are accumulated in groups of up to 5; each group is multiplied in with a single pass
+    uint32_t group = 0;
+    uint32_t group_multiplier = 1;
+    for (size_t i = zero_count; i < in_len; i++) {
+        // uses a trimmed version of BASE58_TABLE to save space, while staying functionally
+        // equivalent
         int pos_trimmed = (in[i]) - 49;
         if (pos_trimmed < 0 || pos_trimmed >= (int) sizeof(BASE58_TABLE_TRIMMED)) {
             return -1;
         }
-
-        tmp[i] = BASE58_TABLE_TRIMMED[pos_trimmed];
-
-        if (tmp[i] == 0xFF) {
+        uint8_t digit = BASE58_TABLE_TRIMMED[pos_trimmed];
+        if (digit == 0xFF) {
             return -1;
         }
-    }
-
-    // // original code for reference
-    // for (uint8_t i = 0; i < in_len; i++) {
-    //     if (in[i] >= sizeof(BASE58_TABLE)) {
-    //         return -1;
-    //     }
-
-    //     tmp[i] = BASE58_TABLE[(int) in[i]];
 
-    //     if (tmp[i] == 0xFF) {
-    //         return -1;
-    //     }
-    // }
-
-    while ((zero_count < in_len) && (tmp[zero_count] == 0)) {
-        ++zero_count;
-    }
-
-    j = in_len;
-    start_at = zero_count;
-    while (start_at < in_len) {
-        uint16_t remainder = 0;
-        for (uint8_t div_loop = start_at; div_loop < in_len; div_loop++) {
-            uint16_t digit256 = (uint16_t) (tmp[div_loop] & 0xFF);
-            uint16_t tmp_div = remainder * 58 + digit256;
-            tmp[div_loop] = (uint8_t) (tmp_div / 256);
-            remainder = tmp_div % 256;
+        group = group * 58 + digit;
+        group_multiplier *= 58;
+        if (group_multiplier != BASE58_POW5 && i + 1 < in_len) {
+            continue;
         }
 
-        if (tmp[start_at] == 0) {
-            ++start_at;
+        // limbs = limbs * group_multiplier + group
+        uint32_t carry = group;
+        for (size_t k = 0; k < n_limbs; k++) {
+            uint64_t t = (uint64_t) limbs[k] * group_multiplier + carry;
+            limbs[k] = (uint32_t) t;
+            carry = (uint32_t) (t >> 32);
+        }
+        if (carry != 0) {
+            if (n_limbs == MAX_DEC_LIMBS) {
+                return -1;
+            }
+            limbs[n_limbs++] = carry;
         }
 
-        buffer[--j] = (uint8_t) remainder;
+        group = 0;
+        group_multiplier = 1;
     }
 
-    while ((j < in_len) && (buffer[j] == 0)) {
-        ++j;
+    // number of significant bytes of the most significant limb
+    size_t top_bytes = 0;
+    if (n_limbs > 0) {
+        for (uint32_t top = limbs[n_limbs - 1]; top != 0; top >>= 8) {
+            ++top_bytes;
+        }
     }
 
-    int length = in_len - (j - zero_count);
-
-    if ((int) out_len < length) {
+    size_t length = zero_count + (n_limbs > 0 ? (n_limbs - 1) * 4 + top_bytes : 0);
+    if (out_len < length) {
         return -1;
     }
 
-    memmove(out, buffer + j - zero_count, length);
+    memset(out, 0, zero_count);
 
-    return length;
+    // write the limbs in big-endian order
+    size_t pos = length;
+    for (size_t k = 0; k < n_limbs; k++) {
+        uint32_t limb = limbs[k];
+        for (int b = 0; b < 4 && pos > zero_count; b++) {
+            out[--pos] = (uint8_t) limb;
+            limb >>= 8;
+        }
+    }
+
+    return (int) length;
 }
 
 int base58_encode(const uint8_t *in, size_t in_len, char *out, size_t out_len) {
-    uint8_t buffer[MAX_ENC_INPUT_SIZE * 138 / 100 + 1] = {0};
-    size_t i, j;
-    size_t stop_at;
+    // the number as little-endian limbs in base 58^4; only the first n_limbs are used
+    uint32_t limbs[MAX_ENC_LIMBS];
+    size_t n_limbs = 0;
     size_t zero_count = 0;
-    size_t output_size;
 
     if (in_len > MAX_ENC_INPUT_SIZE) {
         return -1;
@@ -156,37 +177,53 @@ int base58_encode(const uint8_t *in, size_t in_len, char *out, size_t out_len) {
         ++zero_count;
     }
 
-    output_size = (in_len - zero_count) * 138 / 100 + 1;
-    stop_at = output_size - 1;
-    for (size_t start_at = zero_count; start_at < in_len; start_at++) {
-        unsigned int carry = in[start_at];
-        for (j = output_size - 1; (int) j >= 0; j--) {
-            carry += 256 * buffer[j];
-            buffer[j] = carry % 58;
-            carry /= 58;
-
-            if (j <= stop_at - 1 && carry == 0) {
-                break;
+    for (size_t i = zero_count; i < in_len; i++) {
+        // limbs = limbs * 2^8 + in[i]
+        uint32_t carry = in[i];
+        for (size_t k = 0; k < n_limbs; k++) {
+            uint32_t t = (limbs[k] << 8) + carry;
+            // t / 58^4, estimated with the reciprocal floor(2^33 / 58^4) = 759 without overflow;
+            // for all t <= 58^4 * 2^8, the estimate is either exact or one less
+            carry = ((t >> 10) * 759u) >> 23;
+            t -= carry * BASE58_POW4;
+            if (t >= BASE58_POW4) {
+                t -= BASE58_POW4;
+                ++carry;
             }
+            limbs[k] = t;
+        }
+        if (carry != 0) {
+            if (n_limbs == MAX_ENC_LIMBS) {
+                return -1;
+            }
+            limbs[n_limbs++] = carry;
         }
-        stop_at = j;
     }
 
-    j = 0;
-    while (j < output_size && buffer[j] == 0) {
-        j += 1;
+    // number of significant digits of the most significant limb
+    size_t top_digits = 0;
+    if (n_limbs > 0) {
+        for (uint32_t top = limbs[n_limbs - 1]; top != 0; top /= 58) {
+            ++top_digits;
+        }
     }
 
-    if (out_len < zero_count + output_size - j) {
+    size_t length = zero_count + (n_limbs > 0 ? (n_limbs - 1) * 4 + top_digits : 0);
+    if (out_len < length) {
         return -1;
     }
 
     memset(out, BASE58_ALPHABET[0], zero_count);
 
-    i = zero_count;
-    while (j < output_size) {
-        out[i++] = BASE58_ALPHABET[buffer[j++]];
+    // write the digits of each limb, starting from the least significant one
+    size_t pos = length;
+    for (size_t k = 0; k < n_limbs; k++) {
+        uint32_t limb = limbs[k];
+        for (int d = 0; d < 4 && pos > zero_count; d++) {
+            out[--pos] = BASE58_ALPHABET[limb % 58];
+            limb /= 58;
+        }
     }
 
-    return i;
+    return (int) length;
 }
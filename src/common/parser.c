@@ -31,6 +31,16 @@ bool dbuffer_read_bytes(buffer_t *buffers[2], uint8_t *out, size_t n) {
     return true;
 }
 
+size_t dbuffer_read_chunk(buffer_t *buffers[2], const uint8_t **out, size_t max_n) {
+    buffer_t *buffer = buffer_can_read(buffers[0], 1) ? buffers[0] : buffers[1];
+    size_t length = buffer->size - buffer->offset;
+    size_t n = max_n < length ? max_n : length;
+
+    *out = buffer->ptr + buffer->offset;
+    buffer_seek_cur(buffer, n);
+    return n;
+}
+
 bool dbuffer_read_u8(buffer_t *buffers[2], uint8_t *out) {
     return dbuffer_read_bytes(buffers, out, 1);
 }
@@ -39,6 +39,15 @@ bool dbuffer_can_read(buffer_t *buffers[2], size_t n);
  */
 bool dbuffer_read_bytes(buffer_t *buffers[2], uint8_t *out, size_t n);
 
+/**
+ * Reads up to max_n bytes that are contiguous in memory, without copying them: *out is set to point
+ * to the bytes inside the first buffer if it is not exhausted, or inside the second buffer
+ * otherwise. The bytes are consumed.
+ *
+ * Returns the number of bytes read, which is 0 only if max_n is 0 or both buffers are exhausted.
+ */
+size_t dbuffer_read_chunk(buffer_t *buffers[2], const uint8_t **out, size_t max_n);
+
 /**
  * TODO: docs.
  */
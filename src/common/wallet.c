@@ -73,7 +73,8 @@ int read_policy_map_wallet(buffer_t *buffer, policy_map_wallet_header_t *header)
         return -1;
     }
 
-    if (header->type != WALLET_TYPE_POLICY_MAP) {
+    if (header->type != WALLET_TYPE_POLICY_MAP &&
+        header->type != WALLET_TYPE_POLICY_MAP_BINARY_KEYS) {
         return -2;
     }
 
@@ -219,13 +220,13 @@ static int parse_unsigned_decimal(buffer_t *buffer, size_t *out) {
 // Reads a derivation step expressed in decimal, with the symbol ' to mark if hardened (h is not
 // supported) Returns 0 on success, -1 on error.
 static int buffer_read_derivation_step(buffer_t *buffer, uint32_t *out) {
-    uint32_t der_step;
+    size_t der_step;
     if (parse_unsigned_decimal(buffer, &der_step) == -1 || der_step >= BIP32_FIRST_HARDENED_CHILD) {
         PRINTF("Failed reading derivation step\n");
         return -1;
     }
 
-    *out = der_step;
+    *out = (uint32_t) der_step;
 
     // Check if hardened
     uint8_t c;
@@ -236,6 +237,40 @@ static int buffer_read_derivation_step(buffer_t *buffer, uint32_t *out) {
     return 0;
 }
 
+static int parse_policy_map_key_info_binary(buffer_t *buffer, policy_map_key_info_t *out) {
+    uint8_t flags;
+    if (!buffer_read_u8(buffer, &flags) ||
+        (flags & ~(KEY_INFO_BINARY_HAS_KEY_ORIGIN | KEY_INFO_BINARY_HAS_WILDCARD)) != 0) {
+        return -1;
+    }
+
+    out->is_binary = 1;
+    out->has_key_origin = (flags & KEY_INFO_BINARY_HAS_KEY_ORIGIN) != 0;
+    out->has_wildcard = (flags & KEY_INFO_BINARY_HAS_WILDCARD) != 0;
+
+    if (out->has_key_origin) {
+        if (!buffer_read_bytes(buffer, out->master_key_fingerprint, 4) ||
+            !buffer_read_u8(buffer, &out->master_key_derivation_len) ||
+            out->master_key_derivation_len > MAX_BIP32_PATH_STEPS) {
+            return -1;
+        }
+
+        for (int i = 0; i < out->master_key_derivation_len; i++) {
+            if (!buffer_read_u32(buffer, &out->master_key_derivation[i], LE)) {
+                return -1;
+            }
+        }
+    }
+
+    // the extended pubkey must be exactly the rest of the buffer
+    if (!buffer_read_bytes(buffer, out->ext_pubkey_bytes, SERIALIZED_EXTENDED_PUBKEY_LENGTH) ||
+        buffer_can_read(buffer, 1)) {
+        return -1;
+    }
+
+    return 0;
+}
+
 // TODO: we are currently enforcing that the master key fingerprint (if present) is in lowercase
 // hexadecimal digits,
 //       and that the symbol for "hardened derivation" is "'".
@@ -248,6 +283,11 @@ int parse_policy_map_key_info(buffer_t *buffer, policy_map_key_info_t *out) {
         return -1;
     }
 
+    // the string encoding only contains printable characters
+    if (c < 0x20) {
+        return parse_policy_map_key_info_binary(buffer, out);
+    }
+
     if (c == '[') {
         out->has_key_origin = 1;
 
@@ -368,7 +408,7 @@ static int parse_script(buffer_t *in_buf,
             policy_node_with_script_t *node =
                 (policy_node_with_script_t *) buffer_alloc(out_buf,
                                                            sizeof(policy_node_with_script_t),
-                                                           true);
+                                                           false);
             if (node == NULL) {
                 return -4;
             }
@@ -381,8 +421,8 @@ static int parse_script(buffer_t *in_buf,
             }
 
             // the internal script is recursively parsed (if successful) in the current location of
-            // the output buffer
-            node->script = (policy_node_t *) (out_buf->ptr + out_buf->offset);
+            // the output buffer, that is right after this node
+            node->script_offset = sizeof(policy_node_with_script_t);
 
             int res2;
             if ((res2 = parse_script(in_buf, out_buf, depth + 1, inner_context_flags)) < 0) {
@@ -399,17 +439,17 @@ static int parse_script(buffer_t *in_buf,
             policy_node_with_key_t *node =
                 (policy_node_with_key_t *) buffer_alloc(out_buf,
                                                         sizeof(policy_node_with_key_t),
-                                                        true);
+                                                        false);
             if (node == NULL) {
                 return -6;
             }
             node->type = token;
 
             int key_index = parse_key_index(in_buf);
-            if (key_index == -1) {
+            if (key_index == -1 || key_index > UINT8_MAX) {
                 return -7;
             }
-            node->key_index = (size_t) key_index;
+            node->key_index = (uint8_t) key_index;
 
             break;
         }
@@ -418,22 +458,21 @@ static int parse_script(buffer_t *in_buf,
             policy_node_multisig_t *node =
                 (policy_node_multisig_t *) buffer_alloc(out_buf,
                                                         sizeof(policy_node_multisig_t),
-                                                        true);
+                                                        false);
 
             if (node == NULL) {
                 return -8;
             }
             node->type = token;
 
-            if (parse_unsigned_decimal(in_buf, &node->k) == -1) {
+            size_t k;
+            if (parse_unsigned_decimal(in_buf, &k) == -1 || k > MAX_POLICY_MAP_COSIGNERS) {
                 PRINTF("Error parsing threshold\n");
                 return -9;
             }
+            node->k = (uint8_t) k;
 
-            // We allocate the array of key indices at the current position in the output buffer (on
-            // success)
-            node->key_indexes = (size_t *) (out_buf->ptr + out_buf->offset);
-
+            // The array of key indices follows the node in the output buffer
             node->n = 0;
             while (true) {
                 // If the next character is a ')', we exit and leave it in the buffer
@@ -448,15 +487,19 @@ static int parse_script(buffer_t *in_buf,
                 }
 
                 int key_index = parse_key_index(in_buf);
-                if (key_index == -1) {
+                if (key_index == -1 || key_index > UINT8_MAX) {
                     return -11;
                 }
 
-                size_t *key_index_out = (size_t *) buffer_alloc(out_buf, sizeof(size_t), true);
+                if (node->n >= MAX_POLICY_MAP_COSIGNERS) {
+                    return -13;
+                }
+
+                uint8_t *key_index_out = (uint8_t *) buffer_alloc(out_buf, 1, false);
                 if (key_index_out == NULL) {
                     return -12;
                 }
-                *key_index_out = (size_t) key_index;
+                *key_index_out = (uint8_t) key_index;
 
                 ++node->n;
             }
@@ -486,11 +529,6 @@ static int parse_script(buffer_t *in_buf,
 }
 
 int parse_policy_map(buffer_t *in_buf, void *out, size_t out_len) {
-    if ((unsigned long) out % 4 != 0) {
-        PRINTF("Unaligned pointer\n");
-        return -1;
-    }
-
     buffer_t out_buf = buffer_create(out, out_len);
 
     return parse_script(in_buf, &out_buf, 0, 0);
@@ -518,4 +556,13 @@ void get_policy_wallet_id(policy_map_wallet_header_t *wallet_header, uint8_t out
     crypto_hash_digest(&wallet_hash_context.header, out, 32);
 }
 
+int get_policy_map_key_info_ext_pubkey(const policy_map_key_info_t *key_info,
+                                       serialized_extended_pubkey_t *out) {
+    if (key_info->is_binary) {
+        memcpy(out, key_info->ext_pubkey_bytes, sizeof(*out));
+        return 0;
+    }
+    return crypto_deserialize_extended_pubkey(key_info->ext_pubkey, out);
+}
+
 #endif
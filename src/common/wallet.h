@@ -10,27 +10,49 @@
 #include "../context.h"
 #include "os.h"
 #include "cx.h"
+#include "../crypto.h"
 #endif
 
 #define WALLET_TYPE_POLICY_MAP 1
 
+/**
+ * Same as WALLET_TYPE_POLICY_MAP, except that the key informations use the binary encoding (see
+ * parse_policy_map_key_info). As the type is the first serialized byte, the ids (and therefore the
+ * hmacs) of the two formats never collide.
+ */
+#define WALLET_TYPE_POLICY_MAP_BINARY_KEYS 2
+
 /**
  * Maximum supported number of keys for a policy map.
+ * On Nano S, the limit is kept at 5 keys: the derived pubkeys of a multisig are sorted on the
+ * stack (33 bytes per key, see process_multi_sortedmulti_node), that is too small for 15 keys.
  */
+#ifdef TARGET_NANOS
 #define MAX_POLICY_MAP_COSIGNERS 5
+#else
+#define MAX_POLICY_MAP_COSIGNERS 15
+#endif
 
 /**
  * Maximum supported number of keys for a policy map.
  */
-#define MAX_POLICY_MAP_KEYS 5
+#define MAX_POLICY_MAP_KEYS MAX_POLICY_MAP_COSIGNERS
 
 // The string describing a pubkey can contain:
 // - (optional) the key origin info, which we limit to 46 bytes (2 + 8 + 3*12 = 46 bytes)
 // - the xpub itself (up to 113 characters)
 // - optional, the "/**" suffix.
 // Therefore, the total length of the key info string is at most 162 bytes.
+// The binary encoding (see parse_policy_map_key_info) is at most 1 + 4 + 1 + 4*6 + 78 = 108 bytes.
 #define MAX_POLICY_KEY_INFO_LEN (46 + MAX_SERIALIZED_PUBKEY_LENGTH + 3)
 
+// Length of a BIP32 extended pubkey, without the base58check encoding
+#define SERIALIZED_EXTENDED_PUBKEY_LENGTH 78
+
+// Flags of the first byte of a key information in the binary encoding
+#define KEY_INFO_BINARY_HAS_KEY_ORIGIN 0x01
+#define KEY_INFO_BINARY_HAS_WILDCARD   0x02
+
 // Enough to store "sh(wsh(sortedmulti(15,@0,@1,@2,@3,@4,@5,@6,@7,@8,@9,@10,@11,@12,@13,@14)))"
 #define MAX_POLICY_MAP_STR_LENGTH 74
 
@@ -45,10 +67,11 @@
 // n_keys (1 byte)
 // keys_merkle_root (32 bytes)
 #define MAX_POLICY_MAP_SERIALIZED_LENGTH \
-    (1 + MAX_POLICY_MAP_NAME_LENGTH + 1 + MAX_POLICY_MAP_STR_LENGTH + 32)
+    (1 + 1 + MAX_POLICY_MAP_NAME_LENGTH + 1 + MAX_POLICY_MAP_STR_LENGTH + 1 + 32)
 
-// Maximum size of a parsed policy map in memory
-#define MAX_POLICY_MAP_BYTES 128
+// Maximum size of a parsed policy map in memory.
+// "sh(wsh(sortedmulti(15,@0,...,@14)))" takes 2 + 2 + 3 + 15 = 22 bytes.
+#define MAX_POLICY_MAP_BYTES 64
 
 // Currently only multisig is supported
 #define MAX_POLICY_MAP_LEN MAX_MULTISIG_POLICY_MAP_LENGTH
@@ -59,11 +82,17 @@ typedef struct {
     uint8_t master_key_derivation_len;
     uint8_t has_key_origin;
     uint8_t has_wildcard;  // true iff the keys ends with the /** wildcard
-    char ext_pubkey[MAX_SERIALIZED_PUBKEY_LENGTH + 1];
+    uint8_t is_binary;     // true iff the key information was in the binary encoding
+    union {
+        // the base58check-encoded extended pubkey, if is_binary is false
+        char ext_pubkey[MAX_SERIALIZED_PUBKEY_LENGTH + 1];
+        // the serialized extended pubkey, if is_binary is true
+        uint8_t ext_pubkey_bytes[SERIALIZED_EXTENDED_PUBKEY_LENGTH];
+    };
 } policy_map_key_info_t;
 
 typedef struct {
-    uint8_t type;  // Currently the only supported value is WALLET_TYPE_POLICY_MAP
+    uint8_t type;  // WALLET_TYPE_POLICY_MAP or WALLET_TYPE_POLICY_MAP_BINARY_KEYS
     uint8_t name_len;
     char name[MAX_WALLET_NAME_LENGTH + 1];
     uint16_t policy_map_len;
@@ -86,33 +115,44 @@ typedef enum {
     // TOKEN_RAW,      // unsupported
 } PolicyNodeType;
 
-// TODO: the following structures are using size_t for all integers to avoid alignment problems;
-//       if memory is an issue, we could use a packed version instead, but care needs to be taken
-//       when accessing pointers, since they would be unaligned.
+/*
+ * The parsed policy is a compact bytecode, with the nodes in pre-order. Each node starts with a
+ * 1-byte opcode (a PolicyNodeType), followed by its arguments; all the fields are single bytes, so
+ * the nodes can be accessed in place with no alignment requirement.
+ *
+ * For example, "sh(wsh(sortedmulti(2,@0,@1)))" is encoded as:
+ *   TOKEN_SH 2 TOKEN_WSH 2 TOKEN_SORTEDMULTI 2 2 0 1
+ */
 
 // abstract type for all nodes
 typedef struct {
-    PolicyNodeType type;
-    void *node_data;  // subtypes will redefine this
+    uint8_t type;  // a PolicyNodeType
 } policy_node_t;
 
 typedef struct {
-    PolicyNodeType type;  // == TOKEN_SH, == TOKEN_WSH
-    policy_node_t *script;
+    uint8_t type;           // == TOKEN_SH, == TOKEN_WSH
+    uint8_t script_offset;  // offset of the child script, relative to the start of this node
 } policy_node_with_script_t;
 
 typedef struct {
-    PolicyNodeType type;  // == TOKEN_PK, == TOKEN_PKH, == TOKEN_WPKH
-    size_t key_index;     // index of the key
+    uint8_t type;       // == TOKEN_PKH, == TOKEN_WPKH, == TOKEN_TR
+    uint8_t key_index;  // index of the key
 } policy_node_with_key_t;
 
 typedef struct {
-    PolicyNodeType type;  // == TOKEN_MULTI, == TOKEN_SORTEDMULTI
-    size_t k;             // threshold
-    size_t n;             // number of keys
-    size_t *key_indexes;  // pointer to array of exactly n key indexes
+    uint8_t type;           // == TOKEN_MULTI, == TOKEN_SORTEDMULTI
+    uint8_t k;              // threshold
+    uint8_t n;              // number of keys
+    uint8_t key_indexes[];  // exactly n key indexes
 } policy_node_multisig_t;
 
+/**
+ * Returns the child script of a TOKEN_SH or TOKEN_WSH node.
+ */
+static inline const policy_node_t *policy_node_get_script(const policy_node_with_script_t *node) {
+    return (const policy_node_t *) ((const uint8_t *) node + node->script_offset);
+}
+
 /**
  * TODO: docs
  */
@@ -127,11 +167,20 @@ int read_policy_map_wallet(buffer_t *buffer, policy_map_wallet_header_t *header)
  *
  * For example:
  * "[d34db33f/44'/0'/0']xpub6ERApfZwUNrhLCkDtcHTcxd75RbzS1ed54G1LkBUHQVHQKqhMkhgbmJbZRkrgZw4koxb5JaHWkY4ALHY2grBGRjaDMzQLcgJvLJuZZvRcEL"
+ *
+ * The key informations of WALLET_TYPE_POLICY_MAP_BINARY_KEYS wallets use instead the binary
+ * encoding: a byte of flags (KEY_INFO_BINARY_HAS_KEY_ORIGIN, KEY_INFO_BINARY_HAS_WILDCARD), then
+ * the key origin info if present (the fingerprint, the number of steps as a byte and each step as
+ * a 4-byte little-endian integer), and finally the 78-byte serialized extended pubkey. As the
+ * string encoding never starts with a byte smaller than 0x20, the encoding is detected from the
+ * first byte, and out->is_binary is set accordingly.
  */
 int parse_policy_map_key_info(buffer_t *buffer, policy_map_key_info_t *out);
 
 /**
- * TODO: docs
+ * Parses a policy map, and writes its compact encoding (see policy_node_t) to out.
+ *
+ * @return 0 on success, a negative number on error (including if out_len is not enough).
  */
 int parse_policy_map(buffer_t *in_buf, void *out, size_t out_len);
 
@@ -142,4 +191,13 @@ int parse_policy_map(buffer_t *in_buf, void *out, size_t out_len);
  */
 void get_policy_wallet_id(policy_map_wallet_header_t *wallet_header, uint8_t out[static 32]);
 
+/**
+ * Returns the extended pubkey of a parsed key information, decoding it if it was in the string
+ * encoding.
+ *
+ * @return 0 on success, -1 if the base58check encoding or its checksum is invalid.
+ */
+int get_policy_map_key_info_ext_pubkey(const policy_map_key_info_t *key_info,
+                                       serialized_extended_pubkey_t *out);
+
 #endif
@@ -121,25 +121,29 @@ int crypto_derive_private_key(cx_ecfp_private_key_t *private_key,
     return ret;
 }
 
-int bip32_CKDpub(const serialized_extended_pubkey_t *parent,
-                 uint32_t index,
-                 serialized_extended_pubkey_t *child) {
+int crypto_extended_pubkey_to_point(const serialized_extended_pubkey_t *ext_pubkey,
+                                    extended_pubkey_point_t *out) {
+    memcpy(out->chain_code, ext_pubkey->chain_code, 32);
+    return crypto_get_uncompressed_pubkey(ext_pubkey->compressed_pubkey, out->uncompressed_pubkey);
+}
+
+int bip32_CKDpub_point(const extended_pubkey_point_t *parent,
+                       uint32_t index,
+                       extended_pubkey_point_t *child) {
     PRINT_STACK_POINTER();
 
     if (index >= BIP32_FIRST_HARDENED_CHILD) {
         return -1;  // can only derive unhardened children
     }
 
-    if (parent->depth == 255) {
-        return -2;  // maximum derivation depth reached
-    }
-
     uint8_t I[64];
 
     {  // make sure that heavy memory allocations are freed as soon as possible
 
         uint8_t tmp[33 + 4];
-        memcpy(tmp, parent->compressed_pubkey, 33);
+        if (crypto_get_compressed_pubkey(parent->uncompressed_pubkey, tmp) < 0) {
+            return -1;
+        }
         write_u32_be(tmp, 33, index);
 
         cx_hmac_sha512(parent->chain_code, 32, tmp, sizeof(tmp), I, 64);
@@ -160,31 +164,57 @@ int bip32_CKDpub(const serialized_extended_pubkey_t *parent,
         uint8_t P[65];
         secp256k1_point(I_L, P);
 
-        uint8_t K_par[65];
-        crypto_get_uncompressed_pubkey(parent->compressed_pubkey, K_par);
-
         // add K_par
         if (cx_ecfp_add_point(CX_CURVE_SECP256K1,
                               child_uncompressed_pubkey,
                               P,
-                              K_par,
+                              parent->uncompressed_pubkey,
                               sizeof(child_uncompressed_pubkey)) == 0) {
             return -3;  // the point at infinity is not a valid child pubkey (should never happen in
                         // practice)
         }
     }
 
-    memmove(child->version, parent->version, 4);
-    child->depth = parent->depth + 1;
+    memcpy(child->chain_code, I_R, 32);
+    memcpy(child->uncompressed_pubkey, child_uncompressed_pubkey, 65);
+
+    return 0;
+}
+
+int bip32_CKDpub(const serialized_extended_pubkey_t *parent,
+                 uint32_t index,
+                 serialized_extended_pubkey_t *child) {
+    PRINT_STACK_POINTER();
+
+    if (index >= BIP32_FIRST_HARDENED_CHILD) {
+        return -1;  // can only derive unhardened children
+    }
+
+    if (parent->depth == 255) {
+        return -2;  // maximum derivation depth reached
+    }
+
+    extended_pubkey_point_t node;
+    if (crypto_extended_pubkey_to_point(parent, &node) < 0) {
+        return -1;
+    }
+
+    int ret = bip32_CKDpub_point(&node, index, &node);
+    if (ret < 0) {
+        return ret;
+    }
 
+    // child can equal parent, therefore the fingerprint is computed before writing the child
     uint32_t parent_fingerprint = crypto_get_key_fingerprint(parent->compressed_pubkey);
 
+    memmove(child->version, parent->version, 4);
+    child->depth = parent->depth + 1;
     write_u32_be(child->parent_fingerprint, 0, parent_fingerprint);
     write_u32_be(child->child_number, 0, index);
 
-    memcpy(child->chain_code, I_R, 32);
+    memcpy(child->chain_code, node.chain_code, 32);
 
-    crypto_get_compressed_pubkey(child_uncompressed_pubkey, child->compressed_pubkey);
+    crypto_get_compressed_pubkey(node.uncompressed_pubkey, child->compressed_pubkey);
 
     return 0;
 }
@@ -322,11 +352,39 @@ uint32_t crypto_get_key_fingerprint(const uint8_t pub_key[static 33]) {
     return read_u32_be(key_rip, 0);
 }
 
+// Cache of the master key fingerprint and of the most recently derived pubkeys. It only contains
+// public data, but it depends on the seed: it must be cleared whenever the device is locked, as
+// unlocking with a different PIN might give access to a different seed.
+static struct {
+    bool has_master_key_fingerprint;
+    uint32_t master_key_fingerprint;
+
+    uint32_t use_counter;
+    struct {
+        uint32_t last_use;  // 0 if the entry is empty
+        uint8_t bip32_path_len;
+        uint32_t bip32_path[MAX_BIP32_PATH_STEPS];
+        // if has_ext_pubkey is false, only the pubkey and the chain code of ext_pubkey are set
+        uint8_t has_ext_pubkey;
+        serialized_extended_pubkey_t ext_pubkey;
+    } ext_pubkeys[CRYPTO_EXT_PUBKEY_CACHE_SIZE];
+} G_crypto_cache;
+
+void crypto_clear_cache(void) {
+    explicit_bzero(&G_crypto_cache, sizeof(G_crypto_cache));
+}
+
 uint32_t crypto_get_master_key_fingerprint() {
-    uint8_t master_pub_key[33];
-    uint32_t bip32_path[] = {};
-    crypto_get_compressed_pubkey_at_path(bip32_path, 0, master_pub_key, NULL);
-    return crypto_get_key_fingerprint(master_pub_key);
+    if (!G_crypto_cache.has_master_key_fingerprint) {
+        uint8_t master_pub_key[33];
+        // the path is empty; a 1-element array avoids passing an array of size 0
+        const uint32_t bip32_path[1] = {0};
+        crypto_get_compressed_pubkey_at_path(bip32_path, 0, master_pub_key, NULL);
+
+        G_crypto_cache.master_key_fingerprint = crypto_get_key_fingerprint(master_pub_key);
+        G_crypto_cache.has_master_key_fingerprint = true;
+    }
+    return G_crypto_cache.master_key_fingerprint;
 }
 
 void crypto_derive_symmetric_key(const char *label, size_t label_len, uint8_t key[static 32]) {
@@ -348,44 +406,191 @@ void crypto_derive_symmetric_key(const char *label, size_t label_len, uint8_t ke
                                        0);
 }
 
-// TODO: Split serialization from key derivation?
-//       It might be difficult to have a clean API without wasting memory, as the checksum
-//       needs to be concatenated to the data before base58 serialization.
-int get_serialized_extended_pubkey_at_path(const uint32_t bip32_path[],
-                                           uint8_t bip32_path_len,
-                                           uint32_t bip32_pubkey_version,
-                                           char out[static MAX_SERIALIZED_PUBKEY_LENGTH + 1]) {
+// Returns the index of the cache entry for the given path, or -1 if it is not in the cache
+static int find_cached_pubkey(const uint32_t bip32_path[], uint8_t bip32_path_len) {
+    for (int i = 0; i < CRYPTO_EXT_PUBKEY_CACHE_SIZE; i++) {
+        if (G_crypto_cache.ext_pubkeys[i].last_use != 0 &&
+            G_crypto_cache.ext_pubkeys[i].bip32_path_len == bip32_path_len &&
+            memcmp(G_crypto_cache.ext_pubkeys[i].bip32_path,
+                   bip32_path,
+                   bip32_path_len * sizeof(bip32_path[0])) == 0) {
+            G_crypto_cache.ext_pubkeys[i].last_use = ++G_crypto_cache.use_counter;
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Returns true if the first cache entry is a strict ancestor of the given path, and all the
+// following derivation steps are not hardened
+static bool is_cached_ancestor(const uint32_t bip32_path[], uint8_t bip32_path_len) {
+    uint8_t ancestor_len = G_crypto_cache.ext_pubkeys[0].bip32_path_len;
+    if (G_crypto_cache.ext_pubkeys[0].last_use == 0 || ancestor_len >= bip32_path_len ||
+        memcmp(G_crypto_cache.ext_pubkeys[0].bip32_path,
+               bip32_path,
+               ancestor_len * sizeof(bip32_path[0])) != 0) {
+        return false;
+    }
+    for (int k = ancestor_len; k < bip32_path_len; k++) {
+        if (bip32_path[k] >= BIP32_FIRST_HARDENED_CHILD) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Stores a pubkey in the cache, replacing the least recently used entry
+static void cache_pubkey(const uint32_t bip32_path[],
+                         uint8_t bip32_path_len,
+                         const serialized_extended_pubkey_t *ext_pubkey,
+                         bool has_ext_pubkey) {
+    if (bip32_path_len > MAX_BIP32_PATH_STEPS) {
+        return;
+    }
+
+    int i = find_cached_pubkey(bip32_path, bip32_path_len);
+    if (i < 0 && CRYPTO_EXT_PUBKEY_CACHE_SIZE == 1 &&
+        is_cached_ancestor(bip32_path, bip32_path_len)) {
+        // with a single entry, an ancestor is kept rather than replaced by its descendants, as the
+        // next derivations (like the other addresses of an account) are likely to share it
+        return;
+    }
+    if (i < 0) {
+        i = 0;
+        for (int j = 1; j < CRYPTO_EXT_PUBKEY_CACHE_SIZE; j++) {
+            if (G_crypto_cache.ext_pubkeys[j].last_use < G_crypto_cache.ext_pubkeys[i].last_use) {
+                i = j;
+            }
+        }
+    }
+
+    G_crypto_cache.ext_pubkeys[i].last_use = ++G_crypto_cache.use_counter;
+    G_crypto_cache.ext_pubkeys[i].bip32_path_len = bip32_path_len;
+    memcpy(G_crypto_cache.ext_pubkeys[i].bip32_path,
+           bip32_path,
+           bip32_path_len * sizeof(bip32_path[0]));
+    G_crypto_cache.ext_pubkeys[i].has_ext_pubkey = has_ext_pubkey;
+    memcpy(&G_crypto_cache.ext_pubkeys[i].ext_pubkey, ext_pubkey, sizeof(*ext_pubkey));
+}
+
+// Computes the compressed pubkey and the chain code at the given path, and stores them in the
+// corresponding fields of out; the other fields are not meaningful.
+// If an ancestor of the path is in the cache and all the following derivation steps are not
+// hardened, the pubkey is derived from the ancestor's instead of deriving it from the seed.
+static int get_pubkey_node_at_path(const uint32_t bip32_path[],
+                                   uint8_t bip32_path_len,
+                                   serialized_extended_pubkey_t *out) {
+    int i = find_cached_pubkey(bip32_path, bip32_path_len);
+    if (i >= 0) {
+        memcpy(out, &G_crypto_cache.ext_pubkeys[i].ext_pubkey, sizeof(*out));
+        return 0;
+    }
+
+    int ancestor_len = bip32_path_len - 1;
+    for (; ancestor_len >= 0 && bip32_path[ancestor_len] < BIP32_FIRST_HARDENED_CHILD;
+         ancestor_len--) {
+        i = find_cached_pubkey(bip32_path, ancestor_len);
+        if (i >= 0) {
+            break;
+        }
+    }
+
+    if (i >= 0) {
+        extended_pubkey_point_t node;
+        if (crypto_extended_pubkey_to_point(&G_crypto_cache.ext_pubkeys[i].ext_pubkey, &node) < 0) {
+            return -1;
+        }
+        for (int k = ancestor_len; k < bip32_path_len; k++) {
+            if (bip32_CKDpub_point(&node, bip32_path[k], &node) < 0) {
+                return -1;
+            }
+        }
+        memcpy(out->chain_code, node.chain_code, 32);
+        crypto_get_compressed_pubkey(node.uncompressed_pubkey, out->compressed_pubkey);
+        out->depth = bip32_path_len;
+    } else {
+        if (!crypto_get_compressed_pubkey_at_path(bip32_path,
+                                                  bip32_path_len,
+                                                  out->compressed_pubkey,
+                                                  out->chain_code)) {
+            return -1;
+        }
+        out->depth = bip32_path_len;
+    }
+
+    cache_pubkey(bip32_path, bip32_path_len, out, false);
+    return 0;
+}
+
+int crypto_cache_pubkey_at_path(const uint32_t bip32_path[], uint8_t bip32_path_len) {
+    serialized_extended_pubkey_t node;
+    return get_pubkey_node_at_path(bip32_path, bip32_path_len, &node);
+}
+
+int crypto_get_pubkey_at_path(const uint32_t bip32_path[],
+                              uint8_t bip32_path_len,
+                              uint8_t out[static 33]) {
+    serialized_extended_pubkey_t node;
+    if (get_pubkey_node_at_path(bip32_path, bip32_path_len, &node) < 0) {
+        return -1;
+    }
+    memcpy(out, node.compressed_pubkey, 33);
+    return 0;
+}
+
+int crypto_get_extended_pubkey_at_path(const uint32_t bip32_path[],
+                                       uint8_t bip32_path_len,
+                                       uint32_t bip32_pubkey_version,
+                                       serialized_extended_pubkey_t *out) {
+    int i = find_cached_pubkey(bip32_path, bip32_path_len);
+    if (i >= 0 && G_crypto_cache.ext_pubkeys[i].has_ext_pubkey) {
+        memcpy(out, &G_crypto_cache.ext_pubkeys[i].ext_pubkey, sizeof(*out));
+        write_u32_be(out->version, 0, bip32_pubkey_version);
+        return 0;
+    }
+
     // find parent key's fingerprint and child number
     uint32_t parent_fingerprint = 0;
     uint32_t child_number = 0;
     if (bip32_path_len > 0) {
-        // here we reuse the storage for the parent keys that we will later use
-        // for the response, in order to save memory
-
-        uint8_t parent_pubkey[33];
-        crypto_get_compressed_pubkey_at_path(bip32_path, bip32_path_len - 1, parent_pubkey, NULL);
+        // the parent is kept in the cache, as it is likely to be needed for the next request
+        if (get_pubkey_node_at_path(bip32_path, bip32_path_len - 1, out) < 0) {
+            return -1;
+        }
 
-        parent_fingerprint = crypto_get_key_fingerprint(parent_pubkey);
+        parent_fingerprint = crypto_get_key_fingerprint(out->compressed_pubkey);
         child_number = bip32_path[bip32_path_len - 1];
     }
 
-    struct {
-        serialized_extended_pubkey_t ext_pubkey;
-        uint8_t checksum[4];
-    } ext_pubkey_check;  // extended pubkey and checksum
+    if (get_pubkey_node_at_path(bip32_path, bip32_path_len, out) < 0) {
+        return -1;
+    }
 
-    serialized_extended_pubkey_t *ext_pubkey = &ext_pubkey_check.ext_pubkey;
+    write_u32_be(out->version, 0, bip32_pubkey_version);
+    out->depth = bip32_path_len;
+    write_u32_be(out->parent_fingerprint, 0, parent_fingerprint);
+    write_u32_be(out->child_number, 0, child_number);
 
-    write_u32_be(ext_pubkey->version, 0, bip32_pubkey_version);
-    ext_pubkey->depth = bip32_path_len;
-    write_u32_be(ext_pubkey->parent_fingerprint, 0, parent_fingerprint);
-    write_u32_be(ext_pubkey->child_number, 0, child_number);
+    cache_pubkey(bip32_path, bip32_path_len, out, true);
 
-    crypto_get_compressed_pubkey_at_path(bip32_path,
-                                         bip32_path_len,
-                                         ext_pubkey->compressed_pubkey,
-                                         ext_pubkey->chain_code);
-    crypto_get_checksum((uint8_t *) ext_pubkey, 78, ext_pubkey_check.checksum);
+    return 0;
+}
+
+int get_serialized_extended_pubkey_at_path(const uint32_t bip32_path[],
+                                           uint8_t bip32_path_len,
+                                           uint32_t bip32_pubkey_version,
+                                           char out[static MAX_SERIALIZED_PUBKEY_LENGTH + 1]) {
+    serialized_extended_pubkey_check_t ext_pubkey_check;  // extended pubkey and checksum
+
+    if (crypto_get_extended_pubkey_at_path(bip32_path,
+                                           bip32_path_len,
+                                           bip32_pubkey_version,
+                                           &ext_pubkey_check.serialized_extended_pubkey) < 0) {
+        return -1;
+    }
+    crypto_get_checksum((uint8_t *) &ext_pubkey_check.serialized_extended_pubkey,
+                        78,
+                        ext_pubkey_check.checksum);
 
     int serialized_pubkey_len =
         base58_encode((uint8_t *) &ext_pubkey_check, 78 + 4, out, MAX_SERIALIZED_PUBKEY_LENGTH);
@@ -396,6 +601,47 @@ int get_serialized_extended_pubkey_at_path(const uint32_t bip32_path[],
     return serialized_pubkey_len;
 }
 
+int crypto_deserialize_extended_pubkey(const char *serialized,
+                                       serialized_extended_pubkey_t *out) {
+    serialized_extended_pubkey_check_t ext_pubkey_check;
+    if (base58_decode(serialized,
+                      strlen(serialized),
+                      (uint8_t *) &ext_pubkey_check,
+                      sizeof(ext_pubkey_check)) != sizeof(ext_pubkey_check)) {
+        return -1;
+    }
+
+    uint8_t checksum[4];
+    crypto_get_checksum((uint8_t *) &ext_pubkey_check.serialized_extended_pubkey, 78, checksum);
+    if (memcmp(checksum, ext_pubkey_check.checksum, sizeof(checksum)) != 0) {
+        return -1;
+    }
+
+    memcpy(out, &ext_pubkey_check.serialized_extended_pubkey, sizeof(*out));
+    return 0;
+}
+
+bool crypto_is_extended_pubkey_at_path(const uint8_t master_key_fingerprint[static 4],
+                                       const uint32_t bip32_path[],
+                                       uint8_t bip32_path_len,
+                                       uint32_t bip32_pubkey_version,
+                                       const serialized_extended_pubkey_t *ext_pubkey) {
+    if (read_u32_be(master_key_fingerprint, 0) != crypto_get_master_key_fingerprint()) {
+        return false;
+    }
+
+    // it could be a collision on the fingerprint; we verify that we can actually generate the
+    // same pubkey
+    serialized_extended_pubkey_t derived_ext_pubkey;
+    if (crypto_get_extended_pubkey_at_path(bip32_path,
+                                           bip32_path_len,
+                                           bip32_pubkey_version,
+                                           &derived_ext_pubkey) < 0) {
+        return false;
+    }
+    return memcmp(&derived_ext_pubkey, ext_pubkey, sizeof(derived_ext_pubkey)) == 0;
+}
+
 int base58_encode_address(const uint8_t in[20], uint32_t version, char *out, size_t out_len) {
     uint8_t tmp[4 + 20 + 4];  // version + max_in_len + checksum
 
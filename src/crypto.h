@@ -25,6 +25,28 @@ typedef struct serialized_extended_pubkey_s {
     uint8_t compressed_pubkey[33];
 } serialized_extended_pubkey_t;
 
+/**
+ * An extended pubkey in the representation used for derivations. The pubkey is kept as an
+ * uncompressed point, so that it is not decompressed again for each child; the fields that are
+ * only needed for the serialization (including the parent's fingerprint) are not stored.
+ */
+typedef struct {
+    uint8_t chain_code[32];
+    uint8_t uncompressed_pubkey[65];
+} extended_pubkey_point_t;
+
+/**
+ * Number of recently used pubkeys kept in the RAM cache; the least recently used one is replaced
+ * first. Each entry takes about 110 bytes of RAM, therefore Nano S only keeps one.
+ */
+#ifndef CRYPTO_EXT_PUBKEY_CACHE_SIZE
+#ifdef TARGET_NANOS
+#define CRYPTO_EXT_PUBKEY_CACHE_SIZE 1
+#else
+#define CRYPTO_EXT_PUBKEY_CACHE_SIZE 4
+#endif
+#endif
+
 typedef struct {
     serialized_extended_pubkey_t serialized_extended_pubkey;
     uint8_t checksum[4];
@@ -68,6 +90,39 @@ int bip32_CKDpub(const serialized_extended_pubkey_t *parent,
                  uint32_t index,
                  serialized_extended_pubkey_t *child);
 
+/**
+ * Converts a serialized extended pubkey to the representation used for derivations.
+ *
+ * @param[in]  ext_pubkey
+ *   Pointer to the serialized extended pubkey.
+ * @param[out] out
+ *   Pointer to the output extended pubkey.
+ *
+ * @return 0 if success, -1 if the pubkey is not valid.
+ */
+int crypto_extended_pubkey_to_point(const serialized_extended_pubkey_t *ext_pubkey,
+                                    extended_pubkey_point_t *out);
+
+/**
+ * Same as bip32_CKDpub, for extended pubkeys in the representation used for derivations. Neither
+ * the parent nor the child pubkey is decompressed, and no fingerprint is computed; therefore, it
+ * should be preferred whenever several derivation steps are chained, or only the child pubkey
+ * (and not its serialization) is needed.
+ *
+ * @param[in]  parent
+ *   Pointer to the parent extended pubkey.
+ * @param[in]  index
+ *   Index of the child to derive. It MUST be not hardened, that is, strictly less than 0x80000000.
+ * @param[out] child
+ *   Pointer to the output child extended pubkey. It can equal parent, which in that case is
+ *   overwritten.
+ *
+ * @return 0 if success, a negative number on failure.
+ */
+int bip32_CKDpub_point(const extended_pubkey_point_t *parent,
+                       uint32_t index,
+                       extended_pubkey_point_t *child);
+
 /**
  * Convenience wrapper for cx_hash to add some data to an initialized hash context.
  *
@@ -188,7 +243,7 @@ void crypto_ripemd160(const uint8_t *in, uint16_t inlen, uint8_t out[static 20])
  * @param[out] out
  *   Pointer to the 160-bit (20 bytes) output array.
  */
-void crypto_hash160(const uint8_t *in, uint16_t in_len, uint8_t *out);
+void crypto_hash160(const uint8_t *in, uint16_t in_len, uint8_t out[static 20]);
 
 /**
  * Computes the 33-bytes compressed public key from the uncompressed 65-bytes public key.
@@ -264,12 +319,73 @@ bool crypto_get_compressed_pubkey_at_path(const uint32_t bip32_path[],
 uint32_t crypto_get_key_fingerprint(const uint8_t pub_key[static 33]);
 
 /**
- * Computes the fingerprint of the master key as per BIP32.
+ * Computes the fingerprint of the master key as per BIP32. The result is cached until
+ * crypto_clear_cache is called.
  *
  * @return the fingerprint of the master key.
  */
 uint32_t crypto_get_master_key_fingerprint();
 
+/**
+ * Clears the cache of the master key fingerprint and of the recently derived extended pubkeys.
+ * Must be called whenever the device is locked, as the seed might be different once it is
+ * unlocked again.
+ */
+void crypto_clear_cache(void);
+
+/**
+ * Derives the pubkey at a given path and keeps it in the cache, so that the extended pubkeys of
+ * its descendants that are reached with unhardened derivation steps can be computed without
+ * deriving them from the seed.
+ *
+ * @param[in]  bip32_path
+ *   Pointer to 32-bit array of BIP-32 derivation steps.
+ * @param[in]  bip32_path_len
+ *   Number of steps in the BIP32 derivation.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int crypto_cache_pubkey_at_path(const uint32_t bip32_path[], uint8_t bip32_path_len);
+
+/**
+ * Computes the compressed pubkey at a given path, using the cache like
+ * crypto_get_extended_pubkey_at_path; unlike it, the parent's pubkey is not computed, as the
+ * fingerprint of the parent is not needed.
+ *
+ * @param[in]  bip32_path
+ *   Pointer to 32-bit array of BIP-32 derivation steps.
+ * @param[in]  bip32_path_len
+ *   Number of steps in the BIP32 derivation.
+ * @param[out] out
+ *   Pointer to the output compressed pubkey.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int crypto_get_pubkey_at_path(const uint32_t bip32_path[],
+                              uint8_t bip32_path_len,
+                              uint8_t out[static 33]);
+
+/**
+ * Computes the extended pubkey at a given path. The result and the parent's pubkey are kept in the
+ * cache until crypto_clear_cache is called; whenever possible, the pubkey is derived from a cached
+ * ancestor's.
+ *
+ * @param[in]  bip32_path
+ *   Pointer to 32-bit array of BIP-32 derivation steps.
+ * @param[in]  bip32_path_len
+ *   Number of steps in the BIP32 derivation.
+ * @param[in]  bip32_pubkey_version
+ *   Version prefix to use for the pubkey.
+ * @param[out] out
+ *   Pointer to the output extended pubkey.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int crypto_get_extended_pubkey_at_path(const uint32_t bip32_path[],
+                                       uint8_t bip32_path_len,
+                                       uint32_t bip32_pubkey_version,
+                                       serialized_extended_pubkey_t *out);
+
 /**
  * Computes the base58check-encoded extended pubkey at a given path.
  *
@@ -290,6 +406,42 @@ int get_serialized_extended_pubkey_at_path(const uint32_t bip32_path[],
                                            uint32_t bip32_pubkey_version,
                                            char out[static MAX_SERIALIZED_PUBKEY_LENGTH + 1]);
 
+/**
+ * Decodes a base58check-encoded extended pubkey.
+ *
+ * @param[in]  serialized
+ *   The null-terminated base58check-encoded extended pubkey.
+ * @param[out] out
+ *   Pointer to the output extended pubkey.
+ *
+ * @return 0 on success, -1 if the encoding or the checksum is invalid.
+ */
+int crypto_deserialize_extended_pubkey(const char *serialized, serialized_extended_pubkey_t *out);
+
+/**
+ * Checks whether an extended pubkey with key origin information is derived from the seed of the
+ * device. The comparison is done on the binary serialization, including the version.
+ *
+ * @param[in]  master_key_fingerprint
+ *   The fingerprint of the master key in the key origin information.
+ * @param[in]  bip32_path
+ *   Pointer to 32-bit array of BIP-32 derivation steps of the key origin information.
+ * @param[in]  bip32_path_len
+ *   Number of steps in the BIP32 derivation.
+ * @param[in]  bip32_pubkey_version
+ *   Version prefix of the pubkeys of the device.
+ * @param[in]  ext_pubkey
+ *   Pointer to the extended pubkey to check.
+ *
+ * @return true if the fingerprint is the one of the master key, and ext_pubkey is the extended
+ * pubkey at bip32_path; false otherwise.
+ */
+bool crypto_is_extended_pubkey_at_path(const uint8_t master_key_fingerprint[static 4],
+                                       const uint32_t bip32_path[],
+                                       uint8_t bip32_path_len,
+                                       uint32_t bip32_pubkey_version,
+                                       const serialized_extended_pubkey_t *ext_pubkey);
+
 /**
  * Derives the level-1 symmetric key at the given label using SLIP-0021.
  * Must be wrapped in a TRY/FINALLY block to make sure that the output key is wiped after using it.
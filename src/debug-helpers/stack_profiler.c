@@ -0,0 +1,119 @@
+#ifdef HAVE_STACK_PROFILER
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "stack_profiler.h"
+
+#ifndef HAVE_BOLOS_APP_STACK_CANARY
+#error "The stack profiler requires HAVE_BOLOS_APP_STACK_CANARY"
+#endif
+
+// defined in the linker script: the canary is the word just below the stack
+extern unsigned int app_stack_canary;
+extern unsigned int _estack;
+
+// bytes left unpainted below the frame of stack_profiler_paint
+#define PAINT_MARGIN 64
+
+static stack_profiler_entry_t entries[STACK_PROFILER_MAX_ENTRIES];
+static int n_entries;
+
+static bool is_measuring;
+static uint8_t current_ins;
+
+static volatile uint32_t *get_stack_bottom(void) {
+    return (volatile uint32_t *) (&app_stack_canary + 1);
+}
+
+static volatile uint32_t *get_stack_top(void) {
+    return (volatile uint32_t *) &_estack;
+}
+
+// Paints the stack from the canary (excluded) up to slightly below the frame of this function.
+// Returns false if the stack pointer is not within the stack, which should never happen.
+static bool __attribute__((noinline)) stack_profiler_paint(void) {
+    volatile uint32_t marker = 0;
+
+    volatile uint32_t *p = get_stack_bottom();
+    volatile uint32_t *end = (volatile uint32_t *) ((uintptr_t) &marker - PAINT_MARGIN);
+
+    if (end <= p || (volatile uint32_t *) &marker >= get_stack_top()) {
+        return false;
+    }
+
+    while (p < end) {
+        *p++ = STACK_PROFILER_PATTERN;
+    }
+    return true;
+}
+
+// Returns the number of bytes between the top of the stack and the deepest overwritten word
+static uint32_t stack_profiler_measure(void) {
+    volatile uint32_t *p = get_stack_bottom();
+    volatile uint32_t *top = get_stack_top();
+
+    while (p < top && *p == STACK_PROFILER_PATTERN) {
+        ++p;
+    }
+    return (uint32_t) ((uintptr_t) top - (uintptr_t) p);
+}
+
+void stack_profiler_init(void) {
+    memset(entries, 0, sizeof(entries));
+    n_entries = 0;
+    is_measuring = false;
+
+    stack_profiler_paint();
+}
+
+void stack_profiler_begin_command(uint8_t ins) {
+    is_measuring = stack_profiler_paint();
+    current_ins = ins;
+}
+
+void stack_profiler_end_command(void) {
+    if (!is_measuring) {
+        return;
+    }
+    is_measuring = false;
+
+    uint32_t used = stack_profiler_measure();
+
+    stack_profiler_entry_t *entry = NULL;
+    for (int i = 0; i < n_entries; i++) {
+        if (entries[i].ins == current_ins) {
+            entry = &entries[i];
+            break;
+        }
+    }
+    if (entry == NULL) {
+        if (n_entries == STACK_PROFILER_MAX_ENTRIES) {
+            return;
+        }
+        entry = &entries[n_entries++];
+        entry->ins = current_ins;
+    }
+
+    ++entry->n_commands;
+    if (used > entry->max_used) {
+        entry->max_used = used;
+    }
+
+    PRINTF("STACK PROFILER: INS=%02X used %d bytes (max: %d)\n",
+           current_ins,
+           used,
+           entry->max_used);
+}
+
+uint32_t stack_profiler_get_stack_size(void) {
+    return (uint32_t) ((uintptr_t) get_stack_top() - (uintptr_t) get_stack_bottom());
+}
+
+const stack_profiler_entry_t *stack_profiler_get_entries(int *n) {
+    *n = n_entries;
+    return entries;
+}
+
+#endif  // HAVE_STACK_PROFILER
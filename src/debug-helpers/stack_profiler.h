@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Stack profiler, only enabled in builds with HAVE_STACK_PROFILER (make STACK_PROFILER=1).
+ *
+ * When a command starts, the free part of the stack (below the frame of app_main) is painted with
+ * STACK_PROFILER_PATTERN. When the next APDU is received in app_main, the painted area is scanned
+ * from the stack canary upwards, and the deepest address that was overwritten gives the maximum
+ * stack usage of the command, including its client commands and UX flows. The maximum over all the
+ * executions of each INS is recorded, and returned by the GET_STACK_PROFILE debug APDU.
+ */
+
+#define STACK_PROFILER_PATTERN 0xA5A5A5A5
+
+/**
+ * Maximum number of different INS whose stack usage is recorded.
+ */
+#define STACK_PROFILER_MAX_ENTRIES 16
+
+typedef struct {
+    uint8_t ins;
+    uint32_t n_commands;  // number of executions of the command that were measured
+    uint32_t max_used;    // maximum stack usage, in bytes, measured from the top of the stack
+} stack_profiler_entry_t;
+
+/**
+ * Clears the recorded measurements, and paints the free part of the stack.
+ */
+void stack_profiler_init(void);
+
+/**
+ * Paints the free part of the stack, and starts the measurement of a command with the given INS.
+ */
+void stack_profiler_begin_command(uint8_t ins);
+
+/**
+ * Measures the stack usage since the last call to stack_profiler_begin_command, and records it for
+ * the INS of that command. Does nothing if no command is being measured.
+ */
+void stack_profiler_end_command(void);
+
+/**
+ * Returns the size of the stack, in bytes, excluding the canary; this is the maximum stack usage
+ * that can be measured.
+ */
+uint32_t stack_profiler_get_stack_size(void);
+
+/**
+ * Returns the recorded measurements, and stores their number in n_entries.
+ */
+const stack_profiler_entry_t *stack_profiler_get_entries(int *n_entries);
+
+#ifdef HAVE_STACK_PROFILER
+#define STACK_PROFILER_INIT()             stack_profiler_init()
+#define STACK_PROFILER_BEGIN_COMMAND(ins) stack_profiler_begin_command(ins)
+#define STACK_PROFILER_END_COMMAND()      stack_profiler_end_command()
+#else
+#define STACK_PROFILER_INIT()
+#define STACK_PROFILER_BEGIN_COMMAND(ins)
+#define STACK_PROFILER_END_COMMAND()
+#endif
@@ -25,6 +25,18 @@
 // Response: <is_found(0 or 1) : 1> <leaf_index : 4>
 #define CCMD_GET_MERKLE_LEAF_INDEX 0x42
 
+// Request : <CCMD_GET_MERKLE_LEAVES : 1> <merkle_root : 32> <tree_size : varint>
+//           <start_index : varint>
+// Response: <n_leaves : 1> <len_1 : 1> <leaf preimage 1 : len_1> ... <len_n : 1>
+//           <leaf preimage n_leaves : len_n>
+//           The preimages of consecutive leaves starting from start_index, without the 0x00 prefix;
+//           the host sends as many complete leaves as fit in the response, and at least one.
+#define CCMD_GET_MERKLE_LEAVES 0x43
+
+// Bit of the P2 of a command that the client sets if it supports CCMD_GET_MERKLE_LEAVES; the other
+// client commands are always supported.
+#define CLIENT_FEATURE_GET_MERKLE_LEAVES 0x01
+
 /* GENERIC/MULTIPURPOSE */
 
 // Used to get additional elements from the host when the required response from an interruption did
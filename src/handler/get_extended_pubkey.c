@@ -30,10 +30,10 @@ extern global_context_t *G_coin_config;
 
 static void send_response(dispatcher_context_t *dc);
 
-static bool is_path_safe_for_pubkey_export(const uint32_t bip32_path[],
-                                           size_t bip32_path_len,
-                                           const uint32_t coin_types[],
-                                           size_t coin_types_length) {
+bool is_path_safe_for_pubkey_export(const uint32_t bip32_path[],
+                                    size_t bip32_path_len,
+                                    const uint32_t coin_types[],
+                                    size_t coin_types_length) {
     if (bip32_path_len < 3) {
         return false;
     }
@@ -8,4 +8,14 @@ typedef struct {
     char serialized_pubkey_str[MAX_SERIALIZED_PUBKEY_LENGTH + 1];
 } get_extended_pubkey_state_t;
 
+/**
+ * Returns true if the path is a standard path for the given coin types, as defined in the
+ * documentation of the GET_EXTENDED_PUBKEY command; only the pubkeys at standard paths can be
+ * exported without showing them to the user.
+ */
+bool is_path_safe_for_pubkey_export(const uint32_t bip32_path[],
+                                    size_t bip32_path_len,
+                                    const uint32_t coin_types[],
+                                    size_t coin_types_length);
+
 void handler_get_extended_pubkey(dispatcher_context_t *dispatcher_context);
@@ -0,0 +1,197 @@
+/*****************************************************************************
+ *   Ledger App Bitcoin.
+ *   (c) 2021 Ledger SAS.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "boilerplate/io.h"
+#include "boilerplate/dispatcher.h"
+#include "boilerplate/sw.h"
+#include "../commands.h"
+#include "../constants.h"
+#include "../crypto.h"
+#include "../ui/display.h"
+#include "../ui/menu.h"
+
+#include "client_commands.h"
+
+extern global_context_t *G_coin_config;
+
+static void process_next_path(dispatcher_context_t *dc);
+static void yield_pubkey(dispatcher_context_t *dc);
+
+// Returns the length of the longest prefix that the path with the given index has in common with
+// any other path of the request
+static uint8_t get_shared_prefix_len(const get_extended_pubkeys_state_t *state,
+                                     unsigned int path_index) {
+    const uint32_t *path = state->bip32_paths[path_index];
+    uint8_t path_len = state->bip32_paths_len[path_index];
+
+    uint8_t result = 0;
+    for (unsigned int i = 0; i < state->n_paths; i++) {
+        if (i == path_index) {
+            continue;
+        }
+        uint8_t len = 0;
+        while (len < path_len && len < state->bip32_paths_len[i] &&
+               path[len] == state->bip32_paths[i][len]) {
+            ++len;
+        }
+        if (len > result) {
+            result = len;
+        }
+    }
+    return result;
+}
+
+void handler_get_extended_pubkeys(dispatcher_context_t *dc) {
+    get_extended_pubkeys_state_t *state = (get_extended_pubkeys_state_t *) &G_command_state;
+
+    LOG_PROCESSOR(dc, __FILE__, __LINE__, __func__);
+
+    // Device must be unlocked
+    if (os_global_pin_is_validated() != BOLOS_UX_OK) {
+        SEND_SW(dc, SW_SECURITY_STATUS_NOT_SATISFIED);
+        return;
+    }
+
+    uint8_t display;
+    if (!buffer_read_u8(&dc->read_buffer, &display) ||
+        !buffer_read_u8(&dc->read_buffer, &state->n_paths)) {
+        SEND_SW(dc, SW_WRONG_DATA_LENGTH);
+        return;
+    }
+
+    if (display > 1 || state->n_paths == 0 || state->n_paths > MAX_N_EXTENDED_PUBKEYS_PATHS) {
+        SEND_SW(dc, SW_INCORRECT_DATA);
+        return;
+    }
+    state->display = display;
+
+    uint32_t coin_types[2] = {G_coin_config->bip44_coin_type, G_coin_config->bip44_coin_type2};
+
+    // all the paths are validated before any pubkey is returned
+    for (unsigned int i = 0; i < state->n_paths; i++) {
+        uint8_t bip32_path_len;
+        if (!buffer_read_u8(&dc->read_buffer, &bip32_path_len)) {
+            SEND_SW(dc, SW_WRONG_DATA_LENGTH);
+            return;
+        }
+
+        if (bip32_path_len > MAX_BIP32_PATH_STEPS) {
+            SEND_SW(dc, SW_INCORRECT_DATA);
+            return;
+        }
+
+        if (!buffer_read_bip32_path(&dc->read_buffer, state->bip32_paths[i], bip32_path_len)) {
+            SEND_SW(dc, SW_WRONG_DATA_LENGTH);
+            return;
+        }
+        state->bip32_paths_len[i] = bip32_path_len;
+
+        state->is_path_safe[i] =
+            is_path_safe_for_pubkey_export(state->bip32_paths[i], bip32_path_len, coin_types, 2);
+
+        if (!state->is_path_safe[i] && !state->display) {
+            SEND_SW(dc, SW_NOT_SUPPORTED);
+            return;
+        }
+    }
+
+    if (buffer_can_read(&dc->read_buffer, 1)) {
+        SEND_SW(dc, SW_WRONG_DATA_LENGTH);
+        return;
+    }
+
+    state->cur_path_index = 0;
+    dc->next(process_next_path);
+}
+
+static void process_next_path(dispatcher_context_t *dc) {
+    get_extended_pubkeys_state_t *state = (get_extended_pubkeys_state_t *) &G_command_state;
+
+    LOG_PROCESSOR(dc, __FILE__, __LINE__, __func__);
+
+    if (state->cur_path_index >= state->n_paths) {
+        SEND_SW(dc, SW_OK);
+        return;
+    }
+
+    const uint32_t *bip32_path = state->bip32_paths[state->cur_path_index];
+    uint8_t bip32_path_len = state->bip32_paths_len[state->cur_path_index];
+
+    // The pubkeys after the last hardened derivation step (like the addresses of an account) can be
+    // computed from the pubkey at that step without any derivation from the seed. If other paths
+    // share that ancestor, it is derived once and kept in the cache. The parent of each path is
+    // cached anyway, as it is needed for its fingerprint.
+    uint8_t hardened_prefix_len = bip32_path_len;
+    while (hardened_prefix_len > 0 &&
+           bip32_path[hardened_prefix_len - 1] < BIP32_FIRST_HARDENED_CHILD) {
+        --hardened_prefix_len;
+    }
+    if (hardened_prefix_len + 1 < bip32_path_len &&
+        get_shared_prefix_len(state, state->cur_path_index) >= hardened_prefix_len) {
+        if (crypto_cache_pubkey_at_path(bip32_path, hardened_prefix_len) < 0) {
+            SEND_SW(dc, SW_BAD_STATE);
+            return;
+        }
+    }
+
+    int serialized_pubkey_len =
+        get_serialized_extended_pubkey_at_path(bip32_path,
+                                               bip32_path_len,
+                                               G_coin_config->bip32_pubkey_version,
+                                               state->serialized_pubkey_str);
+    if (serialized_pubkey_len == -1) {
+        SEND_SW(dc, SW_BAD_STATE);
+        return;
+    }
+
+    if (state->display) {
+        char path_str[MAX_SERIALIZED_BIP32_PATH_LENGTH + 1] = "(Master key)";
+        if (bip32_path_len > 0) {
+            bip32_path_format(bip32_path, bip32_path_len, path_str, sizeof(path_str));
+        }
+
+        ui_display_pubkey(dc,
+                          path_str,
+                          !state->is_path_safe[state->cur_path_index],
+                          state->serialized_pubkey_str,
+                          yield_pubkey);
+    } else {
+        dc->next(yield_pubkey);
+    }
+}
+
+static void yield_pubkey(dispatcher_context_t *dc) {
+    get_extended_pubkeys_state_t *state = (get_extended_pubkeys_state_t *) &G_command_state;
+
+    LOG_PROCESSOR(dc, __FILE__, __LINE__, __func__);
+
+    uint8_t cmd = CCMD_YIELD;
+    dc->add_to_response(&cmd, 1);
+    dc->add_to_response(state->serialized_pubkey_str, strlen(state->serialized_pubkey_str));
+    dc->finalize_response(SW_INTERRUPTED_EXECUTION);
+
+    if (dc->process_interruption(dc) < 0) {
+        SEND_SW(dc, SW_BAD_STATE);
+        return;
+    }
+
+    ++state->cur_path_index;
+    dc->next(process_next_path);
+}
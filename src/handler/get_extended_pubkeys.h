@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../common/bip32.h"
+#include "../boilerplate/dispatcher.h"
+
+/**
+ * Maximum number of derivation paths in a single GET_EXTENDED_PUBKEYS request.
+ */
+#define MAX_N_EXTENDED_PUBKEYS_PATHS 16
+
+typedef struct {
+    machine_context_t ctx;
+
+    bool display;
+    uint8_t n_paths;
+    uint8_t cur_path_index;
+
+    uint8_t bip32_paths_len[MAX_N_EXTENDED_PUBKEYS_PATHS];
+    uint32_t bip32_paths[MAX_N_EXTENDED_PUBKEYS_PATHS][MAX_BIP32_PATH_STEPS];
+    bool is_path_safe[MAX_N_EXTENDED_PUBKEYS_PATHS];
+
+    char serialized_pubkey_str[MAX_SERIALIZED_PUBKEY_LENGTH + 1];
+} get_extended_pubkeys_state_t;
+
+void handler_get_extended_pubkeys(dispatcher_context_t *dispatcher_context);
@@ -32,7 +32,9 @@ void handler_get_master_fingerprint(dispatcher_context_t *dc) {
     }
 
     uint8_t master_pubkey[33];
-    if (!crypto_get_compressed_pubkey_at_path((uint32_t[]){}, 0, master_pubkey, NULL)) {
+    // the path is empty; a 1-element array avoids passing an array of size 0
+    const uint32_t bip32_path[1] = {0};
+    if (!crypto_get_compressed_pubkey_at_path(bip32_path, 0, master_pubkey, NULL)) {
         SEND_SW(dc, SW_BAD_STATE);  // should never happen
         return;
     }
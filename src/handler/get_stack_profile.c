@@ -0,0 +1,54 @@
+/*****************************************************************************
+ *   Ledger App Bitcoin.
+ *   (c) 2021 Ledger SAS.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *****************************************************************************/
+
+#ifdef HAVE_STACK_PROFILER
+
+#include <stdint.h>
+
+#include "boilerplate/dispatcher.h"
+#include "boilerplate/sw.h"
+#include "../common/write.h"
+#include "../debug-helpers/stack_profiler.h"
+
+#include "get_stack_profile.h"
+
+void handler_get_stack_profile(dispatcher_context_t *dc) {
+    if (dc->read_buffer.size != 0) {
+        SEND_SW(dc, SW_WRONG_DATA_LENGTH);
+        return;
+    }
+
+    int n_entries;
+    const stack_profiler_entry_t *entries = stack_profiler_get_entries(&n_entries);
+
+    uint8_t header[5];
+    write_u32_be(header, 0, stack_profiler_get_stack_size());
+    header[4] = (uint8_t) n_entries;
+    dc->add_to_response(header, sizeof(header));
+
+    for (int i = 0; i < n_entries; i++) {
+        uint8_t entry[9];
+        entry[0] = entries[i].ins;
+        write_u32_be(entry, 1, entries[i].n_commands);
+        write_u32_be(entry, 5, entries[i].max_used);
+        dc->add_to_response(entry, sizeof(entry));
+    }
+
+    SEND_SW(dc, SW_OK);
+}
+
+#endif  // HAVE_STACK_PROFILER
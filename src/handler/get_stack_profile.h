@@ -0,0 +1,15 @@
+#pragma once
+
+#include "../boilerplate/dispatcher.h"
+
+/**
+ * Debug command, only available in builds with HAVE_STACK_PROFILER (make STACK_PROFILER=1).
+ *
+ * Returns the maximum stack usage measured by the stack profiler for each INS executed since the
+ * app started. The response is:
+ *   - the size of the stack (4 bytes, big endian);
+ *   - the number n of entries (1 byte);
+ *   - for each entry: the INS (1 byte), the number of measured executions (4 bytes, big endian),
+ *     and the maximum stack usage in bytes (4 bytes, big endian).
+ */
+void handler_get_stack_profile(dispatcher_context_t *dispatcher_context);
@@ -34,6 +34,7 @@
 
 #include "lib/policy.h"
 #include "lib/get_preimage.h"
+#include "lib/wallet_cache.h"
 
 #include "get_wallet_address.h"
 #include "client_commands.h"
@@ -77,6 +78,36 @@ void handler_get_wallet_address(dispatcher_context_t *dc) {
         return;
     }
 
+    // the binary OR of all the hmac bytes (so == 0 iff the hmac is identically 0)
+    uint8_t hmac_or = 0;
+    for (int i = 0; i < 32; i++) {
+        hmac_or = hmac_or | state->wallet_hmac[i];
+    }
+
+    // A registered wallet in the cache only needs the hmac to be verified; the policy and the keys
+    // are not fetched from the client
+    const wallet_cache_entry_t *cached_wallet =
+        hmac_or != 0 ? wallet_cache_find(state->wallet_id) : NULL;
+    if (cached_wallet != NULL) {
+        if (!check_wallet_hmac(state->wallet_id, state->wallet_hmac)) {
+            PRINTF("Incorrect hmac\n");
+            SEND_SW(dc, SW_SIGNATURE_FAIL);
+            return;
+        }
+
+        wallet_cache_load(cached_wallet, &state->wallet_header, state->wallet_policy_map_bytes);
+
+        memcpy(state->wallet_header_keys_info_merkle_root,
+               state->wallet_header.keys_info_merkle_root,
+               sizeof(state->wallet_header.keys_info_merkle_root));
+        state->wallet_header_n_keys = state->wallet_header.n_keys;
+
+        state->is_wallet_canonical = false;
+
+        dc->next(compute_address);
+        return;
+    }
+
     // Fetch the serialized wallet policy from the client
     int serialized_wallet_policy_len = call_get_preimage(dc,
                                                          state->wallet_id,
@@ -109,12 +140,6 @@ void handler_get_wallet_address(dispatcher_context_t *dc) {
         return;
     }
 
-    // the binary OR of all the hmac bytes (so == 0 iff the hmac is identically 0)
-    uint8_t hmac_or = 0;
-    for (int i = 0; i < 32; i++) {
-        hmac_or = hmac_or | state->wallet_hmac[i];
-    }
-
     if (hmac_or == 0) {
         // No hmac, verify that the policy is a canonical one that is allowed by default
         state->address_type = get_policy_address_type(&state->wallet_policy_map);
@@ -131,8 +156,6 @@ void handler_get_wallet_address(dispatcher_context_t *dc) {
         }
 
         // we check if the key is indeed internal
-        uint32_t master_key_fingerprint = crypto_get_master_key_fingerprint();
-
         int key_info_len = call_get_merkle_leaf_element(dc,
                                                         state->wallet_header_keys_info_merkle_root,
                                                         state->wallet_header_n_keys,
@@ -153,24 +176,13 @@ void handler_get_wallet_address(dispatcher_context_t *dc) {
             return;
         }
 
-        if (read_u32_be(key_info.master_key_fingerprint, 0) != master_key_fingerprint) {
-            SEND_SW(dc, SW_INCORRECT_DATA);
-            return;
-        }
-
-        // generate pubkey and check if it matches
-        char pubkey_derived[MAX_SERIALIZED_PUBKEY_LENGTH + 1];
-        int serialized_pubkey_len =
-            get_serialized_extended_pubkey_at_path(key_info.master_key_derivation,
-                                                   key_info.master_key_derivation_len,
-                                                   G_coin_config->bip32_pubkey_version,
-                                                   pubkey_derived);
-        if (serialized_pubkey_len == -1) {
-            SEND_SW(dc, SW_BAD_STATE);
-            return;
-        }
-
-        if (strncmp(key_info.ext_pubkey, pubkey_derived, MAX_SERIALIZED_PUBKEY_LENGTH) != 0) {
+        serialized_extended_pubkey_t ext_pubkey;
+        if (get_policy_map_key_info_ext_pubkey(&key_info, &ext_pubkey) < 0 ||
+            !crypto_is_extended_pubkey_at_path(key_info.master_key_fingerprint,
+                                               key_info.master_key_derivation,
+                                               key_info.master_key_derivation_len,
+                                               G_coin_config->bip32_pubkey_version,
+                                               &ext_pubkey)) {
             SEND_SW(dc, SW_INCORRECT_DATA);
             return;
         }
@@ -220,6 +232,14 @@ void handler_get_wallet_address(dispatcher_context_t *dc) {
         return;
     }
 
+    // the cache is an optimization, therefore a failure does not prevent computing the address
+    if (!state->is_wallet_canonical && wallet_cache_record_miss(state->wallet_id)) {
+        wallet_cache_add(dc,
+                         state->wallet_id,
+                         &state->wallet_header,
+                         state->wallet_policy_map_bytes);
+    }
+
     dc->next(compute_address);
 }
 
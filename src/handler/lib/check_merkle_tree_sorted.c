@@ -3,18 +3,53 @@
 #include "check_merkle_tree_sorted.h"
 #include "get_merkle_leaf_element.h"
 
+#include "../../common/buffer.h"
+#include "../../common/merkle.h"
+#include "../../common/varint.h"
+#include "../../boilerplate/sw.h"
+#include "../client_commands.h"
+
 static int compare_byte_arrays(const uint8_t array1[],
                                size_t array1_len,
                                const uint8_t array2[],
                                size_t array2_len);
 
-int call_check_merkle_tree_sorted_with_callback(dispatcher_context_t *dispatcher_context,
-                                                const uint8_t root[static 32],
-                                                size_t size,
-                                                dispatcher_callback_descriptor_t callback) {
-    // LOG_PROCESSOR(dispatcher_context, __FILE__, __LINE__, __func__);
+// Checks that the element is strictly larger than the previous one (if any), stores it as the new
+// previous element, and calls the callback. Returns 0 on success, -1 on failure.
+static int process_element(const uint8_t *cur_el,
+                           size_t cur_el_len,
+                           uint8_t prev_el[static MAX_CHECK_MERKLE_TREE_SORTED_PREIMAGE_SIZE],
+                           int *prev_el_len,
+                           dispatcher_callback_descriptor_t callback) {
+    if (cur_el_len > MAX_CHECK_MERKLE_TREE_SORTED_PREIMAGE_SIZE) {
+        return -1;
+    }
 
-    int prev_el_len = 0;
+    if (*prev_el_len >= 0 && compare_byte_arrays(prev_el, *prev_el_len, cur_el, cur_el_len) >= 0) {
+        // elements are not in (strict) lexicographical order
+        PRINTF("Keys not in order\n");
+        return -1;
+    }
+
+    memcpy(prev_el, cur_el, cur_el_len);
+    *prev_el_len = cur_el_len;
+
+    if (callback.fn != NULL) {
+        // call callback with data
+        buffer_t buf = buffer_create(prev_el, cur_el_len);
+        callback.fn(callback.state, &buf);
+    }
+    return 0;
+}
+
+// Requests each element separately, verifying its Merkle proof.
+// Not inlined, so that the caller's frame does not hold the buffers of both the checks.
+static int __attribute__((noinline))
+check_sorted_by_leaf(dispatcher_context_t *dispatcher_context,
+                     const uint8_t root[static 32],
+                     size_t size,
+                     dispatcher_callback_descriptor_t callback) {
+    int prev_el_len = -1;
     uint8_t prev_el[MAX_CHECK_MERKLE_TREE_SORTED_PREIMAGE_SIZE];
 
     for (size_t cur_el_idx = 0; cur_el_idx < size; cur_el_idx++) {
@@ -30,24 +65,110 @@ int call_check_merkle_tree_sorted_with_callback(dispatcher_context_t *dispatcher
             return -1;
         }
 
-        if (cur_el_idx > 0 && compare_byte_arrays(prev_el, prev_el_len, cur_el, cur_el_len) >= 0) {
-            // elements are not in (strict) lexicographical order
-            PRINTF("Keys not in order\n");
+        if (process_element(cur_el, cur_el_len, prev_el, &prev_el_len, callback) < 0) {
             return -1;
         }
+    }
+    return 0;
+}
+
+// Requests all the elements in order with CCMD_GET_MERKLE_LEAVES, and recomputes the Merkle root
+// incrementally: the stack contains the roots of the complete subtrees of the leaves received so
+// far, with decreasing sizes, that are combined from right to left once all the leaves are known.
+static int __attribute__((noinline))
+check_sorted_streamed(dispatcher_context_t *dc,
+                      const uint8_t root[static 32],
+                      size_t size,
+                      dispatcher_callback_descriptor_t callback) {
+    int prev_el_len = -1;
+    uint8_t prev_el[MAX_CHECK_MERKLE_TREE_SORTED_PREIMAGE_SIZE];
 
-        memcpy(prev_el, cur_el, cur_el_len);
-        prev_el_len = cur_el_len;
+    uint8_t stack[CHECK_MERKLE_TREE_SORTED_STREAM_MAX_DEPTH][32];
+    int stack_len = 0;
 
-        if (callback.fn != NULL) {
-            // call callback with data
-            buffer_t buf = buffer_create(cur_el, cur_el_len);
-            callback.fn(callback.state, &buf);
+    size_t n_received = 0;
+    while (n_received < size) {
+        {  // make sure memory is deallocated as soon as possible
+            uint8_t tmp[9];
+            tmp[0] = CCMD_GET_MERKLE_LEAVES;
+            dc->add_to_response(tmp, 1);
+
+            dc->add_to_response(root, 32);
+
+            int tree_size_len = varint_write(tmp, 0, size);
+            dc->add_to_response(tmp, tree_size_len);
+
+            int start_index_len = varint_write(tmp, 0, n_received);
+            dc->add_to_response(tmp, start_index_len);
+
+            dc->finalize_response(SW_INTERRUPTED_EXECUTION);
         }
+
+        if (dc->process_interruption(dc) < 0) {
+            return -1;
+        }
+
+        uint8_t n_leaves;
+        if (!buffer_read_u8(&dc->read_buffer, &n_leaves) || n_leaves == 0 ||
+            n_leaves > size - n_received) {
+            return -1;
+        }
+
+        for (int i = 0; i < n_leaves; i++) {
+            uint8_t el_len;
+            if (!buffer_read_u8(&dc->read_buffer, &el_len) ||
+                !buffer_can_read(&dc->read_buffer, el_len)) {
+                return -1;
+            }
+
+            const uint8_t *el = dc->read_buffer.ptr + dc->read_buffer.offset;
+            if (process_element(el, el_len, prev_el, &prev_el_len, callback) < 0) {
+                return -1;
+            }
+
+            uint8_t cur_hash[32];
+            merkle_compute_element_hash(prev_el, el_len, cur_hash);
+            buffer_seek_cur(&dc->read_buffer, el_len);
+
+            // merge the complete subtrees of equal size, one for each trailing 1 bit of n_received
+            for (size_t n = n_received; (n & 1) != 0; n >>= 1) {
+                merkle_combine_hashes(stack[--stack_len], cur_hash, cur_hash);
+            }
+            memcpy(stack[stack_len++], cur_hash, 32);
+            ++n_received;
+        }
+
+        if (buffer_can_read(&dc->read_buffer, 1)) {
+            return -1;  // unexpected data after the leaves
+        }
+    }
+
+    for (int i = stack_len - 2; i >= 0; i--) {
+        merkle_combine_hashes(stack[i], stack[stack_len - 1], stack[stack_len - 1]);
+    }
+
+    if (memcmp(stack[stack_len - 1], root, 32) != 0) {
+        PRINTF("Merkle root mismatch");
+        return -1;
     }
     return 0;
 }
 
+int call_check_merkle_tree_sorted_with_callback(dispatcher_context_t *dispatcher_context,
+                                                const uint8_t root[static 32],
+                                                size_t size,
+                                                dispatcher_callback_descriptor_t callback) {
+    // LOG_PROCESSOR(dispatcher_context, __FILE__, __LINE__, __func__);
+
+    if ((dispatcher_get_command_p2() & CLIENT_FEATURE_GET_MERKLE_LEAVES) == 0 || size == 0 ||
+        size >= (1u << CHECK_MERKLE_TREE_SORTED_STREAM_MAX_DEPTH)) {
+        // the client does not support CCMD_GET_MERKLE_LEAVES, or the stack of the streamed check
+        // is not large enough for the tree
+        return check_sorted_by_leaf(dispatcher_context, root, size, callback);
+    }
+    return check_sorted_streamed(dispatcher_context, root, size, callback);
+}
+
 // Returns a negative number, 0 or a positive number if the first array is (respectively)
 // lexicographically smaller, equal, or larger than the second. If one array is prefix than the
 // other, then the shorter ones comes first in lexicographical order.
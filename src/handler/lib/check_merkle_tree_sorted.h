@@ -6,12 +6,26 @@
 // In PSBT, keys are currently up to 1+78 (for a serialized extended public key).
 #define MAX_CHECK_MERKLE_TREE_SORTED_PREIMAGE_SIZE 80
 
+// If the client supports CCMD_GET_MERKLE_LEAVES, trees with fewer than
+// pow(2, CHECK_MERKLE_TREE_SORTED_STREAM_MAX_DEPTH) elements are streamed, keeping a stack of this
+// many hashes (224 bytes); larger trees (not expected for the keys of PSBT maps) are checked one
+// leaf at a time.
+#define CHECK_MERKLE_TREE_SORTED_STREAM_MAX_DEPTH 7
+
 /**
  * Given a Merkle tree root and the size of the tree, it requests all the elements to the client
- * (verifying Merkle proofs) and verifies that the leaf preimages are in lexicographical order. If a
+ * and verifies that the leaf preimages are in lexicographical order. Each element is requested
+ * with its Merkle proof; if the client declared support for CCMD_GET_MERKLE_LEAVES in the P2 of
+ * the command (CLIENT_FEATURE_GET_MERKLE_LEAVES), the elements are instead streamed in order, and
+ * the Merkle root is recomputed from all the leaves, which takes far fewer round trips. If a
  * callback to a non-NULL function is given, it is called once for each of the elements of the
  * Merkle tree, in lexicographical order.
  *
+ * When the elements are streamed, the callback is called for each element as soon as it is
+ * received, before the Merkle root is verified at the end: if this function fails, the callback
+ * might have been called with elements that are not in the tree, and the caller must discard
+ * anything that the callback computed.
+ *
  * Returns 0 on success, or a negative number on failure.
  */
 int call_check_merkle_tree_sorted_with_callback(dispatcher_context_t *dispatcher_context,
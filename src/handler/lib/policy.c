@@ -3,8 +3,8 @@
 #include "policy.h"
 
 #include "../lib/get_merkle_leaf_element.h"
+#include "../lib/wallet_cache.h"
 #include "../../crypto.h"
-#include "../../common/base58.h"
 #include "../../common/segwit_addr.h"
 
 extern global_context_t G_context;
@@ -38,6 +38,9 @@ typedef struct {
     bool change;
     size_t address_index;
 
+    // if not NULL, the keys are read from the wallet cache instead of the client
+    const wallet_cache_entry_t *cached_wallet;
+
     policy_parser_node_state_t nodes[MAX_POLICY_DEPTH];  // stack of nodes being processed
     int node_stack_eos;  // index of node being processed within nodes; will be set -1 at the end of
                          // processing
@@ -94,19 +97,10 @@ static int __attribute__((noinline)) get_extended_pubkey(policy_parser_state_t *
         }
     }
 
-    // decode pubkey
-    serialized_extended_pubkey_check_t decoded_pubkey_check;
-    if (base58_decode(key_info.ext_pubkey,
-                      strlen(key_info.ext_pubkey),
-                      (uint8_t *) &decoded_pubkey_check,
-                      sizeof(decoded_pubkey_check)) == -1) {
+    // decode pubkey, unless it is already in the binary encoding
+    if (get_policy_map_key_info_ext_pubkey(&key_info, out) < 0) {
         return -1;
     }
-    // TODO: validate checksum
-
-    memcpy(out,
-           &decoded_pubkey_check.serialized_extended_pubkey,
-           sizeof(decoded_pubkey_check.serialized_extended_pubkey));
 
     return key_info.has_wildcard ? 1 : 0;
 }
@@ -114,21 +108,54 @@ static int __attribute__((noinline)) get_extended_pubkey(policy_parser_state_t *
 static int get_derived_pubkey(policy_parser_state_t *state, int key_index, uint8_t out[static 33]) {
     PRINT_STACK_POINTER();
 
-    serialized_extended_pubkey_t ext_pubkey;
+    // the derivations use the uncompressed points, that are only compressed at the end
+    extended_pubkey_point_t node;
 
-    int ret = get_extended_pubkey(state, key_index, &ext_pubkey);
-    if (ret < 0) {
-        return -1;
+    if (state->cached_wallet != NULL) {
+        if (key_index < 0 || key_index >= state->cached_wallet->n_keys) {
+            return -1;
+        }
+
+        const wallet_cache_key_t *key = &state->cached_wallet->keys[key_index];
+        if (key->has_wildcard) {
+            // the /0 and /1 children are already cached; only the last step is left
+            if (bip32_CKDpub_point(&key->children[state->change ? 1 : 0],
+                                   state->address_index,
+                                   &node) < 0) {
+                return -1;
+            }
+            crypto_get_compressed_pubkey(node.uncompressed_pubkey, out);
+        } else {
+            memcpy(out, key->ext_pubkey.compressed_pubkey, 33);
+        }
+        return 0;
+    }
+
+    {
+        serialized_extended_pubkey_t ext_pubkey;
+
+        int ret = get_extended_pubkey(state, key_index, &ext_pubkey);
+        if (ret < 0) {
+            return -1;
+        }
+
+        if (ret == 0) {
+            memcpy(out, ext_pubkey.compressed_pubkey, 33);
+            return 0;
+        }
+
+        if (crypto_extended_pubkey_to_point(&ext_pubkey, &node) < 0) {
+            return -1;
+        }
     }
 
-    if (ret == 1) {
-        // we derive the /0/i child of this pubkey
-        // we reuse the same memory of ext_pubkey
-        bip32_CKDpub(&ext_pubkey, state->change, &ext_pubkey);
-        bip32_CKDpub(&ext_pubkey, state->address_index, &ext_pubkey);
+    // we derive the /<change>/<address_index> child of this pubkey
+    if (bip32_CKDpub_point(&node, state->change, &node) < 0 ||
+        bip32_CKDpub_point(&node, state->address_index, &node) < 0) {
+        return -1;
     }
 
-    memcpy(out, ext_pubkey.compressed_pubkey, 33);
+    crypto_get_compressed_pubkey(node.uncompressed_pubkey, out);
 
     return 0;
 }
@@ -136,7 +163,7 @@ static int get_derived_pubkey(policy_parser_state_t *state, int key_index, uint8
 /**
  * Pushes a node onto the stack. Returns 0 on success, -1 if the stack is exhausted.
  */
-static int state_stack_push(policy_parser_state_t *state, policy_node_t *policy_node) {
+static int state_stack_push(policy_parser_state_t *state, const policy_node_t *policy_node) {
     ++state->node_stack_eos;
 
     if (state->node_stack_eos >= MAX_POLICY_DEPTH) {
@@ -257,7 +284,7 @@ static int __attribute__((noinline)) process_sh_wsh_node(policy_parser_state_t *
 
     if (node->step == 0) {
         // process child in HASH mode
-        if (-1 == state_stack_push(state, policy->script)) {
+        if (-1 == state_stack_push(state, policy_node_get_script(policy))) {
             return -1;
         }
         ++node->step;
@@ -413,11 +440,14 @@ int call_get_wallet_script(dispatcher_context_t *dispatcher_context,
                            bool change,
                            size_t address_index,
                            buffer_t *out_buf) {
+    const wallet_cache_entry_t *cached_wallet = wallet_cache_find_keys(keys_merkle_root, n_keys);
+
     policy_parser_state_t state = {.dispatcher_context = dispatcher_context,
                                    .keys_merkle_root = keys_merkle_root,
                                    .n_keys = n_keys,
                                    .change = change,
                                    .address_index = address_index,
+                                   .cached_wallet = cached_wallet,
                                    .node_stack_eos = 0};
 
     state.nodes[0] = (policy_parser_node_state_t){.mode = MODE_OUT_BYTES,
@@ -459,7 +489,8 @@ int get_policy_address_type(const policy_node_t *policy) {
             return ADDRESS_TYPE_WIT;
         case TOKEN_SH:
             // wrapped segwit
-            if (((policy_node_with_script_t *) policy)->script->type == TOKEN_WPKH) {
+            if (policy_node_get_script((const policy_node_with_script_t *) policy)->type ==
+                TOKEN_WPKH) {
                 return ADDRESS_TYPE_SH_WIT;
             }
             return -1;
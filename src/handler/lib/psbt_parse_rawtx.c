@@ -17,87 +17,51 @@
 #include "../../common/varint.h"
 #include "../../crypto.h"
 
-struct parse_rawtx_state_s;  // forward declaration
-
-typedef struct {
-    struct parse_rawtx_state_s *parent_state;  // subparsers can access parent's state
-    unsigned int scriptsig_size;               // max 10_000 bytes
-    unsigned int scriptsig_counter;            // counter of scriptsig bytes already received
-} parse_rawtxinput_state_t;
-
-typedef struct {
-    struct parse_rawtx_state_s *parent_state;
-    unsigned int scriptpubkey_size;     // max 10_000 bytes
-    unsigned int scriptpubkey_counter;  // counter of scriptpubkey bytes already received
-} parse_rawtxoutput_state_t;
-
-typedef struct parse_rawtx_state_s {
-    cx_sha256_t *hash_context;
-
-    bool is_segwit;
-    unsigned int n_inputs;
-    unsigned int n_outputs;
-
-    union {
-        // since the parsing stages of inputs, outputs and witnesses are disjoint, we reuse the same
-        // space in memory
-        struct {
-            unsigned int in_counter;
-            parser_context_t input_parser_context;
-            parse_rawtxinput_state_t input_parser_state;
-        };
-        struct {
-            unsigned int out_counter;
-            parser_context_t output_parser_context;
-            parse_rawtxoutput_state_t output_parser_state;
-        };
-        struct {
-            unsigned int wit_counter;             // index of witness field being read
-            unsigned int wit_stack_el_counter;    // index of the stack element in the witness field
-            unsigned int cur_wit_stack_elements;  // number of stack elements
-            unsigned int cur_wit_elem_len;        // size of the current stack elements
-            unsigned int cur_wit_el_bytes_read;   // number of bytes read of the current element
-            bool is_cur_wit_stack_elements_read;
-            bool is_cur_wit_elem_len_read;
-        };
-    };
-
-    int output_index;  // index of queried output, or -1
-
-    txid_parser_outputs_t *parser_outputs;
-
-} parse_rawtx_state_t;
-
-typedef struct psbt_parse_rawtx_state_s {
-    // internal state
-    uint8_t store[32];               // buffer for unparsed data
-    unsigned int store_data_length;  // size of data currently in store
-    parse_rawtx_state_t parser_state;
-    parser_context_t parser_context;
-    bool parser_error;  // set to true if there was an error during parsing
-} psbt_parse_rawtx_state_t;
+// Processes the next bytes of a field of the given size, of which *counter bytes were already
+// processed. The bytes are used directly from the buffers, without copying them: they are added to
+// hash_context (unless NULL), and copied to out + *counter (unless out is NULL). Returns 1 once the
+// whole field is processed, 0 if more data is needed.
+static int process_field(buffer_t *buffers[2],
+                         unsigned int size,
+                         unsigned int *counter,
+                         cx_sha256_t *hash_context,
+                         uint8_t *out) {
+    while (*counter < size) {
+        const uint8_t *chunk;
+        size_t chunk_len = dbuffer_read_chunk(buffers, &chunk, size - *counter);
+        if (chunk_len == 0) {
+            return 0;  // could not read enough data
+        }
+
+        if (hash_context != NULL) {
+            crypto_hash_update(&hash_context->header, chunk, chunk_len);
+        }
+        if (out != NULL) {
+            memcpy(out + *counter, chunk, chunk_len);
+        }
+        *counter += chunk_len;
+    }
+    return 1;
+}
 
 /*   PARSER FOR A RAWTX INPUT */
 
-// parses the 32-bytes txid of an input in a rawtx
-static int parse_rawtxinput_txid(parse_rawtxinput_state_t *state, buffer_t *buffers[2]) {
-    uint8_t txid[32];
-    bool result = dbuffer_read_bytes(buffers, txid, 32);
-    if (result) {
-        crypto_hash_update(&state->parent_state->hash_context->header, txid, 32);
-    }
-    return result;
+// Does not read any bytes; only initializing the state before the next step
+static int parse_rawtxinput_prevout_init(parse_rawtxinput_state_t *state, buffer_t *buffers[2]) {
+    (void) buffers;
+
+    state->prevout_counter = 0;
+
+    return 1;
 }
 
-// parses the 4-bytes vout of an input in a rawtx
-// TODO: shares logic with the previous method; try to factor out the shared code
-static int parse_rawtxinput_vout(parse_rawtxinput_state_t *state, buffer_t *buffers[2]) {
-    uint8_t vout_bytes[4];
-    bool result = dbuffer_read_bytes(buffers, vout_bytes, 4);
-    if (result) {
-        crypto_hash_update(&state->parent_state->hash_context->header, vout_bytes, 4);
-    }
-    return result;
+// parses the 32-bytes txid and the 4-bytes vout of an input in a rawtx
+static int parse_rawtxinput_prevout(parse_rawtxinput_state_t *state, buffer_t *buffers[2]) {
+    return process_field(buffers,
+                         32 + 4,
+                         &state->prevout_counter,
+                         state->parent_state->hash_context,
+                         NULL);
 }
 
 static int parse_rawtxinput_scriptsig_size(parse_rawtxinput_state_t *state, buffer_t *buffers[2]) {
@@ -122,28 +86,11 @@ static int parse_rawtxinput_scriptsig_init(parse_rawtxinput_state_t *state, buff
 }
 
 static int parse_rawtxinput_scriptsig(parse_rawtxinput_state_t *state, buffer_t *buffers[2]) {
-    uint8_t data[32];
-
-    while (true) {
-        int remaining_len = state->scriptsig_size - state->scriptsig_counter;
-
-        // We read in chunks of at most 32 bytes, so that we can always interrupt with less than 32
-        // unparsed bytes
-        int data_len = MIN(32, remaining_len);
-
-        bool read_result = dbuffer_read_bytes(buffers, data, data_len);
-        if (!read_result) {
-            return 0;  // could not read enough data
-        }
-
-        crypto_hash_update(&state->parent_state->hash_context->header, data, data_len);
-
-        state->scriptsig_counter += data_len;
-
-        if (state->scriptsig_counter == state->scriptsig_size) {
-            return 1;  // done
-        }
-    }
+    return process_field(buffers,
+                         state->scriptsig_size,
+                         &state->scriptsig_counter,
+                         state->parent_state->hash_context,
+                         NULL);
 }
 
 static int parse_rawtxinput_sequence(parse_rawtxinput_state_t *state, buffer_t *buffers[2]) {
@@ -157,8 +104,8 @@ static int parse_rawtxinput_sequence(parse_rawtxinput_state_t *state, buffer_t *
 }
 
 static const parsing_step_t parse_rawtxinput_steps[] = {
-    (parsing_step_t) parse_rawtxinput_txid,
-    (parsing_step_t) parse_rawtxinput_vout,
+    (parsing_step_t) parse_rawtxinput_prevout_init,
+    (parsing_step_t) parse_rawtxinput_prevout,
     (parsing_step_t) parse_rawtxinput_scriptsig_size,
     (parsing_step_t) parse_rawtxinput_scriptsig_init,
     (parsing_step_t) parse_rawtxinput_scriptsig,
@@ -170,6 +117,11 @@ const int n_parse_rawtxinput_steps =
 
 /*   PARSER FOR A RAWTX OUTPUT */
 
+static bool is_relevant_output(const parse_rawtxoutput_state_t *state) {
+    return state->parent_state->output_index != -1 &&
+           state->parent_state->out_counter == (unsigned int) state->parent_state->output_index;
+}
+
 static int parse_rawtxoutput_value(parse_rawtxoutput_state_t *state, buffer_t *buffers[2]) {
     uint8_t value_bytes[8];
     bool result = dbuffer_read_bytes(buffers, value_bytes, 8);
@@ -178,11 +130,8 @@ static int parse_rawtxoutput_value(parse_rawtxoutput_state_t *state, buffer_t *b
 
         crypto_hash_update(&state->parent_state->hash_context->header, value_bytes, 8);
 
-        if (state->parent_state->output_index != -1) {
-            unsigned int relevant_output_index = (unsigned int) state->parent_state->output_index;
-            if (state->parent_state->out_counter == relevant_output_index) {
-                state->parent_state->parser_outputs->vout_value = value;
-            }
+        if (is_relevant_output(state)) {
+            state->parent_state->parser_outputs->vout_value = value;
         }
     }
     return result;
@@ -197,12 +146,13 @@ static int parse_rawtxoutput_scriptpubkey_size(parse_rawtxoutput_state_t *state,
 
         crypto_hash_update_varint(&state->parent_state->hash_context->header, scriptpubkey_size);
 
-        if (state->parent_state->output_index != -1) {
-            unsigned int relevant_output_index = (unsigned int) state->parent_state->output_index;
-            if (state->parent_state->out_counter == relevant_output_index) {
-                state->parent_state->parser_outputs->vout_scriptpubkey_len =
-                    (unsigned int) scriptpubkey_size;
+        if (is_relevant_output(state)) {
+            if (scriptpubkey_size > MAX_PREVOUT_SCRIPTPUBKEY_LEN) {
+                return -1;  // not expecting any scriptPubkey larger than
+                            // MAX_PREVOUT_SCRIPTPUBKEY_LEN
             }
+            state->parent_state->parser_outputs->vout_scriptpubkey_len =
+                (unsigned int) scriptpubkey_size;
         }
     }
     return result;
@@ -217,46 +167,14 @@ static int parse_rawtxoutput_scriptpubkey_init(parse_rawtxoutput_state_t *state,
     return 1;
 }
 
+// The scriptPubKey is only copied for the relevant output; the other ones are only hashed
 static int parse_rawtxoutput_scriptpubkey(parse_rawtxoutput_state_t *state, buffer_t *buffers[2]) {
-    uint8_t data[32];
-
-    while (true) {
-        int remaining_len = state->scriptpubkey_size - state->scriptpubkey_counter;
-
-        // We read in chunks of at most 32 bytes, so that we can always interrupt with less than 32
-        // unparsed bytes
-        int data_len = MIN(32, remaining_len);
-
-        bool read_result = dbuffer_read_bytes(buffers, data, data_len);
-        if (!read_result) {
-            return 0;  // could not read enough data
-        }
-
-        crypto_hash_update(&state->parent_state->hash_context->header, data, data_len);
-
-        if (state->parent_state->output_index != -1) {
-            unsigned int relevant_output_index = (unsigned int) state->parent_state->output_index;
-            if (state->parent_state->out_counter == relevant_output_index) {
-                unsigned int scriptpubkey_len =
-                    state->parent_state->parser_outputs->vout_scriptpubkey_len;
-                if (scriptpubkey_len > MAX_PREVOUT_SCRIPTPUBKEY_LEN) {
-                    return -1;  // not expecting any scriptPubkey larger than
-                                // MAX_PREVOUT_SCRIPTPUBKEY_LEN
-                }
-
-                memcpy(state->parent_state->parser_outputs->vout_scriptpubkey +
-                           state->scriptpubkey_counter,
-                       data,
-                       data_len);
-            }
-        }
-
-        state->scriptpubkey_counter += data_len;
-
-        if (state->scriptpubkey_counter == state->scriptpubkey_size) {
-            return 1;  // done
-        }
-    }
+    return process_field(
+        buffers,
+        state->scriptpubkey_size,
+        &state->scriptpubkey_counter,
+        state->parent_state->hash_context,
+        is_relevant_output(state) ? state->parent_state->parser_outputs->vout_scriptpubkey : NULL);
 }
 
 static const parsing_step_t parse_rawtxoutput_steps[] = {
@@ -447,18 +365,13 @@ static int parse_rawtx_witnesses(parse_rawtx_state_t *state, buffer_t *buffers[2
                 state->cur_wit_el_bytes_read = 0;
             }
 
-            while (state->cur_wit_el_bytes_read < state->cur_wit_elem_len) {
-                uint8_t data[32];
-                int remaining_len = state->cur_wit_elem_len - state->cur_wit_el_bytes_read;
-
-                // We read in chunks of at most 32 bytes, so that we can always interrupt with less
-                // than 32 unparsed bytes
-                int data_len = MIN(32, remaining_len);
-                if (!dbuffer_read_bytes(buffers, data, data_len)) {
-                    return 0;
-                }
-
-                state->cur_wit_el_bytes_read += data_len;
+            // the witnesses are not part of the txid: skip the bytes of the element
+            if (!process_field(buffers,
+                               state->cur_wit_elem_len,
+                               &state->cur_wit_el_bytes_read,
+                               NULL,
+                               NULL)) {
+                return 0;  // incomplete, read more data
             }
 
             ++state->wit_stack_el_counter;
@@ -495,9 +408,20 @@ static const parsing_step_t parse_rawtx_steps[] = {(parsing_step_t) parse_rawtx_
 
 const int n_parse_rawtx_steps = sizeof(parse_rawtx_steps) / sizeof(parse_rawtx_steps[0]);
 
-static void cb_process_data(buffer_t *data, void *cb_state) {
-    psbt_parse_rawtx_state_t *state = (psbt_parse_rawtx_state_t *) cb_state;
+void psbt_parse_rawtx_init(psbt_parse_rawtx_state_t *state,
+                           cx_sha256_t *hash_context,
+                           int output_index,
+                           txid_parser_outputs_t *outputs) {
+    state->store_data_length = 0;
+    state->parser_error = false;
+    parser_init_context(&state->parser_context, &state->parser_state);
+
+    state->parser_state.hash_context = hash_context;
+    state->parser_state.output_index = output_index;
+    state->parser_state.parser_outputs = outputs;
+}
 
+void psbt_parse_rawtx_process(psbt_parse_rawtx_state_t *state, buffer_t *data) {
     if (state->parser_error) {
         // there was already a parsing error, ignore any additional data received
         return;
@@ -517,6 +441,21 @@ static void cb_process_data(buffer_t *data, void *cb_state) {
     }
 }
 
+int psbt_parse_rawtx_finalize(psbt_parse_rawtx_state_t *state) {
+    if (state->parser_error || state->parser_context.cur_step != (size_t) n_parse_rawtx_steps) {
+        return -1;
+    }
+
+    txid_parser_outputs_t *outputs = state->parser_state.parser_outputs;
+    crypto_hash_digest(&state->parser_state.hash_context->header, outputs->txid, 32);
+    cx_hash_sha256(outputs->txid, 32, outputs->txid, 32);
+    return 0;
+}
+
+static void cb_process_data(buffer_t *data, void *cb_state) {
+    psbt_parse_rawtx_process((psbt_parse_rawtx_state_t *) cb_state, data);
+}
+
 int call_psbt_parse_rawtx(dispatcher_context_t *dispatcher_context,
                           const merkleized_map_commitment_t *map,
                           const uint8_t *key,
@@ -529,14 +468,7 @@ int call_psbt_parse_rawtx(dispatcher_context_t *dispatcher_context,
     cx_sha256_init(&hash_context);
 
     psbt_parse_rawtx_state_t flow_state;
-
-    // init parser
-
-    flow_state.store_data_length = 0;
-    flow_state.parser_error = false;
-    parser_init_context(&flow_state.parser_context, &flow_state.parser_state);
-
-    flow_state.parser_state.output_index = output_index;
+    psbt_parse_rawtx_init(&flow_state, &hash_context, output_index, outputs);
 
     uint8_t value_hash[32];
     int res = call_get_merkleized_map_value_hash(dispatcher_context, map, key, key_len, value_hash);
@@ -544,17 +476,10 @@ int call_psbt_parse_rawtx(dispatcher_context_t *dispatcher_context,
         return -1;
     }
 
-    // init the state of the parser (global)
-    flow_state.parser_state.hash_context = &hash_context;
-
-    flow_state.parser_state.parser_outputs = outputs;
-
     res = call_stream_preimage(dispatcher_context, value_hash, NULL, cb_process_data, &flow_state);
-    if (res < 0 || flow_state.parser_error) {
+    if (res < 0) {
         return -1;
     }
 
-    crypto_hash_digest(&hash_context.header, outputs->txid, 32);
-    cx_hash_sha256(outputs->txid, 32, outputs->txid, 32);
-    return 0;
+    return psbt_parse_rawtx_finalize(&flow_state);
 }
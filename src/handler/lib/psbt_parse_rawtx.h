@@ -1,7 +1,11 @@
 #pragma once
 
+#include "cx.h"
+
 #include "../../boilerplate/dispatcher.h"
+#include "../../common/buffer.h"
 #include "../../common/merkle.h"
+#include "../../common/parser.h"
 #include "../../constants.h"
 
 typedef struct {
@@ -11,6 +15,69 @@ typedef struct {
     uint8_t txid[32];                                         // will contain the computed txid
 } txid_parser_outputs_t;
 
+struct parse_rawtx_state_s;  // forward declaration
+
+typedef struct {
+    struct parse_rawtx_state_s *parent_state;  // subparsers can access parent's state
+    unsigned int prevout_counter;              // counter of prevout bytes already received
+    unsigned int scriptsig_size;               // max 10_000 bytes
+    unsigned int scriptsig_counter;            // counter of scriptsig bytes already received
+} parse_rawtxinput_state_t;
+
+typedef struct {
+    struct parse_rawtx_state_s *parent_state;
+    unsigned int scriptpubkey_size;     // max 10_000 bytes
+    unsigned int scriptpubkey_counter;  // counter of scriptpubkey bytes already received
+} parse_rawtxoutput_state_t;
+
+typedef struct parse_rawtx_state_s {
+    cx_sha256_t *hash_context;
+
+    bool is_segwit;
+    unsigned int n_inputs;
+    unsigned int n_outputs;
+
+    union {
+        // since the parsing stages of inputs, outputs and witnesses are disjoint, we reuse the same
+        // space in memory
+        struct {
+            unsigned int in_counter;
+            parser_context_t input_parser_context;
+            parse_rawtxinput_state_t input_parser_state;
+        };
+        struct {
+            unsigned int out_counter;
+            parser_context_t output_parser_context;
+            parse_rawtxoutput_state_t output_parser_state;
+        };
+        struct {
+            unsigned int wit_counter;             // index of witness field being read
+            unsigned int wit_stack_el_counter;    // index of the stack element in the witness field
+            unsigned int cur_wit_stack_elements;  // number of stack elements
+            unsigned int cur_wit_elem_len;        // size of the current stack elements
+            unsigned int cur_wit_el_bytes_read;   // number of bytes read of the current element
+            bool is_cur_wit_stack_elements_read;
+            bool is_cur_wit_elem_len_read;
+        };
+    };
+
+    int output_index;  // index of queried output, or -1
+
+    txid_parser_outputs_t *parser_outputs;
+
+} parse_rawtx_state_t;
+
+typedef struct psbt_parse_rawtx_state_s {
+    // internal state
+    // buffer for unparsed data; only fixed-size fields of at most 9 bytes are kept here, as the
+    // variable-length fields are consumed directly from the streamed chunks
+    uint8_t store[32];
+    unsigned int store_data_length;  // size of data currently in store
+    parse_rawtx_state_t parser_state;
+    parser_context_t parser_context;
+    bool parser_error;  // set to true if there was an error during parsing
+} psbt_parse_rawtx_state_t;
+
 /**
  * Given a commitment to a merkleized map and a key, this flow parses it as a serialized bitcoin
  * transaction, computes the transaction id and optionally keeps track of the vout amunt and
@@ -22,3 +89,35 @@ int call_psbt_parse_rawtx(dispatcher_context_t *dispatcher_context,
                           int key_len,
                           int output_index,
                           txid_parser_outputs_t *outputs);
+
+/**
+ * Initializes the state of the incremental parser of a serialized transaction, that is fed by
+ * psbt_parse_rawtx_process. This is the part of call_psbt_parse_rawtx that does not depend on the
+ * client.
+ *
+ * @param[out] state
+ *   Pointer to the state of the parser.
+ * @param[in] hash_context
+ *   An initialized sha256 context, receiving the transaction (excluding the witnesses).
+ * @param[in] output_index
+ *   Index of the output whose value and scriptPubKey are returned in outputs, or -1.
+ * @param[out] outputs
+ *   Receives the value and scriptPubKey of the requested output, and the txid.
+ */
+void psbt_parse_rawtx_init(psbt_parse_rawtx_state_t *state,
+                           cx_sha256_t *hash_context,
+                           int output_index,
+                           txid_parser_outputs_t *outputs);
+
+/**
+ * Parses the next chunk of the serialized transaction. Errors are reported by
+ * psbt_parse_rawtx_finalize.
+ */
+void psbt_parse_rawtx_process(psbt_parse_rawtx_state_t *state, buffer_t *data);
+
+/**
+ * Computes the txid once the whole transaction was processed.
+ *
+ * @return 0 on success, -1 if the transaction is invalid or incomplete.
+ */
+int psbt_parse_rawtx_finalize(psbt_parse_rawtx_state_t *state);
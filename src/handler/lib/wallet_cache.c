@@ -0,0 +1,271 @@
+#include <string.h>
+
+#include "os.h"
+
+#include "wallet_cache.h"
+
+#include "get_merkle_leaf_element.h"
+#include "../../common/buffer.h"
+
+// One more slot than the number of cached entries is stored, so that a new entry is always written
+// in a slot that does not hold a valid entry; the least recently used entry is only evicted once
+// the new one is complete.
+#define WALLET_CACHE_N_STORED_SLOTS (WALLET_CACHE_N_SLOTS + 1)
+
+typedef struct {
+    wallet_cache_entry_t entries[WALLET_CACHE_N_STORED_SLOTS];
+} wallet_cache_t;
+
+// The cache is stored in the flash memory of the app, and it can only be modified with nvm_write.
+// Builds without flash (e.g. on the host) can define NVM_CONST to make it ordinary memory.
+#ifndef NVM_CONST
+#define NVM_CONST const
+#endif
+
+NVM_CONST wallet_cache_t N_wallet_cache_real;
+#define N_wallet_cache (*(volatile wallet_cache_t *) PIC(&N_wallet_cache_real))
+
+// Value of the use counter of each slot when it was last used, or 0 if it was not used since the
+// app started. It is kept in RAM, in order to avoid writing to flash at each use.
+static uint32_t last_use[WALLET_CACHE_N_STORED_SLOTS];
+static uint32_t use_counter;
+
+// Prefixes of the ids of the wallet policies that most recently missed the cache, in a ring buffer.
+// A wallet policy is only inserted after a miss if it already missed recently, so that rotating
+// between more than WALLET_CACHE_N_SLOTS wallet policies does not rewrite a slot at each use.
+static uint8_t recent_misses[WALLET_CACHE_N_SLOTS][8];
+static uint8_t recent_misses_valid[WALLET_CACHE_N_SLOTS];
+static unsigned int recent_misses_next;
+
+static const wallet_cache_entry_t *get_entry(int slot) {
+    return (const wallet_cache_entry_t *) &N_wallet_cache.entries[slot];
+}
+
+static void invalidate_entry(int slot) {
+    uint8_t is_valid = 0;
+    nvm_write((void *) &get_entry(slot)->is_valid, &is_valid, sizeof(is_valid));
+    last_use[slot] = 0;
+}
+
+void wallet_cache_clear(void) {
+    for (int i = 0; i < WALLET_CACHE_N_STORED_SLOTS; i++) {
+        invalidate_entry(i);
+    }
+    for (int i = 0; i < WALLET_CACHE_N_SLOTS; i++) {
+        recent_misses_valid[i] = 0;
+    }
+    use_counter = 0;
+    recent_misses_next = 0;
+}
+
+const wallet_cache_entry_t *wallet_cache_find(const uint8_t wallet_id[static 32]) {
+    for (int i = 0; i < WALLET_CACHE_N_STORED_SLOTS; i++) {
+        const wallet_cache_entry_t *entry = get_entry(i);
+        if (entry->is_valid && memcmp(entry->wallet_id, wallet_id, 32) == 0) {
+            last_use[i] = ++use_counter;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+const wallet_cache_entry_t *wallet_cache_find_keys(const uint8_t keys_merkle_root[static 32],
+                                                   uint32_t n_keys) {
+    for (int i = 0; i < WALLET_CACHE_N_STORED_SLOTS; i++) {
+        const wallet_cache_entry_t *entry = get_entry(i);
+        if (entry->is_valid && entry->n_keys == n_keys &&
+            memcmp(entry->keys_info_merkle_root, keys_merkle_root, 32) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+void wallet_cache_load(const wallet_cache_entry_t *entry,
+                       policy_map_wallet_header_t *wallet_header,
+                       uint8_t policy_map_bytes[static MAX_POLICY_MAP_BYTES]) {
+    wallet_header->type = entry->type;
+    wallet_header->name_len = entry->name_len;
+    memcpy(wallet_header->name, entry->name, sizeof(wallet_header->name));
+    wallet_header->policy_map_len = 0;
+    wallet_header->n_keys = entry->n_keys;
+    memcpy(wallet_header->keys_info_merkle_root,
+           entry->keys_info_merkle_root,
+           sizeof(wallet_header->keys_info_merkle_root));
+
+    memcpy(policy_map_bytes, entry->policy_map_bytes, MAX_POLICY_MAP_BYTES);
+}
+
+// Returns the valid entry to evict, other than the one in the given slot: the least recently used
+// one, or the oldest one among the entries that were not used since the app started. Returns -1 if
+// there is no such entry.
+static int find_evicted_slot(int excluded_slot) {
+    int slot = -1;
+    for (int i = 0; i < WALLET_CACHE_N_STORED_SLOTS; i++) {
+        const wallet_cache_entry_t *entry = get_entry(i);
+        if (i == excluded_slot || !entry->is_valid) {
+            continue;
+        }
+        if (slot < 0 || last_use[i] < last_use[slot] ||
+            (last_use[i] == last_use[slot] && entry->sequence < get_entry(slot)->sequence)) {
+            slot = i;
+        }
+    }
+    return slot;
+}
+
+int wallet_cache_begin(void) {
+    // there is always a slot without a valid entry, unless the app was stopped in the middle of
+    // wallet_cache_commit; in that case, the evicted entry is only invalidated by the first
+    // wallet_cache_set_key
+    for (int i = 0; i < WALLET_CACHE_N_STORED_SLOTS; i++) {
+        if (!get_entry(i)->is_valid) {
+            return i;
+        }
+    }
+    return find_evicted_slot(-1);
+}
+
+int wallet_cache_set_key(int slot, unsigned int key_index, const policy_map_key_info_t *key_info) {
+    if (slot < 0 || slot >= WALLET_CACHE_N_STORED_SLOTS || key_index >= MAX_POLICY_MAP_KEYS) {
+        return -1;
+    }
+
+    wallet_cache_key_t key;
+    memset(&key, 0, sizeof(key));
+
+    memcpy(key.master_key_fingerprint, key_info->master_key_fingerprint, 4);
+    key.master_key_derivation_len = key_info->master_key_derivation_len;
+    memcpy(key.master_key_derivation,
+           key_info->master_key_derivation,
+           sizeof(key.master_key_derivation));
+    key.has_key_origin = key_info->has_key_origin;
+    key.has_wildcard = key_info->has_wildcard;
+
+    if (get_policy_map_key_info_ext_pubkey(key_info, &key.ext_pubkey) < 0) {
+        return -1;
+    }
+
+    if (key.has_wildcard) {
+        extended_pubkey_point_t node;
+        if (crypto_extended_pubkey_to_point(&key.ext_pubkey, &node) < 0 ||
+            bip32_CKDpub_point(&node, 0, &key.children[0]) < 0 ||
+            bip32_CKDpub_point(&node, 1, &key.children[1]) < 0) {
+            return -1;
+        }
+    }
+
+    if (get_entry(slot)->is_valid) {
+        invalidate_entry(slot);
+    }
+    nvm_write((void *) &get_entry(slot)->keys[key_index], &key, sizeof(key));
+    return 0;
+}
+
+void wallet_cache_commit(int slot,
+                         const uint8_t wallet_id[static 32],
+                         const policy_map_wallet_header_t *wallet_header,
+                         const uint8_t policy_map_bytes[static MAX_POLICY_MAP_BYTES]) {
+    if (slot < 0 || slot >= WALLET_CACHE_N_STORED_SLOTS || get_entry(slot)->is_valid) {
+        return;
+    }
+
+    uint32_t sequence = 0;
+    for (int i = 0; i < WALLET_CACHE_N_STORED_SLOTS; i++) {
+        const wallet_cache_entry_t *entry = get_entry(i);
+        if (entry->is_valid && entry->sequence > sequence) {
+            sequence = entry->sequence;
+        }
+    }
+
+    sequence += 1;
+    uint8_t n_keys = (uint8_t) wallet_header->n_keys;
+
+    // the keys were already written by wallet_cache_set_key
+    const wallet_cache_entry_t *entry = get_entry(slot);
+    nvm_write((void *) &entry->sequence, &sequence, sizeof(sequence));
+    nvm_write((void *) &entry->type, (void *) &wallet_header->type, sizeof(entry->type));
+    nvm_write((void *) entry->wallet_id, (void *) wallet_id, sizeof(entry->wallet_id));
+    nvm_write((void *) entry->keys_info_merkle_root,
+              (void *) wallet_header->keys_info_merkle_root,
+              sizeof(entry->keys_info_merkle_root));
+    nvm_write((void *) &entry->n_keys, &n_keys, sizeof(n_keys));
+    nvm_write((void *) &entry->name_len,
+              (void *) &wallet_header->name_len,
+              sizeof(entry->name_len));
+    nvm_write((void *) entry->name, (void *) wallet_header->name, sizeof(entry->name));
+    nvm_write((void *) entry->policy_map_bytes,
+              (void *) policy_map_bytes,
+              sizeof(entry->policy_map_bytes));
+
+    // the entry becomes valid only once it is completely written
+    uint8_t is_valid = 1;
+    nvm_write((void *) &entry->is_valid, &is_valid, sizeof(is_valid));
+
+    last_use[slot] = ++use_counter;
+
+    // evict an entry if the cache is over capacity; its slot is the one written next
+    int n_valid = 0;
+    for (int i = 0; i < WALLET_CACHE_N_STORED_SLOTS; i++) {
+        n_valid += get_entry(i)->is_valid ? 1 : 0;
+    }
+    if (n_valid > WALLET_CACHE_N_SLOTS) {
+        invalidate_entry(find_evicted_slot(slot));
+    }
+}
+
+bool wallet_cache_record_miss(const uint8_t wallet_id[static 32]) {
+    for (int i = 0; i < WALLET_CACHE_N_SLOTS; i++) {
+        if (recent_misses_valid[i] &&
+            memcmp(recent_misses[i], wallet_id, sizeof(recent_misses[i])) == 0) {
+            recent_misses_valid[i] = 0;
+            return true;
+        }
+    }
+
+    memcpy(recent_misses[recent_misses_next], wallet_id, sizeof(recent_misses[0]));
+    recent_misses_valid[recent_misses_next] = 1;
+    recent_misses_next = (recent_misses_next + 1) % WALLET_CACHE_N_SLOTS;
+    return false;
+}
+
+int wallet_cache_add(dispatcher_context_t *dispatcher_context,
+                     const uint8_t wallet_id[static 32],
+                     const policy_map_wallet_header_t *wallet_header,
+                     const uint8_t policy_map_bytes[static MAX_POLICY_MAP_BYTES]) {
+    if (wallet_header->n_keys > MAX_POLICY_MAP_KEYS) {
+        return -1;
+    }
+
+    // the keys are written in a slot without a valid entry, so a failure evicts nothing
+    int slot = wallet_cache_begin();
+
+    for (unsigned int i = 0; i < wallet_header->n_keys; i++) {
+        policy_map_key_info_t key_info;
+        {
+            char key_info_str[MAX_POLICY_KEY_INFO_LEN];
+
+            int key_info_len = call_get_merkle_leaf_element(dispatcher_context,
+                                                            wallet_header->keys_info_merkle_root,
+                                                            wallet_header->n_keys,
+                                                            i,
+                                                            (uint8_t *) key_info_str,
+                                                            sizeof(key_info_str));
+            if (key_info_len < 0) {
+                return -1;
+            }
+
+            buffer_t key_info_buffer = buffer_create(key_info_str, key_info_len);
+            if (parse_policy_map_key_info(&key_info_buffer, &key_info) == -1) {
+                return -1;
+            }
+        }
+
+        if (wallet_cache_set_key(slot, i, &key_info) < 0) {
+            return -1;
+        }
+    }
+
+    wallet_cache_commit(slot, wallet_id, wallet_header, policy_map_bytes);
+    return 0;
+}
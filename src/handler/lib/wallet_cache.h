@@ -0,0 +1,184 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../../boilerplate/dispatcher.h"
+#include "../../common/bip32.h"
+#include "../../common/wallet.h"
+#include "../../constants.h"
+#include "../../crypto.h"
+
+/**
+ * Number of registered wallet policies that are kept in the cache. One more slot is stored in
+ * flash, where the next entry is written.
+ */
+#ifndef WALLET_CACHE_N_SLOTS
+#define WALLET_CACHE_N_SLOTS 3
+#endif
+
+/**
+ * A key information of a cached wallet policy, with the extended pubkey already decoded.
+ */
+typedef struct {
+    uint8_t master_key_fingerprint[4];
+    uint8_t master_key_derivation_len;
+    uint8_t has_key_origin;
+    uint8_t has_wildcard;
+    uint32_t master_key_derivation[MAX_BIP32_PATH_STEPS];
+    serialized_extended_pubkey_t ext_pubkey;
+    // the /0 and /1 children of ext_pubkey, ready for deriving the addresses; only computed if
+    // has_wildcard is true
+    extended_pubkey_point_t children[2];
+} wallet_cache_key_t;
+
+/**
+ * A registered wallet policy, as stored in the cache.
+ *
+ * Only public data that is committed to by the wallet id is stored; in particular, it is not
+ * recorded which key is internal, as that depends on the seed.
+ */
+typedef struct {
+    uint8_t is_valid;
+    uint32_t sequence;  // insertion order; the highest is the most recently inserted entry
+    uint8_t type;  // the wallet type, as in policy_map_wallet_header_t
+    uint8_t wallet_id[32];
+    uint8_t keys_info_merkle_root[32];
+    uint8_t n_keys;
+    uint8_t name_len;
+    char name[MAX_WALLET_NAME_LENGTH + 1];
+    uint8_t policy_map_bytes[MAX_POLICY_MAP_BYTES];
+    wallet_cache_key_t keys[MAX_POLICY_MAP_KEYS];
+} wallet_cache_entry_t;
+
+/**
+ * Removes all the entries from the cache.
+ */
+void wallet_cache_clear(void);
+
+/**
+ * Looks up a wallet policy in the cache, and marks it as the most recently used entry.
+ *
+ * The caller is still responsible for verifying the hmac of the wallet id.
+ *
+ * @param[in] wallet_id
+ *   The id of the wallet policy.
+ *
+ * @return a pointer to the cached entry, or NULL if the wallet policy is not in the cache.
+ */
+const wallet_cache_entry_t *wallet_cache_find(const uint8_t wallet_id[static 32]);
+
+/**
+ * Looks up the keys of a wallet policy in the cache. As each key information is authenticated by
+ * the Merkle root of the keys, the cached keys can be used for any policy with the same keys.
+ *
+ * @param[in] keys_merkle_root
+ *   The Merkle root of the tree of key informations.
+ * @param[in] n_keys
+ *   The number of keys.
+ *
+ * @return a pointer to the cached entry, or NULL if no cached entry has the same keys.
+ */
+const wallet_cache_entry_t *wallet_cache_find_keys(const uint8_t keys_merkle_root[static 32],
+                                                   uint32_t n_keys);
+
+/**
+ * Fills the wallet header and the parsed policy of a cached entry. As the policy map string is
+ * not cached, wallet_header->policy_map_len is set to 0.
+ *
+ * @param[in] entry
+ *   Pointer to the cached entry.
+ * @param[out] wallet_header
+ *   Pointer to the wallet header to fill.
+ * @param[out] policy_map_bytes
+ *   Buffer of MAX_POLICY_MAP_BYTES bytes receiving the parsed policy.
+ */
+void wallet_cache_load(const wallet_cache_entry_t *entry,
+                       policy_map_wallet_header_t *wallet_header,
+                       uint8_t policy_map_bytes[static MAX_POLICY_MAP_BYTES]);
+
+/**
+ * Records that a registered wallet policy was not found in the cache, and tells whether it should
+ * now be inserted with wallet_cache_add.
+ *
+ * Each insertion rewrites a whole slot of flash (about 5 KB for 15 keys), so a wallet policy is
+ * only inserted the second time it misses among the last WALLET_CACHE_N_SLOTS misses. Registering
+ * a wallet policy inserts it directly. Therefore, the flash is written at most once per
+ * registration and once per two uses of a wallet policy that is not cached, and rotating between
+ * more than WALLET_CACHE_N_SLOTS wallet policies in turn does not write to flash at all.
+ *
+ * The recent misses are kept in RAM, and are forgotten when the app exits.
+ *
+ * @param[in] wallet_id
+ *   The id of the wallet policy.
+ *
+ * @return true if the wallet policy should be inserted in the cache, false otherwise.
+ */
+bool wallet_cache_record_miss(const uint8_t wallet_id[static 32]);
+
+/**
+ * Picks the slot where a new entry is written with wallet_cache_set_key and wallet_cache_commit.
+ * No entry is invalidated: the slot does not hold a valid entry, except if the app was stopped
+ * while committing an entry; in that case, the entry is invalidated by the first call to
+ * wallet_cache_set_key.
+ *
+ * @return the slot.
+ */
+int wallet_cache_begin(void);
+
+/**
+ * Decodes a key information, computes its /0 and /1 children and writes it in the given slot.
+ * Nothing is written if the key information is invalid.
+ *
+ * @param[in] slot
+ *   The slot returned by wallet_cache_begin.
+ * @param[in] key_index
+ *   The index of the key in the wallet policy.
+ * @param[in] key_info
+ *   Pointer to the parsed key information.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int wallet_cache_set_key(int slot, unsigned int key_index, const policy_map_key_info_t *key_info);
+
+/**
+ * Completes the entry in the given slot, whose keys were all written with wallet_cache_set_key, and
+ * marks it as the most recently used one. Only then, if the cache is full, the least recently used
+ * entry is evicted. It must only be called for wallet policies that were approved by the user, or
+ * whose hmac was verified.
+ *
+ * @param[in] slot
+ *   The slot returned by wallet_cache_begin.
+ * @param[in] wallet_id
+ *   The id of the wallet policy.
+ * @param[in] wallet_header
+ *   Pointer to the wallet header.
+ * @param[in] policy_map_bytes
+ *   The parsed policy.
+ */
+void wallet_cache_commit(int slot,
+                         const uint8_t wallet_id[static 32],
+                         const policy_map_wallet_header_t *wallet_header,
+                         const uint8_t policy_map_bytes[static MAX_POLICY_MAP_BYTES]);
+
+/**
+ * Inserts a wallet policy in the cache, evicting the least recently used entry if the cache is
+ * full, and fetching all the key informations from the client. It must only be called for wallet
+ * policies that were approved by the user, or whose hmac was verified. If it fails, no entry is
+ * evicted.
+ *
+ * @param[in] dispatcher_context
+ *   Pointer to the dispatcher context
+ * @param[in] wallet_id
+ *   The id of the wallet policy.
+ * @param[in] wallet_header
+ *   Pointer to the wallet header.
+ * @param[in] policy_map_bytes
+ *   The parsed policy.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int wallet_cache_add(dispatcher_context_t *dispatcher_context,
+                     const uint8_t wallet_id[static 32],
+                     const policy_map_wallet_header_t *wallet_header,
+                     const uint8_t policy_map_bytes[static MAX_POLICY_MAP_BYTES]);
@@ -16,6 +16,7 @@
  *****************************************************************************/
 
 #include <stdint.h>
+#include <stdio.h>  // snprintf
 #include <string.h>
 
 #include "os.h"
@@ -23,6 +24,8 @@
 
 #include "../boilerplate/dispatcher.h"
 #include "../boilerplate/sw.h"
+#include "../common/base58.h"
+#include "../common/format.h"
 #include "../common/merkle.h"
 #include "../common/read.h"
 #include "../common/wallet.h"
@@ -35,6 +38,7 @@
 #include "../ui/menu.h"
 
 #include "lib/policy.h"
+#include "lib/wallet_cache.h"
 
 #include "client_commands.h"
 
@@ -46,8 +50,10 @@ static void finalize_response(dispatcher_context_t *dc);
 
 extern global_context_t *G_coin_config;
 
-static bool is_policy_acceptable(policy_node_t *policy);
+static bool is_policy_acceptable(const policy_node_t *policy);
 static bool is_policy_name_acceptable(const char *name, size_t name_len);
+static int format_binary_key_info(const policy_map_key_info_t *key_info,
+                                  char out[static MAX_POLICY_KEY_INFO_LEN + 1]);
 
 /**
  * Validates the input, initializes the hash context and starts accumulating the wallet header in
@@ -110,6 +116,7 @@ void handler_register_wallet(dispatcher_context_t *dc) {
     state->master_key_fingerprint = crypto_get_master_key_fingerprint();
 
     state->next_pubkey_index = 0;
+    state->cache_slot = wallet_cache_begin();
 
     ui_display_wallet_header(dc, &state->wallet_header, process_cosigner_info);
 }
@@ -140,49 +147,57 @@ static void process_cosigner_info(dispatcher_context_t *dc) {
     // Make a sub-buffer for the pubkey info
     buffer_t key_info_buffer = buffer_create(state->next_pubkey_info, pubkey_info_len);
 
-    policy_map_key_info_t key_info;
-    if (parse_policy_map_key_info(&key_info_buffer, &key_info) == -1) {
+    policy_map_key_info_t *key_info = &state->next_key_info;
+    if (parse_policy_map_key_info(&key_info_buffer, key_info) == -1) {
         PRINTF("Incorrect policy map.\n");
         SEND_SW(dc, SW_INCORRECT_DATA);
         return;
     }
 
+    // the encoding of the key informations must be the one of the wallet type, which is committed
+    // to by the wallet id
+    if (key_info->is_binary !=
+        (state->wallet_header.type == WALLET_TYPE_POLICY_MAP_BINARY_KEYS)) {
+        PRINTF("Key info encoding does not match the wallet type.\n");
+        SEND_SW(dc, SW_INCORRECT_DATA);
+        return;
+    }
+
+    // binary key informations are shown to the user in the usual string encoding
+    if (key_info->is_binary &&
+        format_binary_key_info(key_info, (char *) state->next_pubkey_info) < 0) {
+        SEND_SW(dc, SW_INCORRECT_DATA);
+        return;
+    }
+
     // We refuse to register wallets without key origin information, or whose keys don't end with
     // the wildcard ('/**'). The key origin information is necessary when signing to identify which
     // one is our key. Using addresses without a wildcard could potentially be supported, but
     // disabled for now (question to address: can only _some_ of the keys have a wildcard?).
 
-    if (!key_info.has_key_origin) {
+    if (!key_info->has_key_origin) {
         PRINTF("Key info without origin unsupported.\n");
         SEND_SW(dc, SW_NOT_SUPPORTED);
         return;
     }
 
-    if (!key_info.has_wildcard) {
+    if (!key_info->has_wildcard) {
         PRINTF("Key info without wildcard unsupported.\n");
         SEND_SW(dc, SW_NOT_SUPPORTED);
         return;
     }
 
     bool is_key_internal = false;
-    if (read_u32_be(key_info.master_key_fingerprint, 0) == state->master_key_fingerprint) {
-        // it could be a collision on the fingerprint; we verify that we can actually generate the
-        // same pubkey
-        char pubkey_derived[MAX_SERIALIZED_PUBKEY_LENGTH + 1];
-        int serialized_pubkey_len =
-            get_serialized_extended_pubkey_at_path(key_info.master_key_derivation,
-                                                   key_info.master_key_derivation_len,
-                                                   G_coin_config->bip32_pubkey_version,
-                                                   pubkey_derived);
-        if (serialized_pubkey_len == -1) {
-            SEND_SW(dc, SW_BAD_STATE);
-            return;
-        }
-
-        if (strncmp(key_info.ext_pubkey, pubkey_derived, MAX_SERIALIZED_PUBKEY_LENGTH) == 0) {
-            is_key_internal = true;
-            ++state->n_internal_keys;
-        }
+    serialized_extended_pubkey_t ext_pubkey;
+    if (read_u32_be(key_info->master_key_fingerprint, 0) == state->master_key_fingerprint &&
+        get_policy_map_key_info_ext_pubkey(key_info, &ext_pubkey) == 0 &&
+        crypto_is_extended_pubkey_at_path(key_info->master_key_fingerprint,
+                                          key_info->master_key_derivation,
+                                          key_info->master_key_derivation_len,
+                                          G_coin_config->bip32_pubkey_version,
+                                          &ext_pubkey)) {
+        is_key_internal = true;
+        ++state->n_internal_keys;
     }
 
     // TODO: it would be sensible to validate the pubkey (at least syntactically + validate
@@ -202,6 +217,14 @@ static void next_cosigner(dispatcher_context_t *dc) {
 
     LOG_PROCESSOR(dc, __FILE__, __LINE__, __func__);
 
+    // the key was validated by the user, store it in the wallet cache; the slot does not hold a
+    // valid entry, so nothing is evicted before the registration is approved
+    if (state->cache_slot >= 0 &&
+        wallet_cache_set_key(state->cache_slot, state->next_pubkey_index, &state->next_key_info) <
+            0) {
+        state->cache_slot = -1;
+    }
+
     ++state->next_pubkey_index;
     if (state->next_pubkey_index < state->wallet_header.n_keys) {
         dc->next(process_cosigner_info);
@@ -227,6 +250,17 @@ static void finalize_response(dispatcher_context_t *dc) {
     //       wallet is a sensitive operation, and a fraudulent wallet with the same name would
     //       result in loss of funds.
 
+    // The wallet policy was approved by the user: complete its entry in the wallet cache, whose
+    // keys were stored as they were validated. Only then an entry is evicted, so that a rejected
+    // registration leaves the cache untouched. The cache is an optimization, therefore a failure
+    // does not prevent the registration.
+    if (state->cache_slot >= 0) {
+        wallet_cache_commit(state->cache_slot,
+                            state->wallet_id,
+                            &state->wallet_header,
+                            state->policy_map_bytes);
+    }
+
     struct {
         uint8_t wallet_id[32];
         uint8_t hmac[32];
@@ -266,21 +300,22 @@ static void finalize_response(dispatcher_context_t *dc) {
     SEND_RESPONSE(dc, &response, sizeof(response), SW_OK);
 }
 
-static bool is_policy_acceptable(policy_node_t *policy) {
-    policy_node_t *internal_script;
+static bool is_policy_acceptable(const policy_node_t *policy) {
+    const policy_node_t *internal_script;
 
     if (policy->type == TOKEN_SH) {
-        policy_node_t *child_node = ((policy_node_with_script_t *) policy)->script;
+        const policy_node_t *child_node =
+            policy_node_get_script((const policy_node_with_script_t *) policy);
         if (child_node->type == TOKEN_WSH) {
             // sh(wsh({sorted}multi(@0)))
-            internal_script = ((policy_node_with_script_t *) child_node)->script;
+            internal_script = policy_node_get_script((const policy_node_with_script_t *) child_node);
         } else {
             // sh({sorted}multi(@0))
             internal_script = child_node;
         }
     } else if (policy->type == TOKEN_WSH) {
         // wsh({sorted}multi(@0))
-        internal_script = ((policy_node_with_script_t *) policy)->script;
+        internal_script = policy_node_get_script((const policy_node_with_script_t *) policy);
     } else {
         return false;  // unexpected policy
     }
@@ -300,4 +335,63 @@ static bool is_policy_name_acceptable(const char *name, size_t name_len) {
         if (name[i] < 0x20 || name[i] > 0x7E) return false;
 
     return true;
-}
\ No newline at end of file
+}
+
+/**
+ * Writes the string encoding of a key information that was in the binary encoding.
+ *
+ * @return 0 on success, -1 on failure (including if the result is longer than
+ * MAX_POLICY_KEY_INFO_LEN).
+ */
+static int format_binary_key_info(const policy_map_key_info_t *key_info,
+                                  char out[static MAX_POLICY_KEY_INFO_LEN + 1]) {
+    char origin[1 + 8 + 1 + MAX_SERIALIZED_BIP32_PATH_LENGTH + 1 + 1] = "";
+    if (key_info->has_key_origin) {
+        char fingerprint[8 + 1];
+        char path[MAX_SERIALIZED_BIP32_PATH_LENGTH + 1] = "";
+        if (format_hex(key_info->master_key_fingerprint, 4, fingerprint, sizeof(fingerprint)) < 0 ||
+            !bip32_path_format(key_info->master_key_derivation,
+                               key_info->master_key_derivation_len,
+                               path,
+                               sizeof(path))) {
+            return -1;
+        }
+        snprintf(origin,
+                 sizeof(origin),
+                 "[%s%s%s]",
+                 fingerprint,
+                 key_info->master_key_derivation_len > 0 ? "/" : "",
+                 path);
+    }
+
+    char ext_pubkey[MAX_SERIALIZED_PUBKEY_LENGTH + 1];
+    {
+        serialized_extended_pubkey_check_t ext_pubkey_check;
+        memcpy(&ext_pubkey_check.serialized_extended_pubkey,
+               key_info->ext_pubkey_bytes,
+               sizeof(ext_pubkey_check.serialized_extended_pubkey));
+        crypto_get_checksum((uint8_t *) &ext_pubkey_check.serialized_extended_pubkey,
+                            sizeof(ext_pubkey_check.serialized_extended_pubkey),
+                            ext_pubkey_check.checksum);
+
+        int ext_pubkey_len = base58_encode((uint8_t *) &ext_pubkey_check,
+                                           sizeof(ext_pubkey_check),
+                                           ext_pubkey,
+                                           MAX_SERIALIZED_PUBKEY_LENGTH);
+        if (ext_pubkey_len < 0) {
+            return -1;
+        }
+        ext_pubkey[ext_pubkey_len] = '\0';
+    }
+
+    int len = snprintf(out,
+                       MAX_POLICY_KEY_INFO_LEN + 1,
+                       "%s%s%s",
+                       origin,
+                       ext_pubkey,
+                       key_info->has_wildcard ? "/**" : "");
+    if (len < 0 || len > MAX_POLICY_KEY_INFO_LEN) {
+        return -1;
+    }
+    return 0;
+}
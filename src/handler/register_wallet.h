@@ -23,6 +23,10 @@ typedef struct {
 
     uint8_t next_pubkey_index;
     uint8_t next_pubkey_info[MAX_POLICY_KEY_INFO_LEN + 1];
+    policy_map_key_info_t next_key_info;
+
+    // slot of the wallet cache where the keys are stored once validated, or -1 if caching failed
+    int cache_slot;
 } register_wallet_state_t;
 
 void handler_register_wallet(dispatcher_context_t *dispatcher_context);
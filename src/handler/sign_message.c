@@ -26,6 +26,9 @@
 #include "../ui/display.h"
 #include "../ui/menu.h"
 
+#include "lib/get_merkle_leaf_element.h"
+#include "lib/stream_preimage.h"
+
 extern global_context_t *G_coin_config;
 
 static void send_response(dispatcher_context_t *dc);
@@ -34,39 +37,78 @@ static unsigned char const BSM_SIGN_MAGIC[] = {'\x18', 'B', 'i', 't', 'c', 'o',
                                                'S',    'i', 'g', 'n', 'e', 'd', ' ', 'M', 'e',
                                                's',    's', 'a', 'g', 'e', ':', '\n'};
 
-void handler_sign_message(dispatcher_context_t *dc) {
-    sign_message_state_t *state = (sign_message_state_t *) &G_command_state;
-
-    LOG_PROCESSOR(dc, __FILE__, __LINE__, __func__);
-
+// Parses the BIP-32 path at the beginning of the request, and initializes the hash contexts.
+// Returns false (after sending the error status word) if the request is invalid.
+static bool init_sign_message(dispatcher_context_t *dc, sign_message_state_t *state) {
     // Device must be unlocked
     if (os_global_pin_is_validated() != BOLOS_UX_OK) {
         SEND_SW(dc, SW_SECURITY_STATUS_NOT_SATISFIED);
-        return;
+        return false;
     }
 
     if (!buffer_read_u8(&dc->read_buffer, &state->bip32_path_len) ||
-        !buffer_read_bip32_path(&dc->read_buffer, state->bip32_path, state->bip32_path_len) ||
-        !buffer_read_varint(&dc->read_buffer, &state->message_length) ||
-        !buffer_read_bytes(&dc->read_buffer, state->message_merkle_root, 32)) {
+        !buffer_read_bip32_path(&dc->read_buffer, state->bip32_path, state->bip32_path_len)) {
         SEND_SW(dc, SW_WRONG_DATA_LENGTH);
-        return;
+        return false;
     }
 
-    if (state->bip32_path_len > MAX_BIP32_PATH_STEPS || state->message_length >= (1LL << 32)) {
+    if (state->bip32_path_len > MAX_BIP32_PATH_STEPS) {
         SEND_SW(dc, SW_INCORRECT_DATA);
-        return;
+        return false;
     }
 
+    cx_sha256_init(&state->msg_hash_context);
+    cx_sha256_init(&state->bsm_digest_context);
+
+    crypto_hash_update(&state->bsm_digest_context.header, BSM_SIGN_MAGIC, sizeof(BSM_SIGN_MAGIC));
+    return true;
+}
+
+// Adds a part of the message to both the hashes
+static void update_message_hashes(sign_message_state_t *state, const uint8_t *data, size_t len) {
+    crypto_hash_update(&state->msg_hash_context.header, data, len);
+    crypto_hash_update(&state->bsm_digest_context.header, data, len);
+}
+
+// Computes the digests, and shows the message hash to the user
+static void display_message_hash(dispatcher_context_t *dc, sign_message_state_t *state) {
+    crypto_hash_digest(&state->msg_hash_context.header, state->message_hash, 32);
+    crypto_hash_digest(&state->bsm_digest_context.header, state->bsm_digest, 32);
+    cx_hash_sha256(state->bsm_digest, 32, state->bsm_digest, 32);
+
     char path_str[MAX_SERIALIZED_BIP32_PATH_LENGTH + 1] = "(Master key)";
     if (state->bip32_path_len > 0) {
         bip32_path_format(state->bip32_path, state->bip32_path_len, path_str, sizeof(path_str));
     }
 
-    cx_sha256_init(&state->msg_hash_context);
-    cx_sha256_init(&state->bsm_digest_context);
+    char message_hash_str[64 + 1];
+    for (int i = 0; i < 32; i++) {
+        snprintf(message_hash_str + 2 * i, 3, "%02X", state->message_hash[i]);
+    }
+
+    ui_display_message_hash(dc, path_str, message_hash_str, send_response);
+}
+
+void handler_sign_message(dispatcher_context_t *dc) {
+    sign_message_state_t *state = (sign_message_state_t *) &G_command_state;
+
+    LOG_PROCESSOR(dc, __FILE__, __LINE__, __func__);
+
+    if (!init_sign_message(dc, state)) {
+        return;
+    }
+
+    if (!buffer_read_varint(&dc->read_buffer, &state->message_length) ||
+        !buffer_read_bytes(&dc->read_buffer, state->message_merkle_root, 32)) {
+        SEND_SW(dc, SW_WRONG_DATA_LENGTH);
+        return;
+    }
+
+    if (state->message_length >= (1LL << 32)) {
+        SEND_SW(dc, SW_INCORRECT_DATA);
+        return;
+    }
 
-    crypto_hash_update(&state->bsm_digest_context.header, BSM_SIGN_MAGIC, sizeof(BSM_SIGN_MAGIC));
     crypto_hash_update_varint(&state->bsm_digest_context.header, state->message_length);
 
     size_t n_chunks = (state->message_length + 63) / 64;
@@ -84,20 +126,52 @@ void handler_sign_message(dispatcher_context_t *dc) {
             return;
         }
 
-        crypto_hash_update(&state->msg_hash_context.header, message_chunk, chunk_len);
-        crypto_hash_update(&state->bsm_digest_context.header, message_chunk, chunk_len);
+        update_message_hashes(state, message_chunk, chunk_len);
     }
 
-    crypto_hash_digest(&state->msg_hash_context.header, state->message_hash, 32);
-    crypto_hash_digest(&state->bsm_digest_context.header, state->bsm_digest, 32);
-    cx_hash_sha256(state->bsm_digest, 32, state->bsm_digest, 32);
+    display_message_hash(dc, state);
+}
 
-    char message_hash_str[64 + 1];
-    for (int i = 0; i < 32; i++) {
-        snprintf(message_hash_str + 2 * i, 3, "%02X", state->message_hash[i]);
+static void cb_process_message_len(size_t len, void *cb_state) {
+    sign_message_state_t *state = (sign_message_state_t *) cb_state;
+
+    state->message_length = len;
+    crypto_hash_update_varint(&state->bsm_digest_context.header, len);
+}
+
+static void cb_process_message_data(buffer_t *data, void *cb_state) {
+    sign_message_state_t *state = (sign_message_state_t *) cb_state;
+
+    update_message_hashes(state, data->ptr + data->offset, data->size - data->offset);
+}
+
+void handler_sign_message_streamed(dispatcher_context_t *dc) {
+    sign_message_state_t *state = (sign_message_state_t *) &G_command_state;
+
+    LOG_PROCESSOR(dc, __FILE__, __LINE__, __func__);
+
+    if (!init_sign_message(dc, state)) {
+        return;
     }
 
-    ui_display_message_hash(dc, path_str, message_hash_str, send_response);
+    uint8_t message_hash[32];
+    if (!buffer_read_bytes(&dc->read_buffer, message_hash, 32)) {
+        SEND_SW(dc, SW_WRONG_DATA_LENGTH);
+        return;
+    }
+
+    // The whole message is the preimage of a single Merkle leaf; it is received in chunks as large
+    // as the APDUs allow, and it is only shown to the user after its hash is verified.
+    if (call_stream_preimage(dc,
+                             message_hash,
+                             cb_process_message_len,
+                             cb_process_message_data,
+                             state) < 0) {
+        SEND_SW(dc, SW_INCORRECT_DATA);
+        return;
+    }
+
+    display_message_hash(dc, state);
 }
 
 static void send_response(dispatcher_context_t *dc) {
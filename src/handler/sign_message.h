@@ -9,7 +9,7 @@ typedef struct {
     uint8_t bip32_path_len;
     uint32_t bip32_path[MAX_BIP32_PATH_STEPS];
     uint64_t message_length;
-    uint8_t message_merkle_root[32];
+    uint8_t message_merkle_root[32];  // only used by SIGN_MESSAGE
 
     cx_sha256_t msg_hash_context;    // used to compute sha256(message)
     cx_sha256_t bsm_digest_context;  // used to compute the Bitcoin Message Signing digest
@@ -19,3 +19,9 @@ typedef struct {
 } sign_message_state_t;
 
 void handler_sign_message(dispatcher_context_t *dispatcher_context);
+
+/**
+ * Variant of SIGN_MESSAGE where the message is committed to by a single hash, and it is received
+ * from the client with a single GET_PREIMAGE request.
+ */
+void handler_sign_message_streamed(dispatcher_context_t *dispatcher_context);
@@ -40,6 +40,7 @@
 #include "lib/get_merkleized_map.h"
 #include "lib/get_merkleized_map_value.h"
 #include "lib/psbt_parse_rawtx.h"
+#include "lib/wallet_cache.h"
 
 #include "sign_psbt.h"
 
@@ -73,7 +74,6 @@ static void sign_init(dispatcher_context_t *dc);
 static void sign_process_input_map(dispatcher_context_t *dc);
 
 // Legacy sighash computation (P2PKH and P2SH)
-static void sign_legacy(dispatcher_context_t *dc);
 static void sign_legacy_compute_sighash(dispatcher_context_t *dc);
 
 // Segwit sighash computation (P2WPKH, P2WSH and P2TR)
@@ -104,13 +104,76 @@ It would be possible to generalize to more complex scripts, but it makes it more
 the right paths to identify internal inputs/outputs.
 */
 
+/**
+ * A signing session, started once the user approves a transaction. It is kept outside of
+ * G_command_state, that is cleared at each new command, so that RESUME_SIGN_PSBT can continue the
+ * signing flow if it is interrupted. The RAM of the device is not accessible to the host, therefore
+ * the session can only be altered by the app.
+ */
+typedef struct {
+    bool is_active;
+    uint8_t psbt_digest[32];  // sha256 of the data of the command that started it
+    // the client received the signatures of all the inputs before next_input_index
+    unsigned int next_input_index;
+} sign_psbt_session_t;
+
+static sign_psbt_session_t session;
+
+void sign_psbt_clear_session(void) {
+    explicit_bzero(&session, sizeof(session));
+}
+
 // HELPER FUNCTIONS
 
-// Updates the hash_context with the network serialization of all the outputs
+/**
+ * Resets the outputs cache, before the outputs are fetched in order.
+ */
+static void outputs_cache_init(sign_psbt_state_t *state) {
+    state->outputs_cache_len = 0;
+    state->outputs_cache_overflow = false;
+    state->outputs_cached = false;
+}
+
+/**
+ * Appends the network serialization of the next output to the outputs cache, if it fits.
+ */
+static void outputs_cache_add(sign_psbt_state_t *state,
+                              const uint8_t amount_raw[static 8],
+                              const uint8_t script[],
+                              size_t script_len) {
+    size_t len = 8 + varint_size(script_len) + script_len;
+    if (state->outputs_cache_overflow || state->outputs_cache_len + len > OUTPUTS_CACHE_SIZE) {
+        state->outputs_cache_overflow = true;
+        return;
+    }
+
+#if OUTPUTS_CACHE_SIZE > 0
+    uint8_t *out = state->outputs_cache + state->outputs_cache_len;
+    memcpy(out, amount_raw, 8);
+    int varint_len = varint_write(out, 8, script_len);
+    memcpy(out + 8 + varint_len, script, script_len);
+    state->outputs_cache_len += len;
+#else
+    (void) amount_raw;
+    (void) script;
+#endif
+}
+
+// Updates the hash_context with the network serialization of all the outputs. Unless they are
+// already cached, they are fetched from the client, and cached if they fit.
 // returns -1 on error. 0 on success.
 static int hash_outputs(dispatcher_context_t *dc, cx_hash_t *hash_context) {
     sign_psbt_state_t *state = (sign_psbt_state_t *) &G_command_state;
 
+#if OUTPUTS_CACHE_SIZE > 0
+    if (state->outputs_cached) {
+        crypto_hash_update(hash_context, state->outputs_cache, state->outputs_cache_len);
+        return 0;
+    }
+#endif
+
+    outputs_cache_init(state);
+
     // TODO: support other SIGHASH FLAGS
     for (unsigned int i = 0; i < state->n_outputs; i++) {
         // get this output's map
@@ -149,7 +212,11 @@ static int hash_outputs(dispatcher_context_t *dc, cx_hash_t *hash_context) {
 
         crypto_hash_update_varint(hash_context, out_script_len);
         crypto_hash_update(hash_context, out_script, out_script_len);
+
+        outputs_cache_add(state, amount_raw, out_script, out_script_len);
     }
+
+    state->outputs_cached = !state->outputs_cache_overflow;
     return 0;
 }
 
@@ -291,19 +358,253 @@ static int get_amount_scriptpubkey_from_psbt(
                                                         NULL);
 }
 
+#ifdef SIGN_PSBT_HASH_INPUTS_WHILE_VERIFYING
+static void input_hashes_init(sign_psbt_state_t *state) {
+    cx_sha256_init(&state->inputs_hash_contexts.sha_prevouts_context);
+    cx_sha256_init(&state->inputs_hash_contexts.sha_amounts_context);
+    cx_sha256_init(&state->inputs_hash_contexts.sha_scriptpubkeys_context);
+    cx_sha256_init(&state->inputs_hash_contexts.sha_sequences_context);
+}
+
+/*
+ Adds an input to sha_prevouts, sha_amounts, sha_scriptpubkeys and sha_sequences, given its prevout
+ hash, and the amount and scriptPubKey of its prevout. The output index and the sequence are fetched
+ from the input map.
+ Returns -1 on failure, 0 on success.
+*/
+static int input_hashes_add(dispatcher_context_t *dc,
+                            sign_psbt_state_t *state,
+                            const merkleized_map_commitment_t *input_map,
+                            const uint8_t prevout_hash[static 32],
+                            uint64_t amount,
+                            const uint8_t *scriptPubKey,
+                            size_t scriptPubKey_len) {
+    uint8_t prevout_n_raw[4];
+    if (4 != call_get_merkleized_map_value(dc,
+                                           input_map,
+                                           (uint8_t[]){PSBT_IN_OUTPUT_INDEX},
+                                           1,
+                                           prevout_n_raw,
+                                           4)) {
+        return -1;
+    }
+
+    uint8_t nSequence_raw[4];
+    if (4 != call_get_merkleized_map_value(dc,
+                                           input_map,
+                                           (uint8_t[]){PSBT_IN_SEQUENCE},
+                                           1,
+                                           nSequence_raw,
+                                           4)) {
+        // if no PSBT_IN_SEQUENCE is present, we must assume nSequence 0xFFFFFFFF
+        memset(nSequence_raw, 0xFF, 4);
+    }
+
+    crypto_hash_update(&state->inputs_hash_contexts.sha_prevouts_context.header, prevout_hash, 32);
+    crypto_hash_update(&state->inputs_hash_contexts.sha_prevouts_context.header, prevout_n_raw, 4);
+
+    uint8_t amount_le[8];
+    write_u64_le(amount_le, 0, amount);
+    crypto_hash_update(&state->inputs_hash_contexts.sha_amounts_context.header, amount_le, 8);
+
+    crypto_hash_update_varint(&state->inputs_hash_contexts.sha_scriptpubkeys_context.header,
+                              scriptPubKey_len);
+    crypto_hash_update(&state->inputs_hash_contexts.sha_scriptpubkeys_context.header,
+                       scriptPubKey,
+                       scriptPubKey_len);
+
+    crypto_hash_update(&state->inputs_hash_contexts.sha_sequences_context.header, nSequence_raw, 4);
+    return 0;
+}
+
+static void input_hashes_finalize(sign_psbt_state_t *state) {
+    crypto_hash_digest(&state->inputs_hash_contexts.sha_prevouts_context.header,
+                       state->hashes.sha_prevouts,
+                       32);
+    crypto_hash_digest(&state->inputs_hash_contexts.sha_amounts_context.header,
+                       state->hashes.sha_amounts,
+                       32);
+    crypto_hash_digest(&state->inputs_hash_contexts.sha_scriptpubkeys_context.header,
+                       state->hashes.sha_scriptpubkeys,
+                       32);
+    crypto_hash_digest(&state->inputs_hash_contexts.sha_sequences_context.header,
+                       state->hashes.sha_sequences,
+                       32);
+    state->segwit_hashes_computed = true;
+}
+#else
+typedef enum {
+    INPUT_HASH_PREVOUTS,
+    INPUT_HASH_AMOUNTS,
+    INPUT_HASH_SCRIPTPUBKEYS,
+    INPUT_HASH_SEQUENCES,
+} input_hash_e;
+
+/*
+ Computes one of sha_prevouts, sha_amounts, sha_scriptpubkeys and sha_sequences, fetching the
+ inputs from the client. Each hash takes a pass on the inputs, so that a single hash context is
+ kept in the state.
+ Returns -1 on failure, 0 on success.
+*/
+static int compute_input_hash(dispatcher_context_t *dc,
+                              sign_psbt_state_t *state,
+                              input_hash_e input_hash,
+                              uint8_t out[static 32]) {
+    cx_sha256_init(&state->input_hash_context);
+
+    for (unsigned int i = 0; i < state->n_inputs; i++) {
+        merkleized_map_commitment_t ith_map;
+        if (0 > call_get_merkleized_map(dc, state->inputs_root, state->n_inputs, i, &ith_map)) {
+            return -1;
+        }
+
+        if (input_hash == INPUT_HASH_PREVOUTS) {
+            uint8_t prevout[32 + 4];  // prevout hash and output index
+            if (32 != call_get_merkleized_map_value(dc,
+                                                    &ith_map,
+                                                    (uint8_t[]){PSBT_IN_PREVIOUS_TXID},
+                                                    1,
+                                                    prevout,
+                                                    32) ||
+                4 != call_get_merkleized_map_value(dc,
+                                                   &ith_map,
+                                                   (uint8_t[]){PSBT_IN_OUTPUT_INDEX},
+                                                   1,
+                                                   prevout + 32,
+                                                   4)) {
+                return -1;
+            }
+            crypto_hash_update(&state->input_hash_context.header, prevout, sizeof(prevout));
+        } else if (input_hash == INPUT_HASH_SEQUENCES) {
+            uint8_t nSequence_raw[4];
+            if (4 != call_get_merkleized_map_value(dc,
+                                                   &ith_map,
+                                                   (uint8_t[]){PSBT_IN_SEQUENCE},
+                                                   1,
+                                                   nSequence_raw,
+                                                   4)) {
+                // if no PSBT_IN_SEQUENCE is present, we must assume nSequence 0xFFFFFFFF
+                memset(nSequence_raw, 0xFF, 4);
+            }
+            crypto_hash_update(&state->input_hash_context.header, nSequence_raw, 4);
+        } else {
+            uint64_t amount;
+            uint8_t scriptPubKey[MAX_PREVOUT_SCRIPTPUBKEY_LEN];
+            size_t scriptPubKey_len;
+            if (0 > get_amount_scriptpubkey_from_psbt(dc,
+                                                      &ith_map,
+                                                      &amount,
+                                                      scriptPubKey,
+                                                      &scriptPubKey_len)) {
+                return -1;
+            }
+
+            if (input_hash == INPUT_HASH_AMOUNTS) {
+                uint8_t amount_le[8];
+                write_u64_le(amount_le, 0, amount);
+                crypto_hash_update(&state->input_hash_context.header, amount_le, 8);
+            } else {
+                crypto_hash_update_varint(&state->input_hash_context.header, scriptPubKey_len);
+                crypto_hash_update(&state->input_hash_context.header,
+                                   scriptPubKey,
+                                   scriptPubKey_len);
+            }
+        }
+    }
+
+    crypto_hash_digest(&state->input_hash_context.header, out, 32);
+    return 0;
+}
+#endif
+
+/**
+ * Fetches the only key of a canonical wallet, and checks if it is ours. If so, it sets
+ * has_canonical_key and our_key_derivation in the state; its pubkey is left in the cache of
+ * crypto.c, so that the pubkeys of the inputs and outputs are derived from it.
+ *
+ * @return 0 on success (even if the key is not ours), -1 on failure.
+ */
+static int load_canonical_key(dispatcher_context_t *dc,
+                              sign_psbt_state_t *state,
+                              const uint8_t keys_merkle_root[static 32]) {
+    state->has_canonical_key = false;
+
+    policy_map_key_info_t key_info;
+    {
+        uint8_t key_info_str[MAX_POLICY_KEY_INFO_LEN];
+
+        int key_info_len = call_get_merkle_leaf_element(dc,
+                                                        keys_merkle_root,
+                                                        1,
+                                                        0,
+                                                        key_info_str,
+                                                        sizeof(key_info_str));
+        if (key_info_len < 0) {
+            return -1;
+        }
+
+        buffer_t key_info_buffer = buffer_create(key_info_str, key_info_len);
+        if (parse_policy_map_key_info(&key_info_buffer, &key_info) == -1) {
+            return -1;
+        }
+    }
+
+    serialized_extended_pubkey_t ext_pubkey;
+    if (!key_info.has_key_origin || !key_info.has_wildcard ||
+        get_policy_map_key_info_ext_pubkey(&key_info, &ext_pubkey) < 0 ||
+        !crypto_is_extended_pubkey_at_path(key_info.master_key_fingerprint,
+                                           key_info.master_key_derivation,
+                                           key_info.master_key_derivation_len,
+                                           G_coin_config->bip32_pubkey_version,
+                                           &ext_pubkey)) {
+        // not our key; the generic validation will find that the inputs are external
+        return 0;
+    }
+
+    state->has_canonical_key = true;
+    state->our_key_derivation_length = key_info.master_key_derivation_len;
+    for (int i = 0; i < key_info.master_key_derivation_len; i++) {
+        state->our_key_derivation[i] = key_info.master_key_derivation[i];
+    }
+    return 0;
+}
+
 /**
  * Validates the input, initializes the hash context and starts accumulating the wallet header in
  * it.
  */
-void handler_sign_psbt(dispatcher_context_t *dc) {
+static void sign_psbt_start(dispatcher_context_t *dc, bool batch_signatures, bool is_resumed) {
     sign_psbt_state_t *state = (sign_psbt_state_t *) &G_command_state;
 
+    state->batch_signatures = batch_signatures;
+    state->signatures_batch_len = 0;
+    state->is_resumed = is_resumed;
+
     // Device must be unlocked
     if (os_global_pin_is_validated() != BOLOS_UX_OK) {
         SEND_SW(dc, SW_SECURITY_STATUS_NOT_SATISFIED);
         return;
     }
 
+    // As all the data of the psbt and of the wallet policy is committed to in the command, its
+    // hash identifies the approved transaction
+    if (is_resumed) {
+        uint8_t psbt_digest[32];
+        cx_hash_sha256(dc->read_buffer.ptr, dc->read_buffer.size, psbt_digest, 32);
+
+        if (!session.is_active ||
+            memcmp(session.psbt_digest, psbt_digest, sizeof(session.psbt_digest)) != 0) {
+            PRINTF("No signing session to resume for this psbt\n");
+            SEND_SW(dc, SW_BAD_STATE);
+            return;
+        }
+    } else {
+        // any previous session is abandoned; the new one only becomes active once the user
+        // approves the transaction
+        explicit_bzero(&session, sizeof(session));
+        cx_hash_sha256(dc->read_buffer.ptr, dc->read_buffer.size, session.psbt_digest, 32);
+    }
+
     merkleized_map_commitment_t global_map;
     if (!buffer_read_varint(&dc->read_buffer, &global_map.size)) {
         SEND_SW(dc, SW_WRONG_DATA_LENGTH);
@@ -323,10 +624,9 @@ void handler_sign_psbt(dispatcher_context_t *dc) {
         SEND_SW(dc, SW_WRONG_DATA_LENGTH);
         return;
     }
-    if (n_inputs > MAX_N_INPUTS_CAN_SIGN) {
-        // TODO: remove this limitation
-        PRINTF("At most %d inputs are supported\n", MAX_N_INPUTS_CAN_SIGN);
-        SEND_SW(dc, SW_NOT_SUPPORTED);
+    if (n_inputs > UINT32_MAX) {
+        // a transaction with so many inputs could not be valid anyway
+        SEND_SW(dc, SW_INCORRECT_DATA);
         return;
     }
     state->n_inputs = (unsigned int) n_inputs;
@@ -347,84 +647,115 @@ void handler_sign_psbt(dispatcher_context_t *dc) {
         return;
     }
 
-    // Fetch the serialized wallet policy from the client
-    uint8_t serialized_wallet_policy[MAX_POLICY_MAP_SERIALIZED_LENGTH];
-    int serialized_wallet_policy_len = call_get_preimage(dc,
-                                                         wallet_id,
-                                                         serialized_wallet_policy,
-                                                         sizeof(serialized_wallet_policy));
-    if (serialized_wallet_policy_len < 0) {
-        SEND_SW(dc, SW_INCORRECT_DATA);
-        return;
-    }
-
-    policy_map_wallet_header_t wallet_header;
-    buffer_t serialized_wallet_policy_buf =
-        buffer_create(serialized_wallet_policy, serialized_wallet_policy_len);
-    if ((read_policy_map_wallet(&serialized_wallet_policy_buf, &wallet_header)) < 0) {
-        SEND_SW(dc, SW_INCORRECT_DATA);
-        return;
-    }
-
-    memcpy(state->wallet_header_keys_info_merkle_root,
-           wallet_header.keys_info_merkle_root,
-           sizeof(wallet_header.keys_info_merkle_root));
-    state->wallet_header_n_keys = wallet_header.n_keys;
-
-    buffer_t policy_map_buffer =
-        buffer_create(&wallet_header.policy_map, wallet_header.policy_map_len);
-
-    if (parse_policy_map(&policy_map_buffer,
-                         state->wallet_policy_map_bytes,
-                         sizeof(state->wallet_policy_map_bytes)) < 0) {
-        SEND_SW(dc, SW_INCORRECT_DATA);
-        return;
-    }
-
     uint8_t hmac_or =
         0;  // the binary OR of all the hmac bytes (so == 0 iff the hmac is identically 0)
     for (int i = 0; i < 32; i++) {
         hmac_or = hmac_or | wallet_hmac[i];
     }
-    if (hmac_or == 0) {
-        // No hmac, verify that the policy is a canonical one that is allowed by default
 
-        if (state->wallet_header_n_keys != 1) {
-            PRINTF("Non-standard policy, it should only have 1 key\n");
-            SEND_SW(dc, SW_INCORRECT_DATA);
+    policy_map_wallet_header_t wallet_header;
+
+    // A registered wallet in the cache only needs the hmac to be verified; the policy and the keys
+    // are not fetched from the client
+    const wallet_cache_entry_t *cached_wallet = hmac_or != 0 ? wallet_cache_find(wallet_id) : NULL;
+    if (cached_wallet != NULL) {
+        if (!check_wallet_hmac(wallet_id, wallet_hmac)) {
+            PRINTF("Incorrect hmac\n");
+            SEND_SW(dc, SW_SIGNATURE_FAIL);
             return;
         }
 
-        state->address_type = get_policy_address_type(&state->wallet_policy_map);
-        if (state->address_type == -1) {
-            PRINTF("Non-standard policy, and no hmac provided\n");
+        wallet_cache_load(cached_wallet, &wallet_header, state->wallet_policy_map_bytes);
+
+        state->is_wallet_canonical = false;
+        state->has_canonical_key = false;
+    } else {
+        // Fetch the serialized wallet policy from the client
+        uint8_t serialized_wallet_policy[MAX_POLICY_MAP_SERIALIZED_LENGTH];
+        int serialized_wallet_policy_len = call_get_preimage(dc,
+                                                             wallet_id,
+                                                             serialized_wallet_policy,
+                                                             sizeof(serialized_wallet_policy));
+        if (serialized_wallet_policy_len < 0) {
             SEND_SW(dc, SW_INCORRECT_DATA);
             return;
         }
 
-        state->is_wallet_canonical = true;
-
-        // Based on the address type, we set the expected bip44 purpose for this canonical wallet
-        state->bip44_purpose = get_bip44_purpose(state->address_type);
-        if (state->bip44_purpose < 0) {
-            SEND_SW(dc, SW_BAD_STATE);
+        buffer_t serialized_wallet_policy_buf =
+            buffer_create(serialized_wallet_policy, serialized_wallet_policy_len);
+        if ((read_policy_map_wallet(&serialized_wallet_policy_buf, &wallet_header)) < 0) {
+            SEND_SW(dc, SW_INCORRECT_DATA);
             return;
         }
 
-        // We do not check here that the purpose field, coin_type and account (first three step of
-        // the bip44 derivation) are standard. Will check at signing time that the path is valid.
-    } else {
-        // Verify hmac
+        buffer_t policy_map_buffer =
+            buffer_create(&wallet_header.policy_map, wallet_header.policy_map_len);
 
-        if (!check_wallet_hmac(wallet_id, wallet_hmac)) {
-            PRINTF("Incorrect hmac\n");
-            SEND_SW(dc, SW_SIGNATURE_FAIL);
+        if (parse_policy_map(&policy_map_buffer,
+                             state->wallet_policy_map_bytes,
+                             sizeof(state->wallet_policy_map_bytes)) < 0) {
+            SEND_SW(dc, SW_INCORRECT_DATA);
             return;
         }
 
-        state->is_wallet_canonical = false;
+        if (hmac_or == 0) {
+            // No hmac, verify that the policy is a canonical one that is allowed by default
+
+            if (wallet_header.n_keys != 1) {
+                PRINTF("Non-standard policy, it should only have 1 key\n");
+                SEND_SW(dc, SW_INCORRECT_DATA);
+                return;
+            }
+
+            state->address_type = get_policy_address_type(&state->wallet_policy_map);
+            if (state->address_type == -1) {
+                PRINTF("Non-standard policy, and no hmac provided\n");
+                SEND_SW(dc, SW_INCORRECT_DATA);
+                return;
+            }
+
+            state->is_wallet_canonical = true;
+
+            // Based on the address type, we set the expected bip44 purpose for this canonical
+            // wallet
+            state->bip44_purpose = get_bip44_purpose(state->address_type);
+            if (state->bip44_purpose < 0) {
+                SEND_SW(dc, SW_BAD_STATE);
+                return;
+            }
+
+            // We do not check here that the purpose field, coin_type and account (first three step
+            // of the bip44 derivation) are standard. Will check at signing time that the path is
+            // valid.
+
+            if (load_canonical_key(dc, state, wallet_header.keys_info_merkle_root) < 0) {
+                SEND_SW(dc, SW_INCORRECT_DATA);
+                return;
+            }
+        } else {
+            // Verify hmac
+
+            if (!check_wallet_hmac(wallet_id, wallet_hmac)) {
+                PRINTF("Incorrect hmac\n");
+                SEND_SW(dc, SW_SIGNATURE_FAIL);
+                return;
+            }
+
+            state->is_wallet_canonical = false;
+            state->has_canonical_key = false;
+
+            // the cache is an optimization, therefore a failure does not prevent signing
+            if (wallet_cache_record_miss(wallet_id)) {
+                wallet_cache_add(dc, wallet_id, &wallet_header, state->wallet_policy_map_bytes);
+            }
+        }
     }
 
+    memcpy(state->wallet_header_keys_info_merkle_root,
+           wallet_header.keys_info_merkle_root,
+           sizeof(wallet_header.keys_info_merkle_root));
+    state->wallet_header_n_keys = wallet_header.n_keys;
+
     // Swap feature: check that wallet is canonical
     if (G_swap_state.called_from_swap && !state->is_wallet_canonical) {
         PRINTF("Must be a canonical wallet for swap feature\n");
@@ -432,9 +763,13 @@ void handler_sign_psbt(dispatcher_context_t *dc) {
         return;
     }
 
+    state->segwit_hashes_computed = false;
+    state->sha_outputs_computed = false;
+    outputs_cache_init(state);
+
     state->inputs_total_value = 0;
     state->internal_inputs_total_value = 0;
-    memset(state->internal_inputs, 0, sizeof(state->internal_inputs));
+    state->n_internal_inputs = 0;
 
     state->master_key_fingerprint = crypto_get_master_key_fingerprint();
 
@@ -486,6 +821,18 @@ void handler_sign_psbt(dispatcher_context_t *dc) {
 
     state->cur_input_index = 0;
 
+    if (state->is_resumed) {
+        // The transaction was already verified and approved in the session; it is only signed
+        dc->next(sign_init);
+        return;
+    }
+
+#ifdef SIGN_PSBT_HASH_INPUTS_WHILE_VERIFYING
+    // if the first input has a witness UTXO, the aggregate hashes of the inputs for the segwit
+    // sighashes are computed while verifying them
+    input_hashes_init(state);
+#endif
+
     if (state->is_wallet_canonical) {
         // Canonical wallet, we start processing the psbt directly
         dc->next(process_input_map);
@@ -495,6 +842,18 @@ void handler_sign_psbt(dispatcher_context_t *dc) {
     }
 }
 
+void handler_sign_psbt(dispatcher_context_t *dc) {
+    sign_psbt_start(dc, false, false);
+}
+
+void handler_sign_psbt_batched(dispatcher_context_t *dc) {
+    sign_psbt_start(dc, true, false);
+}
+
+void handler_resume_sign_psbt(dispatcher_context_t *dc) {
+    sign_psbt_start(dc, true, true);
+}
+
 /** Inputs verification flow
  *
  *  Go though all the inputs:
@@ -550,6 +909,11 @@ static void process_input_map(dispatcher_context_t *dc) {
 
     if (state->cur_input_index >= state->n_inputs) {
         // all inputs already processed
+#ifdef SIGN_PSBT_HASH_INPUTS_WHILE_VERIFYING
+        if (state->hashing_inputs) {
+            input_hashes_finalize(state);
+        }
+#endif
         dc->next(alert_external_inputs);
         return;
     }
@@ -583,24 +947,32 @@ static void process_input_map(dispatcher_context_t *dc) {
         return;
     }
 
-    // validate non-witness utxo (if present) and witness utxo (if present)
+#ifdef SIGN_PSBT_HASH_INPUTS_WHILE_VERIFYING
+    if (state->cur_input_index == 0) {
+        state->hashing_inputs = state->cur.input.has_witnessUtxo;
+    }
+    bool needs_prevout_hash = state->hashing_inputs || state->cur.input.has_nonWitnessUtxo;
+#else
+    bool needs_prevout_hash = state->cur.input.has_nonWitnessUtxo;
+#endif
 
-    if (state->cur.input.has_nonWitnessUtxo) {
-        uint8_t prevout_hash[32];
+    uint8_t prevout_hash[32];
+    if (needs_prevout_hash &&
+        32 != call_get_merkleized_map_value(dc,
+                                            &state->cur.in_out.map,
+                                            (uint8_t[]){PSBT_IN_PREVIOUS_TXID},
+                                            1,
+                                            prevout_hash,
+                                            sizeof(prevout_hash))) {
+        SEND_SW(dc, SW_INCORRECT_DATA);
+        return;
+    }
 
-        // check if the prevout_hash of the transaction matches the computed one from the
-        // non-witness utxo
-        if (0 > call_get_merkleized_map_value(dc,
-                                              &state->cur.in_out.map,
-                                              (uint8_t[]){PSBT_IN_PREVIOUS_TXID},
-                                              1,
-                                              prevout_hash,
-                                              sizeof(prevout_hash))) {
-            SEND_SW(dc, SW_INCORRECT_DATA);
-            return;
-        }
+    // validate non-witness utxo (if present) and witness utxo (if present)
 
-        // request non-witness utxo, and get the prevout's value and scriptpubkey
+    if (state->cur.input.has_nonWitnessUtxo) {
+        // request non-witness utxo, and get the prevout's value and scriptpubkey; the
+        // prevout_hash of the transaction must match the one computed from the non-witness utxo
         if (0 > get_amount_scriptpubkey_from_psbt_nonwitness(dc,
                                                              &state->cur.in_out.map,
                                                              &state->cur.input.prevout_amount,
@@ -638,6 +1010,7 @@ static void process_input_map(dispatcher_context_t *dc) {
                 PRINTF(
                     "scriptPubKey or amount in non-witness utxo doesn't match with witness utxo\n");
                 SEND_SW(dc, SW_INCORRECT_DATA);
+                return;
             }
         } else {
             // we extract the scriptPubKey and prevout amount from the witness utxo
@@ -651,6 +1024,19 @@ static void process_input_map(dispatcher_context_t *dc) {
         }
     }
 
+#ifdef SIGN_PSBT_HASH_INPUTS_WHILE_VERIFYING
+    if (state->hashing_inputs && 0 > input_hashes_add(dc,
+                                                      state,
+                                                      &state->cur.in_out.map,
+                                                      prevout_hash,
+                                                      state->cur.input.prevout_amount,
+                                                      state->cur.in_out.scriptPubKey,
+                                                      state->cur.in_out.scriptPubKey_len)) {
+        SEND_SW(dc, SW_INCORRECT_DATA);
+        return;
+    }
+#endif
+
     dc->next(check_input_owned);
 }
 
@@ -665,10 +1051,12 @@ static void check_input_owned(dispatcher_context_t *dc) {
         PRINTF("Error checking if input %d is internal\n", state->cur_input_index);
         SEND_SW(dc, SW_INCORRECT_DATA);
         return;
-    } else if (is_internal == 0) {
+    }
+
+    if (is_internal == 0) {
         PRINTF("INPUT %d is external\n", state->cur_input_index);
     } else {
-        bitvector_set(state->internal_inputs, state->cur_input_index, 1);
+        ++state->n_internal_inputs;
         state->internal_inputs_total_value += state->cur.input.prevout_amount;
 
         int segwit_version =
@@ -699,12 +1087,7 @@ static void alert_external_inputs(dispatcher_context_t *dc) {
 
     LOG_PROCESSOR(dc, __FILE__, __LINE__, __func__);
 
-    size_t count_external_inputs = 0;
-    for (unsigned int i = 0; i < state->n_inputs; i++) {
-        if (!bitvector_get(state->internal_inputs, i)) {
-            ++count_external_inputs;
-        }
-    }
+    size_t count_external_inputs = state->n_inputs - state->n_internal_inputs;
 
     if (count_external_inputs == 0) {
         // no external inputs
@@ -747,6 +1130,11 @@ static void verify_outputs_init(dispatcher_context_t *dc) {
 
     state->external_outputs_count = 0;
 
+    // the outputs are hashed and cached while they are verified, so that the signing flow does not
+    // need to fetch them again
+    cx_sha256_init(&state->sha_outputs_context);
+    outputs_cache_init(state);
+
     dc->next(process_output_map);
 }
 
@@ -787,6 +1175,10 @@ static void process_output_map(dispatcher_context_t *dc) {
 
     if (state->cur_output_index >= state->n_outputs) {
         // all outputs already processed
+        crypto_hash_digest(&state->sha_outputs_context.header, state->hashes.sha_outputs, 32);
+        state->sha_outputs_computed = true;
+        state->outputs_cached = !state->outputs_cache_overflow;
+
         dc->next(confirm_transaction);
         return;
     }
@@ -832,6 +1224,8 @@ static void process_output_map(dispatcher_context_t *dc) {
     state->cur.output.value = value;
     state->outputs_total_value += value;
 
+    crypto_hash_update(&state->sha_outputs_context.header, raw_result, 8);
+
     // Read the output's scriptPubKey
     result_len = call_get_merkleized_map_value(dc,
                                                &state->cur.in_out.map,
@@ -847,6 +1241,12 @@ static void process_output_map(dispatcher_context_t *dc) {
 
     state->cur.in_out.scriptPubKey_len = result_len;
 
+    crypto_hash_update_varint(&state->sha_outputs_context.header, result_len);
+    crypto_hash_update(&state->sha_outputs_context.header,
+                       state->cur.in_out.scriptPubKey,
+                       result_len);
+    outputs_cache_add(state, raw_result, state->cur.in_out.scriptPubKey, result_len);
+
     dc->next(check_output_owned);
 }
 
@@ -1008,58 +1408,70 @@ static void sign_init(dispatcher_context_t *dc) {
 
     LOG_PROCESSOR(dc, __FILE__, __LINE__, __func__);
 
-    // find and parse our registered key info in the wallet
-    bool our_key_found = false;
-    for (unsigned int i = 0; i < state->wallet_header_n_keys; i++) {
-        uint8_t key_info_str[MAX_POLICY_KEY_INFO_LEN];
+    const wallet_cache_entry_t *cached_wallet =
+        wallet_cache_find_keys(state->wallet_header_keys_info_merkle_root,
+                               state->wallet_header_n_keys);
 
-        int key_info_len = call_get_merkle_leaf_element(dc,
-                                                        state->wallet_header_keys_info_merkle_root,
-                                                        state->wallet_header_n_keys,
-                                                        i,
-                                                        key_info_str,
-                                                        sizeof(key_info_str));
+    // find and parse our registered key info in the wallet, unless it is already known
+    bool our_key_found = state->has_canonical_key;
+    for (unsigned int i = 0; !our_key_found && i < state->wallet_header_n_keys; i++) {
+        policy_map_key_info_t our_key_info;
+        serialized_extended_pubkey_t ext_pubkey;
 
-        if (key_info_len < 0) {
-            SEND_SW(dc, SW_BAD_STATE);  // should never happen
-            return;
-        }
+        if (cached_wallet != NULL) {
+            const wallet_cache_key_t *key = &cached_wallet->keys[i];
 
-        // Make a sub-buffer for the pubkey info
-        buffer_t key_info_buffer = buffer_create(key_info_str, key_info_len);
+            memcpy(our_key_info.master_key_fingerprint, key->master_key_fingerprint, 4);
+            our_key_info.master_key_derivation_len = key->master_key_derivation_len;
+            memcpy(our_key_info.master_key_derivation,
+                   key->master_key_derivation,
+                   sizeof(our_key_info.master_key_derivation));
+            memcpy(&ext_pubkey, &key->ext_pubkey, sizeof(ext_pubkey));
+        } else {
+            uint8_t key_info_str[MAX_POLICY_KEY_INFO_LEN];
+
+            int key_info_len =
+                call_get_merkle_leaf_element(dc,
+                                             state->wallet_header_keys_info_merkle_root,
+                                             state->wallet_header_n_keys,
+                                             i,
+                                             key_info_str,
+                                             sizeof(key_info_str));
+
+            if (key_info_len < 0) {
+                SEND_SW(dc, SW_BAD_STATE);  // should never happen
+                return;
+            }
 
-        policy_map_key_info_t our_key_info;
-        if (parse_policy_map_key_info(&key_info_buffer, &our_key_info) == -1) {
-            SEND_SW(dc, SW_BAD_STATE);  // should never happen
-            return;
-        }
+            // Make a sub-buffer for the pubkey info
+            buffer_t key_info_buffer = buffer_create(key_info_str, key_info_len);
 
-        uint32_t fpr = read_u32_be(our_key_info.master_key_fingerprint, 0);
-        if (fpr == state->master_key_fingerprint) {
-            // it could be a collision on the fingerprint; we verify that we can actually generate
-            // the same pubkey
-            char pubkey_derived[MAX_SERIALIZED_PUBKEY_LENGTH + 1];
-            int serialized_pubkey_len =
-                get_serialized_extended_pubkey_at_path(our_key_info.master_key_derivation,
-                                                       our_key_info.master_key_derivation_len,
-                                                       G_coin_config->bip32_pubkey_version,
-                                                       pubkey_derived);
-            if (serialized_pubkey_len == -1) {
-                SEND_SW(dc, SW_BAD_STATE);
+            if (parse_policy_map_key_info(&key_info_buffer, &our_key_info) == -1) {
+                SEND_SW(dc, SW_BAD_STATE);  // should never happen
                 return;
             }
 
-            if (strncmp(our_key_info.ext_pubkey, pubkey_derived, MAX_SERIALIZED_PUBKEY_LENGTH) ==
-                0) {
-                our_key_found = true;
+            // only keys with our fingerprint are of interest
+            if (read_u32_be(our_key_info.master_key_fingerprint, 0) !=
+                    state->master_key_fingerprint ||
+                get_policy_map_key_info_ext_pubkey(&our_key_info, &ext_pubkey) < 0) {
+                continue;
+            }
+        }
 
-                state->our_key_derivation_length = our_key_info.master_key_derivation_len;
-                for (int i = 0; i < our_key_info.master_key_derivation_len; i++) {
-                    state->our_key_derivation[i] = our_key_info.master_key_derivation[i];
-                }
+        if (crypto_is_extended_pubkey_at_path(our_key_info.master_key_fingerprint,
+                                              our_key_info.master_key_derivation,
+                                              our_key_info.master_key_derivation_len,
+                                              G_coin_config->bip32_pubkey_version,
+                                              &ext_pubkey)) {
+            our_key_found = true;
 
-                break;
+            state->our_key_derivation_length = our_key_info.master_key_derivation_len;
+            for (int i = 0; i < our_key_info.master_key_derivation_len; i++) {
+                state->our_key_derivation[i] = our_key_info.master_key_derivation[i];
             }
+
+            break;
         }
     }
 
@@ -1071,9 +1483,17 @@ static void sign_init(dispatcher_context_t *dc) {
         return;
     }
 
-    state->segwit_hashes_computed = false;
+    if (state->is_resumed) {
+        // skip the inputs whose signatures were already received by the client
+        state->cur_input_index = session.next_input_index;
+    } else {
+        state->cur_input_index = 0;
+
+        // the user approved the transaction: start the session
+        session.next_input_index = 0;
+        session.is_active = true;
+    }
 
-    state->cur_input_index = 0;
     dc->next(sign_process_input_map);
 }
 
@@ -1082,13 +1502,6 @@ static void sign_process_input_map(dispatcher_context_t *dc) {
 
     LOG_PROCESSOR(dc, __FILE__, __LINE__, __func__);
 
-    // skip external inputs
-    while (state->cur_input_index < state->n_inputs &&
-           !bitvector_get(state->internal_inputs, state->cur_input_index)) {
-        PRINTF("Skipping signing external input %d\n", state->cur_input_index);
-        ++state->cur_input_index;
-    }
-
     if (state->cur_input_index >= state->n_inputs) {
         // all inputs already processed
         dc->next(finalize);
@@ -1105,11 +1518,47 @@ static void sign_process_input_map(dispatcher_context_t *dc) {
         state->cur_input_index,
         make_callback(state, (dispatcher_callback_t) input_keys_callback),
         &state->cur.in_out.map);
+    if (res < 0 || state->cur.in_out.unexpected_pubkey_error) {
+        SEND_SW(dc, SW_INCORRECT_DATA);
+        return;
+    }
+
+    // Get the prevout's amount and scriptPubKey, in order to decide again if the input is internal.
+    // This is the same committed data that the verification flow used: if both are present, it
+    // checked that the witness utxo matches the non-witness utxo, so it is enough to request the
+    // witness utxo.
+    if (state->cur.input.has_witnessUtxo) {
+        res = get_amount_scriptpubkey_from_psbt_witness(dc,
+                                                        &state->cur.in_out.map,
+                                                        &state->cur.input.prevout_amount,
+                                                        state->cur.in_out.scriptPubKey,
+                                                        &state->cur.in_out.scriptPubKey_len);
+    } else {
+        res = get_amount_scriptpubkey_from_psbt_nonwitness(dc,
+                                                           &state->cur.in_out.map,
+                                                           &state->cur.input.prevout_amount,
+                                                           state->cur.in_out.scriptPubKey,
+                                                           &state->cur.in_out.scriptPubKey_len,
+                                                           NULL);
+    }
     if (res < 0) {
         SEND_SW(dc, SW_INCORRECT_DATA);
         return;
     }
 
+    int is_internal = is_in_out_internal(dc, state, &state->cur.in_out, true);
+    if (is_internal < 0) {
+        SEND_SW(dc, SW_INCORRECT_DATA);
+        return;
+    }
+
+    if (is_internal == 0) {
+        PRINTF("Skipping signing external input %d\n", state->cur_input_index);
+        ++state->cur_input_index;
+        dc->next(sign_process_input_map);
+        return;
+    }
+
     if (!state->cur.input.has_sighash_type) {
         state->cur.input.sighash_type = SIGHASH_ALL;
     } else {
@@ -1175,35 +1624,13 @@ static void sign_process_input_map(dispatcher_context_t *dc) {
 
     // Sign as segwit input iff it has a witness utxo
     if (!state->cur.input.has_witnessUtxo) {
-        dc->next(sign_legacy);
+        dc->next(sign_legacy_compute_sighash);
     } else {
         dc->next(sign_segwit);
     }
 }
 
-static void sign_legacy(dispatcher_context_t *dc) {
-    // sign legacy P2PKH or P2SH
-
-    sign_psbt_state_t *state = (sign_psbt_state_t *) &G_command_state;
-
-    LOG_PROCESSOR(dc, __FILE__, __LINE__, __func__);
-
-    // sign_non_witness(non_witness_utxo.vout[psbt.tx.input_[i].prevout.n].scriptPubKey, i)
-
-    uint64_t tmp;  // unused
-    if (0 > get_amount_scriptpubkey_from_psbt_nonwitness(dc,
-                                                         &state->cur.in_out.map,
-                                                         &tmp,
-                                                         state->cur.in_out.scriptPubKey,
-                                                         &state->cur.in_out.scriptPubKey_len,
-                                                         NULL)) {
-        SEND_SW(dc, SW_INCORRECT_DATA);
-        return;
-    }
-
-    dc->next(sign_legacy_compute_sighash);
-}
-
+// sign legacy P2PKH or P2SH
 static void sign_legacy_compute_sighash(dispatcher_context_t *dc) {
     sign_psbt_state_t *state = (sign_psbt_state_t *) &G_command_state;
 
@@ -1336,18 +1763,7 @@ static void sign_segwit(dispatcher_context_t *dc) {
     int segwit_version;
 
     {
-        uint64_t amount;
-        if (0 > get_amount_scriptpubkey_from_psbt_witness(dc,
-                                                          &state->cur.in_out.map,
-                                                          &amount,
-                                                          state->cur.in_out.scriptPubKey,
-                                                          &state->cur.in_out.scriptPubKey_len)) {
-            SEND_SW(dc, SW_INCORRECT_DATA);
-            return;
-        }
-
-        state->inputs_total_value += amount;
-
+        // the witness utxo's amount and scriptPubKey were already fetched in sign_process_input_map
         if (state->cur.input.has_redeemScript) {
             // Get redeemScript
             uint8_t redeemScript[64];
@@ -1398,136 +1814,85 @@ static void sign_segwit(dispatcher_context_t *dc) {
         }
     }
 
-    // compute all the tx-wide hashes
+    // compute all the tx-wide hashes, unless they were computed in the verification flow
 
     if (!state->segwit_hashes_computed) {
-        {
-            // compute sha_prevouts and sha_sequences
-            cx_sha256_t sha_prevouts_context, sha_sequences_context;
-
-            // compute hashPrevouts and hashSequence
-            cx_sha256_init(&sha_prevouts_context);
-            cx_sha256_init(&sha_sequences_context);
+#ifdef SIGN_PSBT_HASH_INPUTS_WHILE_VERIFYING
+        // resumed sessions, or the first input had no witness UTXO: each input map is fetched once,
+        // and feeds all the hashes
+        input_hashes_init(state);
 
-            for (unsigned int i = 0; i < state->n_inputs; i++) {
-                // get this input's map
-                merkleized_map_commitment_t ith_map;
+        for (unsigned int i = 0; i < state->n_inputs; i++) {
+            // get this input's map
+            merkleized_map_commitment_t ith_map;
 
-                int res =
-                    call_get_merkleized_map(dc, state->inputs_root, state->n_inputs, i, &ith_map);
-                if (res < 0) {
-                    SEND_SW(dc, SW_INCORRECT_DATA);
-                    return;
-                }
-
-                // get prevout hash and output index for the i-th input
-                uint8_t ith_prevout_hash[32];
-                if (32 != call_get_merkleized_map_value(dc,
-                                                        &ith_map,
-                                                        (uint8_t[]){PSBT_IN_PREVIOUS_TXID},
-                                                        1,
-                                                        ith_prevout_hash,
-                                                        32)) {
-                    SEND_SW(dc, SW_INCORRECT_DATA);
-                    return;
-                }
-
-                crypto_hash_update(&sha_prevouts_context.header, ith_prevout_hash, 32);
-
-                uint8_t ith_prevout_n_raw[4];
-                if (4 != call_get_merkleized_map_value(dc,
-                                                       &ith_map,
-                                                       (uint8_t[]){PSBT_IN_OUTPUT_INDEX},
-                                                       1,
-                                                       ith_prevout_n_raw,
-                                                       4)) {
-                    SEND_SW(dc, SW_INCORRECT_DATA);
-                    return;
-                }
-
-                crypto_hash_update(&sha_prevouts_context.header, ith_prevout_n_raw, 4);
-
-                uint8_t ith_nSequence_raw[4];
-                if (4 != call_get_merkleized_map_value(dc,
-                                                       &ith_map,
-                                                       (uint8_t[]){PSBT_IN_SEQUENCE},
-                                                       1,
-                                                       ith_nSequence_raw,
-                                                       4)) {
-                    // if no PSBT_IN_SEQUENCE is present, we must assume nSequence 0xFFFFFFFF
-                    memset(ith_nSequence_raw, 0xFF, 4);
-                }
-
-                crypto_hash_update(&sha_sequences_context.header, ith_nSequence_raw, 4);
+            int res = call_get_merkleized_map(dc, state->inputs_root, state->n_inputs, i, &ith_map);
+            if (res < 0) {
+                SEND_SW(dc, SW_INCORRECT_DATA);
+                return;
             }
 
-            crypto_hash_digest(&sha_prevouts_context.header, state->hashes.sha_prevouts, 32);
-            crypto_hash_digest(&sha_sequences_context.header, state->hashes.sha_sequences, 32);
-        }
-
-        {
-            // compute sha_outputs
-            cx_sha256_t sha_outputs_context;
-            cx_sha256_init(&sha_outputs_context);
-
-            if (hash_outputs(dc, &sha_outputs_context.header) == -1) {
+            uint8_t ith_prevout_hash[32];
+            if (32 != call_get_merkleized_map_value(dc,
+                                                    &ith_map,
+                                                    (uint8_t[]){PSBT_IN_PREVIOUS_TXID},
+                                                    1,
+                                                    ith_prevout_hash,
+                                                    32)) {
                 SEND_SW(dc, SW_INCORRECT_DATA);
                 return;
             }
 
-            crypto_hash_digest(&sha_outputs_context.header, state->hashes.sha_outputs, 32);
+            uint64_t in_amount;
+            uint8_t in_scriptPubKey[MAX_PREVOUT_SCRIPTPUBKEY_LEN];
+            size_t in_scriptPubKey_len;
+
+            if (0 > get_amount_scriptpubkey_from_psbt(dc,
+                                                      &ith_map,
+                                                      &in_amount,
+                                                      in_scriptPubKey,
+                                                      &in_scriptPubKey_len) ||
+                0 > input_hashes_add(dc,
+                                     state,
+                                     &ith_map,
+                                     ith_prevout_hash,
+                                     in_amount,
+                                     in_scriptPubKey,
+                                     in_scriptPubKey_len)) {
+                SEND_SW(dc, SW_INCORRECT_DATA);
+                return;
+            }
         }
 
-        {
-            // compute sha_amounts and sha_scriptpubkeys
-            // TODO: could be skipped if there are no segwitv1 inputs to sign
-
-            cx_sha256_t sha_amounts_context, sha_scriptpubkeys_context;
-
-            cx_sha256_init(&sha_amounts_context);
-            cx_sha256_init(&sha_scriptpubkeys_context);
-
-            for (unsigned int i = 0; i < state->n_inputs; i++) {
-                // get this input's map
-                merkleized_map_commitment_t ith_map;
-
-                int res =
-                    call_get_merkleized_map(dc, state->inputs_root, state->n_inputs, i, &ith_map);
-                if (res < 0) {
-                    SEND_SW(dc, SW_INCORRECT_DATA);
-                    return;
-                }
-
-                uint64_t in_amount;
-                uint8_t in_scriptPubKey[MAX_PREVOUT_SCRIPTPUBKEY_LEN];
-                size_t in_scriptPubKey_len;
-
-                if (0 > get_amount_scriptpubkey_from_psbt(dc,
-                                                          &ith_map,
-                                                          &in_amount,
-                                                          in_scriptPubKey,
-                                                          &in_scriptPubKey_len)) {
-                    SEND_SW(dc, SW_INCORRECT_DATA);
-                    return;
-                }
-
-                uint8_t in_amount_le[8];
-                write_u64_le(in_amount_le, 0, in_amount);
-                crypto_hash_update(&sha_amounts_context.header, in_amount_le, 8);
+        input_hashes_finalize(state);
+#else
+        if (0 > compute_input_hash(dc, state, INPUT_HASH_PREVOUTS, state->hashes.sha_prevouts) ||
+            0 > compute_input_hash(dc, state, INPUT_HASH_AMOUNTS, state->hashes.sha_amounts) ||
+            0 > compute_input_hash(dc,
+                                   state,
+                                   INPUT_HASH_SCRIPTPUBKEYS,
+                                   state->hashes.sha_scriptpubkeys) ||
+            0 > compute_input_hash(dc, state, INPUT_HASH_SEQUENCES, state->hashes.sha_sequences)) {
+            SEND_SW(dc, SW_INCORRECT_DATA);
+            return;
+        }
+        state->segwit_hashes_computed = true;
+#endif
+    }
 
-                crypto_hash_update_varint(&sha_scriptpubkeys_context.header, in_scriptPubKey_len);
-                crypto_hash_update(&sha_scriptpubkeys_context.header,
-                                   in_scriptPubKey,
-                                   in_scriptPubKey_len);
-            }
+    if (!state->sha_outputs_computed) {
+        // compute sha_outputs, unless it was computed while verifying the outputs
+        cx_sha256_t sha_outputs_context;
+        cx_sha256_init(&sha_outputs_context);
 
-            crypto_hash_digest(&sha_amounts_context.header, state->hashes.sha_amounts, 32);
-            crypto_hash_digest(&sha_scriptpubkeys_context.header,
-                               state->hashes.sha_scriptpubkeys,
-                               32);
+        if (hash_outputs(dc, &sha_outputs_context.header) == -1) {
+            SEND_SW(dc, SW_INCORRECT_DATA);
+            return;
         }
+
+        crypto_hash_digest(&sha_outputs_context.header, state->hashes.sha_outputs, 32);
+        state->sha_outputs_computed = true;
     }
-    state->segwit_hashes_computed = true;
 
     if (segwit_version == 0) {
         dc->next(sign_segwit_v0);
@@ -1801,6 +2166,103 @@ static void sign_segwit_v1(dispatcher_context_t *dc) {
     dc->next(sign_sighash_schnorr);
 }
 
+/**
+ * Records in the session that the client received the signatures of all the inputs before
+ * next_input_index.
+ */
+static void save_session_progress(unsigned int next_input_index) {
+    session.next_input_index = next_input_index;
+}
+
+/**
+ * Sends the accumulated signatures to the client with a single YIELD, if there are any.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int flush_signatures(dispatcher_context_t *dc) {
+    sign_psbt_state_t *state = (sign_psbt_state_t *) &G_command_state;
+
+    if (state->signatures_batch_len == 0) {
+        return 0;
+    }
+
+#if SIGNATURES_BATCH_MAX_LEN > 0
+    uint8_t cmd = CCMD_YIELD;
+    dc->add_to_response(&cmd, 1);
+    dc->add_to_response(state->signatures_batch, state->signatures_batch_len);
+    dc->finalize_response(SW_INTERRUPTED_EXECUTION);
+
+    state->signatures_batch_len = 0;
+
+    if (dc->process_interruption(dc) < 0) {
+        return -1;
+    }
+
+    save_session_progress(state->batch_next_input_index);
+#endif
+    return 0;
+}
+
+/**
+ * Sends the signature of the current input to the client. Unless the signatures are batched, it is
+ * yielded immediately as <input_index> <signature>; otherwise, <input_index> <len> <signature> is
+ * appended to the batch, that is first flushed if there is not enough space left (or yielded
+ * immediately, if SIGNATURES_BATCH_MAX_LEN is 0).
+ *
+ * @param[in] sig
+ *   The signature, including the sighash byte if any.
+ * @param[in] sig_len
+ *   The length of sig.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int yield_signature(dispatcher_context_t *dc, const uint8_t *sig, size_t sig_len) {
+    sign_psbt_state_t *state = (sign_psbt_state_t *) &G_command_state;
+
+    uint8_t input_index[9];
+    int input_index_len = varint_write(input_index, 0, state->cur_input_index);
+
+    if (!state->batch_signatures || SIGNATURES_BATCH_MAX_LEN == 0) {
+        uint8_t cmd = CCMD_YIELD;
+        dc->add_to_response(&cmd, 1);
+        dc->add_to_response(input_index, input_index_len);
+        if (state->batch_signatures) {
+            // a batch with a single signature
+            uint8_t len = (uint8_t) sig_len;
+            dc->add_to_response(&len, 1);
+        }
+        dc->add_to_response(sig, sig_len);
+        dc->finalize_response(SW_INTERRUPTED_EXECUTION);
+
+        if (dc->process_interruption(dc) < 0) {
+            return -1;
+        }
+
+        save_session_progress(state->cur_input_index + 1);
+        return 0;
+    }
+
+#if SIGNATURES_BATCH_MAX_LEN > 0
+    size_t entry_len = input_index_len + 1 + sig_len;
+    if (entry_len > sizeof(state->signatures_batch)) {
+        return -1;  // can't happen
+    }
+    if (state->signatures_batch_len + entry_len > sizeof(state->signatures_batch) &&
+        flush_signatures(dc) < 0) {
+        return -1;
+    }
+
+    uint8_t *entry = state->signatures_batch + state->signatures_batch_len;
+    memcpy(entry, input_index, input_index_len);
+    entry[input_index_len] = (uint8_t) sig_len;
+    memcpy(entry + input_index_len + 1, sig, sig_len);
+    state->signatures_batch_len += entry_len;
+
+    state->batch_next_input_index = state->cur_input_index + 1;
+#endif
+    return 0;
+}
+
 // Common for legacy and segwitv0 transactions
 static void sign_sighash_ecdsa(dispatcher_context_t *dc) {
     sign_psbt_state_t *state = (sign_psbt_state_t *) &G_command_state;
@@ -1816,7 +2278,7 @@ static void sign_sighash_ecdsa(dispatcher_context_t *dc) {
 
     int sign_path_len = state->our_key_derivation_length + 2;
 
-    uint8_t sig[MAX_DER_SIG_LEN];
+    uint8_t sig[MAX_DER_SIG_LEN + 1];  // extra byte for the sighash type
 
     int sig_len =
         crypto_ecdsa_sign_sha256_hash_with_key(sign_path, sign_path_len, state->sighash, sig, NULL);
@@ -1826,21 +2288,9 @@ static void sign_sighash_ecdsa(dispatcher_context_t *dc) {
         return;
     }
 
-    // yield signature
-    uint8_t cmd = CCMD_YIELD;
-    dc->add_to_response(&cmd, 1);
-
-    uint8_t buf[9];
-    int input_index_varint_len = varint_write(buf, 0, state->cur_input_index);
-    dc->add_to_response(&buf, input_index_varint_len);
-
-    dc->add_to_response(&sig, sig_len);
-    uint8_t sighash_byte = (uint8_t) (state->cur.input.sighash_type & 0xFF);
-    dc->add_to_response(&sighash_byte, 1);
-
-    dc->finalize_response(SW_INTERRUPTED_EXECUTION);
+    sig[sig_len++] = (uint8_t) (state->cur.input.sighash_type & 0xFF);
 
-    if (dc->process_interruption(dc) < 0) {
+    if (yield_signature(dc, sig, sig_len) < 0) {
         SEND_SW(dc, SW_BAD_STATE);
         return;
     }
@@ -1869,8 +2319,8 @@ static void sign_sighash_schnorr(dispatcher_context_t *dc) {
 
     int sign_path_len = state->our_key_derivation_length + 2;
 
-    uint8_t sig[64];
-    size_t sig_len;
+    uint8_t sig[64 + 1];  // extra byte for the sighash type
+    size_t sig_len = 64;
 
     bool error = false;
     BEGIN_TRY {
@@ -1910,25 +2360,13 @@ static void sign_sighash_schnorr(dispatcher_context_t *dc) {
         return;
     }
 
-    // yield signature
-    uint8_t cmd = CCMD_YIELD;
-    dc->add_to_response(&cmd, 1);
-
-    uint8_t buf[9];
-    int input_index_varint_len = varint_write(buf, 0, state->cur_input_index);
-    dc->add_to_response(&buf, input_index_varint_len);
-
-    dc->add_to_response(&sig, sizeof(sig));
-
     // only append the sighash type byte if it is non-zero
     uint8_t sighash_byte = (uint8_t) (state->cur.input.sighash_type & 0xFF);
     if (sighash_byte != 0x00) {
-        // only add the sighash byte if not 0
-        dc->add_to_response(&sighash_byte, 1);
+        sig[sig_len++] = sighash_byte;
     }
-    dc->finalize_response(SW_INTERRUPTED_EXECUTION);
 
-    if (dc->process_interruption(dc) < 0) {
+    if (yield_signature(dc, sig, sig_len) < 0) {
         SEND_SW(dc, SW_BAD_STATE);
         return;
     }
@@ -1940,6 +2378,15 @@ static void sign_sighash_schnorr(dispatcher_context_t *dc) {
 static void finalize(dispatcher_context_t *dc) {
     LOG_PROCESSOR(dc, __FILE__, __LINE__, __func__);
 
+    // send the signatures that are left in the batch
+    if (flush_signatures(dc) < 0) {
+        SEND_SW(dc, SW_BAD_STATE);
+        return;
+    }
+
+    // all the signatures were received, the session is complete
+    explicit_bzero(&session, sizeof(session));
+
     // Only if called from swap, the app should terminate after sending the response
     if (G_swap_state.called_from_swap) {
         G_swap_state.should_exit = true;
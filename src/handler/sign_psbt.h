@@ -2,12 +2,9 @@
 
 #include "../boilerplate/dispatcher.h"
 #include "../constants.h"
-#include "../common/bitvector.h"
 #include "../common/merkle.h"
 #include "../common/wallet.h"
 
-#define MAX_N_INPUTS_CAN_SIGN 512
-
 // common info that applies to either the current input or the current output
 typedef struct {
     merkleized_map_commitment_t map;
@@ -56,6 +53,47 @@ typedef struct {
     uint64_t value;
 } output_info_t;
 
+/*
+ * On Nano S, G_command_state overlaps the globals of the legacy app (see script-nanos.ld), and it
+ * only takes no additional RAM as long as it is not larger than them; main.c checks it. The buffers
+ * below only save round trips with the client, therefore they are disabled on Nano S, and so is
+ * the hashing of the inputs while they are verified (see SIGN_PSBT_HASH_INPUTS_WHILE_VERIFYING).
+ */
+
+/**
+ * Maximum length of the signatures that SIGN_PSBT_BATCHED yields together; each of them is encoded
+ * with its input index (up to 5 bytes), its length (1 byte) and the sighash byte, therefore three
+ * ECDSA signatures always fit. If 0, each signature is yielded alone, in the same format.
+ */
+#ifndef SIGNATURES_BATCH_MAX_LEN
+#ifdef TARGET_NANOS
+#define SIGNATURES_BATCH_MAX_LEN 0
+#else
+#define SIGNATURES_BATCH_MAX_LEN (3 * (5 + 1 + MAX_DER_SIG_LEN + 1))
+#endif
+#endif
+
+/**
+ * Size of the buffer that keeps the serialized outputs once they are verified, so that the sighash
+ * of each legacy input does not fetch them again from the client. If 0, the outputs are not cached.
+ */
+#ifndef OUTPUTS_CACHE_SIZE
+#ifdef TARGET_NANOS
+#define OUTPUTS_CACHE_SIZE 0
+#else
+#define OUTPUTS_CACHE_SIZE 1024
+#endif
+#endif
+
+/**
+ * If defined, sha_prevouts, sha_amounts, sha_scriptpubkeys and sha_sequences are computed while the
+ * inputs are verified, which needs a hash context for each of them in the state. Otherwise, they
+ * are computed one after the other when the first segwit input is signed, with a single context.
+ */
+#ifndef TARGET_NANOS
+#define SIGN_PSBT_HASH_INPUTS_WHILE_VERIFYING
+#endif
+
 typedef struct {
     machine_context_t ctx;
 
@@ -70,6 +108,10 @@ typedef struct {
     bool is_wallet_canonical;
     int address_type;   // only relevant for canonical wallets
     int bip44_purpose;  // only relevant for canonical wallets
+    // only relevant for canonical wallets: true if the key of the wallet was verified to be ours
+    // before processing the inputs. In that case, our_key_derivation is already known, and the
+    // scripts of the inputs and outputs are derived without fetching the key again
+    bool has_canonical_key;
 
     uint8_t wallet_header_keys_info_merkle_root[32];
     size_t wallet_header_n_keys;
@@ -80,8 +122,10 @@ typedef struct {
 
     uint32_t master_key_fingerprint;
 
-    // bitmap to track of which inputs are internal
-    uint8_t internal_inputs[BITVECTOR_REAL_SIZE(MAX_N_INPUTS_CAN_SIGN)];
+    // In order to use the same amount of memory for any number of inputs, we do not store which
+    // inputs are internal. Instead, the signing flow re-derives it for each input from the same
+    // committed data as the verification flow.
+    unsigned int n_internal_inputs;
 
     union {
         unsigned int cur_input_index;
@@ -105,7 +149,41 @@ typedef struct {
         uint8_t sha_sequences[32];
         uint8_t sha_outputs[32];
     } hashes;
+    // true if sha_prevouts, sha_amounts, sha_scriptpubkeys and sha_sequences were already computed
+    // while verifying the inputs
     bool segwit_hashes_computed;
+#ifdef SIGN_PSBT_HASH_INPUTS_WHILE_VERIFYING
+    // true if the inputs are hashed while they are verified; that is only the case if the first
+    // input has a witness UTXO, so that no additional data is fetched for legacy transactions
+    bool hashing_inputs;
+#endif
+    // true if hashes.sha_outputs was already computed while verifying the outputs
+    bool sha_outputs_computed;
+    union {
+#ifdef SIGN_PSBT_HASH_INPUTS_WHILE_VERIFYING
+        // the inputs are hashed while they are verified (or while signing, for resumed sessions)
+        struct {
+            cx_sha256_t sha_prevouts_context;
+            cx_sha256_t sha_amounts_context;
+            cx_sha256_t sha_scriptpubkeys_context;
+            cx_sha256_t sha_sequences_context;
+        } inputs_hash_contexts;
+#else
+        // the inputs are hashed while signing, one hash at a time
+        cx_sha256_t input_hash_context;
+#endif
+        // only used after all the inputs are hashed
+        cx_sha256_t sha_outputs_context;
+    };
+
+    // Network serialization of the outputs, accumulated while they are fetched. If all the outputs
+    // fit, outputs_cached is set to true and the sighash of legacy inputs uses it.
+#if OUTPUTS_CACHE_SIZE > 0
+    uint8_t outputs_cache[OUTPUTS_CACHE_SIZE];
+#endif
+    size_t outputs_cache_len;
+    bool outputs_cache_overflow;
+    bool outputs_cached;
 
     uint64_t inputs_total_value;
     uint64_t outputs_total_value;
@@ -119,6 +197,39 @@ typedef struct {
 
     int our_key_derivation_length;
     uint32_t our_key_derivation[MAX_BIP32_PATH_STEPS];
+
+    // if true, the signatures are accumulated in signatures_batch, and yielded together
+    bool batch_signatures;
+#if SIGNATURES_BATCH_MAX_LEN > 0
+    uint8_t signatures_batch[SIGNATURES_BATCH_MAX_LEN];
+#endif
+    size_t signatures_batch_len;
+    // progress of the signing flow after the last signature in signatures_batch; it is recorded
+    // in the signing session once the batch is received by the client
+    unsigned int batch_next_input_index;
+
+    // if true, the command continues a signing session that the user already approved
+    bool is_resumed;
 } sign_psbt_state_t;
 
 void handler_sign_psbt(dispatcher_context_t *dispatcher_context);
+
+/**
+ * Same as handler_sign_psbt, but the signatures are yielded in batches.
+ */
+void handler_sign_psbt_batched(dispatcher_context_t *dispatcher_context);
+
+/**
+ * Ends the signing session, if any. Must be called whenever the device is locked, as the user who
+ * unlocks it might not be the one who approved the transaction.
+ */
+void sign_psbt_clear_session(void);
+
+/**
+ * Continues the signing session of a SIGN_PSBT or SIGN_PSBT_BATCHED command that was interrupted
+ * after the user approved the transaction, for example because the host was disconnected. The
+ * command data must be identical to the one of the interrupted command. Only the signatures that
+ * the client did not receive yet are produced, and they are yielded in the format of
+ * SIGN_PSBT_BATCHED.
+ */
+void handler_resume_sign_psbt(dispatcher_context_t *dispatcher_context);
@@ -7,6 +7,8 @@
 #include "../lib/policy.h"
 
 #include "../../common/read.h"
+#include "../../common/script.h"
+#include "../../crypto.h"
 
 int compare_wallet_script_at_path(dispatcher_context_t *dispatcher_context,
                                   uint32_t change,
@@ -41,3 +43,65 @@ int compare_wallet_script_at_path(dispatcher_context_t *dispatcher_context,
         return 0;
     }
 }
+
+int compare_canonical_script_at_path(const uint32_t bip32_path[],
+                                     uint8_t bip32_path_len,
+                                     int address_type,
+                                     const uint8_t expected_script[],
+                                     size_t expected_script_len) {
+    // only the pubkey is needed: unlike the extended pubkey, it does not require the parent's
+    uint8_t pubkey[33];
+    if (crypto_get_pubkey_at_path(bip32_path, bip32_path_len, pubkey) < 0) {
+        return -1;
+    }
+
+    uint8_t script[2 + 32];
+    size_t script_len;
+    switch (address_type) {
+        case ADDRESS_TYPE_LEGACY:
+            script[0] = OP_DUP;
+            script[1] = OP_HASH160;
+            script[2] = 0x14;
+            crypto_hash160(pubkey, 33, script + 3);
+            script[23] = OP_EQUALVERIFY;
+            script[24] = OP_CHECKSIG;
+            script_len = 3 + 20 + 2;
+            break;
+        case ADDRESS_TYPE_WIT:
+        case ADDRESS_TYPE_SH_WIT:
+            script[0] = OP_0;
+            script[1] = 0x14;
+            crypto_hash160(pubkey, 33, script + 2);
+            script_len = 2 + 20;
+
+            if (address_type == ADDRESS_TYPE_SH_WIT) {
+                // the redeem script is the P2WPKH script
+                uint8_t script_hash[20];
+                crypto_hash160(script, script_len, script_hash);
+                script[0] = OP_HASH160;
+                script[1] = 0x14;
+                memcpy(script + 2, script_hash, 20);
+                script[22] = OP_EQUAL;
+                script_len = 2 + 20 + 1;
+            }
+            break;
+        case ADDRESS_TYPE_TR: {
+            uint8_t parity;
+            script[0] = OP_1;
+            script[1] = 0x20;
+            if (crypto_tr_tweak_pubkey(pubkey + 1, &parity, script + 2) < 0) {
+                return -1;
+            }
+            script_len = 2 + 32;
+            break;
+        }
+        default:
+            return -1;
+    }
+
+    if (script_len == expected_script_len && memcmp(script, expected_script, script_len) == 0) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
@@ -14,4 +14,28 @@ int compare_wallet_script_at_path(dispatcher_context_t *dispatcher_context,
                                   const uint8_t keys_merkle_root[static 32],
                                   uint32_t n_keys,
                                   const uint8_t expected_script[],
-                                  size_t expected_script_len);
\ No newline at end of file
+                                  size_t expected_script_len);
+/**
+ * Compares a scriptPubKey with the script of a canonical single-key wallet (pkh, sh(wpkh), wpkh or
+ * tr) for our pubkey at the given path. Unlike compare_wallet_script_at_path, the key is not
+ * fetched from the client: the pubkey is derived by the device, whenever possible from an ancestor
+ * in the cache of crypto.c.
+ *
+ * @param[in] bip32_path
+ *   The full derivation path of the pubkey, including the change and the address index.
+ * @param[in] bip32_path_len
+ *   The number of steps of bip32_path.
+ * @param[in] address_type
+ *   One of ADDRESS_TYPE_LEGACY, ADDRESS_TYPE_WIT, ADDRESS_TYPE_SH_WIT or ADDRESS_TYPE_TR.
+ * @param[in] expected_script
+ *   The scriptPubKey to compare.
+ * @param[in] expected_script_len
+ *   The length of expected_script.
+ *
+ * @return 1 if the scripts are equal, 0 if they are different, -1 on error.
+ */
+int compare_canonical_script_at_path(const uint32_t bip32_path[],
+                                     uint8_t bip32_path_len,
+                                     int address_type,
+                                     const uint8_t expected_script[],
+                                     size_t expected_script_len);
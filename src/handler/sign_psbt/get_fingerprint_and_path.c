@@ -34,7 +34,7 @@ int get_fingerprint_and_path(dispatcher_context_t *dispatcher_context,
         return -1;
     }
 
-    *out_fingerprint = read_u32_le(fpt_der, 0);
+    *out_fingerprint = read_u32_be(fpt_der, 0);
 
     uint8_t *derivation_path = fpt_der + 4;
     for (int i = 0; i < bip32_path_len; i++) {
@@ -79,7 +79,7 @@ int get_emptyhashes_fingerprint_and_path(dispatcher_context_t *dispatcher_contex
         return -1;
     }
 
-    *out_fingerprint = read_u32_le(hasheslen_fpt_der, 1);
+    *out_fingerprint = read_u32_be(hasheslen_fpt_der, 1);
 
     uint8_t *derivation_path = hasheslen_fpt_der + 1 + 4;
     for (int i = 0; i < bip32_path_len; i++) {
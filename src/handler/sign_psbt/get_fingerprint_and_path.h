@@ -7,6 +7,7 @@
 /**
  * Used to read PSBT_IN_BIP32_DERIVATION or PSBT_OUT_BIP32_DERIVATION entries from a PSBT map.
  * Returns the length of the BIP32 path on success, a negative number on failure.
+ * The fingerprint is read as a big-endian number, like crypto_get_master_key_fingerprint.
  *
  * TODO: more precise docs
  */
@@ -4,13 +4,102 @@
 #include "compare_wallet_script_at_path.h"
 #include "get_fingerprint_and_path.h"
 
+#include "../lib/wallet_cache.h"
+
 #include "../../common/bip32.h"
 #include "../../common/psbt.h"
+#include "../../common/read.h"
 #include "../../common/script.h"
 #include "../../constants.h"
+#include "../../crypto.h"
 
 extern global_context_t *G_coin_config;
 
+// Compares the pubkey of a BIP32 derivation in the PSBT, that is x-only for taproot, with a
+// compressed pubkey
+static bool is_same_pubkey(const uint8_t derivation_pubkey[static 33],
+                           bool is_taproot,
+                           const uint8_t compressed_pubkey[static 33]) {
+    if (is_taproot) {
+        return memcmp(derivation_pubkey, compressed_pubkey + 1, 32) == 0;
+    } else {
+        return memcmp(derivation_pubkey, compressed_pubkey, 33) == 0;
+    }
+}
+
+/**
+ * Cheap checks on the BIP32 derivation of an output, that allow to recognize most external outputs
+ * without fetching the keys and deriving the wallet's script at the change and address index:
+ * - if the fingerprint is ours, the pubkey must be our key at that path. Our key is derived from
+ *   the parent that is kept in the cache of crypto.c, therefore this is a single CKDpub for all
+ *   the outputs after the first one;
+ * - otherwise, the wallet must have a key with that fingerprint (only known for canonical wallets,
+ *   whose only key is ours, and for the wallets in the wallet cache). For a cached key, the pubkey
+ *   must match the child of its /1 derivation, that is also computed with a single CKDpub.
+ *
+ * @return 0 if the output is definitely external, 1 if the wallet's script must be compared.
+ */
+static int is_change_output_plausible(const sign_psbt_state_t *state,
+                                      const in_out_info_t *in_out_info,
+                                      bool is_taproot,
+                                      uint32_t fingerprint,
+                                      const uint32_t bip32_path[],
+                                      int bip32_path_len) {
+    if (fingerprint == state->master_key_fingerprint) {
+        // only the pubkey is needed: neither the parent's fingerprint nor the serialization are
+        uint8_t our_pubkey[33];
+        if (bip32_path_len == 0 ||
+            crypto_cache_pubkey_at_path(bip32_path, bip32_path_len - 1) < 0 ||
+            crypto_get_pubkey_at_path(bip32_path, bip32_path_len, our_pubkey) < 0) {
+            return 1;  // let the full check decide
+        }
+        return is_same_pubkey(in_out_info->bip32_derivation_pubkey, is_taproot, our_pubkey);
+    }
+
+    if (state->is_wallet_canonical) {
+        return 0;
+    }
+
+    const wallet_cache_entry_t *cached_wallet =
+        wallet_cache_find_keys(state->wallet_header_keys_info_merkle_root,
+                               state->wallet_header_n_keys);
+    if (cached_wallet == NULL) {
+        return 1;
+    }
+
+    for (unsigned int i = 0; i < state->wallet_header_n_keys; i++) {
+        const wallet_cache_key_t *key = &cached_wallet->keys[i];
+
+        if (!key->has_key_origin || !key->has_wildcard) {
+            // the derivations of this key could have any fingerprint or path
+            return 1;
+        }
+    }
+
+    for (unsigned int i = 0; i < state->wallet_header_n_keys; i++) {
+        const wallet_cache_key_t *key = &cached_wallet->keys[i];
+
+        if (read_u32_be(key->master_key_fingerprint, 0) != fingerprint ||
+            key->master_key_derivation_len + 2 != bip32_path_len ||
+            memcmp(key->master_key_derivation,
+                   bip32_path,
+                   key->master_key_derivation_len * sizeof(bip32_path[0])) != 0) {
+            continue;
+        }
+
+        extended_pubkey_point_t child;
+        uint8_t child_pubkey[33];
+        if (bip32_CKDpub_point(&key->children[1], bip32_path[bip32_path_len - 1], &child) < 0 ||
+            crypto_get_compressed_pubkey(child.uncompressed_pubkey, child_pubkey) < 0) {
+            return 1;
+        }
+        if (is_same_pubkey(in_out_info->bip32_derivation_pubkey, is_taproot, child_pubkey)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 int is_in_out_internal(dispatcher_context_t *dispatcher_context,
                        const sign_psbt_state_t *state,
                        const in_out_info_t *in_out_info,
@@ -92,6 +181,32 @@ int is_in_out_internal(dispatcher_context_t *dispatcher_context,
         }
     }
 
+    if (!is_input && !is_change_output_plausible(state,
+                                                 in_out_info,
+                                                 script_type == SCRIPT_TYPE_P2TR,
+                                                 fingerprint,
+                                                 bip32_path,
+                                                 bip32_path_len)) {
+        PRINTF("BIP32 derivation not matching the wallet's keys\n");
+        return 0;
+    }
+
+    if (state->is_wallet_canonical && state->has_canonical_key) {
+        // the key of the wallet is ours: the script is derived directly from our pubkey at the
+        // path, that must be the change and address index of the wallet's key
+        if (bip32_path_len != state->our_key_derivation_length + 2 ||
+            memcmp(bip32_path,
+                   state->our_key_derivation,
+                   state->our_key_derivation_length * sizeof(bip32_path[0])) != 0) {
+            return 0;
+        }
+        return compare_canonical_script_at_path(bip32_path,
+                                                bip32_path_len,
+                                                state->address_type,
+                                                in_out_info->scriptPubKey,
+                                                in_out_info->scriptPubKey_len);
+    }
+
     return compare_wallet_script_at_path(dispatcher_context,
                                          change,
                                          address_index,
@@ -23,6 +23,44 @@
 #define GET_TRUSTED_INPUT_P1_FIRST 0x00
 #define GET_TRUSTED_INPUT_P1_NEXT 0x80
 
+// The first APDU starts with the list of the outputs to convert, instead of a single output index
+#define GET_TRUSTED_INPUT_P2_MULTIPLE_OUTPUTS 0x01
+
+// Reads the outputs to convert at the beginning of the first APDU, and returns the length of the
+// data read, or -1 if the list is invalid
+static int read_target_inputs(unsigned char *buffer,
+                              unsigned char length,
+                              unsigned char multipleOutputs) {
+    unsigned char count = 1;
+    unsigned char offset = 0;
+
+    if (multipleOutputs) {
+        // Number of outputs (1 byte), followed by the output indexes in increasing order
+        if (length < 1) {
+            return -1;
+        }
+        count = buffer[0];
+        offset = 1;
+        if (count == 0 || count > MAX_TRUSTED_INPUT_TARGETS) {
+            return -1;
+        }
+    }
+    if (length < offset + 4 * count) {
+        return -1;
+    }
+
+    for (unsigned char i = 0; i < count; i++) {
+        unsigned long int index = btchip_read_u32(buffer + offset, 1, 0);
+        if (i > 0 && index <= btchip_context_D.transactionTargetInputs[i - 1]) {
+            return -1;
+        }
+        btchip_context_D.transactionTargetInputs[i] = index;
+        offset += 4;
+    }
+    btchip_context_D.transactionTargetInputsCount = count;
+    return offset;
+}
+
 unsigned short btchip_apdu_get_trusted_input() {
     unsigned char apduLength;
     unsigned char dataOffset = 0;
@@ -39,25 +77,34 @@ unsigned short btchip_apdu_get_trusted_input() {
     }
 
     if (G_io_apdu_buffer[ISO_OFFSET_P1] == GET_TRUSTED_INPUT_P1_FIRST) {
+        // Only the first APDU can select the multiple outputs mode
+        if (G_io_apdu_buffer[ISO_OFFSET_P2] != 0x00 &&
+            G_io_apdu_buffer[ISO_OFFSET_P2] != GET_TRUSTED_INPUT_P2_MULTIPLE_OUTPUTS) {
+            return BTCHIP_SW_INCORRECT_P1_P2;
+        }
+
         // Initialize
-        btchip_context_D.transactionTargetInput =
-            btchip_read_u32(G_io_apdu_buffer + ISO_OFFSET_CDATA, 1, 0);
+        int targetsLength = read_target_inputs(
+            G_io_apdu_buffer + ISO_OFFSET_CDATA, apduLength,
+            G_io_apdu_buffer[ISO_OFFSET_P2] == GET_TRUSTED_INPUT_P2_MULTIPLE_OUTPUTS);
+        if (targetsLength < 0) {
+            btchip_context_D.transactionTargetInputsCount = 0;
+            return BTCHIP_SW_INCORRECT_DATA;
+        }
         btchip_context_D.transactionContext.transactionState =
             BTCHIP_TRANSACTION_NONE;
         btchip_context_D.trustedInputProcessed = 0;
         btchip_context_D.transactionContext.consumeP2SH = 0;
         btchip_set_check_internal_structure_integrity(1);
-        dataOffset = 4;
+        dataOffset = (unsigned char)targetsLength;
         btchip_context_D.transactionHashOption = TRANSACTION_HASH_FULL;
         btchip_context_D.usingSegwit = 0;
         btchip_context_D.usingOverwinter = 0;
-    } else if (G_io_apdu_buffer[ISO_OFFSET_P1] != GET_TRUSTED_INPUT_P1_NEXT) {
+    } else if (G_io_apdu_buffer[ISO_OFFSET_P1] != GET_TRUSTED_INPUT_P1_NEXT ||
+               G_io_apdu_buffer[ISO_OFFSET_P2] != 0x00) {
         return BTCHIP_SW_INCORRECT_P1_P2;
     }
 
-    if (G_io_apdu_buffer[ISO_OFFSET_P2] != 0x00) {
-        return BTCHIP_SW_INCORRECT_P1_P2;
-    }
     btchip_context_D.transactionBufferPointer =
         G_io_apdu_buffer + ISO_OFFSET_CDATA + dataOffset;
     btchip_context_D.transactionDataRemaining = apduLength - dataOffset;
@@ -66,33 +113,46 @@ unsigned short btchip_apdu_get_trusted_input() {
 
     if (btchip_context_D.transactionContext.transactionState ==
         BTCHIP_TRANSACTION_PARSED) {
+        unsigned char hash[32];
+        unsigned char txid[32];
 
         btchip_context_D.transactionContext.transactionState =
             BTCHIP_TRANSACTION_NONE;
         btchip_set_check_internal_structure_integrity(1);
-        if (!btchip_context_D.trustedInputProcessed) {
-            // Output was not found
+        if (btchip_context_D.trustedInputProcessed == 0 ||
+            btchip_context_D.trustedInputProcessed !=
+                btchip_context_D.transactionTargetInputsCount) {
+            // Some output was not found
             return BTCHIP_SW_INCORRECT_DATA;
         }
 
         cx_hash(&btchip_context_D.transactionHashFull.sha256.header, CX_LAST,
-                (unsigned char *)NULL, 0, G_io_apdu_buffer + TRUSTED_INPUT_SIZE, 32);
-
-        // Otherwise prepare
-        cx_rng(G_io_apdu_buffer, 8);
-        G_io_apdu_buffer[0] = MAGIC_TRUSTED_INPUT;
-        G_io_apdu_buffer[1] = 0x00;
-        cx_hash_sha256(G_io_apdu_buffer + TRUSTED_INPUT_SIZE, 32, G_io_apdu_buffer + 4, 32);
-
-        btchip_write_u32_le(G_io_apdu_buffer + 4 + 32,
-                            btchip_context_D.transactionTargetInput);
-        os_memmove(G_io_apdu_buffer + 4 + 32 + 4,
-                   btchip_context_D.transactionContext.transactionAmount, 8);
-
-        cx_hmac_sha256((uint8_t *)N_btchip.bkp.trustedinput_key,
-                       sizeof(N_btchip.bkp.trustedinput_key), G_io_apdu_buffer,
-                       TRUSTED_INPUT_SIZE, G_io_apdu_buffer + TRUSTED_INPUT_SIZE, 32);
-        btchip_context_D.outLength = TRUSTED_INPUT_TOTAL_SIZE;
+                (unsigned char *)NULL, 0, hash, 32);
+        cx_hash_sha256(hash, 32, txid, 32);
+
+        // Otherwise prepare a trusted input for each output, in the order of the request
+        for (unsigned char i = 0; i < btchip_context_D.transactionTargetInputsCount; i++) {
+            unsigned char *trustedInput = G_io_apdu_buffer + i * TRUSTED_INPUT_TOTAL_SIZE;
+            unsigned char hmac[32];
+
+            cx_rng(trustedInput, 8);
+            trustedInput[0] = MAGIC_TRUSTED_INPUT;
+            trustedInput[1] = 0x00;
+            os_memmove(trustedInput + 4, txid, 32);
+
+            btchip_write_u32_le(trustedInput + 4 + 32,
+                                btchip_context_D.transactionTargetInputs[i]);
+            os_memmove(trustedInput + 4 + 32 + 4,
+                       btchip_context_D.trustedInputAmounts[i], 8);
+
+            cx_hmac_sha256((uint8_t *)N_btchip.bkp.trustedinput_key,
+                           sizeof(N_btchip.bkp.trustedinput_key), trustedInput,
+                           TRUSTED_INPUT_SIZE, hmac, 32);
+            os_memmove(trustedInput + TRUSTED_INPUT_SIZE, hmac,
+                       TRUSTED_INPUT_TOTAL_SIZE - TRUSTED_INPUT_SIZE);
+        }
+        btchip_context_D.outLength =
+            btchip_context_D.transactionTargetInputsCount * TRUSTED_INPUT_TOTAL_SIZE;
     }
     return BTCHIP_SW_OK;
 }
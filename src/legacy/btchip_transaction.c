@@ -771,16 +771,20 @@ void transaction_parse(unsigned char parseMode) {
                     }
                     // Amount
                     check_transaction_available(8);
+                    // The targets are sorted, so only the next one can match
                     if ((parseMode == PARSE_MODE_TRUSTED_INPUT) &&
+                        (btchip_context_D.trustedInputProcessed <
+                         btchip_context_D.transactionTargetInputsCount) &&
                         (btchip_context_D.transactionContext
                              .transactionCurrentInputOutput ==
-                         btchip_context_D.transactionTargetInput)) {
+                         btchip_context_D.transactionTargetInputs
+                             [btchip_context_D.trustedInputProcessed])) {
                         // Save the amount
-                        os_memmove(btchip_context_D.transactionContext
-                                       .transactionAmount,
+                        os_memmove(btchip_context_D.trustedInputAmounts
+                                       [btchip_context_D.trustedInputProcessed],
                                    btchip_context_D.transactionBufferPointer,
                                    8);
-                        btchip_context_D.trustedInputProcessed = 1;
+                        btchip_context_D.trustedInputProcessed++;
                     }
                     transaction_offset_increase(8);
                     // Read the script length
@@ -29,6 +29,9 @@
 #define MAX_SHORT_COIN_ID 5
 
 #define MAGIC_TRUSTED_INPUT 0x32
+// Maximum number of outputs of the same transaction converted by a single GET_TRUSTED_INPUT; the
+// trusted inputs of all of them must fit in the response APDU
+#define MAX_TRUSTED_INPUT_TARGETS 4
 #define MAGIC_DEV_KEY 0x01
 
 #define ZCASH_USING_OVERWINTER 0x01
@@ -192,10 +195,14 @@ struct btchip_context_s {
     unsigned char transactionDataRemaining;
     /** Current pointer to the transaction buffer for the transaction parser */
     unsigned char *transactionBufferPointer;
-    /** Trusted Input index processed */
+    /** Number of outputs of transactionTargetInputs already processed */
     unsigned char trustedInputProcessed;
-    /** Transaction input to catch for a Trusted Input lookup */
-    unsigned long int transactionTargetInput;
+    /** Number of outputs to catch for a Trusted Input lookup */
+    unsigned char transactionTargetInputsCount;
+    /** Outputs to catch for a Trusted Input lookup, in increasing order */
+    unsigned long int transactionTargetInputs[MAX_TRUSTED_INPUT_TARGETS];
+    /** Values of the outputs of transactionTargetInputs already processed */
+    unsigned char trustedInputAmounts[MAX_TRUSTED_INPUT_TARGETS][8];
 
     /** Length of the incoming command */
     unsigned short inLength;
@@ -32,6 +32,8 @@
 #include "boilerplate/dispatcher.h"
 
 #include "commands.h"
+#include "crypto.h"
+#include "debug-helpers/stack_profiler.h"
 
 // common declarations between legacy and new code; will refactor it out later
 #include "legacy/include/btchip_context.h"
@@ -114,16 +116,43 @@ const command_descriptor_t COMMAND_DESCRIPTORS[] = {
         .ins = SIGN_PSBT,
         .handler = (command_handler_t)handler_sign_psbt
     },
+    {
+        .cla = CLA_APP,
+        .ins = SIGN_PSBT_BATCHED,
+        .handler = (command_handler_t)handler_sign_psbt_batched
+    },
+    {
+        .cla = CLA_APP,
+        .ins = RESUME_SIGN_PSBT,
+        .handler = (command_handler_t)handler_resume_sign_psbt
+    },
     {
         .cla = CLA_APP,
         .ins = GET_MASTER_FINGERPRINT,
         .handler = (command_handler_t)handler_get_master_fingerprint
     },
+    {
+        .cla = CLA_APP,
+        .ins = GET_EXTENDED_PUBKEYS,
+        .handler = (command_handler_t)handler_get_extended_pubkeys
+    },
     {
         .cla = CLA_APP,
         .ins = SIGN_MESSAGE,
         .handler = (command_handler_t)handler_sign_message
     },
+    {
+        .cla = CLA_APP,
+        .ins = SIGN_MESSAGE_STREAMED,
+        .handler = (command_handler_t)handler_sign_message_streamed
+    },
+#ifdef HAVE_STACK_PROFILER
+    {
+        .cla = CLA_APP,
+        .ins = GET_STACK_PROFILE,
+        .handler = (command_handler_t)handler_get_stack_profile
+    },
+#endif
 };
 // clang-format on
 
@@ -180,6 +209,8 @@ void init_coin_config(btchip_altcoin_config_t *coin_config) {
 }
 
 void app_main() {
+    STACK_PROFILER_INIT();
+
     for (;;) {
         // Length of APDU command received in G_io_apdu_buffer
         int input_len = 0;
@@ -198,6 +229,9 @@ void app_main() {
             return;
         }
 
+        // the previous command (including its UX flows) is completed when the next APDU arrives
+        STACK_PROFILER_END_COMMAND();
+
 #ifndef DISABLE_LEGACY_SUPPORT
         if (G_io_apdu_buffer[0] == CLA_APP_LEGACY) {
             if (G_app_mode != APP_MODE_LEGACY) {
@@ -263,6 +297,10 @@ void app_main() {
                 return;
             }
 
+            if (cmd.cla != CLA_FRAMEWORK) {
+                STACK_PROFILER_BEGIN_COMMAND(cmd.ins);
+            }
+
             // Dispatch structured APDU command to handler
             apdu_dispatcher(COMMAND_DESCRIPTORS,
                             sizeof(COMMAND_DESCRIPTORS) / sizeof(COMMAND_DESCRIPTORS[0]),
@@ -285,6 +323,9 @@ void app_main() {
  * Exit the application and go back to the dashboard.
  */
 void app_exit() {
+    crypto_clear_cache();
+    sign_psbt_clear_session();
+
     BEGIN_TRY_L(exit) {
         TRY_L(exit) {
             os_sched_exit(-1);
@@ -313,6 +354,14 @@ void coin_main(btchip_altcoin_config_t *coin_config) {
     _Static_assert(sizeof(cx_sha256_t) <= 108, "cx_sha256_t too large");
     _Static_assert(sizeof(policy_map_key_info_t) <= 148, "policy_map_key_info_t too large");
 
+#ifdef TARGET_NANOS
+    // the new globals overlap the legacy ones (see script-nanos.ld); as long as they are not
+    // larger, they do not take any RAM from the 4.5 KB that are shared with the stack
+    _Static_assert(
+        sizeof(command_state_t) + sizeof(dispatcher_context_t) <= sizeof(btchip_context_t),
+        "command_state_t too large");
+#endif
+
     G_app_mode = APP_MODE_UNINITIALIZED;
 
     btchip_altcoin_config_t config;
@@ -7,6 +7,7 @@ import json
 from typing import Literal, Union
 
 from . import default_settings, SpeculosGlobals
+from .transcript import RecordingTransport
 
 from bitcoin_client.ledger_bitcoin import TransportClient, Client, Chain, createClient
 
@@ -22,6 +23,9 @@ BITCOIN_APP_BINARY: the full path and file name of the app's binary to use. Defa
 
 BITCOIN_APP_LIB_BINARY: the full path and file name of binary to use as Bitcoin library in speculos.
                         If omitted no library is used in speculos.
+
+If the --record-apdus=<folder> option is given, the APDUs exchanged by the `client` fixture are saved in
+<folder>/<test name>.json; see transcript.py.
 """
 
 
@@ -52,6 +56,7 @@ def pytest_addoption(parser):
     parser.addoption("--hid", action="store_true")
     parser.addoption("--headless", action="store_true")
     parser.addoption("--enableslowtests", action="store_true")
+    parser.addoption("--record-apdus", action="store", default=None)
 
 
 @pytest.fixture(scope="module")
@@ -155,7 +160,7 @@ def bitcoin_network() -> Union[Literal['main'], Literal['test']]:
 
 
 @pytest.fixture
-def client(bitcoin_network: str, comm: Union[TransportClient, SpeculosClient]) -> Client:
+def client(request, bitcoin_network: str, comm: Union[TransportClient, SpeculosClient]) -> Client:
     if bitcoin_network == "main":
         chain = Chain.MAIN
     elif bitcoin_network == "test":
@@ -163,7 +168,17 @@ def client(bitcoin_network: str, comm: Union[TransportClient, SpeculosClient]) -
     else:
         raise ValueError(
             f'Invalid value for BITCOIN_NETWORK: {bitcoin_network}')
-    return createClient(comm, chain=chain, debug=True)
+
+    record_apdus_dir = request.config.getoption("record_apdus")
+    if record_apdus_dir is None:
+        yield createClient(comm, chain=chain, debug=True)
+        return
+
+    recorder = RecordingTransport(comm)
+    yield createClient(recorder, chain=chain, debug=True)
+
+    os.makedirs(record_apdus_dir, exist_ok=True)
+    recorder.transcript.save(Path(record_apdus_dir) / f"{request.node.name}.json")
 
 
 @pytest.fixture
@@ -0,0 +1,114 @@
+"""
+Transport running the host build of the app (unit-tests/libapp) in-process, through ctypes.
+
+The library is built with the unit tests; use the same target as the device the results are compared with, for
+example for Nano S:
+
+    cd unit-tests && cmake -Bbuild -H. -DCMAKE_C_FLAGS=-DTARGET_NANOS && make -C build libapp_shared
+
+The app runs the same code as on the device, and every UX flow is approved; therefore, the exchanged APDUs are the same
+as with Speculos, but the timings are meaningless. The app (including the wallet cache) is reset when the transport is
+created.
+"""
+
+import ctypes
+import queue
+import threading
+
+from pathlib import Path
+from typing import Optional, Tuple, Union
+
+from bitcoin_client.ledger_bitcoin.client_base import ApduException
+
+DEFAULT_LIBAPP_PATH = Path(__file__).parent.parent / "unit-tests" / "build" / "libapp" / "libapp.so"
+
+LIBAPP_MAX_APDU_LENGTH = 5 + 255
+
+CLA_FRAMEWORK = 0xF8
+INS_CONTINUE = 0x01
+
+SW_OK = 0x9000
+SW_INTERRUPTED_EXECUTION = 0xE000
+
+LIBAPP_RESPONDER = ctypes.CFUNCTYPE(
+    ctypes.c_int, ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint8), ctypes.c_size_t, ctypes.POINTER(ctypes.c_uint8))
+
+
+class LibappTransport:
+    """
+    Transport with the same interface as TransportClient, where the APDUs are processed by the host build of the app.
+
+    libapp_exchange processes a command to completion, and answers the client commands with a callback; it runs in a
+    separate thread, so that each client command is returned to the client as a SW_INTERRUPTED_EXECUTION response,
+    and the callback waits for the CONTINUE_INTERRUPTED APDU.
+    """
+
+    def __init__(self, mnemonic: str, library_path: Union[str, Path] = DEFAULT_LIBAPP_PATH) -> None:
+        self.lib = ctypes.CDLL(str(library_path))
+        self.lib.libapp_init_from_mnemonic.argtypes = [ctypes.c_char_p]
+        self.lib.libapp_exchange.argtypes = [
+            ctypes.c_char_p, ctypes.c_size_t, LIBAPP_RESPONDER, ctypes.c_void_p,
+            ctypes.POINTER(ctypes.c_uint8), ctypes.c_size_t]
+        self.lib.libapp_exchange.restype = ctypes.c_int
+
+        self.lib.libapp_init_from_mnemonic(mnemonic.encode())
+
+        # kept alive as long as the library might call it
+        self._responder = LIBAPP_RESPONDER(self._respond)
+
+        self._thread: Optional[threading.Thread] = None
+        # ("request", data) for each client command, then ("response", (sw, data)) once the command is complete
+        self._events: "queue.Queue[Tuple[str, object]]" = queue.Queue()
+        # data of each CONTINUE_INTERRUPTED APDU, or None if the command is abandoned
+        self._continuations: "queue.Queue[Optional[bytes]]" = queue.Queue()
+
+    def _respond(self, ctx, request, request_len: int, response) -> int:
+        self._events.put(("request", bytes(request[:request_len])))
+
+        data = self._continuations.get()
+        if data is None:
+            return -1
+
+        ctypes.memmove(response, data, len(data))
+        return len(data)
+
+    def _run(self, apdu: bytes) -> None:
+        out = (ctypes.c_uint8 * LIBAPP_MAX_APDU_LENGTH)()
+        res = self.lib.libapp_exchange(apdu, len(apdu), self._responder, None, out, len(out))
+        if res < 2:
+            self._events.put(("error", res))
+        else:
+            response = bytes(out[:res])
+            self._events.put(("response", (int.from_bytes(response[-2:], byteorder="big"), response[:-2])))
+
+    def apdu_exchange(self, cla: int, ins: int, data: bytes = b"", p1: int = 0, p2: int = 0) -> bytes:
+        if self._thread is not None:
+            if cla != CLA_FRAMEWORK or ins != INS_CONTINUE:
+                raise RuntimeError("A command is in progress: only CONTINUE_INTERRUPTED is expected")
+            self._continuations.put(data)
+        else:
+            apdu = bytes([cla, ins, p1, p2, len(data)]) + data
+            self._thread = threading.Thread(target=self._run, args=(apdu,), daemon=True)
+            self._thread.start()
+
+        kind, value = self._events.get()
+        if kind == "request":
+            raise ApduException(SW_INTERRUPTED_EXECUTION, value)
+
+        self._thread.join()
+        self._thread = None
+
+        if kind == "error":
+            raise RuntimeError(f"libapp_exchange failed with error {value}")
+
+        sw, response = value
+        if sw != SW_OK:
+            raise ApduException(sw, response)
+        return response
+
+    def stop(self) -> None:
+        if self._thread is not None:
+            # abandons the command in progress
+            self._continuations.put(None)
+            self._thread.join()
+            self._thread = None
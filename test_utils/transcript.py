@@ -0,0 +1,200 @@
+"""
+Recording and replay of APDU transcripts.
+
+RecordingTransport wraps a TransportClient (or a SpeculosClient) and captures every APDU exchanged with the device,
+together with its timestamp and round-trip time.
+
+ReplayTransport answers the APDUs of a client from a recorded transcript, without any device or emulator. As the app's
+behavior only depends on the APDUs it receives, a client repeating the same operation with the same inputs produces
+exactly the same APDUs; this allows to profile the host side of the protocol (client command interpreter,
+merkleization, PSBT conversion) in isolation.
+
+Transcripts are stored as JSON; they can be converted to the textual format used by dev-tools/tag_apdus.py with
+Transcript.to_text, and analyzed with dev-tools/analyze_apdus.py.
+"""
+
+import json
+import time
+
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Dict, List, Optional, Union
+
+from bitcoin_client.ledger_bitcoin.client_base import ApduException
+
+TRANSCRIPT_VERSION = 1
+
+SW_OK = 0x9000
+
+
+def serialize_apdu(cla: int, ins: int, p1: int, p2: int, data: bytes) -> bytes:
+    return bytes([cla, ins, p1, p2, len(data)]) + data
+
+
+@dataclass
+class Exchange:
+    """A single APDU, and the corresponding response of the device."""
+
+    apdu: bytes
+    response: bytes  # response data, without the status word
+    sw: int
+    t_sent: float = 0.0  # seconds since the beginning of the recording
+    rtt: float = 0.0  # round-trip time, in seconds
+
+    def to_dict(self) -> dict:
+        return {
+            "apdu": self.apdu.hex(),
+            "response": (self.response + self.sw.to_bytes(2, byteorder="big")).hex(),
+            "t_sent": round(self.t_sent, 6),
+            "rtt": round(self.rtt, 6),
+        }
+
+    @classmethod
+    def from_dict(cls, d: dict) -> 'Exchange':
+        response_raw = bytes.fromhex(d["response"])
+        if len(response_raw) < 2:
+            raise ValueError("Invalid response: missing status word")
+
+        return cls(
+            apdu=bytes.fromhex(d["apdu"]),
+            response=response_raw[:-2],
+            sw=int.from_bytes(response_raw[-2:], byteorder="big"),
+            t_sent=d.get("t_sent", 0.0),
+            rtt=d.get("rtt", 0.0),
+        )
+
+
+@dataclass
+class Transcript:
+    exchanges: List[Exchange] = field(default_factory=list)
+    started_at: float = 0.0  # unix time of the beginning of the recording
+
+    def to_dict(self) -> dict:
+        return {
+            "version": TRANSCRIPT_VERSION,
+            "started_at": self.started_at,
+            "exchanges": [e.to_dict() for e in self.exchanges],
+        }
+
+    @classmethod
+    def from_dict(cls, d: dict) -> 'Transcript':
+        if d.get("version") != TRANSCRIPT_VERSION:
+            raise ValueError(f"Unsupported transcript version: {d.get('version')}")
+
+        return cls(
+            exchanges=[Exchange.from_dict(e) for e in d["exchanges"]],
+            started_at=d.get("started_at", 0.0),
+        )
+
+    def save(self, path: Union[str, Path]) -> None:
+        Path(path).write_text(json.dumps(self.to_dict(), indent=1) + "\n")
+
+    @classmethod
+    def load(cls, path: Union[str, Path]) -> 'Transcript':
+        return cls.from_dict(json.loads(Path(path).read_text()))
+
+    def to_text(self) -> str:
+        """Returns the transcript in the format expected by dev-tools/tag_apdus.py."""
+        lines: List[str] = []
+        for e in self.exchanges:
+            lines.append(f"=> {e.apdu.hex()}")
+            lines.append(f"<= {(e.response + e.sw.to_bytes(2, byteorder='big')).hex()}")
+        return "\n".join(lines) + "\n"
+
+
+class RecordingTransport:
+    """Wraps a TransportClient (or a SpeculosClient), recording all the exchanged APDUs."""
+
+    def __init__(self, transport) -> None:
+        self.transport = transport
+        self.clear()
+
+    def clear(self) -> None:
+        """Forgets all the recorded APDUs, and restarts the clock of the recording."""
+        self.transcript = Transcript(started_at=time.time())
+        self._t0 = time.perf_counter()
+
+    def apdu_exchange(self, cla: int, ins: int, data: bytes = b"", p1: int = 0, p2: int = 0) -> bytes:
+        apdu = serialize_apdu(cla, ins, p1, p2, data)
+
+        t_sent = time.perf_counter()
+        try:
+            response = self.transport.apdu_exchange(cla, ins, data, p1, p2)
+        except ApduException as e:
+            self._record(apdu, e.data, e.sw, t_sent)
+            raise
+
+        self._record(apdu, response, SW_OK, t_sent)
+        return response
+
+    def _record(self, apdu: bytes, response: bytes, sw: int, t_sent: float) -> None:
+        rtt = time.perf_counter() - t_sent
+        self.transcript.exchanges.append(Exchange(apdu, response, sw, t_sent - self._t0, rtt))
+
+    def stop(self) -> None:
+        self.transport.stop()
+
+
+class ReplayMismatchError(Exception):
+    def __init__(self, index: int, expected: Optional[bytes], actual: bytes) -> None:
+        expected_str = expected.hex() if expected is not None else "end of transcript"
+        super().__init__(f"APDU #{index} does not match the transcript: expected {expected_str}, got {actual.hex()}")
+        self.index = index
+        self.expected = expected
+        self.actual = actual
+
+
+class ReplayTransport:
+    """
+    Transport that answers the APDUs from a recorded transcript, with the same interface as TransportClient.
+
+    In strict mode (the default), the i-th APDU must be identical to the i-th APDU of the transcript. Otherwise, each
+    APDU is answered with the first unused response recorded for an identical APDU, which tolerates a different
+    interleaving of independent requests.
+    """
+
+    def __init__(self, transcript: Transcript, strict: bool = True) -> None:
+        self.transcript = transcript
+        self.strict = strict
+        self.rewind()
+
+    @classmethod
+    def load(cls, path: Union[str, Path], strict: bool = True) -> 'ReplayTransport':
+        return cls(Transcript.load(path), strict)
+
+    def rewind(self) -> None:
+        """Restarts the replay from the beginning of the transcript."""
+        self.index = 0
+        self._pending: Dict[bytes, List[Exchange]] = {}
+        if not self.strict:
+            for e in self.transcript.exchanges:
+                self._pending.setdefault(e.apdu, []).append(e)
+
+    @property
+    def is_complete(self) -> bool:
+        """True if all the APDUs of the transcript were replayed."""
+        return self.index == len(self.transcript.exchanges)
+
+    def apdu_exchange(self, cla: int, ins: int, data: bytes = b"", p1: int = 0, p2: int = 0) -> bytes:
+        apdu = serialize_apdu(cla, ins, p1, p2, data)
+
+        if self.strict:
+            if self.index >= len(self.transcript.exchanges):
+                raise ReplayMismatchError(self.index, None, apdu)
+            exchange = self.transcript.exchanges[self.index]
+            if exchange.apdu != apdu:
+                raise ReplayMismatchError(self.index, exchange.apdu, apdu)
+        else:
+            candidates = self._pending.get(apdu, [])
+            if len(candidates) == 0:
+                raise ReplayMismatchError(self.index, None, apdu)
+            exchange = candidates.pop(0)
+
+        self.index += 1
+
+        if exchange.sw != SW_OK:
+            raise ApduException(exchange.sw, exchange.response)
+        return exchange.response
+
+    def stop(self) -> None:
+        pass
@@ -1,3 +1,4 @@
+import re
 from random import randint
 
 from typing import List, Tuple, Optional
@@ -16,6 +17,8 @@ SPECULOS_SEED = "glory promote mansion idle axis finger extra february uncover o
 master_key = HDKey.from_seed(mnemonic_to_seed(SPECULOS_SEED))
 master_key_fpr = master_key.derive("m/0'").fingerprint
 
+MULTISIG_POLICY_RE = re.compile(r"^wsh\((sorted)?multi\(\d+(,@\d+)+\)\)$")
+
 
 def random_numbers_with_sum(n: int, s: int) -> List[int]:
     """Returns a list of n random numbers with sum s."""
@@ -40,7 +43,7 @@ def random_txid() -> bytes:
     return random_bytes(32)
 
 
-def getScriptPubkeyFromWallet(wallet: PolicyMapWallet, change: bool, address_index: int) -> Script:
+def getDescriptorFromWallet(wallet: PolicyMapWallet, change: bool) -> Descriptor:
     descriptor_str = wallet.policy_map
 
     # Iterate in reverse order, as strings identifying a small-index key (like @1) can be a
@@ -57,7 +60,24 @@ def getScriptPubkeyFromWallet(wallet: PolicyMapWallet, change: bool, address_ind
 
         descriptor_str = descriptor_str.replace(f"@{i}", key_info_str)
 
-    return Descriptor.from_string(descriptor_str).derive(address_index).script_pubkey()
+    return Descriptor.from_string(descriptor_str)
+
+
+def getScriptPubkeyFromWallet(wallet: PolicyMapWallet, change: bool, address_index: int) -> Script:
+    return getDescriptorFromWallet(wallet, change).derive(address_index).script_pubkey()
+
+
+def getDerivedKeysFromWallet(wallet: PolicyMapWallet, change: bool, address_index: int) -> List[Tuple[bytes, KeyOriginInfo]]:
+    """Returns the compressed pubkey and the key origin of each key of the wallet, derived at change/address_index."""
+    result: List[Tuple[bytes, KeyOriginInfo]] = []
+    for key_info_str in wallet.keys_info:
+        origin, xpub = key_info_str[1:-3].split("]")
+        fpr_hex, *origin_steps = origin.split("/")
+
+        pubkey: bytes = HDKey.from_string(xpub).derive([int(change), address_index]).key.sec()
+        path = parse_path("/".join(origin_steps + [str(int(change)), str(address_index)]))
+        result.append((pubkey, KeyOriginInfo(bytes.fromhex(fpr_hex), path)))
+    return result
 
 
 def createFakeWalletTransaction(n_inputs: int, n_outputs: int, output_amount: int, wallet: PolicyMapWallet) -> Tuple[CTransaction, int, int, int]:
@@ -123,11 +143,11 @@ def createPsbt(wallet: PolicyMapWallet, input_amounts: List[int], output_amounts
     assert len(output_amounts) == len(output_wallet)
     assert sum(output_amounts) <= sum(input_amounts)
 
-    # TODO: add support for wrapped segwit wallets
+    is_multisig = MULTISIG_POLICY_RE.match(wallet.policy_map) is not None
 
-    if wallet.n_keys != 1:
-        raise NotImplementedError("Only 1-key wallets supported")
-    if wallet.policy_map not in ["pkh(@0)", "wpkh(@0)", "tr(@0)"]:
+    if wallet.n_keys != 1 and not is_multisig:
+        raise NotImplementedError("Only 1-key wallets or wsh multisig wallets supported")
+    if wallet.policy_map not in ["pkh(@0)", "wpkh(@0)", "sh(wpkh(@0))", "tr(@0)"] and not is_multisig:
         raise NotImplementedError("Unsupported policy type")
 
     vin: List[CTxIn] = [CTxIn() for _ in input_amounts]
@@ -165,12 +185,10 @@ def createPsbt(wallet: PolicyMapWallet, input_amounts: List[int], output_amounts
 
     # simplification; good enough for the scripts we support now, but will need more work
     is_legacy = wallet.policy_map.startswith("pkh(")
-    is_segwitv0 = wallet.policy_map.startswith(
-        "wpkh(") or wallet.policy_map.startswith("sh(wpkh(")
+    is_wrapped = wallet.policy_map.startswith("sh(wpkh(")
+    is_segwitv0 = wallet.policy_map.startswith("wpkh(") or is_wrapped or is_multisig
     is_taproot = wallet.policy_map.startswith("tr(")
 
-    key_origin = wallet.keys_info[0][1:wallet.keys_info[0].index("]")]
-
     for i in range(len(input_amounts)):
         if is_legacy or is_segwitv0:
             # add non-witness UTXO
@@ -179,22 +197,23 @@ def createPsbt(wallet: PolicyMapWallet, input_amounts: List[int], output_amounts
             # add witness UTXO
             psbt.inputs[i].witness_utxo = prevouts[i].vout[prevout_ns[i]]
 
-        path_str = f"m{key_origin[8:]}/{prevout_path_change[i]}/{prevout_path_addr_idx[i]}"
-        path = parse_path(path_str)
-        input_key: bytes = master_key.derive(path_str).key.sec()
-
-        assert len(input_key) == 33
+        desc = getDescriptorFromWallet(wallet, prevout_path_change[i]).derive(prevout_path_addr_idx[i])
+        if is_wrapped:
+            psbt.inputs[i].redeem_script = desc.redeem_script().data
+        if is_multisig:
+            psbt.inputs[i].witness_script = desc.witness_script().data
 
         # add key and path info
-        if is_legacy or is_segwitv0:
-            psbt.inputs[i].hd_keypaths[input_key] = KeyOriginInfo(
-                master_key_fpr, path)
-        elif is_taproot:
-            tweaked_key = get_taproot_output_key(input_key)
-            psbt.inputs[i].tap_bip32_paths[tweaked_key] = (
-                list(), KeyOriginInfo(master_key_fpr, path))
-        else:
-            raise RuntimeError("Unexpected state: unknown transaction type")
+        for input_key, key_origin in getDerivedKeysFromWallet(wallet, prevout_path_change[i], prevout_path_addr_idx[i]):
+            assert len(input_key) == 33
+
+            if is_legacy or is_segwitv0:
+                psbt.inputs[i].hd_keypaths[input_key] = key_origin
+            elif is_taproot:
+                tweaked_key = get_taproot_output_key(input_key)
+                psbt.inputs[i].tap_bip32_paths[tweaked_key] = (list(), key_origin)
+            else:
+                raise RuntimeError("Unexpected state: unknown transaction type")
 
     for i, output_amount in enumerate(output_amounts):
         wallet_i = output_wallet[i]
@@ -207,21 +226,19 @@ def createPsbt(wallet: PolicyMapWallet, input_amounts: List[int], output_amounts
         tx.vout[i].nValue = output_amount
 
         if output_is_change[i]:
-            path_str = f"m{key_origin[8:]}/1/{i}"
-            path = parse_path(path_str)
-            output_key: bytes = master_key.derive(path_str).key.sec()
+            desc = getDescriptorFromWallet(wallet, 1).derive(i)
+            if is_wrapped:
+                psbt.outputs[i].redeem_script = desc.redeem_script().data
+            if is_multisig:
+                psbt.outputs[i].witness_script = desc.witness_script().data
 
             # add key and path information for change output
-            if is_legacy or is_segwitv0:
-                psbt.outputs[i].hd_keypaths[output_key] = KeyOriginInfo(
-                    master_key_fpr, path)
-            elif is_taproot:
-                tweaked_key = get_taproot_output_key(output_key)
-                psbt.outputs[i].tap_bip32_paths[tweaked_key] = (
-                    list(), KeyOriginInfo(master_key_fpr, path))
-
-                psbt.outputs[i].tap_bip32_paths[tweaked_key] = (
-                    list(), KeyOriginInfo(master_key_fpr, path))
+            for output_key, key_origin in getDerivedKeysFromWallet(wallet, 1, i):
+                if is_legacy or is_segwitv0:
+                    psbt.outputs[i].hd_keypaths[output_key] = key_origin
+                elif is_taproot:
+                    tweaked_key = get_taproot_output_key(output_key)
+                    psbt.outputs[i].tap_bip32_paths[tweaked_key] = (list(), key_origin)
 
     psbt.tx = tx
 
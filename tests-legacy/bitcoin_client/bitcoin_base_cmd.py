@@ -202,6 +202,51 @@ class BitcoinBaseCommand:
             if sw != 0x9000:
                 raise DeviceException(error_code=sw, ins=InsType.GET_TRUSTED_INPUT)
 
+        self._check_trusted_input(response, utxo, output_index)
+
+        return response
+
+    def get_trusted_inputs(self,
+                           utxo: CTransaction,
+                           output_indexes: List[int]) -> List[bytes]:
+        """Get the trusted inputs of several outputs of the same UTXO, parsing it once.
+
+        Parameters
+        ----------
+        utxo : CTransaction
+            Serialized Bitcoin transaction to extract UTXO.
+        output_indexes : List[int]
+            Indexes of the UTXO to build the trusted inputs, in increasing order.
+
+        Returns
+        -------
+        List[bytes]
+            Serialized trusted inputs, in the same order as output_indexes.
+
+        """
+        sw: int
+        response: bytes = b""
+
+        for chunk in self.builder.get_trusted_inputs(utxo, output_indexes):
+            self.transport.send_raw(chunk)
+            sw, response = self.transport.recv()  # type: int, bytes
+
+            if sw != 0x9000:
+                raise DeviceException(error_code=sw, ins=InsType.GET_TRUSTED_INPUT)
+
+        assert len(response) == 56 * len(output_indexes)
+
+        trusted_inputs: List[bytes] = [response[i * 56:(i + 1) * 56]
+                                       for i in range(len(output_indexes))]
+        for trusted_input, output_index in zip(trusted_inputs, output_indexes):
+            self._check_trusted_input(trusted_input, utxo, output_index)
+
+        return trusted_inputs
+
+    @staticmethod
+    def _check_trusted_input(response: bytes,
+                             utxo: CTransaction,
+                             output_index: int) -> None:
         # response = 0x32 (1) || 0x00 (1) || random (2) || prev_txid (32) ||
         #            output_index (4) || amount (8) || HMAC (8)
         assert len(response) == 56
@@ -231,8 +276,6 @@ class BitcoinBaseCommand:
 
         assert offset == len(response)
 
-        return response
-
     def untrusted_hash_tx_input_start(self,
                                       tx: CTransaction,
                                       inputs: List[Tuple[CTransaction, bytes]],
@@ -200,15 +200,47 @@ class BitcoinCommandBuilder:
             APDU command chunk for GET_TRUSTED_INPUT.
 
         """
+        cdata: bytes = (output_index.to_bytes(4, byteorder="big") +
+                        utxo.serialize_without_witness())
+
+        yield from self._get_trusted_input_chunks(cdata=cdata, p2=0x00)
+
+    def get_trusted_inputs(self,
+                           utxo: CTransaction,
+                           output_indexes: List[int]) -> Iterator[bytes]:
+        """Command builder for GET_TRUSTED_INPUT with several outputs of the same UTXO.
+
+        Parameters
+        ----------
+        utxo: CTransaction
+            Unspent Transaction Output (UTXO) serialized.
+        output_indexes: List[int]
+            Output indexes owned in the UTXO, in increasing order.
+
+        Yields
+        ------
+        bytes
+            APDU command chunk for GET_TRUSTED_INPUT.
+
+        """
+        cdata: bytes = (len(output_indexes).to_bytes(1, byteorder="big") +
+                        b"".join(output_index.to_bytes(4, byteorder="big")
+                                 for output_index in output_indexes) +
+                        utxo.serialize_without_witness())
+
+        yield from self._get_trusted_input_chunks(cdata=cdata, p2=0x01)
+
+    def _get_trusted_input_chunks(self,
+                                  cdata: bytes,
+                                  p2: int) -> Iterator[bytes]:
         ins: InsType = InsType.GET_TRUSTED_INPUT
         # P1:
         # - 0x00, first transaction data chunk
         # - 0x80, other transaction data chunk
+        # P2 (first chunk only, 0x00 for the other chunks):
+        # - 0x00, the first chunk starts with a single output index
+        # - 0x01, the first chunk starts with a list of output indexes
         p1: int
-        p2: int = 0x00
-
-        cdata: bytes = (output_index.to_bytes(4, byteorder="big") +
-                        utxo.serialize_without_witness())
 
         for i, (is_last, chunk) in enumerate(chunkify(cdata, MAX_APDU_LEN)):
             p1 = 0x00 if i == 0 else 0x80
@@ -216,13 +248,13 @@ class BitcoinCommandBuilder:
                 yield self.serialize(cla=self.CLA,
                                      ins=ins,
                                      p1=p1,
-                                     p2=p2,
+                                     p2=p2 if i == 0 else 0x00,
                                      cdata=chunk)
                 return
             yield self.serialize(cla=self.CLA,
                                  ins=ins,
                                  p1=p1,
-                                 p2=p2,
+                                 p2=p2 if i == 0 else 0x00,
                                  cdata=chunk)
 
     def untrusted_hash_tx_input_start(self,
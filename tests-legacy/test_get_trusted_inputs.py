@@ -1,6 +1,9 @@
 from io import BytesIO
 
-from bitcoin_client.hwi.serialization import CTransaction
+import pytest
+
+from bitcoin_client.hwi.serialization import COutPoint, CTransaction, CTxIn, CTxOut
+from bitcoin_client.exception import IncorrectDataError
 from bitcoin_client.utils import deser_trusted_input
 
 
@@ -172,3 +175,57 @@ def test_get_trusted_inputs(cmd):
     assert out_index == output_index
     assert prev_txid == bip141_tx.sha256.to_bytes(32, byteorder="little")
     assert amount == bip141_tx.vout[out_index].nValue
+
+
+def test_get_trusted_inputs_multiple_outputs(cmd):
+    # A payout transaction with many outputs, some of them spent together
+    tx = CTransaction()
+    tx.nVersion = 2
+    tx.vin = [CTxIn(COutPoint(h=0x40d1ae8a596b34f48b303e853c56f8f6f54c483babc16978eb182e2154d5f2ab,
+                              n=0),
+                    scriptSig=bytes.fromhex("160014" "4c9fca3fd23ae5cc1f0dfe46b446da611219c020"),
+                    nSequence=0xfffffffd)]
+    tx.vout = [CTxOut(nValue=100000 + i,
+                      scriptPubKey=bytes.fromhex("0014") + bytes([i] * 20))
+               for i in range(10)]
+    tx.nLockTime = 0x1969e3
+    tx.calc_sha256()
+
+    output_indexes = [1, 4, 5, 9]
+    trusted_inputs = cmd.get_trusted_inputs(utxo=tx, output_indexes=output_indexes)
+
+    assert len(trusted_inputs) == len(output_indexes)
+    for trusted_input, output_index in zip(trusted_inputs, output_indexes):
+        _, _, _, prev_txid, out_index, amount, _ = deser_trusted_input(trusted_input)
+        assert out_index == output_index
+        assert prev_txid == tx.sha256.to_bytes(32, byteorder="little")
+        assert amount == tx.vout[out_index].nValue
+
+    # the trusted inputs are the same as the ones of single outputs, except for the random bytes
+    # and the HMAC
+    single_trusted_input = cmd.get_trusted_input(utxo=tx, output_index=4)
+    assert single_trusted_input[4:48] == trusted_inputs[1][4:48]
+
+    # the output indexes must be strictly increasing
+    with pytest.raises(IncorrectDataError):
+        cmd.get_trusted_inputs(utxo=tx, output_indexes=[4, 1])
+    with pytest.raises(IncorrectDataError):
+        cmd.get_trusted_inputs(utxo=tx, output_indexes=[4, 4])
+
+    # at most 4 outputs at once
+    with pytest.raises(IncorrectDataError):
+        cmd.get_trusted_inputs(utxo=tx, output_indexes=[0, 1, 2, 3, 4])
+
+    # all the outputs must exist
+    with pytest.raises(IncorrectDataError):
+        cmd.get_trusted_inputs(utxo=tx, output_indexes=[9, 10])
+
+    # P2 = 0x01 is only accepted in the first APDU; the other chunks require P2 = 0x00
+    chunks = list(cmd.builder.get_trusted_inputs(utxo=tx, output_indexes=output_indexes))
+    assert len(chunks) > 1
+    cmd.transport.send_raw(chunks[0])
+    sw, _ = cmd.transport.recv()
+    assert sw == 0x9000
+    cmd.transport.send_raw(chunks[1][:3] + b"\x01" + chunks[1][4:])
+    sw, _ = cmd.transport.recv()
+    assert sw == 0x6B00
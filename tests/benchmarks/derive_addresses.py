@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""
+Benchmark of the address derivation of the Python client, as used by the host-side address verification and
+change detection.
+
+Derives the first --count receive addresses of several descriptors with the elliptic curve backend selected
+by bitcoin_client/ledger_bitcoin/key.py (libsecp256k1 via coincurve if installed, otherwise the pure Python
+implementation; set LEDGER_BITCOIN_EC_BACKEND=python to force the latter), and reports the time per address.
+
+The first --reference-count addresses are also derived with the plain affine double-and-add implementation
+that key.py used to have, in order to report the speedup and to check that the results are identical.
+
+No device is needed. Run from the `tests` folder:
+
+    python benchmarks/derive_addresses.py
+"""
+
+import argparse
+import sys
+import time
+
+from pathlib import Path
+from typing import Callable, List, Optional, Tuple
+
+repo_root_path: Path = Path(__file__).parent.parent.parent
+sys.path.insert(0, str(repo_root_path))
+
+from bitcoin_client.ledger_bitcoin import key as key_module  # noqa: E402
+from bitcoin_client.ledger_bitcoin.descriptor import parse_descriptor  # noqa: E402
+from bitcoin_client.ledger_bitcoin.key import ExtendedKey, get_taproot_output_key  # noqa: E402
+
+from test_utils import segwit_addr  # noqa: E402
+
+# master xpub of the test vector 2 of BIP-32
+MASTER_XPUB = "xpub661MyMwAqRbcFW31YEwpkMuc5THy2PSt5bDMsktWQcFF8syAmRUapSCGu8ED9W6oDMSgv6Zz8idoc4a6mr8BDzTJY47LJhkJ8UB7WEGuduB"
+
+
+def get_cases() -> List[Tuple[str, Callable[[int], str]]]:
+    master = ExtendedKey.deserialize(MASTER_XPUB)
+    xpubs = [master.derive_pub(i).to_string() for i in range(3)]
+
+    wpkh = parse_descriptor(f"wpkh({xpubs[0]}/0/*)")
+    wsh_multi = parse_descriptor(f"wsh(sortedmulti(2,{xpubs[0]}/0/*,{xpubs[1]}/0/*,{xpubs[2]}/0/*))")
+    tr = parse_descriptor(f"tr({xpubs[0]}/0/*)")
+
+    def segwit_v0_address(script: bytes) -> str:
+        return segwit_addr.encode("bc", 0, script[2:])
+
+    return [
+        ("wpkh", lambda pos: segwit_v0_address(wpkh.expand(pos).output_script)),
+        ("wsh(sortedmulti(2,3))", lambda pos: segwit_v0_address(wsh_multi.expand(pos).output_script)),
+        ("tr (key path)", lambda pos: segwit_addr.encode(
+            "bc", 1, get_taproot_output_key(tr.pubkeys[0].get_pubkey_bytes(pos)))),
+    ]
+
+
+def reference_point_mul(P: key_module.Point, k: int) -> key_module.Point:
+    r = None
+    for i in range(256):
+        if ((k >> i) & 1):
+            r = key_module.point_add(r, P)
+        P = key_module.point_add(P, P)
+    return r
+
+
+def reference_pubkey_tweak_add(pubkey: bytes, t: int) -> bytes:
+    P = key_module.bytes_to_point(pubkey)
+    return key_module.point_to_bytes(key_module.point_add(reference_point_mul(key_module.G, t), P))
+
+
+def run_case(derive: Callable[[int], str], count: int) -> Tuple[List[str], float]:
+    start = time.perf_counter()
+    addresses = [derive(pos) for pos in range(count)]
+    return addresses, time.perf_counter() - start
+
+
+def main(args: Optional[List[str]] = None) -> int:
+    parser = argparse.ArgumentParser(description="Address derivation benchmark of the Python client")
+    parser.add_argument("--count", type=int, default=10000, help="number of addresses for each descriptor")
+    parser.add_argument("--reference-count", type=int, default=20,
+                        help="number of addresses derived with the reference implementation (0 to skip)")
+    parsed = parser.parse_args(args)
+
+    print(f"EC backend: {key_module.EC_BACKEND}")
+
+    start = time.perf_counter()
+    cases = get_cases()
+    print(f"setup (including the precomputed tables): {(time.perf_counter() - start) * 1e3:.1f} ms")
+
+    print(f"{'descriptor':<24} {'addresses':>9} {'total (s)':>10} {'us/address':>11} {'reference':>11} {'speedup':>8}")
+    failed = False
+    for name, derive in cases:
+        addresses, elapsed = run_case(derive, parsed.count)
+        per_address = elapsed / parsed.count * 1e6
+        reference_column = speedup_column = "-"
+
+        if parsed.reference_count > 0:
+            n_ref = min(parsed.reference_count, parsed.count)
+            pubkey_tweak_add = key_module.pubkey_tweak_add
+            key_module.pubkey_tweak_add = reference_pubkey_tweak_add
+            try:
+                ref_addresses, ref_elapsed = run_case(derive, n_ref)
+            finally:
+                key_module.pubkey_tweak_add = pubkey_tweak_add
+
+            if ref_addresses != addresses[:n_ref]:
+                print(f"{name}: the addresses differ from the reference implementation")
+                failed = True
+            ref_per_address = ref_elapsed / n_ref * 1e6
+            reference_column = f"{ref_per_address:.0f}"
+            speedup_column = f"{ref_per_address / per_address:.1f}x"
+
+        print(f"{name:<24} {parsed.count:>9} {elapsed:>10.3f} {per_address:>11.1f} "
+              f"{reference_column:>11} {speedup_column:>8}")
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
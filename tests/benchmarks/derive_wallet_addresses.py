@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""
+Benchmark of PolicyMapWallet.derive_addresses, the bulk local derivation of the addresses of a wallet policy used to
+reconcile the addresses returned by the device.
+
+For several wallet policies, derives --count receive addresses:
+- with a single process;
+- with --processes processes (default: the number of CPUs);
+and compares with the derivation of each address from its full descriptor (Descriptor.expand, which derives the
+change level again for each address) on the first --per-position-count addresses, checking that the results match.
+
+No device is needed. Run from the `tests` folder:
+
+    python benchmarks/derive_wallet_addresses.py
+"""
+
+import argparse
+import os
+import sys
+import time
+
+from pathlib import Path
+from typing import List, Optional
+
+repo_root_path: Path = Path(__file__).parent.parent.parent
+sys.path.insert(0, str(repo_root_path))
+
+from bitcoin_client.ledger_bitcoin import AddressType, Chain, MultisigWallet, PolicyMapWallet  # noqa: E402
+from bitcoin_client.ledger_bitcoin import key as key_module  # noqa: E402
+from bitcoin_client.ledger_bitcoin._script import script_to_address  # noqa: E402
+from bitcoin_client.ledger_bitcoin.descriptor import parse_descriptor  # noqa: E402
+
+WALLETS = [
+    PolicyMapWallet(
+        name="",
+        policy_map="wpkh(@0)",
+        keys_info=[
+            "[f5acc2fd/84'/1'/0']tpubDCtKfsNyRhULjZ9XMS4VKKtVcPdVDi8MKUbcSD9MJDyjRu1A2ND5MiipozyyspBT9bg8upEp7a8EAgFxNxXn1d7QkdbL52Ty5jiSLcxPt1P/**",
+        ],
+    ),
+    PolicyMapWallet(
+        name="",
+        policy_map="tr(@0)",
+        keys_info=[
+            "[f5acc2fd/86'/1'/0']tpubDDKYE6BREvDsSWMazgHoyQWiJwYaDDYPbCFjYxN3HFXJP5fokeiK4hwK5tTLBNEDBwrDXn8cQ4v9b2xdW62Xr5yxoQdMu1v6c7UDXYVH27U/**",
+        ],
+    ),
+    MultisigWallet(
+        name="Cold storage",
+        address_type=AddressType.WIT,
+        threshold=2,
+        keys_info=[
+            "[76223a6e/48'/1'/0'/2']tpubDE7NQymr4AFtewpAsWtnreyq9ghkzQBXpCZjWLFVRAvnbf7vya2eMTvT2fPapNqL8SuVvLQdbUbMfWLVDCZKnsEBqp6UK93QEzL8Ck23AwF/**",
+            "[f5acc2fd/48'/1'/0'/2']tpubDFAqEGNyad35aBCKUAXbQGDjdVhNueno5ZZVEn3sQbW5ci457gLR7HyTmHBg93oourBssgUxuWz1jX5uhc1qaqFo9VsybY1J5FuedLfm4dK/**",
+        ],
+    ),
+]
+
+
+def derive_per_position(wallet: PolicyMapWallet, count: int) -> List[str]:
+    desc = parse_descriptor(wallet.get_descriptor(False))
+    return [script_to_address(desc.expand(pos).output_script, Chain.TEST) for pos in range(count)]
+
+
+def main(args: Optional[List[str]] = None) -> int:
+    parser = argparse.ArgumentParser(description="Benchmark of PolicyMapWallet.derive_addresses")
+    parser.add_argument("--count", type=int, default=100000, help="number of addresses for each wallet policy")
+    parser.add_argument("--processes", type=int, default=os.cpu_count() or 1,
+                        help="number of processes of the parallel derivation")
+    parser.add_argument("--per-position-count", type=int, default=1000,
+                        help="number of addresses derived from the full descriptor (0 to skip)")
+    parsed = parser.parse_args(args)
+
+    print(f"EC backend: {key_module.EC_BACKEND}, {parsed.processes} processes")
+    print(f"{'policy':<28} {'addresses':>9} {'per-position':>13} {'1 process':>10} {'parallel':>9}  (us/address)")
+
+    failed = False
+    for wallet in WALLETS:
+        start = time.perf_counter()
+        addresses = wallet.derive_addresses(False, 0, parsed.count, Chain.TEST)
+        single = (time.perf_counter() - start) / parsed.count * 1e6
+
+        start = time.perf_counter()
+        parallel_addresses = wallet.derive_addresses(False, 0, parsed.count, Chain.TEST, processes=parsed.processes)
+        parallel = (time.perf_counter() - start) / parsed.count * 1e6
+
+        if parallel_addresses != addresses:
+            print(f"{wallet.policy_map}: the parallel derivation returned different addresses")
+            failed = True
+
+        per_position_column = "-"
+        n_per_position = min(parsed.per_position_count, parsed.count)
+        if n_per_position > 0:
+            start = time.perf_counter()
+            per_position_addresses = derive_per_position(wallet, n_per_position)
+            per_position_column = f"{(time.perf_counter() - start) / n_per_position * 1e6:.1f}"
+
+            if per_position_addresses != addresses[:n_per_position]:
+                print(f"{wallet.policy_map}: the addresses differ from the ones of the full descriptor")
+                failed = True
+
+        print(f"{wallet.policy_map:<28} {parsed.count:>9} {per_position_column:>13} {single:>10.1f} {parallel:>9.1f}")
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""
+Benchmark of the PSBT parsing of the Python client, on PSBTs whose inputs have large non-witness UTXOs.
+
+Builds a synthetic PSBT with --inputs inputs, each spending an output of a previous transaction with --prev-outputs
+outputs (and large witnesses), and reports the time of:
+- PSBT.deserialize, that only indexes the non-witness UTXOs (and computes their txid without the witnesses);
+- the materialization of all the non-witness UTXOs as CTransaction objects, as the previous implementation of
+  PSBT.deserialize did;
+- NewClient._prepare_sign_psbt, that computes the Merkleized map commitments sent with SIGN_PSBT from views of the
+  serialized PSBT, compared with the previous implementation that parsed each map again with a BytesIO stream.
+
+No device is needed. Run from the `tests` folder:
+
+    python benchmarks/psbt_parsing.py
+"""
+
+import argparse
+import base64
+import sys
+import time
+
+from io import BytesIO
+from pathlib import Path
+from typing import List, Optional
+
+repo_root_path: Path = Path(__file__).parent.parent.parent
+sys.path.insert(0, str(repo_root_path))
+
+from bitcoin_client.ledger_bitcoin.client import NewClient, parse_stream_to_map  # noqa: E402
+from bitcoin_client.ledger_bitcoin.client_command import ClientCommandInterpreter  # noqa: E402
+from bitcoin_client.ledger_bitcoin.merkle import get_merkleized_map_commitment  # noqa: E402
+from bitcoin_client.ledger_bitcoin.psbt import PSBT, PartiallySignedInput, PartiallySignedOutput  # noqa: E402
+from bitcoin_client.ledger_bitcoin.tx import (  # noqa: E402
+    COutPoint, CTransaction, CTxIn, CTxInWitness, CTxOut, CTxWitness
+)
+from bitcoin_client.ledger_bitcoin.wallet import PolicyMapWallet  # noqa: E402
+
+WALLET = PolicyMapWallet(
+    name="",
+    policy_map="wpkh(@0)",
+    keys_info=[
+        "[f5acc2fd/84'/1'/0']tpubDCtKfsNyRhULjZ9XMS4VKKtVcPdVDi8MKUbcSD9MJDyjRu1A2ND5MiipozyyspBT9bg8upEp7a8EAgFxNxXn1d7QkdbL52Ty5jiSLcxPt1P/**",
+    ],
+)
+
+
+def make_prev_tx(index: int, n_outputs: int) -> CTransaction:
+    tx = CTransaction()
+    tx.nVersion = 2
+    tx.vin = [CTxIn(COutPoint(index, i)) for i in range(8)]
+    tx.vout = [CTxOut(1000 + i, bytes([0x00, 0x14]) + i.to_bytes(20, 'little')) for i in range(n_outputs)]
+    tx.wit = CTxWitness()
+    for _ in tx.vin:
+        in_wit = CTxInWitness()
+        in_wit.scriptWitness.stack = [bytes(72), bytes(33), bytes(4096)]
+        tx.wit.vtxinwit.append(in_wit)
+    tx.rehash()
+    return tx
+
+
+def make_psbt(n_inputs: int, n_prev_outputs: int) -> str:
+    psbt = PSBT()
+    psbt.version = 2
+    psbt.tx_version = 2
+    for i in range(n_inputs):
+        prev_tx = make_prev_tx(i, n_prev_outputs)
+        psbt_in = PartiallySignedInput(2)
+        psbt_in.non_witness_utxo = prev_tx
+        psbt_in.witness_utxo = prev_tx.vout[0]
+        psbt_in.prev_txid = prev_tx.hash
+        psbt_in.prev_out = 0
+        psbt_in.sequence = 0xfffffffd
+        psbt.inputs.append(psbt_in)
+
+    psbt_out = PartiallySignedOutput(2)
+    psbt_out.amount = 1000
+    psbt_out.script = bytes([0x00, 0x14]) + bytes(20)
+    psbt.outputs.append(psbt_out)
+    return psbt.serialize()
+
+
+def previous_prepare_commitments(psbt: PSBT) -> List[bytes]:
+    # the map parsing of the previous implementation of _prepare_sign_psbt
+    psbt_bytes = base64.b64decode(psbt.serialize())
+    f = BytesIO(psbt_bytes)
+    assert f.read(5) == b"psbt\xff"
+
+    client_intepreter = ClientCommandInterpreter()
+    maps = [parse_stream_to_map(f) for _ in range(1 + len(psbt.inputs) + len(psbt.outputs))]
+    for m in maps:
+        client_intepreter.add_known_mapping(m)
+    return [get_merkleized_map_commitment(m) for m in maps]
+
+
+def main(args: Optional[List[str]] = None) -> int:
+    parser = argparse.ArgumentParser(description="PSBT parsing benchmark of the Python client")
+    parser.add_argument("--inputs", type=int, default=50, help="number of inputs of the PSBT")
+    parser.add_argument("--prev-outputs", type=int, default=1000,
+                        help="number of outputs of the transaction spent by each input")
+    parser.add_argument("--repeat", type=int, default=3, help="number of repetitions of each measurement")
+    parsed = parser.parse_args(args)
+
+    psbt_str = make_psbt(parsed.inputs, parsed.prev_outputs)
+    print(f"PSBT: {parsed.inputs} inputs, {len(base64.b64decode(psbt_str)) / 1e6:.1f} MB")
+
+    def measure(f) -> float:
+        best = float("inf")
+        for _ in range(parsed.repeat):
+            start = time.perf_counter()
+            f()
+            best = min(best, time.perf_counter() - start)
+        return best * 1e3
+
+    def deserialize() -> PSBT:
+        psbt = PSBT()
+        psbt.deserialize(psbt_str)
+        return psbt
+
+    def deserialize_and_materialize() -> PSBT:
+        psbt = deserialize()
+        for psbt_in in psbt.inputs:
+            assert psbt_in.non_witness_utxo is not None
+        return psbt
+
+    psbt = deserialize()
+    fake_client = type("FakeClient", (), {"_no_clone_psbt": True})()
+
+    _, (global_commitment, input_commitments, output_commitments) = NewClient._prepare_sign_psbt(
+        fake_client, psbt, WALLET)
+    if [global_commitment, *input_commitments, *output_commitments] != previous_prepare_commitments(psbt):
+        print("the Merkleized map commitments differ from the previous implementation")
+        return 1
+
+    print(f"{'step':<36} {'ms':>9}")
+    print(f"{'deserialize':<36} {measure(deserialize):>9.1f}")
+    print(f"{'deserialize + materialize UTXOs':<36} {measure(deserialize_and_materialize):>9.1f}")
+    print(f"{'_prepare_sign_psbt':<36} {measure(lambda: NewClient._prepare_sign_psbt(fake_client, psbt, WALLET)):>9.1f}")
+    print(f"{'_prepare_sign_psbt (previous)':<36} {measure(lambda: previous_prepare_commitments(psbt)):>9.1f}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
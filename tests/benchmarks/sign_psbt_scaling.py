@@ -0,0 +1,381 @@
+#!/usr/bin/env python3
+"""
+Performance regression suite for SIGN_PSBT.
+
+Signs synthetic PSBTs with a growing number of inputs for several script types, and records for each of them:
+- the number of APDUs exchanged (including the CONTINUE_INTERRUPTED ones), and the number of each client command;
+- the bytes exchanged in each direction (host-to-device includes the 5-byte APDU header, device-to-host includes the
+  2-byte status word);
+- the CPU time spent by the client command interpreter on the host, and the total CPU time of the host client;
+- the wall time spent waiting for the device (Speculos), and the total wall time of the signing flow.
+
+The results are written to a JSON file, and compared against a committed baseline: the script exits with an error
+if any metric exceeds the baseline by more than the tolerance configured in the baseline file, or if a case is not in
+the baseline.
+
+Run from the `tests` folder, after building the app:
+
+    python benchmarks/sign_psbt_scaling.py --headless
+
+Use --update-baseline to record the results of the current run as the new baseline, and --record-apdus to save the
+transcript of each case for dev-tools/analyze_apdus.py.
+
+With --libapp, the APDUs are processed by the host build of the app (see test_utils/libapp.py) instead of Speculos.
+The protocol metrics are the same, but the timings are not meaningful: they are neither checked nor recorded in the
+baseline.
+"""
+
+import argparse
+import base64
+import json
+import os
+import random
+import sys
+import time
+
+from pathlib import Path
+from typing import Dict, List, Optional, Tuple
+
+repo_root_path: Path = Path(__file__).parent.parent.parent
+sys.path.insert(0, str(repo_root_path))
+
+from bitcoin_client.ledger_bitcoin import Chain, PolicyMapWallet, MultisigWallet, AddressType, createClient  # noqa: E402
+from bitcoin_client.ledger_bitcoin import client as client_module  # noqa: E402
+from bitcoin_client.ledger_bitcoin.client import NewClient  # noqa: E402
+from bitcoin_client.ledger_bitcoin.client_base import ApduException  # noqa: E402
+from bitcoin_client.ledger_bitcoin.client_command import ClientCommandCode, ClientCommandInterpreter  # noqa: E402
+
+from test_utils import DEFAULT_SPECULOS_MNEMONIC, txmaker  # noqa: E402
+from test_utils.fixtures import get_app_version  # noqa: E402
+from test_utils.libapp import DEFAULT_LIBAPP_PATH, LibappTransport  # noqa: E402
+from test_utils.transcript import RecordingTransport  # noqa: E402
+
+benchmarks_root: Path = Path(__file__).parent
+tests_root: Path = benchmarks_root.parent
+
+DEFAULT_BASELINE = benchmarks_root / "sign_psbt_baseline.json"
+
+DEFAULT_INPUT_COUNTS = [1, 10, 50, 200, 512]
+
+SW_OK = 0x9000
+SW_INTERRUPTED_EXECUTION = 0xE000
+
+# metrics that only depend on the protocol, and are therefore reproducible on any machine; all the other metrics
+# depend on the speed of the machine running the benchmark
+DETERMINISTIC_METRICS = ["apdu_count", "bytes_sent", "bytes_received"]
+TIMING_METRICS = ["interpreter_cpu_s", "host_cpu_s", "device_wall_s", "wall_s"]
+
+# script type => (wallet, wallet_hmac, automation file)
+SCRIPT_TYPES: Dict[str, Tuple[PolicyMapWallet, Optional[bytes], str]] = {
+    "pkh": (
+        PolicyMapWallet(
+            "",
+            "pkh(@0)",
+            ["[f5acc2fd/44'/1'/0']tpubDCwYjpDhUdPGP5rS3wgNg13mTrrjBuG8V9VpWbyptX6TRPbNoZVXsoVUSkCjmQ8jJycjuDKBb9eataSymXakTTaGifxR6kmVsfFehH1ZgJT/**"],
+        ),
+        None,
+        "automations/sign_with_default_wallet_accept.json"
+    ),
+    "sh-wpkh": (
+        PolicyMapWallet(
+            "",
+            "sh(wpkh(@0))",
+            ["[f5acc2fd/49'/1'/0']tpubDC871vGLAiKPcwAw22EjhKVLk5L98UGXBEcGR8gpcigLQVDDfgcYW24QBEyTHTSFEjgJgbaHU8CdRi9vmG4cPm1kPLmZhJEP17FMBdNheh3/**"],
+        ),
+        None,
+        "automations/sign_with_default_wallet_accept.json"
+    ),
+    "wpkh": (
+        PolicyMapWallet(
+            "",
+            "wpkh(@0)",
+            ["[f5acc2fd/84'/1'/0']tpubDCtKfsNyRhULjZ9XMS4VKKtVcPdVDi8MKUbcSD9MJDyjRu1A2ND5MiipozyyspBT9bg8upEp7a8EAgFxNxXn1d7QkdbL52Ty5jiSLcxPt1P/**"],
+        ),
+        None,
+        "automations/sign_with_default_wallet_accept.json"
+    ),
+    "tr": (
+        PolicyMapWallet(
+            "",
+            "tr(@0)",
+            ["[f5acc2fd/86'/1'/0']tpubDDKYE6BREvDsSWMazgHoyQWiJwYaDDYPbCFjYxN3HFXJP5fokeiK4hwK5tTLBNEDBwrDXn8cQ4v9b2xdW62Xr5yxoQdMu1v6c7UDXYVH27U/**"],
+        ),
+        None,
+        "automations/sign_with_default_wallet_accept.json"
+    ),
+    "wsh-multisig": (
+        # same wallet as in test_sign_psbt_multisig_wsh; the hmac is valid for the default Speculos seed
+        MultisigWallet(
+            name="Cold storage",
+            address_type=AddressType.WIT,
+            threshold=2,
+            keys_info=[
+                "[76223a6e/48'/1'/0'/2']tpubDE7NQymr4AFtewpAsWtnreyq9ghkzQBXpCZjWLFVRAvnbf7vya2eMTvT2fPapNqL8SuVvLQdbUbMfWLVDCZKnsEBqp6UK93QEzL8Ck23AwF/**",
+                "[f5acc2fd/48'/1'/0'/2']tpubDFAqEGNyad35aBCKUAXbQGDjdVhNueno5ZZVEn3sQbW5ci457gLR7HyTmHBg93oourBssgUxuWz1jX5uhc1qaqFo9VsybY1J5FuedLfm4dK/**",
+            ],
+        ),
+        bytes.fromhex("d6434852fb3caa7edbd1165084968f1691444b3cfc10cf1e431acbbc7f48451f"),
+        "automations/sign_with_wallet_accept.json"
+    ),
+}
+
+
+class CountingTransport:
+    """Wraps a TransportClient (or a SpeculosClient), counting the exchanged APDUs and bytes."""
+
+    def __init__(self, transport) -> None:
+        self.transport = transport
+        self.reset()
+
+    def reset(self) -> None:
+        self.apdu_count = 0
+        self.bytes_sent = 0
+        self.bytes_received = 0
+        self.device_wall_s = 0.0
+        self.client_commands: Dict[str, int] = {}
+
+    def apdu_exchange(self, cla: int, ins: int, data: bytes = b"", p1: int = 0, p2: int = 0) -> bytes:
+        self.apdu_count += 1
+        self.bytes_sent += 5 + len(data)
+
+        response = b""
+        sw = None
+        start = time.perf_counter()
+        try:
+            response = self.transport.apdu_exchange(cla, ins, data, p1, p2)
+            sw = SW_OK
+        except ApduException as e:
+            response = e.data
+            sw = e.sw
+            raise
+        finally:
+            self.device_wall_s += time.perf_counter() - start
+            self.bytes_received += len(response) + 2
+            if sw == SW_INTERRUPTED_EXECUTION and len(response) > 0:
+                try:
+                    name = ClientCommandCode(response[0]).name
+                except ValueError:
+                    name = f"0x{response[0]:02x}"
+                self.client_commands[name] = self.client_commands.get(name, 0) + 1
+
+        return response
+
+    def stop(self) -> None:
+        self.transport.stop()
+
+
+class TimedClientCommandInterpreter(ClientCommandInterpreter):
+    """ClientCommandInterpreter that accumulates the CPU time spent answering the client commands."""
+
+    cpu_time_s: float = 0.0
+
+    def execute(self, hw_response: bytes) -> bytes:
+        start = time.process_time()
+        try:
+            return super().execute(hw_response)
+        finally:
+            TimedClientCommandInterpreter.cpu_time_s += time.process_time() - start
+
+
+def make_psbt(script_type: str, n_inputs: int):
+    """Creates a PSBT spending n_inputs inputs of the wallet to an external output and a change output."""
+
+    # the same case always produces the same PSBT, so that the protocol metrics are reproducible
+    random.seed(f"{script_type}/{n_inputs}")
+
+    wallet, _, _ = SCRIPT_TYPES[script_type]
+
+    in_amounts = [random.randint(10_000, 1_000_000) for _ in range(n_inputs)]
+    total = sum(in_amounts)
+    fee = 200 * n_inputs
+    out_amounts = [total // 2, total - total // 2 - fee]
+
+    return txmaker.createPsbt(wallet, in_amounts, out_amounts, [False, True])
+
+
+def run_case(client, transport: CountingTransport, script_type: str, n_inputs: int) -> dict:
+    wallet, wallet_hmac, _ = SCRIPT_TYPES[script_type]
+
+    psbt = make_psbt(script_type, n_inputs)
+    psbt_size = len(base64.b64decode(psbt.serialize()))
+
+    transport.reset()
+    TimedClientCommandInterpreter.cpu_time_s = 0.0
+
+    wall_start = time.perf_counter()
+    cpu_start = time.process_time()
+    result = client.sign_psbt(psbt, wallet, wallet_hmac)
+    host_cpu_s = time.process_time() - cpu_start
+    wall_s = time.perf_counter() - wall_start
+
+    if len(result) != n_inputs:
+        raise RuntimeError(f"{script_type}/{n_inputs}: expected {n_inputs} signatures, got {len(result)}")
+
+    return {
+        "script_type": script_type,
+        "n_inputs": n_inputs,
+        "psbt_size": psbt_size,
+        "apdu_count": transport.apdu_count,
+        "bytes_sent": transport.bytes_sent,
+        "bytes_received": transport.bytes_received,
+        "client_commands": dict(sorted(transport.client_commands.items())),
+        "interpreter_cpu_s": round(TimedClientCommandInterpreter.cpu_time_s, 4),
+        "host_cpu_s": round(host_cpu_s, 4),
+        "device_wall_s": round(transport.device_wall_s, 4),
+        "wall_s": round(wall_s, 4),
+    }
+
+
+def check_against_baseline(results: dict, baseline: dict, check_timing: bool) -> List[str]:
+    """Returns the list of regressions of results with respect to baseline."""
+
+    tolerances: Dict[str, float] = baseline.get("tolerances", {})
+    baseline_cases: Dict[str, dict] = baseline.get("cases", {})
+
+    regressions: List[str] = []
+    for case_name, case in results["cases"].items():
+        base_case = baseline_cases.get(case_name)
+        if base_case is None:
+            regressions.append(f"{case_name}: not in the baseline (record it with --update-baseline)")
+            continue
+
+        for metric, tolerance in tolerances.items():
+            if metric not in DETERMINISTIC_METRICS and not check_timing:
+                continue
+            if metric not in base_case:
+                # the timings are not recorded if the baseline was produced with --libapp
+                if metric in DETERMINISTIC_METRICS:
+                    regressions.append(f"{case_name}: {metric} is not in the baseline")
+                continue
+            if metric not in case:
+                continue
+
+            limit = base_case[metric] * (1 + tolerance)
+            if case[metric] > limit:
+                regressions.append(
+                    f"{case_name}: {metric} = {case[metric]} exceeds the baseline {base_case[metric]} "
+                    f"(tolerance {tolerance:.0%})")
+            elif case[metric] < base_case[metric]:
+                print(f"[baseline] {case_name}: {metric} improved from {base_case[metric]} to {case[metric]}")
+
+    return regressions
+
+
+def start_transport(args):
+    if args.libapp is not None:
+        return LibappTransport(DEFAULT_SPECULOS_MNEMONIC, args.libapp), None
+
+    if args.hid:
+        from bitcoin_client.ledger_bitcoin import TransportClient
+        return TransportClient("hid"), None
+
+    from speculos.client import SpeculosClient
+
+    # emulate the app name returned by GET_VERSION, so that createClient picks the right client
+    if not os.getenv("SPECULOS_APPNAME"):
+        os.environ['SPECULOS_APPNAME'] = f'Bitcoin Test:{get_app_version()}'
+
+    app_binary = os.getenv("BITCOIN_APP_BINARY", str(repo_root_path.joinpath("bin/app.elf")))
+
+    speculos = SpeculosClient(
+        app_binary,
+        ['--sdk', '2.1', '--seed', DEFAULT_SPECULOS_MNEMONIC]
+        + ["--display", "qt" if not args.headless else "headless"]
+    )
+    speculos.start()
+    return speculos, speculos
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="Performance regression suite for SIGN_PSBT.")
+    parser.add_argument("--hid", action="store_true", help="use a real device instead of Speculos")
+    parser.add_argument("--headless", action="store_true", help="run Speculos without display")
+    parser.add_argument("--libapp", nargs="?", type=Path, const=DEFAULT_LIBAPP_PATH, default=None,
+                        help="run the host build of the app in unit-tests/libapp instead of Speculos; only the metrics "
+                             "that do not depend on the speed of the machine are checked or recorded")
+    parser.add_argument("--script-types", nargs="+", choices=list(SCRIPT_TYPES.keys()),
+                        default=list(SCRIPT_TYPES.keys()))
+    parser.add_argument("--inputs", nargs="+", type=int, default=DEFAULT_INPUT_COUNTS,
+                        help="number of inputs of the signed PSBTs")
+    parser.add_argument("--output", type=Path, default=Path("sign_psbt_perf.json"),
+                        help="JSON file where the results are written")
+    parser.add_argument("--baseline", type=Path, default=DEFAULT_BASELINE)
+    parser.add_argument("--no-timing-check", action="store_true",
+                        help="only check the metrics that do not depend on the speed of the machine")
+    parser.add_argument("--update-baseline", action="store_true",
+                        help="store the results in the baseline file instead of checking them")
+    parser.add_argument("--record-apdus", type=Path, default=None,
+                        help="folder where the transcript of the APDUs of each case is saved")
+    args = parser.parse_args()
+
+    # measure the time spent in the client command interpreter
+    client_module.ClientCommandInterpreter = TimedClientCommandInterpreter
+
+    transport, speculos = start_transport(args)
+    recorder = RecordingTransport(transport)
+    counting_transport = CountingTransport(recorder)
+
+    if args.record_apdus is not None:
+        os.makedirs(args.record_apdus, exist_ok=True)
+
+    results = {
+        "app_version": get_app_version(),
+        "cases": {}
+    }
+
+    try:
+        if args.libapp is not None:
+            # GET_VERSION is answered by the OS, that is not part of the host build
+            client = NewClient(counting_transport, chain=Chain.TEST, debug=False)
+        else:
+            client = createClient(counting_transport, chain=Chain.TEST, debug=False)
+
+        for script_type in args.script_types:
+            _, _, automation_file = SCRIPT_TYPES[script_type]
+            if speculos is not None:
+                speculos.set_automation_rules(json.load(open(tests_root / automation_file)))
+
+            for n_inputs in args.inputs:
+                case_name = f"{script_type}/{n_inputs}"
+                recorder.clear()
+                case = run_case(client, counting_transport, script_type, n_inputs)
+                results["cases"][case_name] = case
+
+                if args.record_apdus is not None:
+                    recorder.transcript.save(args.record_apdus / f"{script_type}-{n_inputs}.json")
+
+                print(f"{case_name}: {case['apdu_count']} APDUs, {case['bytes_sent']} B sent, "
+                      f"{case['bytes_received']} B received, {case['interpreter_cpu_s']} s interpreter CPU, "
+                      f"{case['device_wall_s']} s device, {case['wall_s']} s total")
+    finally:
+        counting_transport.stop()
+
+    args.output.write_text(json.dumps(results, indent=2) + "\n")
+    print(f"Results written to {args.output}")
+
+    baseline = json.loads(args.baseline.read_text()) if args.baseline.is_file() else {}
+
+    if args.update_baseline:
+        cases = results["cases"]
+        if args.libapp is not None:
+            cases = {
+                case_name: {metric: value for metric, value in case.items() if metric not in TIMING_METRICS}
+                for case_name, case in cases.items()
+            }
+        baseline.setdefault("tolerances", {})
+        baseline.setdefault("cases", {}).update(cases)
+        baseline["cases"] = dict(sorted(baseline["cases"].items()))
+        args.baseline.write_text(json.dumps(baseline, indent=2) + "\n")
+        print(f"Baseline updated: {args.baseline}")
+        return 0
+
+    check_timing = not args.no_timing_check and args.libapp is None
+    regressions = check_against_baseline(results, baseline, check_timing)
+    for regression in regressions:
+        print(f"REGRESSION: {regression}")
+
+    return 1 if len(regressions) > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -25,6 +25,34 @@ def test_get_extended_pubkey_standard_nodisplay(client: Client):
         )
 
 
+def test_get_extended_pubkeys_standard_nodisplay(client: Client):
+    paths = [
+        "m/44'/1'/0'",
+        "m/44'/1'/10'",
+        "m/44'/1'/2'/1/42",
+        "m/48'/1'/4'/1'/0/7",
+        "m/49'/1'/1'/1/3",
+        "m/84'/1'/2'/0/10",
+        "m/86'/1'/4'/1/12",
+    ] + [f"m/84'/1'/0'/{change}/{index}" for change in [0, 1] for index in range(10)]
+
+    # more paths than fit in a single request
+    assert len(paths) > 16
+
+    expected = [client.get_extended_pubkey(path=path, display=False) for path in paths]
+
+    assert client.get_extended_pubkeys(paths=paths, display=False) == expected
+
+
+def test_get_extended_pubkeys_nonstandard_nodisplay(client: Client):
+    # the whole request is rejected if any of the paths is not standard
+    with pytest.raises(NotSupportedError):
+        client.get_extended_pubkeys(
+            paths=["m/44'/1'/0'", "m/44'/1'"],
+            display=False
+        )
+
+
 def test_get_extended_pubkey_nonstandard_nodisplay(client: Client):
     # as these paths are not standard, the app should reject immediately if display=False
     testcases = [
@@ -194,3 +194,43 @@ def test_get_wallet_address_multisig_wit(client: Client):
 
     res = client.get_wallet_address(wallet, wallet_hmac, 0, 0, False)
     assert res == "tb1qmyauyzn08cduzdqweexgna2spwd0rndj55fsrkefry2cpuyt4cpsn2pg28"
+
+
+def test_get_wallet_address_bulk_derivation(client: Client):
+    # addresses derived locally by the client must match the ones returned by the device
+
+    singlesig_wallet = PolicyMapWallet(
+        name="",
+        policy_map="tr(@0)",
+        keys_info=[
+            f"[f5acc2fd/86'/1'/0']tpubDDKYE6BREvDsSWMazgHoyQWiJwYaDDYPbCFjYxN3HFXJP5fokeiK4hwK5tTLBNEDBwrDXn8cQ4v9b2xdW62Xr5yxoQdMu1v6c7UDXYVH27U/**",
+        ],
+    )
+
+    addresses = singlesig_wallet.derive_addresses(False, 0, 10, client.chain)
+    assert addresses[0] == "tb1pws8wvnj99ca6acf8kq7pjk7vyxknah0d9mexckh5s0vu2ccy68js9am6u7"
+    assert addresses[9] == "tb1psl7eyk2jyjzq6evqvan854fts7a5j65rth25yqahkd2a765yvj0qggs5ne"
+
+    addresses = singlesig_wallet.derive_addresses(True, 100, 200, client.chain)
+    assert client.verify_wallet_addresses(singlesig_wallet, None, 1, 100, addresses, n_samples=4) == []
+
+    multisig_wallet = MultisigWallet(
+        name="Cold storage",
+        address_type=AddressType.WIT,
+        threshold=2,
+        keys_info=[
+            f"[76223a6e/48'/1'/0'/2']tpubDE7NQymr4AFtewpAsWtnreyq9ghkzQBXpCZjWLFVRAvnbf7vya2eMTvT2fPapNqL8SuVvLQdbUbMfWLVDCZKnsEBqp6UK93QEzL8Ck23AwF/**",
+            f"[f5acc2fd/48'/1'/0'/2']tpubDFAqEGNyad35aBCKUAXbQGDjdVhNueno5ZZVEn3sQbW5ci457gLR7HyTmHBg93oourBssgUxuWz1jX5uhc1qaqFo9VsybY1J5FuedLfm4dK/**",
+        ],
+    )
+    wallet_hmac = bytes.fromhex(
+        "d6434852fb3caa7edbd1165084968f1691444b3cfc10cf1e431acbbc7f48451f"
+    )
+
+    addresses = multisig_wallet.derive_addresses(False, 0, 500, client.chain, processes=2)
+    assert addresses[0] == "tb1qmyauyzn08cduzdqweexgna2spwd0rndj55fsrkefry2cpuyt4cpsn2pg28"
+    assert client.verify_wallet_addresses(multisig_wallet, wallet_hmac, 0, 0, addresses, n_samples=4) == []
+
+    # a wrong address is detected if it is sampled
+    addresses[-1] = addresses[0]
+    assert client.verify_wallet_addresses(multisig_wallet, wallet_hmac, 0, 0, addresses, n_samples=0) == [499]
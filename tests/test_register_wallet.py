@@ -76,6 +76,37 @@ def test_register_wallet_accept_wit(client: Client, speculos_globals):
     )
 
 
+@has_automation("automations/register_wallet_accept.json")
+def test_register_wallet_accept_wit_binary_keys(client: Client, speculos_globals):
+    keys_info = [
+        f"[76223a6e/48'/1'/0'/2']tpubDE7NQymr4AFtewpAsWtnreyq9ghkzQBXpCZjWLFVRAvnbf7vya2eMTvT2fPapNqL8SuVvLQdbUbMfWLVDCZKnsEBqp6UK93QEzL8Ck23AwF/**",
+        f"[f5acc2fd/48'/1'/0'/2']tpubDFAqEGNyad35aBCKUAXbQGDjdVhNueno5ZZVEn3sQbW5ci457gLR7HyTmHBg93oourBssgUxuWz1jX5uhc1qaqFo9VsybY1J5FuedLfm4dK/**",
+    ]
+    wallet = MultisigWallet(
+        name="Cold storage",
+        address_type=AddressType.WIT,
+        threshold=2,
+        keys_info=keys_info,
+        binary_keys=True,
+    )
+
+    wallet_id, wallet_hmac = client.register_wallet(wallet)
+
+    assert wallet_id == wallet.id
+
+    # the wallet type is part of the id: same policy and keys, but a different wallet
+    assert wallet_id != MultisigWallet("Cold storage", AddressType.WIT, 2, keys_info).id
+
+    assert hmac.compare_digest(
+        hmac.new(speculos_globals.wallet_registration_key, wallet_id, sha256).digest(),
+        wallet_hmac,
+    )
+
+    # same addresses as the wallet with the keys in the string encoding
+    res = client.get_wallet_address(wallet, wallet_hmac, 0, 0, False)
+    assert res == "tb1qmyauyzn08cduzdqweexgna2spwd0rndj55fsrkefry2cpuyt4cpsn2pg28"
+
+
 @has_automation("automations/register_wallet_reject.json")
 def test_register_wallet_reject_header(client: Client):
     wallet = MultisigWallet(
@@ -1,6 +1,7 @@
 import pytest
 
 import threading
+from time import sleep
 
 from decimal import Decimal
 
@@ -9,7 +10,8 @@ from typing import List
 from pathlib import Path
 
 from bitcoin_client.ledger_bitcoin import Client, PolicyMapWallet, MultisigWallet, AddressType
-from bitcoin_client.ledger_bitcoin.exception.errors import IncorrectDataError, NotSupportedError
+from bitcoin_client.ledger_bitcoin.client_command import ClientCommandCode, ClientCommandInterpreter
+from bitcoin_client.ledger_bitcoin.exception.errors import BadStateError, IncorrectDataError, NotSupportedError
 
 from bitcoin_client.ledger_bitcoin.psbt import PSBT
 from bitcoin_client.ledger_bitcoin.wallet import AddressType
@@ -22,6 +24,8 @@ from embit.networks import NETWORKS
 
 from test_utils.speculos import automation
 
+from .conftest import SpeculosGlobals
+
 tests_root: Path = Path(__file__).parent
 
 
@@ -448,7 +452,7 @@ def test_sign_psbt_singlesig_large_amount(client: Client, comm: SpeculosClient,
 
 @has_automation("automations/sign_with_default_wallet_accept.json")
 def test_sign_psbt_singlesig_wpkh_512to256(client: Client, enable_slow_tests: bool):
-    # PSBT for a transaction with 512 inputs and 256 outputs (maximum currently supported in the app)
+    # PSBT for a transaction with 512 inputs and 256 outputs
     # Very slow test (esp. with DEBUG enabled), so disabled unless the --enableslowtests option is used
 
     if not enable_slow_tests:
@@ -574,3 +578,99 @@ def test_sign_psbt_with_segwit_v16(client: Client, comm: SpeculosClient):
         hww_sigs = client.sign_psbt(psbt, wallet, None)
 
     assert len(hww_sigs) == 1
+
+
+def interrupt_sign_psbt(client: Client, comm: SpeculosClient, monkeypatch):
+    # Signs a PSBT with 12 internal inputs, but the host stops answering after receiving the first
+    # signature; returns the psbt, the wallet and the number of inputs
+
+    wallet = PolicyMapWallet(
+        "",
+        "wpkh(@0)",
+        [
+            "[f5acc2fd/84'/1'/0']tpubDCtKfsNyRhULjZ9XMS4VKKtVcPdVDi8MKUbcSD9MJDyjRu1A2ND5MiipozyyspBT9bg8upEp7a8EAgFxNxXn1d7QkdbL52Ty5jiSLcxPt1P/**"
+        ],
+    )
+
+    n_ins = 12
+    psbt = txmaker.createPsbt(
+        wallet,
+        [10000 + 10000 * i for i in range(n_ins)],
+        [9999, 20000],
+        [False, True]
+    )
+
+    received: List[bytes] = []
+    original_execute = ClientCommandInterpreter.execute
+
+    def execute(self, hw_response: bytes) -> bytes:
+        if hw_response[0] == ClientCommandCode.YIELD:
+            if len(received) > 0:
+                raise ConnectionError("simulated disconnection")
+            received.append(hw_response[1:])
+        return original_execute(self, hw_response)
+
+    monkeypatch.setattr(ClientCommandInterpreter, "execute", execute)
+
+    with automation(comm, "automations/sign_with_default_wallet_accept.json"):
+        with pytest.raises(ConnectionError):
+            client.sign_psbt(psbt, wallet, None)
+
+    monkeypatch.undo()
+    assert len(received) == 1
+
+    return psbt, wallet, n_ins
+
+
+def check_resume_sign_psbt(client: Client, psbt: PSBT, wallet: PolicyMapWallet, n_ins: int):
+    # there is no user interaction when resuming; the signatures that were already received are not
+    # produced again
+    result = client.resume_sign_psbt(psbt, wallet, None)
+
+    n_received = min(result.keys())
+    assert n_received > 0
+    assert sorted(result.keys()) == list(range(n_received, n_ins))
+
+    # the session is over
+    with pytest.raises(BadStateError):
+        client.resume_sign_psbt(psbt, wallet, None)
+
+
+def test_sign_psbt_resume_after_interruption(client: Client, comm: SpeculosClient, is_speculos: bool, monkeypatch):
+    # The host stops answering after receiving the first signatures; once the interrupted command is
+    # abandoned, the signing session is resumed without a new approval, and only the missing
+    # signatures are produced
+
+    if not is_speculos:
+        pytest.skip("Requires speculos")
+
+    psbt, wallet, n_ins = interrupt_sign_psbt(client, comm, monkeypatch)
+
+    # a client that restarts sends a new command instead of waiting for the interruption timeout;
+    # the app answers it with an error, and abandons the interrupted command
+    with pytest.raises((BadStateError, IncorrectDataError)):
+        client.get_master_fingerprint()
+
+    check_resume_sign_psbt(client, psbt, wallet, n_ins)
+
+
+def test_sign_psbt_resume_after_interruption_timeout(client: Client, comm: SpeculosClient, is_speculos: bool, enable_slow_tests: bool, speculos_globals: SpeculosGlobals, monkeypatch):
+    # Same as test_sign_psbt_resume_after_interruption, but the client waits until the app resets
+    # its IO after INTERRUPTION_TIMEOUT_TICKS ticks without an answer; the session survives the reset
+    # Slow test, so disabled unless the --enableslowtests option is used
+
+    if not is_speculos:
+        pytest.skip("Requires speculos")
+
+    if not enable_slow_tests:
+        pytest.skip()
+
+    psbt, wallet, n_ins = interrupt_sign_psbt(client, comm, monkeypatch)
+
+    # INTERRUPTION_TIMEOUT_TICKS is 50 ticks of 100 ms
+    sleep(5 + 2)
+
+    # the interrupted command was abandoned: new commands are answered normally
+    assert client.get_master_fingerprint() == speculos_globals.master_key_fingerprint
+
+    check_resume_sign_psbt(client, psbt, wallet, n_ins)
@@ -0,0 +1,85 @@
+import pytest
+
+from pathlib import Path
+from typing import Dict, Tuple
+
+from bitcoin_client.ledger_bitcoin import Client, PolicyMapWallet, MultisigWallet, AddressType
+from bitcoin_client.ledger_bitcoin.command_builder import BitcoinInsType
+from bitcoin_client.ledger_bitcoin.psbt import PSBT
+
+from test_utils import has_automation
+
+tests_root: Path = Path(__file__).parent
+
+# debug command, only available in builds with STACK_PROFILER=1 (see src/handler/get_stack_profile.h)
+GET_STACK_PROFILE = 0xF0
+
+SW_INS_NOT_SUPPORTED = 0x6D00
+
+
+def get_stack_profile(client: Client) -> Tuple[int, Dict[int, Tuple[int, int]]]:
+    """Returns the size of the stack, and a dictionary mapping each INS executed since the app started to the number of
+    measured executions and to the maximum stack usage in bytes. Skips the test if the app is not built with the stack
+    profiler."""
+
+    sw, response = client._apdu_exchange(client.builder.serialize(cla=client.builder.CLA_BITCOIN, ins=GET_STACK_PROFILE))
+    if sw == SW_INS_NOT_SUPPORTED:
+        pytest.skip("Requires an app built with STACK_PROFILER=1")
+    assert sw == 0x9000
+
+    stack_size = int.from_bytes(response[0:4], byteorder="big")
+    n_entries = response[4]
+    assert len(response) == 5 + 9 * n_entries
+
+    entries = {}
+    for i in range(n_entries):
+        entry = response[5 + 9 * i: 5 + 9 * (i + 1)]
+        entries[entry[0]] = (int.from_bytes(entry[1:5], byteorder="big"), int.from_bytes(entry[5:9], byteorder="big"))
+    return stack_size, entries
+
+
+@has_automation("automations/sign_with_wallet_accept.json")
+def test_stack_profile(client: Client):
+    get_stack_profile(client)
+
+    client.get_master_fingerprint()
+    client.get_extended_pubkey("m/84'/1'/0'")
+
+    wallet = PolicyMapWallet(
+        name="",
+        policy_map="wpkh(@0)",
+        keys_info=[
+            f"[f5acc2fd/84'/1'/0']tpubDCtKfsNyRhULjZ9XMS4VKKtVcPdVDi8MKUbcSD9MJDyjRu1A2ND5MiipozyyspBT9bg8upEp7a8EAgFxNxXn1d7QkdbL52Ty5jiSLcxPt1P/**",
+        ],
+    )
+    client.get_wallet_address(wallet, None, 0, 0, False)
+
+    multisig_wallet = MultisigWallet(
+        name="Cold storage",
+        address_type=AddressType.WIT,
+        threshold=2,
+        keys_info=[
+            f"[76223a6e/48'/1'/0'/2']tpubDE7NQymr4AFtewpAsWtnreyq9ghkzQBXpCZjWLFVRAvnbf7vya2eMTvT2fPapNqL8SuVvLQdbUbMfWLVDCZKnsEBqp6UK93QEzL8Ck23AwF/**",
+            f"[f5acc2fd/48'/1'/0'/2']tpubDFAqEGNyad35aBCKUAXbQGDjdVhNueno5ZZVEn3sQbW5ci457gLR7HyTmHBg93oourBssgUxuWz1jX5uhc1qaqFo9VsybY1J5FuedLfm4dK/**",
+        ],
+    )
+    multisig_wallet_hmac = bytes.fromhex("d6434852fb3caa7edbd1165084968f1691444b3cfc10cf1e431acbbc7f48451f")
+
+    psbt = PSBT()
+    psbt.deserialize(open(f"{tests_root}/psbt/multisig/wsh-2of2.psbt", "r").read().strip())
+    assert len(client.sign_psbt(psbt, multisig_wallet, multisig_wallet_hmac)) == 1
+
+    stack_size, entries = get_stack_profile(client)
+
+    for ins, (n_commands, max_used) in sorted(entries.items()):
+        print(f"INS {ins:02X}: {n_commands} executions, max stack usage {max_used}/{stack_size} bytes")
+
+    sign_psbt_ins = BitcoinInsType.SIGN_PSBT_BATCHED if BitcoinInsType.SIGN_PSBT_BATCHED in entries else BitcoinInsType.SIGN_PSBT
+
+    for ins in [BitcoinInsType.GET_MASTER_FINGERPRINT, BitcoinInsType.GET_EXTENDED_PUBKEY,
+                BitcoinInsType.GET_WALLET_ADDRESS, sign_psbt_ins, GET_STACK_PROFILE]:
+        assert ins in entries
+        n_commands, max_used = entries[ins]
+        assert n_commands >= 1
+        # the bottom of the stack, just above the canary, must never be reached
+        assert 0 < max_used < stack_size
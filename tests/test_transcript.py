@@ -0,0 +1,40 @@
+from bitcoin_client.ledger_bitcoin import Chain, PolicyMapWallet, createClient
+
+from test_utils.transcript import RecordingTransport, ReplayTransport, ReplayMismatchError
+
+import pytest
+
+
+def run_commands(client):
+    wallet = PolicyMapWallet(
+        name="",
+        policy_map="wpkh(@0)",
+        keys_info=[
+            f"[f5acc2fd/84'/1'/0']tpubDCtKfsNyRhULjZ9XMS4VKKtVcPdVDi8MKUbcSD9MJDyjRu1A2ND5MiipozyyspBT9bg8upEp7a8EAgFxNxXn1d7QkdbL52Ty5jiSLcxPt1P/**",
+        ],
+    )
+
+    return (
+        client.get_extended_pubkey("m/84'/1'/0'", False),
+        client.get_wallet_address(wallet, None, 0, 5, False),
+    )
+
+
+def test_transcript_replay(comm):
+    recorder = RecordingTransport(comm)
+    expected = run_commands(createClient(recorder, chain=Chain.TEST))
+
+    transcript = recorder.transcript
+    assert len(transcript.exchanges) > 3  # the wallet address requires some client commands
+    assert all(e.rtt > 0 for e in transcript.exchanges)
+
+    # the same operations are answered by the transcript, without the device
+    replay = ReplayTransport(transcript)
+    assert run_commands(createClient(replay, chain=Chain.TEST)) == expected
+    assert replay.is_complete
+
+    # any APDU that differs from the transcript is detected
+    replay.rewind()
+    replay_client = createClient(replay, chain=Chain.TEST)
+    with pytest.raises(ReplayMismatchError):
+        replay_client.get_extended_pubkey("m/84'/1'/1'", False)
@@ -0,0 +1,574 @@
+/*
+ * Benchmarks for the host-native build of the app.
+ *
+ * Usage: bench_libapp [n_iterations]
+ *
+ * Each benchmark runs a full command flow (including all the client commands) through
+ * libapp_exchange, and reports the number of flows per second and the number of APDUs per flow.
+ *
+ * The primitive benchmarks compare alternative implementations of the same computation, and report
+ * the time (and, on x86, the number of TSC cycles) per operation.
+ *
+ * The parser benchmarks report the throughput of the parser of the transactions of the PSBT inputs.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "common/base58.h"
+#include "common/varint.h"
+#include "crypto.h"
+#include "psbt_parse_rawtx.h"
+
+#include "libapp.h"
+#include "host_client.h"
+
+#define CLA_APP                0xE1
+#define INS_GET_WALLET_ADDRESS 0x03
+#define INS_SIGN_MESSAGE       0x10
+
+static const char TEST_MNEMONIC[] =
+    "glory promote mansion idle axis finger extra february uncover one trip resource lawn turtle "
+    "enact monster seven myth punch hobby comfort wild raise skin";
+
+typedef struct {
+    const char *name;
+    void (*setup)(host_client_t *client, uint8_t *apdu, size_t *apdu_len);
+} benchmark_t;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void setup_sign_message(host_client_t *client, uint8_t *apdu, size_t *apdu_len) {
+    static const char message[] =
+        "The Times 03/Jan/2009 Chancellor on brink of second bailout for banks.";
+    const uint8_t *chunks[2] = {(const uint8_t *) message, (const uint8_t *) message + 64};
+    const size_t chunk_lengths[2] = {64, sizeof(message) - 1 - 64};
+
+    // m/84'/1'/0'/0/0
+    // clang-format off
+    const uint8_t path[] = {
+        5,
+        0x80, 0x00, 0x00, 0x54,
+        0x80, 0x00, 0x00, 0x01,
+        0x80, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00
+    };
+    // clang-format on
+
+    size_t pos = 5;
+    memcpy(apdu + pos, path, sizeof(path));
+    pos += sizeof(path);
+    apdu[pos++] = sizeof(message) - 1;
+    host_client_add_known_list(client, chunks, chunk_lengths, 2, apdu + pos);
+    pos += 32;
+
+    apdu[0] = CLA_APP;
+    apdu[1] = INS_SIGN_MESSAGE;
+    apdu[2] = 0;
+    apdu[3] = 0;
+    apdu[4] = (uint8_t) (pos - 5);
+    *apdu_len = pos;
+}
+
+static void setup_get_wallet_address(host_client_t *client, uint8_t *apdu, size_t *apdu_len) {
+    const char *key_info =
+        "[f5acc2fd/84'/1'/0']tpubDCtKfsNyRhULjZ9XMS4VKKtVcPdVDi8MKUbcSD9MJDyjRu1A2ND5MiipozyyspBT9bg"
+        "8upEp7a8EAgFxNxXn1d7QkdbL52Ty5jiSLcxPt1P/**";
+
+    apdu[0] = CLA_APP;
+    apdu[1] = INS_GET_WALLET_ADDRESS;
+    apdu[2] = 0;
+    apdu[3] = 0;
+    apdu[4] = 1 + 32 + 32 + 1 + 4;
+    apdu[5] = 0;  // no display
+    host_client_add_policy_wallet(client, "", "wpkh(@0)", &key_info, 1, apdu + 6, NULL);
+    memset(apdu + 6 + 32, 0, 32 + 1 + 4);  // no hmac, receive address, index 0
+    *apdu_len = 5 + apdu[4];
+}
+
+static const benchmark_t BENCHMARKS[] = {
+    {"sign_message", setup_sign_message},
+    {"get_wallet_address (wpkh)", setup_get_wallet_address},
+};
+
+// Derives the /0/i pubkeys of an account from its serialized extended pubkey, as done for each key
+// when computing an address of a wallet policy
+static int derive_addresses_serialized(const serialized_extended_pubkey_t *account,
+                                       int n,
+                                       uint8_t out[static 33]) {
+    for (int i = 0; i < n; i++) {
+        serialized_extended_pubkey_t child;
+        if (bip32_CKDpub(account, 0, &child) < 0 || bip32_CKDpub(&child, i, &child) < 0) {
+            return -1;
+        }
+        memcpy(out, child.compressed_pubkey, 33);
+    }
+    return 0;
+}
+
+// Same as derive_addresses_serialized, using the point representation
+static int derive_addresses_point(const serialized_extended_pubkey_t *account,
+                                  int n,
+                                  uint8_t out[static 33]) {
+    for (int i = 0; i < n; i++) {
+        extended_pubkey_point_t node;
+        if (crypto_extended_pubkey_to_point(account, &node) < 0 ||
+            bip32_CKDpub_point(&node, 0, &node) < 0 || bip32_CKDpub_point(&node, i, &node) < 0) {
+            return -1;
+        }
+        crypto_get_compressed_pubkey(node.uncompressed_pubkey, out);
+    }
+    return 0;
+}
+
+typedef struct {
+    const char *name;
+    int (*run)(const serialized_extended_pubkey_t *account, int n, uint8_t out[static 33]);
+} primitive_benchmark_t;
+
+static const primitive_benchmark_t PRIMITIVE_BENCHMARKS[] = {
+    {"CKDpub /0/i (serialized)", derive_addresses_serialized},
+    {"CKDpub /0/i (point)", derive_addresses_point},
+};
+
+static int run_primitive_benchmarks(int n_iterations) {
+    // m/84'/1'/0'
+    const uint32_t path[] = {0x80000054, 0x80000001, 0x80000000};
+    serialized_extended_pubkey_t account;
+    if (crypto_get_extended_pubkey_at_path(path, 3, 0x043587CF, &account) < 0) {
+        fprintf(stderr, "failed to derive the account pubkey\n");
+        return 1;
+    }
+
+    uint8_t expected[33];
+    for (size_t b = 0; b < sizeof(PRIMITIVE_BENCHMARKS) / sizeof(PRIMITIVE_BENCHMARKS[0]); b++) {
+        uint8_t result[33];
+
+        double start = now();
+        uint64_t start_cycles = cycles();
+        int res = PRIMITIVE_BENCHMARKS[b].run(&account, n_iterations, result);
+        uint64_t elapsed_cycles = cycles() - start_cycles;
+        double elapsed = now() - start;
+
+        if (b == 0) {
+            memcpy(expected, result, sizeof(expected));
+        }
+        if (res < 0 || memcmp(result, expected, sizeof(expected)) != 0) {
+            fprintf(stderr, "%s: unexpected result\n", PRIMITIVE_BENCHMARKS[b].name);
+            return 1;
+        }
+
+        printf("%-28s %8.1f us/op  %10.0f cycles/op\n",
+               PRIMITIVE_BENCHMARKS[b].name,
+               elapsed * 1e6 / n_iterations,
+               (double) elapsed_cycles / n_iterations);
+    }
+    return 0;
+}
+
+// The byte-at-a-time base58 kernels that preceded the limb-based ones of src/common/base58.c, kept
+// as the baseline of the benchmarks
+static int base58_decode_bytewise(const char *in, size_t in_len, uint8_t *out, size_t out_len) {
+    static const char alphabet[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    uint8_t tmp[MAX_DEC_INPUT_SIZE] = {0};
+    uint8_t buffer[MAX_DEC_INPUT_SIZE] = {0};
+    size_t zero_count = 0;
+
+    if (in_len > MAX_DEC_INPUT_SIZE || in_len < 2) {
+        return -1;
+    }
+    for (size_t i = 0; i < in_len; i++) {
+        const char *digit = memchr(alphabet, in[i], 58);
+        if (digit == NULL) {
+            return -1;
+        }
+        tmp[i] = (uint8_t) (digit - alphabet);
+    }
+    while (zero_count < in_len && tmp[zero_count] == 0) {
+        ++zero_count;
+    }
+
+    size_t j = in_len;
+    size_t start_at = zero_count;
+    while (start_at < in_len) {
+        uint16_t remainder = 0;
+        for (size_t div_loop = start_at; div_loop < in_len; div_loop++) {
+            uint16_t tmp_div = remainder * 58 + tmp[div_loop];
+            tmp[div_loop] = (uint8_t) (tmp_div / 256);
+            remainder = tmp_div % 256;
+        }
+        if (tmp[start_at] == 0) {
+            ++start_at;
+        }
+        buffer[--j] = (uint8_t) remainder;
+    }
+    while (j < in_len && buffer[j] == 0) {
+        ++j;
+    }
+
+    size_t length = in_len - (j - zero_count);
+    if (out_len < length) {
+        return -1;
+    }
+    memmove(out, buffer + j - zero_count, length);
+    return (int) length;
+}
+
+static int base58_encode_bytewise(const uint8_t *in, size_t in_len, char *out, size_t out_len) {
+    static const char alphabet[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    uint8_t buffer[MAX_ENC_INPUT_SIZE * 138 / 100 + 1] = {0};
+    size_t zero_count = 0;
+
+    if (in_len > MAX_ENC_INPUT_SIZE) {
+        return -1;
+    }
+    while (zero_count < in_len && in[zero_count] == 0) {
+        ++zero_count;
+    }
+
+    size_t output_size = (in_len - zero_count) * 138 / 100 + 1;
+    size_t stop_at = output_size - 1;
+    for (size_t start_at = zero_count; start_at < in_len; start_at++) {
+        unsigned int carry = in[start_at];
+        size_t j;
+        for (j = output_size - 1; (int) j >= 0; j--) {
+            carry += 256 * buffer[j];
+            buffer[j] = carry % 58;
+            carry /= 58;
+            if (j <= stop_at - 1 && carry == 0) {
+                break;
+            }
+        }
+        stop_at = j;
+    }
+
+    size_t j = 0;
+    while (j < output_size && buffer[j] == 0) {
+        j += 1;
+    }
+    if (out_len < zero_count + output_size - j) {
+        return -1;
+    }
+    memset(out, alphabet[0], zero_count);
+    size_t i = zero_count;
+    while (j < output_size) {
+        out[i++] = alphabet[buffer[j++]];
+    }
+    return (int) i;
+}
+
+typedef struct {
+    const char *name;
+    int (*encode)(const uint8_t *in, size_t in_len, char *out, size_t out_len);
+    int (*decode)(const char *in, size_t in_len, uint8_t *out, size_t out_len);
+} base58_implementation_t;
+
+static const base58_implementation_t BASE58_IMPLEMENTATIONS[] = {
+    {"bytewise", base58_encode_bytewise, base58_decode_bytewise},
+    {"limbs", base58_encode, base58_decode},
+};
+
+// Encodes and decodes an extended pubkey without (78 bytes) and with (82 bytes) the checksum
+static int run_base58_benchmarks(int n_iterations) {
+    // m/84'/1'/0'
+    const uint32_t path[] = {0x80000054, 0x80000001, 0x80000000};
+    serialized_extended_pubkey_check_t payload;
+    if (crypto_get_extended_pubkey_at_path(path,
+                                           3,
+                                           0x043587CF,
+                                           &payload.serialized_extended_pubkey) < 0) {
+        fprintf(stderr, "failed to derive the account pubkey\n");
+        return 1;
+    }
+    crypto_get_checksum((uint8_t *) &payload.serialized_extended_pubkey, 78, payload.checksum);
+
+    // base58 is much faster than the derivations
+    n_iterations *= 100;
+
+    const size_t payload_lengths[] = {78, 82};
+    for (size_t l = 0; l < sizeof(payload_lengths) / sizeof(payload_lengths[0]); l++) {
+        size_t payload_len = payload_lengths[l];
+
+        char expected[MAX_DEC_INPUT_SIZE];
+        int expected_len = base58_encode_bytewise((const uint8_t *) &payload,
+                                                  payload_len,
+                                                  expected,
+                                                  sizeof(expected));
+
+        for (size_t b = 0; b < sizeof(BASE58_IMPLEMENTATIONS) / sizeof(BASE58_IMPLEMENTATIONS[0]);
+             b++) {
+            const base58_implementation_t *impl = &BASE58_IMPLEMENTATIONS[b];
+            char encoded[MAX_DEC_INPUT_SIZE];
+            uint8_t decoded[MAX_ENC_INPUT_SIZE];
+            int encoded_len = 0, decoded_len = 0;
+
+            double start = now();
+            uint64_t start_cycles = cycles();
+            for (int i = 0; i < n_iterations; i++) {
+                encoded_len = impl->encode((const uint8_t *) &payload,
+                                           payload_len,
+                                           encoded,
+                                           sizeof(encoded));
+            }
+            uint64_t encode_cycles = cycles() - start_cycles;
+            double encode_elapsed = now() - start;
+
+            start = now();
+            start_cycles = cycles();
+            for (int i = 0; i < n_iterations; i++) {
+                decoded_len = impl->decode(expected, expected_len, decoded, sizeof(decoded));
+            }
+            uint64_t decode_cycles = cycles() - start_cycles;
+            double decode_elapsed = now() - start;
+
+            if (encoded_len != expected_len || memcmp(encoded, expected, expected_len) != 0 ||
+                decoded_len != (int) payload_len || memcmp(decoded, &payload, payload_len) != 0) {
+                fprintf(stderr, "base58 (%s): unexpected result\n", impl->name);
+                return 1;
+            }
+
+            char name[32];
+            snprintf(name, sizeof(name), "base58_encode %zuB (%s)", payload_len, impl->name);
+            printf("%-28s %8.3f us/op  %10.0f cycles/op\n",
+                   name,
+                   encode_elapsed * 1e6 / n_iterations,
+                   (double) encode_cycles / n_iterations);
+            snprintf(name, sizeof(name), "base58_decode %zuB (%s)", payload_len, impl->name);
+            printf("%-28s %8.3f us/op  %10.0f cycles/op\n",
+                   name,
+                   decode_elapsed * 1e6 / n_iterations,
+                   (double) decode_cycles / n_iterations);
+        }
+    }
+    return 0;
+}
+
+// Size of the chunks of the transaction streamed by the client, as in the responses to GET_PREIMAGE
+#define RAWTX_CHUNK_SIZE 250
+
+#define RAWTX_MAX_SIZE 120000
+
+typedef struct {
+    uint8_t data[RAWTX_MAX_SIZE];
+    size_t len;
+    uint32_t rng;
+} rawtx_writer_t;
+
+static void rawtx_put(rawtx_writer_t *w, const void *data, size_t len) {
+    if (w->len + len > RAWTX_MAX_SIZE) abort();
+    memcpy(w->data + w->len, data, len);
+    w->len += len;
+}
+
+static void rawtx_put_u32(rawtx_writer_t *w, uint32_t value) {
+    uint8_t bytes[4] = {value, value >> 8, value >> 16, value >> 24};
+    rawtx_put(w, bytes, 4);
+}
+
+static void rawtx_put_varint(rawtx_writer_t *w, uint64_t value) {
+    uint8_t bytes[9];
+    rawtx_put(w, bytes, varint_write(bytes, 0, value));
+}
+
+// Appends len pseudo-random bytes, standing for hashes, signatures and the like
+static void rawtx_put_random(rawtx_writer_t *w, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        w->rng ^= w->rng << 13;
+        w->rng ^= w->rng >> 17;
+        w->rng ^= w->rng << 5;
+        uint8_t byte = (uint8_t) w->rng;
+        rawtx_put(w, &byte, 1);
+    }
+}
+
+static void rawtx_put_output(rawtx_writer_t *w, uint32_t value, size_t script_len) {
+    rawtx_put_u32(w, value);
+    rawtx_put_u32(w, 0);
+    rawtx_put_varint(w, script_len);
+    rawtx_put_random(w, script_len);
+}
+
+// Consolidation of 50 P2WSH 2-of-3 multisig inputs: each witness has two signatures and the
+// witness script
+static void build_rawtx_p2wsh_multisig(rawtx_writer_t *w) {
+    rawtx_put_u32(w, 2);
+    rawtx_put(w, (uint8_t[]){0x00, 0x01}, 2);
+    rawtx_put_varint(w, 50);
+    for (int i = 0; i < 50; i++) {
+        rawtx_put_random(w, 36);
+        rawtx_put_varint(w, 0);
+        rawtx_put_u32(w, 0xfffffffd);
+    }
+    rawtx_put_varint(w, 1);
+    rawtx_put_output(w, 123456789, 34);
+    for (int i = 0; i < 50; i++) {
+        rawtx_put_varint(w, 4);
+        rawtx_put_varint(w, 0);
+        rawtx_put_varint(w, 72);
+        rawtx_put_random(w, 72);
+        rawtx_put_varint(w, 71);
+        rawtx_put_random(w, 71);
+        rawtx_put_varint(w, 105);
+        rawtx_put_random(w, 105);
+    }
+    rawtx_put_u32(w, 0);
+}
+
+// Taproot script path spend with a large data envelope in the revealed script
+static void build_rawtx_taproot_envelope(rawtx_writer_t *w) {
+    rawtx_put_u32(w, 2);
+    rawtx_put(w, (uint8_t[]){0x00, 0x01}, 2);
+    rawtx_put_varint(w, 1);
+    rawtx_put_random(w, 36);
+    rawtx_put_varint(w, 0);
+    rawtx_put_u32(w, 0xfffffffd);
+    rawtx_put_varint(w, 1);
+    rawtx_put_output(w, 10000, 34);
+    rawtx_put_varint(w, 3);
+    rawtx_put_varint(w, 64);
+    rawtx_put_random(w, 64);
+    rawtx_put_varint(w, 100000);
+    rawtx_put_random(w, 100000);
+    rawtx_put_varint(w, 33);
+    rawtx_put_random(w, 33);
+    rawtx_put_u32(w, 0);
+}
+
+// Legacy batch payment: 20 P2PKH inputs and 100 P2PKH outputs
+static void build_rawtx_p2pkh_batch(rawtx_writer_t *w) {
+    rawtx_put_u32(w, 1);
+    rawtx_put_varint(w, 20);
+    for (int i = 0; i < 20; i++) {
+        rawtx_put_random(w, 36);
+        rawtx_put_varint(w, 107);
+        rawtx_put_random(w, 107);
+        rawtx_put_u32(w, 0xffffffff);
+    }
+    rawtx_put_varint(w, 100);
+    for (int i = 0; i < 100; i++) {
+        rawtx_put_output(w, 100000 + i, 25);
+    }
+    rawtx_put_u32(w, 0);
+}
+
+typedef struct {
+    const char *name;
+    void (*build)(rawtx_writer_t *w);
+    int output_index;
+    uint32_t output_value;
+} rawtx_benchmark_t;
+
+static const rawtx_benchmark_t RAWTX_BENCHMARKS[] = {
+    {"parse_rawtx p2wsh multisig", build_rawtx_p2wsh_multisig, 0, 123456789},
+    {"parse_rawtx tr envelope", build_rawtx_taproot_envelope, 0, 10000},
+    {"parse_rawtx p2pkh batch", build_rawtx_p2pkh_batch, 57, 100057},
+};
+
+// Parses transactions with the shapes of common mainnet transactions with large scriptSigs or
+// witnesses, streamed in chunks like in SIGN_PSBT
+static int run_rawtx_benchmarks(int n_iterations) {
+    static rawtx_writer_t writer;
+
+    for (size_t b = 0; b < sizeof(RAWTX_BENCHMARKS) / sizeof(RAWTX_BENCHMARKS[0]); b++) {
+        const rawtx_benchmark_t *bench = &RAWTX_BENCHMARKS[b];
+        writer.len = 0;
+        writer.rng = 0x12345678;
+        bench->build(&writer);
+
+        double start = now();
+        uint64_t start_cycles = cycles();
+        for (int i = 0; i < n_iterations; i++) {
+            cx_sha256_t hash_context;
+            psbt_parse_rawtx_state_t state;
+            txid_parser_outputs_t outputs;
+
+            cx_sha256_init(&hash_context);
+            psbt_parse_rawtx_init(&state, &hash_context, bench->output_index, &outputs);
+            for (size_t offset = 0; offset < writer.len; offset += RAWTX_CHUNK_SIZE) {
+                size_t chunk_len = writer.len - offset < RAWTX_CHUNK_SIZE ? writer.len - offset
+                                                                          : RAWTX_CHUNK_SIZE;
+                buffer_t chunk = buffer_create(writer.data + offset, chunk_len);
+                psbt_parse_rawtx_process(&state, &chunk);
+            }
+            if (psbt_parse_rawtx_finalize(&state) < 0 ||
+                outputs.vout_value != bench->output_value) {
+                fprintf(stderr, "%s: unexpected result\n", bench->name);
+                return 1;
+            }
+        }
+        uint64_t elapsed_cycles = cycles() - start_cycles;
+        double elapsed = now() - start;
+
+        printf("%-28s %8.1f MB/s   %10.1f cycles/byte  (%zu bytes)\n",
+               bench->name,
+               (double) writer.len * n_iterations / elapsed / 1e6,
+               (double) elapsed_cycles / n_iterations / writer.len,
+               writer.len);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int n_iterations = argc > 1 ? atoi(argv[1]) : 200;
+
+    libapp_init_from_mnemonic(TEST_MNEMONIC);
+
+    for (size_t b = 0; b < sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]); b++) {
+        host_client_t *client = host_client_new();
+        uint8_t apdu[LIBAPP_MAX_APDU_LENGTH], response[LIBAPP_MAX_APDU_LENGTH];
+        size_t apdu_len;
+        BENCHMARKS[b].setup(client, apdu, &apdu_len);
+
+        uint32_t apdu_count_start = libapp_get_apdu_count();
+        double start = now();
+        for (int i = 0; i < n_iterations; i++) {
+            int res = libapp_exchange(apdu,
+                                      apdu_len,
+                                      host_client_respond,
+                                      client,
+                                      response,
+                                      sizeof(response));
+            if (res < 2 || response[res - 2] != 0x90 || response[res - 1] != 0x00) {
+                fprintf(stderr, "%s: unexpected response (%d)\n", BENCHMARKS[b].name, res);
+                return 1;
+            }
+        }
+        double elapsed = now() - start;
+        uint32_t n_apdus = libapp_get_apdu_count() - apdu_count_start;
+
+        printf("%-28s %8.1f flows/s  %6.1f APDUs/flow\n",
+               BENCHMARKS[b].name,
+               n_iterations / elapsed,
+               (double) n_apdus / n_iterations);
+
+        host_client_free(client);
+    }
+
+    if (run_primitive_benchmarks(n_iterations) != 0) {
+        return 1;
+    }
+    if (run_base58_benchmarks(n_iterations) != 0) {
+        return 1;
+    }
+    return run_rawtx_benchmarks(n_iterations);
+}
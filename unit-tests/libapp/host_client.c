@@ -0,0 +1,658 @@
+/*****************************************************************************
+ *   Ledger App Bitcoin.
+ *   (c) 2021 Ledger SAS.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "os.h"
+#include "cx.h"
+
+#include "common/merkle.h"
+#include "common/varint.h"
+#include "handler/client_commands.h"
+
+#include "host_client.h"
+
+typedef struct {
+    uint8_t hash[32];
+    uint8_t *data;
+    size_t len;
+} preimage_t;
+
+typedef struct {
+    uint8_t root[32];
+    size_t n_leaves;
+    // levels[0] are the leaf hashes; levels[k][j] is the root of the perfect subtree with the
+    // leaves from j * 2^k to (j + 1) * 2^k - 1, for all such subtrees that are fully in the tree
+    uint8_t (*levels[MAX_MERKLE_TREE_DEPTH + 1])[32];
+    size_t n_levels;
+} tree_t;
+
+// Open-addressing hash table of the indices of entries whose first 32 bytes are a hash
+typedef struct {
+    size_t *slots;  // index + 1 of the entry, or 0 for empty slots
+    size_t capacity;  // 0, or a power of 2
+} hash_index_t;
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+} bytes_t;
+
+struct host_client_s {
+    preimage_t *preimages;
+    size_t n_preimages;
+    hash_index_t preimages_index;
+
+    tree_t *trees;
+    size_t n_trees;
+    hash_index_t trees_index;
+
+    // elements of the queue have all the same length
+    uint8_t *queue;
+    size_t queue_elem_len;
+    size_t queue_head;
+    size_t queue_count;
+
+    bytes_t *yielded;
+    size_t n_yielded;
+
+    size_t n_merkle_leaves_requests;
+};
+
+static void *xrealloc(void *ptr, size_t size) {
+    void *ret = realloc(ptr, size);
+    if (ret == NULL) abort();
+    return ret;
+}
+
+static void *xmemdup(const void *src, size_t len) {
+    void *ret = malloc(len > 0 ? len : 1);
+    if (ret == NULL) abort();
+    memcpy(ret, src, len);
+    return ret;
+}
+
+host_client_t *host_client_new(void) {
+    host_client_t *client = calloc(1, sizeof(host_client_t));
+    if (client == NULL) abort();
+    return client;
+}
+
+void host_client_free(host_client_t *client) {
+    if (client == NULL) return;
+
+    for (size_t i = 0; i < client->n_preimages; i++) free(client->preimages[i].data);
+    free(client->preimages);
+    free(client->preimages_index.slots);
+    for (size_t i = 0; i < client->n_trees; i++) {
+        for (size_t k = 0; k < client->trees[i].n_levels; k++) free(client->trees[i].levels[k]);
+    }
+    free(client->trees);
+    free(client->trees_index.slots);
+    free(client->queue);
+    host_client_clear_yielded(client);
+    free(client);
+}
+
+static size_t hash_index_slot(const uint8_t key[static 32], size_t capacity) {
+    size_t h;
+    memcpy(&h, key, sizeof(h));
+    return h & (capacity - 1);
+}
+
+/**
+ * Returns the index + 1 of the entry with the given key, or 0 if not found.
+ */
+static size_t hash_index_find(const hash_index_t *index,
+                              const void *entries,
+                              size_t entry_size,
+                              const uint8_t key[static 32]) {
+    if (index->capacity == 0) return 0;
+
+    for (size_t pos = hash_index_slot(key, index->capacity); index->slots[pos] != 0;
+         pos = (pos + 1) & (index->capacity - 1)) {
+        const uint8_t *entry = (const uint8_t *) entries + (index->slots[pos] - 1) * entry_size;
+        if (memcmp(entry, key, 32) == 0) return index->slots[pos];
+    }
+    return 0;
+}
+
+/**
+ * Adds the last of the n_entries entries to the index, growing it if needed.
+ */
+static void hash_index_add(hash_index_t *index,
+                           const void *entries,
+                           size_t entry_size,
+                           size_t n_entries) {
+    size_t first = n_entries - 1;
+    if (2 * n_entries > index->capacity) {
+        // grow, and reinsert all the entries
+        free(index->slots);
+        index->capacity = index->capacity == 0 ? 64 : 2 * index->capacity;
+        index->slots = calloc(index->capacity, sizeof(size_t));
+        if (index->slots == NULL) abort();
+        first = 0;
+    }
+
+    for (size_t i = first; i < n_entries; i++) {
+        const uint8_t *key = (const uint8_t *) entries + i * entry_size;
+        size_t pos = hash_index_slot(key, index->capacity);
+        while (index->slots[pos] != 0) pos = (pos + 1) & (index->capacity - 1);
+        index->slots[pos] = i + 1;
+    }
+}
+
+static size_t largest_power_of_2_less_than(size_t n) {
+    size_t p = 1;
+    while (2 * p < n) p *= 2;
+    return p;
+}
+
+static void merkle_root_rec(const uint8_t (*leaves)[32], size_t size, uint8_t out[static 32]) {
+    if (size == 1) {
+        memcpy(out, leaves[0], 32);
+        return;
+    }
+    size_t lsize = largest_power_of_2_less_than(size);
+    uint8_t left[32], right[32];
+    merkle_root_rec(leaves, lsize, left);
+    merkle_root_rec(leaves + lsize, size - lsize, right);
+    merkle_combine_hashes(left, right, out);
+}
+
+void host_merkle_root(const uint8_t (*leaf_hashes)[32], size_t n_leaves, uint8_t root[static 32]) {
+    if (n_leaves == 0) {
+        memset(root, 0, 32);
+    } else {
+        merkle_root_rec(leaf_hashes, n_leaves, root);
+    }
+}
+
+/**
+ * Computes the root of the subtree with the leaves from start to start + size - 1, using the
+ * cached roots of the perfect subtrees. As in the recursive definition of the tree, start is a
+ * multiple of the largest power of 2 smaller than size.
+ */
+static void tree_subtree_root(const tree_t *tree, size_t start, size_t size, uint8_t out[static 32]) {
+    size_t level = 0;
+    while (((size_t) 1 << level) < size) ++level;
+
+    if (((size_t) 1 << level) == size) {
+        memcpy(out, tree->levels[level][start >> level], 32);
+        return;
+    }
+
+    size_t lsize = largest_power_of_2_less_than(size);
+    uint8_t left[32], right[32];
+    tree_subtree_root(tree, start, lsize, left);
+    tree_subtree_root(tree, start + lsize, size - lsize, right);
+    merkle_combine_hashes(left, right, out);
+}
+
+// Appends the proof for the leaf at the given index, from the bottom of the tree to the top
+static size_t merkle_proof_rec(const tree_t *tree,
+                               size_t start,
+                               size_t size,
+                               size_t index,
+                               uint8_t (*proof)[32]) {
+    if (size == 1) return 0;
+
+    size_t lsize = largest_power_of_2_less_than(size);
+    size_t n;
+    if (index < lsize) {
+        n = merkle_proof_rec(tree, start, lsize, index, proof);
+        tree_subtree_root(tree, start + lsize, size - lsize, proof[n]);
+    } else {
+        n = merkle_proof_rec(tree, start + lsize, size - lsize, index - lsize, proof);
+        tree_subtree_root(tree, start, lsize, proof[n]);
+    }
+    return n + 1;
+}
+
+void host_client_add_known_preimage(host_client_t *client, const uint8_t *element, size_t len) {
+    uint8_t hash[32];
+    cx_hash_sha256(element, len, hash, 32);
+    if (hash_index_find(&client->preimages_index, client->preimages, sizeof(preimage_t), hash)) {
+        return;  // already known
+    }
+
+    client->preimages =
+        xrealloc(client->preimages, (client->n_preimages + 1) * sizeof(client->preimages[0]));
+    preimage_t *p = &client->preimages[client->n_preimages++];
+    memcpy(p->hash, hash, 32);
+    p->data = xmemdup(element, len);
+    p->len = len;
+
+    hash_index_add(&client->preimages_index,
+                   client->preimages,
+                   sizeof(preimage_t),
+                   client->n_preimages);
+}
+
+void host_client_add_known_list(host_client_t *client,
+                                const uint8_t *const elements[],
+                                const size_t lengths[],
+                                size_t n_elements,
+                                uint8_t root[static 32]) {
+    tree_t tree;
+    memset(&tree, 0, sizeof(tree));
+    tree.n_leaves = n_elements;
+    tree.levels[0] = xrealloc(NULL, (n_elements > 0 ? n_elements : 1) * 32);
+    tree.n_levels = 1;
+
+    for (size_t i = 0; i < n_elements; i++) {
+        uint8_t *prefixed = xrealloc(NULL, lengths[i] + 1);
+        prefixed[0] = 0x00;
+        memcpy(prefixed + 1, elements[i], lengths[i]);
+        host_client_add_known_preimage(client, prefixed, lengths[i] + 1);
+        free(prefixed);
+
+        merkle_compute_element_hash(elements[i], lengths[i], tree.levels[0][i]);
+    }
+
+    // cache the roots of all the perfect subtrees
+    for (size_t k = 1; ((size_t) 1 << k) <= n_elements; k++) {
+        size_t n_nodes = n_elements >> k;
+        tree.levels[k] = xrealloc(NULL, n_nodes * 32);
+        for (size_t j = 0; j < n_nodes; j++) {
+            merkle_combine_hashes(tree.levels[k - 1][2 * j],
+                                  tree.levels[k - 1][2 * j + 1],
+                                  tree.levels[k][j]);
+        }
+        tree.n_levels = k + 1;
+    }
+
+    if (n_elements == 0) {
+        memset(tree.root, 0, 32);
+    } else {
+        tree_subtree_root(&tree, 0, n_elements, tree.root);
+    }
+
+    if (root != NULL) {
+        memcpy(root, tree.root, 32);
+    }
+
+    if (hash_index_find(&client->trees_index, client->trees, sizeof(tree_t), tree.root)) {
+        // already known
+        for (size_t k = 0; k < tree.n_levels; k++) free(tree.levels[k]);
+        return;
+    }
+
+    client->trees = xrealloc(client->trees, (client->n_trees + 1) * sizeof(client->trees[0]));
+    client->trees[client->n_trees++] = tree;
+    hash_index_add(&client->trees_index, client->trees, sizeof(tree_t), client->n_trees);
+}
+
+typedef struct {
+    const uint8_t *key;
+    size_t key_len;
+    const uint8_t *value;
+    size_t value_len;
+} kv_t;
+
+static int compare_kv(const void *a, const void *b) {
+    const kv_t *x = a, *y = b;
+    size_t min_len = MIN(x->key_len, y->key_len);
+    int c = memcmp(x->key, y->key, min_len);
+    if (c != 0) return c;
+    return (x->key_len > y->key_len) - (x->key_len < y->key_len);
+}
+
+size_t host_client_add_known_mapping(host_client_t *client,
+                                     const uint8_t *const keys[],
+                                     const size_t key_lengths[],
+                                     const uint8_t *const values[],
+                                     const size_t value_lengths[],
+                                     size_t n_pairs,
+                                     uint8_t commitment[static 9 + 32 + 32]) {
+    kv_t *items = xrealloc(NULL, (n_pairs > 0 ? n_pairs : 1) * sizeof(kv_t));
+    for (size_t i = 0; i < n_pairs; i++) {
+        items[i] = (kv_t){keys[i], key_lengths[i], values[i], value_lengths[i]};
+    }
+    qsort(items, n_pairs, sizeof(kv_t), compare_kv);
+
+    const uint8_t **sorted_keys = xrealloc(NULL, (n_pairs > 0 ? n_pairs : 1) * sizeof(uint8_t *));
+    const uint8_t **sorted_values = xrealloc(NULL, (n_pairs > 0 ? n_pairs : 1) * sizeof(uint8_t *));
+    size_t *sorted_key_lengths = xrealloc(NULL, (n_pairs > 0 ? n_pairs : 1) * sizeof(size_t));
+    size_t *sorted_value_lengths = xrealloc(NULL, (n_pairs > 0 ? n_pairs : 1) * sizeof(size_t));
+    for (size_t i = 0; i < n_pairs; i++) {
+        sorted_keys[i] = items[i].key;
+        sorted_key_lengths[i] = items[i].key_len;
+        sorted_values[i] = items[i].value;
+        sorted_value_lengths[i] = items[i].value_len;
+    }
+
+    uint8_t keys_root[32], values_root[32];
+    host_client_add_known_list(client, sorted_keys, sorted_key_lengths, n_pairs, keys_root);
+    host_client_add_known_list(client, sorted_values, sorted_value_lengths, n_pairs, values_root);
+
+    free(items);
+    free(sorted_keys);
+    free(sorted_values);
+    free(sorted_key_lengths);
+    free(sorted_value_lengths);
+
+    uint8_t out[9 + 32 + 32];
+    size_t len = varint_write(out, 0, n_pairs);
+    memcpy(out + len, keys_root, 32);
+    memcpy(out + len + 32, values_root, 32);
+    len += 64;
+    if (commitment != NULL) {
+        memcpy(commitment, out, len);
+    }
+    return len;
+}
+
+static size_t add_policy_wallet(host_client_t *client,
+                                uint8_t type,
+                                const char *name,
+                                const char *policy_map,
+                                const uint8_t *const keys_info[],
+                                const size_t key_info_lengths[],
+                                size_t n_keys,
+                                uint8_t wallet_id[static 32],
+                                uint8_t *serialized_wallet) {
+    uint8_t keys_root[32];
+    host_client_add_known_list(client, keys_info, key_info_lengths, n_keys, keys_root);
+
+    size_t name_len = strlen(name), policy_map_len = strlen(policy_map);
+    uint8_t *ser = xrealloc(NULL, 2 + name_len + 9 + policy_map_len + 9 + 32);
+    size_t pos = 0;
+    ser[pos++] = type;
+    ser[pos++] = (uint8_t) name_len;
+    memcpy(ser + pos, name, name_len);
+    pos += name_len;
+    pos += varint_write(ser, pos, policy_map_len);
+    memcpy(ser + pos, policy_map, policy_map_len);
+    pos += policy_map_len;
+    pos += varint_write(ser, pos, n_keys);
+    memcpy(ser + pos, keys_root, 32);
+    pos += 32;
+
+    host_client_add_known_preimage(client, ser, pos);
+    cx_hash_sha256(ser, pos, wallet_id, 32);
+    if (serialized_wallet != NULL) {
+        memcpy(serialized_wallet, ser, pos);
+    }
+    free(ser);
+    return pos;
+}
+
+size_t host_client_add_policy_wallet(host_client_t *client,
+                                     const char *name,
+                                     const char *policy_map,
+                                     const char *const keys_info[],
+                                     size_t n_keys,
+                                     uint8_t wallet_id[static 32],
+                                     uint8_t *serialized_wallet) {
+    size_t *lengths = xrealloc(NULL, (n_keys > 0 ? n_keys : 1) * sizeof(size_t));
+    for (size_t i = 0; i < n_keys; i++) {
+        lengths[i] = strlen(keys_info[i]);
+    }
+    size_t len = add_policy_wallet(client,
+                                   0x01,  // WALLET_TYPE_POLICY_MAP
+                                   name,
+                                   policy_map,
+                                   (const uint8_t *const *) keys_info,
+                                   lengths,
+                                   n_keys,
+                                   wallet_id,
+                                   serialized_wallet);
+    free(lengths);
+    return len;
+}
+
+size_t host_client_add_policy_wallet_binary_keys(host_client_t *client,
+                                                 const char *name,
+                                                 const char *policy_map,
+                                                 const uint8_t *const keys_info[],
+                                                 const size_t key_info_lengths[],
+                                                 size_t n_keys,
+                                                 uint8_t wallet_id[static 32],
+                                                 uint8_t *serialized_wallet) {
+    return add_policy_wallet(client,
+                             0x02,  // WALLET_TYPE_POLICY_MAP_BINARY_KEYS
+                             name,
+                             policy_map,
+                             keys_info,
+                             key_info_lengths,
+                             n_keys,
+                             wallet_id,
+                             serialized_wallet);
+}
+
+size_t host_client_get_yielded_count(const host_client_t *client) {
+    return client->n_yielded;
+}
+
+const uint8_t *host_client_get_yielded(const host_client_t *client, size_t i, size_t *len) {
+    if (i >= client->n_yielded) return NULL;
+    *len = client->yielded[i].len;
+    return client->yielded[i].data;
+}
+
+void host_client_clear_yielded(host_client_t *client) {
+    for (size_t i = 0; i < client->n_yielded; i++) free(client->yielded[i].data);
+    free(client->yielded);
+    client->yielded = NULL;
+    client->n_yielded = 0;
+}
+
+size_t host_client_get_merkle_leaves_count(const host_client_t *client) {
+    return client->n_merkle_leaves_requests;
+}
+
+static void queue_push(host_client_t *client, const uint8_t *elements, size_t n, size_t elem_len) {
+    if (client->queue_count == 0) {
+        client->queue_head = 0;
+        client->queue_elem_len = elem_len;
+    } else if (client->queue_elem_len != elem_len) {
+        abort();
+    }
+    size_t start = client->queue_head + client->queue_count;
+    client->queue = xrealloc(client->queue, (start + n) * elem_len);
+    memcpy(client->queue + start * elem_len, elements, n * elem_len);
+    client->queue_count += n;
+}
+
+static int handle_yield(host_client_t *client, const uint8_t *req, size_t req_len) {
+    client->yielded = xrealloc(client->yielded, (client->n_yielded + 1) * sizeof(bytes_t));
+    client->yielded[client->n_yielded].data = xmemdup(req + 1, req_len - 1);
+    client->yielded[client->n_yielded].len = req_len - 1;
+    ++client->n_yielded;
+    return 0;
+}
+
+static int handle_get_preimage(host_client_t *client,
+                               const uint8_t *req,
+                               size_t req_len,
+                               uint8_t *resp) {
+    if (req_len != 1 + 1 + 32 || req[1] != 0) {
+        return -1;
+    }
+    const uint8_t *hash = req + 2;
+
+    size_t found = hash_index_find(&client->preimages_index, client->preimages, sizeof(preimage_t), hash);
+    if (found != 0) {
+        const preimage_t *p = &client->preimages[found - 1];
+
+        size_t pos = varint_write(resp, 0, p->len);
+        size_t max_payload_size = 255 - pos - 1;
+        size_t payload_size = MIN(max_payload_size, p->len);
+
+        resp[pos++] = (uint8_t) payload_size;
+        memcpy(resp + pos, p->data, payload_size);
+        pos += payload_size;
+
+        if (payload_size < p->len) {
+            queue_push(client, p->data + payload_size, p->len - payload_size, 1);
+        }
+        return (int) pos;
+    }
+    return -1;
+}
+
+static const tree_t *find_tree(const host_client_t *client, const uint8_t root[static 32]) {
+    size_t found = hash_index_find(&client->trees_index, client->trees, sizeof(tree_t), root);
+    return found != 0 ? &client->trees[found - 1] : NULL;
+}
+
+static int handle_get_merkle_leaf_proof(host_client_t *client,
+                                        const uint8_t *req,
+                                        size_t req_len,
+                                        uint8_t *resp) {
+    uint64_t tree_size, leaf_index;
+    size_t pos = 1;
+    int n;
+
+    if (req_len < pos + 32) return -1;
+    const uint8_t *root = req + pos;
+    pos += 32;
+    if ((n = varint_read(req + pos, req_len - pos, &tree_size)) < 0) return -1;
+    pos += n;
+    if ((n = varint_read(req + pos, req_len - pos, &leaf_index)) < 0) return -1;
+    pos += n;
+    if (pos != req_len) return -1;
+
+    const tree_t *tree = find_tree(client, root);
+    if (tree == NULL || leaf_index >= tree_size || tree->n_leaves != tree_size) return -1;
+    if (client->queue_count != 0) return -1;
+
+    uint8_t proof[MAX_MERKLE_TREE_DEPTH][32];
+    size_t proof_len = merkle_proof_rec(tree, 0, tree->n_leaves, leaf_index, proof);
+
+    size_t n_response_elements = MIN((255 - 32 - 1 - 1) / 32, proof_len);
+    if (proof_len > n_response_elements) {
+        queue_push(client, proof[n_response_elements], proof_len - n_response_elements, 32);
+    }
+
+    memcpy(resp, tree->levels[0][leaf_index], 32);
+    resp[32] = (uint8_t) proof_len;
+    resp[33] = (uint8_t) n_response_elements;
+    memcpy(resp + 34, proof, 32 * n_response_elements);
+    return (int) (34 + 32 * n_response_elements);
+}
+
+static int handle_get_merkle_leaf_index(host_client_t *client,
+                                        const uint8_t *req,
+                                        size_t req_len,
+                                        uint8_t *resp) {
+    if (req_len != 1 + 32 + 32) return -1;
+
+    const tree_t *tree = find_tree(client, req + 1);
+    if (tree == NULL) return -1;
+
+    for (size_t i = 0; i < tree->n_leaves; i++) {
+        if (memcmp(tree->levels[0][i], req + 1 + 32, 32) == 0) {
+            resp[0] = 1;
+            return 1 + varint_write(resp, 1, i);
+        }
+    }
+    resp[0] = 0;
+    return 1 + varint_write(resp, 1, 0);
+}
+
+static int handle_get_merkle_leaves(host_client_t *client,
+                                    const uint8_t *req,
+                                    size_t req_len,
+                                    uint8_t *resp) {
+    uint64_t tree_size, start_index;
+    size_t pos = 1;
+    int n;
+
+    if (req_len < pos + 32) return -1;
+    const uint8_t *root = req + pos;
+    pos += 32;
+    if ((n = varint_read(req + pos, req_len - pos, &tree_size)) < 0) return -1;
+    pos += n;
+    if ((n = varint_read(req + pos, req_len - pos, &start_index)) < 0) return -1;
+    pos += n;
+    if (pos != req_len) return -1;
+
+    ++client->n_merkle_leaves_requests;
+
+    const tree_t *tree = find_tree(client, root);
+    if (tree == NULL || start_index >= tree_size || tree->n_leaves != tree_size) return -1;
+
+    // as many complete leaf preimages (without the 0x00 prefix) as fit in the response
+    size_t resp_len = 1;
+    size_t n_leaves = 0;
+    for (size_t i = start_index; i < tree->n_leaves && n_leaves < 255; i++) {
+        size_t found = hash_index_find(&client->preimages_index,
+                                       client->preimages,
+                                       sizeof(preimage_t),
+                                       tree->levels[0][i]);
+        if (found == 0) return -1;
+        const preimage_t *p = &client->preimages[found - 1];
+
+        if (p->len < 1 || resp_len + 1 + (p->len - 1) > 255) break;
+
+        resp[resp_len] = (uint8_t) (p->len - 1);
+        memcpy(resp + resp_len + 1, p->data + 1, p->len - 1);
+        resp_len += 1 + (p->len - 1);
+        ++n_leaves;
+    }
+    if (n_leaves == 0) return -1;  // the leaf does not fit in a response
+
+    resp[0] = (uint8_t) n_leaves;
+    return (int) resp_len;
+}
+
+static int handle_get_more_elements(host_client_t *client, size_t req_len, uint8_t *resp) {
+    if (req_len != 1 || client->queue_count == 0) return -1;
+
+    size_t elem_len = client->queue_elem_len;
+    size_t n_added = 0;
+    while (client->queue_count > 0 && (n_added + 1) * elem_len <= 253) {
+        memcpy(resp + 2 + n_added * elem_len,
+               client->queue + client->queue_head * elem_len,
+               elem_len);
+        ++client->queue_head;
+        --client->queue_count;
+        ++n_added;
+    }
+    resp[0] = (uint8_t) n_added;
+    resp[1] = (uint8_t) elem_len;
+    return (int) (2 + n_added * elem_len);
+}
+
+int host_client_respond(void *ctx, const uint8_t *request, size_t request_len, uint8_t *response) {
+    host_client_t *client = ctx;
+
+    if (request_len == 0) {
+        return -1;
+    }
+
+    switch (request[0]) {
+        case CCMD_YIELD:
+            return handle_yield(client, request, request_len);
+        case CCMD_GET_PREIMAGE:
+            return handle_get_preimage(client, request, request_len, response);
+        case CCMD_GET_MERKLE_LEAF_PROOF:
+            return handle_get_merkle_leaf_proof(client, request, request_len, response);
+        case CCMD_GET_MERKLE_LEAF_INDEX:
+            return handle_get_merkle_leaf_index(client, request, request_len, response);
+        case CCMD_GET_MERKLE_LEAVES:
+            return handle_get_merkle_leaves(client, request, request_len, response);
+        case CCMD_GET_MORE_ELEMENTS:
+            return handle_get_more_elements(client, request_len, response);
+        default:
+            return -1;
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+/*
+ * C port of the client-side command interpreter of the Python client
+ * (bitcoin_client/ledger_bitcoin/client_command.py), to be used as the responder of
+ * libapp_exchange.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct host_client_s host_client_t;
+
+/**
+ * Allocates a new client interpreter with no known preimages or Merkle trees.
+ */
+host_client_t *host_client_new(void);
+
+/**
+ * Frees a client interpreter allocated with host_client_new.
+ */
+void host_client_free(host_client_t *client);
+
+/**
+ * Adds a preimage; the client answers GET_PREIMAGE requests for sha256(element).
+ */
+void host_client_add_known_preimage(host_client_t *client, const uint8_t *element, size_t len);
+
+/**
+ * Adds a Merkleized list of elements: the Merkle tree of the element hashes, and the preimages of
+ * all the leaves (with the 0x00 prefix).
+ *
+ * @param[out] root
+ *   If not NULL, receives the Merkle root of the list.
+ */
+void host_client_add_known_list(host_client_t *client,
+                                const uint8_t *const elements[],
+                                const size_t lengths[],
+                                size_t n_elements,
+                                uint8_t root[static 32]);
+
+/**
+ * Adds a Merkleized map: the Merkleized lists of keys and values, sorted by key.
+ *
+ * @param[out] commitment
+ *   If not NULL, receives the serialized commitment of the map (varint size, keys root, values
+ *   root).
+ *
+ * @return the length of the commitment.
+ */
+size_t host_client_add_known_mapping(host_client_t *client,
+                                     const uint8_t *const keys[],
+                                     const size_t key_lengths[],
+                                     const uint8_t *const values[],
+                                     const size_t value_lengths[],
+                                     size_t n_pairs,
+                                     uint8_t commitment[static 9 + 32 + 32]);
+
+/**
+ * Adds the serialization of a policy map wallet, and the Merkleized list of its keys information.
+ *
+ * @param[out] wallet_id
+ *   Receives the wallet id, that is the sha256 of the serialized wallet.
+ * @param[out] serialized_wallet
+ *   If not NULL, receives the serialized wallet, as sent in the REGISTER_WALLET command. It must be
+ *   at least 2 + strlen(name) + 9 + strlen(policy_map) + 9 + 32 bytes long.
+ *
+ * @return the length of the serialized wallet.
+ */
+size_t host_client_add_policy_wallet(host_client_t *client,
+                                     const char *name,
+                                     const char *policy_map,
+                                     const char *const keys_info[],
+                                     size_t n_keys,
+                                     uint8_t wallet_id[static 32],
+                                     uint8_t *serialized_wallet);
+
+/**
+ * Same as host_client_add_policy_wallet, for a wallet policy whose key informations are in the
+ * binary encoding (WALLET_TYPE_POLICY_MAP_BINARY_KEYS).
+ */
+size_t host_client_add_policy_wallet_binary_keys(host_client_t *client,
+                                                 const char *name,
+                                                 const char *policy_map,
+                                                 const uint8_t *const keys_info[],
+                                                 const size_t key_info_lengths[],
+                                                 size_t n_keys,
+                                                 uint8_t wallet_id[static 32],
+                                                 uint8_t *serialized_wallet);
+
+/**
+ * Returns the number of values received with the YIELD client command.
+ */
+size_t host_client_get_yielded_count(const host_client_t *client);
+
+/**
+ * Returns the i-th value received with the YIELD client command, and stores its length in len.
+ */
+const uint8_t *host_client_get_yielded(const host_client_t *client, size_t i, size_t *len);
+
+/**
+ * Forgets all the yielded values.
+ */
+void host_client_clear_yielded(host_client_t *client);
+
+/**
+ * Returns the number of GET_MERKLE_LEAVES client commands received.
+ */
+size_t host_client_get_merkle_leaves_count(const host_client_t *client);
+
+/**
+ * Responder for libapp_exchange; ctx must be a host_client_t.
+ */
+int host_client_respond(void *ctx, const uint8_t *request, size_t request_len, uint8_t *response);
+
+/**
+ * Computes the root of the Merkle tree with the given leaf hashes, as defined in
+ * src/common/merkle.h. The root of the empty tree is all zeros.
+ */
+void host_merkle_root(const uint8_t (*leaf_hashes)[32], size_t n_leaves, uint8_t root[static 32]);
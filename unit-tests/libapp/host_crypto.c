@@ -0,0 +1,1278 @@
+/*****************************************************************************
+ *   Ledger App Bitcoin.
+ *   (c) 2021 Ledger SAS.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Software implementation of the subset of the BOLOS cryptographic API used by the app, for the
+ * host-native libapp build: SHA-256, SHA-512, RIPEMD-160, HMAC, modular arithmetic for moduli close
+ * to 2^256, secp256k1 point arithmetic, ECDSA (RFC6979, low-S) and BIP-340 Schnorr signatures, and
+ * BIP-32/SLIP-21 derivations from the seed set with libapp_init.
+ *
+ * Nothing here is constant-time: this code must never be used with real keys.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "os.h"
+#include "cx.h"
+
+#include "host_crypto.h"
+
+/* ---------------------------------------------------------------------------------------------- */
+/* Hashes                                                                                          */
+/* ---------------------------------------------------------------------------------------------- */
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static void sha256_compress(uint32_t acc[8], const uint8_t block[64]) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t) block[4 * i] << 24) | ((uint32_t) block[4 * i + 1] << 16) |
+               ((uint32_t) block[4 * i + 2] << 8) | block[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = acc[0], b = acc[1], c = acc[2], d = acc[3];
+    uint32_t e = acc[4], f = acc[5], g = acc[6], h = acc[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t S1 = ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + S1 + ch + SHA256_K[i] + w[i];
+        uint32_t S0 = ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = S0 + maj;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    acc[0] += a;
+    acc[1] += b;
+    acc[2] += c;
+    acc[3] += d;
+    acc[4] += e;
+    acc[5] += f;
+    acc[6] += g;
+    acc[7] += h;
+}
+
+int cx_sha256_init(cx_sha256_t *hash) {
+    static const uint32_t iv[8] = {0x6a09e667,
+                                   0xbb67ae85,
+                                   0x3c6ef372,
+                                   0xa54ff53a,
+                                   0x510e527f,
+                                   0x9b05688c,
+                                   0x1f83d9ab,
+                                   0x5be0cd19};
+    memset(hash, 0, sizeof(*hash));
+    hash->header.algo = CX_SHA256;
+    memcpy(hash->acc, iv, sizeof(iv));
+    return CX_SHA256;
+}
+
+cx_err_t cx_sha256_init_no_throw(cx_sha256_t *hash) {
+    cx_sha256_init(hash);
+    return CX_OK;
+}
+
+cx_err_t cx_sha256_update(cx_sha256_t *hash, const uint8_t *in, size_t in_len) {
+    while (in_len > 0) {
+        size_t n = MIN(in_len, 64 - hash->blen);
+        memcpy(hash->block + hash->blen, in, n);
+        hash->blen += n;
+        in += n;
+        in_len -= n;
+        if (hash->blen == 64) {
+            sha256_compress(hash->acc, hash->block);
+            hash->header.counter++;
+            hash->blen = 0;
+        }
+    }
+    return CX_OK;
+}
+
+cx_err_t cx_sha256_final(cx_sha256_t *hash, uint8_t *out) {
+    uint64_t bitlen = ((uint64_t) hash->header.counter * 64 + hash->blen) * 8;
+
+    hash->block[hash->blen++] = 0x80;
+    if (hash->blen > 56) {
+        memset(hash->block + hash->blen, 0, 64 - hash->blen);
+        sha256_compress(hash->acc, hash->block);
+        hash->blen = 0;
+    }
+    memset(hash->block + hash->blen, 0, 56 - hash->blen);
+    for (int i = 0; i < 8; i++) {
+        hash->block[56 + i] = (uint8_t) (bitlen >> (56 - 8 * i));
+    }
+    sha256_compress(hash->acc, hash->block);
+
+    // out may alias the accumulator (see get_merkle_preimage), hence the temporary buffer
+    uint8_t digest[32];
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = (uint8_t) (hash->acc[i] >> 24);
+        digest[4 * i + 1] = (uint8_t) (hash->acc[i] >> 16);
+        digest[4 * i + 2] = (uint8_t) (hash->acc[i] >> 8);
+        digest[4 * i + 3] = (uint8_t) hash->acc[i];
+    }
+    memcpy(out, digest, sizeof(digest));
+    return CX_OK;
+}
+
+size_t cx_hash_sha256(const uint8_t *in, size_t len, uint8_t *out, size_t out_len) {
+    if (out_len < CX_SHA256_SIZE) {
+        return 0;
+    }
+    cx_sha256_t ctx;
+    cx_sha256_init(&ctx);
+    cx_sha256_update(&ctx, in, len);
+    cx_sha256_final(&ctx, out);
+    return CX_SHA256_SIZE;
+}
+
+static const uint64_t SHA512_K[80] = {
+    0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc,
+    0x3956c25bf348b538, 0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118,
+    0xd807aa98a3030242, 0x12835b0145706fbe, 0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2,
+    0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235, 0xc19bf174cf692694,
+    0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+    0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5,
+    0x983e5152ee66dfab, 0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4,
+    0xc6e00bf33da88fc2, 0xd5a79147930aa725, 0x06ca6351e003826f, 0x142929670a0e6e70,
+    0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed, 0x53380d139d95b3df,
+    0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+    0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30,
+    0xd192e819d6ef5218, 0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8,
+    0x19a4c116b8d2d0c8, 0x1e376c085141ab53, 0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8,
+    0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373, 0x682e6ff3d6b2b8a3,
+    0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+    0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b,
+    0xca273eceea26619c, 0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178,
+    0x06f067aa72176fba, 0x0a637dc5a2c898a6, 0x113f9804bef90dae, 0x1b710b35131c471b,
+    0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc, 0x431d67c49c100d4c,
+    0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817};
+
+static void sha512_compress(uint64_t acc[8], const uint8_t block[128]) {
+    uint64_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = 0;
+        for (int j = 0; j < 8; j++) {
+            w[i] = (w[i] << 8) | block[8 * i + j];
+        }
+    }
+    for (int i = 16; i < 80; i++) {
+        uint64_t s0 = ROR64(w[i - 15], 1) ^ ROR64(w[i - 15], 8) ^ (w[i - 15] >> 7);
+        uint64_t s1 = ROR64(w[i - 2], 19) ^ ROR64(w[i - 2], 61) ^ (w[i - 2] >> 6);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint64_t a = acc[0], b = acc[1], c = acc[2], d = acc[3];
+    uint64_t e = acc[4], f = acc[5], g = acc[6], h = acc[7];
+    for (int i = 0; i < 80; i++) {
+        uint64_t S1 = ROR64(e, 14) ^ ROR64(e, 18) ^ ROR64(e, 41);
+        uint64_t ch = (e & f) ^ (~e & g);
+        uint64_t t1 = h + S1 + ch + SHA512_K[i] + w[i];
+        uint64_t S0 = ROR64(a, 28) ^ ROR64(a, 34) ^ ROR64(a, 39);
+        uint64_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint64_t t2 = S0 + maj;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    acc[0] += a;
+    acc[1] += b;
+    acc[2] += c;
+    acc[3] += d;
+    acc[4] += e;
+    acc[5] += f;
+    acc[6] += g;
+    acc[7] += h;
+}
+
+int cx_sha512_init(cx_sha512_t *hash) {
+    static const uint64_t iv[8] = {0x6a09e667f3bcc908,
+                                   0xbb67ae8584caa73b,
+                                   0x3c6ef372fe94f82b,
+                                   0xa54ff53a5f1d36f1,
+                                   0x510e527fade682d1,
+                                   0x9b05688c2b3e6c1f,
+                                   0x1f83d9abfb41bd6b,
+                                   0x5be0cd19137e2179};
+    memset(hash, 0, sizeof(*hash));
+    hash->header.algo = CX_SHA512;
+    memcpy(hash->acc, iv, sizeof(iv));
+    return CX_SHA512;
+}
+
+cx_err_t cx_sha512_update(cx_sha512_t *hash, const uint8_t *in, size_t in_len) {
+    while (in_len > 0) {
+        size_t n = MIN(in_len, 128 - hash->blen);
+        memcpy(hash->block + hash->blen, in, n);
+        hash->blen += n;
+        in += n;
+        in_len -= n;
+        if (hash->blen == 128) {
+            sha512_compress(hash->acc, hash->block);
+            hash->header.counter++;
+            hash->blen = 0;
+        }
+    }
+    return CX_OK;
+}
+
+cx_err_t cx_sha512_final(cx_sha512_t *hash, uint8_t *out) {
+    uint64_t bitlen = ((uint64_t) hash->header.counter * 128 + hash->blen) * 8;
+
+    hash->block[hash->blen++] = 0x80;
+    if (hash->blen > 112) {
+        memset(hash->block + hash->blen, 0, 128 - hash->blen);
+        sha512_compress(hash->acc, hash->block);
+        hash->blen = 0;
+    }
+    memset(hash->block + hash->blen, 0, 120 - hash->blen);
+    for (int i = 0; i < 8; i++) {
+        hash->block[120 + i] = (uint8_t) (bitlen >> (56 - 8 * i));
+    }
+    sha512_compress(hash->acc, hash->block);
+
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            out[8 * i + j] = (uint8_t) (hash->acc[i] >> (56 - 8 * j));
+        }
+    }
+    return CX_OK;
+}
+
+// RIPEMD-160 message schedule and constants
+static const uint8_t RMD_R1[80] = {0,  1, 2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14, 15,
+                                   7,  4, 13, 1,  10, 6,  15, 3,  12, 0,  9,  5,  2,  14, 11, 8,
+                                   3,  10, 14, 4, 9,  15, 8,  1,  2,  7,  0,  6,  13, 11, 5,  12,
+                                   1,  9, 11, 10, 0,  8,  12, 4,  13, 3,  7,  15, 14, 5,  6,  2,
+                                   4,  0, 5,  9,  7,  12, 2,  10, 14, 1,  3,  8,  11, 6,  15, 13};
+static const uint8_t RMD_R2[80] = {5,  14, 7,  0,  9, 2,  11, 4,  13, 6,  15, 8,  1,  10, 3,  12,
+                                   6,  11, 3,  7,  0, 13, 5,  10, 14, 15, 8,  12, 4,  9,  1,  2,
+                                   15, 5,  1,  3,  7, 14, 6,  9,  11, 8,  12, 2,  10, 0,  4,  13,
+                                   8,  6,  4,  1,  3, 11, 15, 0,  5,  12, 2,  13, 9,  7,  10, 14,
+                                   12, 15, 10, 4,  1, 5,  8,  7,  6,  2,  13, 14, 0,  3,  9,  11};
+static const uint8_t RMD_S1[80] = {11, 14, 15, 12, 5,  8,  7,  9,  11, 13, 14, 15, 6,  7,  9,  8,
+                                   7,  6,  8,  13, 11, 9,  7,  15, 7,  12, 15, 9,  11, 7,  13, 12,
+                                   11, 13, 6,  7,  14, 9,  13, 15, 14, 8,  13, 6,  5,  12, 7,  5,
+                                   11, 12, 14, 15, 14, 15, 9,  8,  9,  14, 5,  6,  8,  6,  5,  12,
+                                   9,  15, 5,  11, 6,  8,  13, 12, 5,  12, 13, 14, 11, 8,  5,  6};
+static const uint8_t RMD_S2[80] = {8,  9,  9,  11, 13, 15, 15, 5,  7,  7,  8,  11, 14, 14, 12, 6,
+                                   9,  13, 15, 7,  12, 8,  9,  11, 7,  7,  12, 7,  6,  15, 13, 11,
+                                   9,  7,  15, 11, 8,  6,  6,  14, 12, 13, 5,  14, 13, 13, 7,  5,
+                                   15, 5,  8,  11, 14, 14, 6,  14, 6,  9,  12, 9,  12, 5,  15, 8,
+                                   8,  5,  12, 9,  12, 5,  14, 6,  8,  13, 6,  5,  15, 13, 11, 11};
+
+static uint32_t rmd_f(int j, uint32_t x, uint32_t y, uint32_t z) {
+    switch (j / 16) {
+        case 0:
+            return x ^ y ^ z;
+        case 1:
+            return (x & y) | (~x & z);
+        case 2:
+            return (x | ~y) ^ z;
+        case 3:
+            return (x & z) | (y & ~z);
+        default:
+            return x ^ (y | ~z);
+    }
+}
+
+static void ripemd160_compress(uint32_t acc[5], const uint8_t block[64]) {
+    static const uint32_t K1[5] = {0x00000000, 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xA953FD4E};
+    static const uint32_t K2[5] = {0x50A28BE6, 0x5C4DD124, 0x6D703EF3, 0x7A6D76E9, 0x00000000};
+
+    uint32_t x[16];
+    for (int i = 0; i < 16; i++) {
+        x[i] = (uint32_t) block[4 * i] | ((uint32_t) block[4 * i + 1] << 8) |
+               ((uint32_t) block[4 * i + 2] << 16) | ((uint32_t) block[4 * i + 3] << 24);
+    }
+
+    uint32_t al = acc[0], bl = acc[1], cl = acc[2], dl = acc[3], el = acc[4];
+    uint32_t ar = al, br = bl, cr = cl, dr = dl, er = el;
+    for (int j = 0; j < 80; j++) {
+        uint32_t t = ROL32(al + rmd_f(j, bl, cl, dl) + x[RMD_R1[j]] + K1[j / 16], RMD_S1[j]) + el;
+        al = el;
+        el = dl;
+        dl = ROL32(cl, 10);
+        cl = bl;
+        bl = t;
+
+        t = ROL32(ar + rmd_f(79 - j, br, cr, dr) + x[RMD_R2[j]] + K2[j / 16], RMD_S2[j]) + er;
+        ar = er;
+        er = dr;
+        dr = ROL32(cr, 10);
+        cr = br;
+        br = t;
+    }
+    uint32_t t = acc[1] + cl + dr;
+    acc[1] = acc[2] + dl + er;
+    acc[2] = acc[3] + el + ar;
+    acc[3] = acc[4] + al + br;
+    acc[4] = acc[0] + bl + cr;
+    acc[0] = t;
+}
+
+cx_err_t cx_ripemd160_init_no_throw(cx_ripemd160_t *hash) {
+    memset(hash, 0, sizeof(*hash));
+    hash->header.algo = CX_RIPEMD160;
+    hash->acc[0] = 0x67452301;
+    hash->acc[1] = 0xEFCDAB89;
+    hash->acc[2] = 0x98BADCFE;
+    hash->acc[3] = 0x10325476;
+    hash->acc[4] = 0xC3D2E1F0;
+    return CX_OK;
+}
+
+cx_err_t cx_ripemd160_update(cx_ripemd160_t *hash, const uint8_t *in, size_t in_len) {
+    while (in_len > 0) {
+        size_t n = MIN(in_len, 64 - hash->blen);
+        memcpy(hash->block + hash->blen, in, n);
+        hash->blen += n;
+        in += n;
+        in_len -= n;
+        if (hash->blen == 64) {
+            ripemd160_compress(hash->acc, hash->block);
+            hash->header.counter++;
+            hash->blen = 0;
+        }
+    }
+    return CX_OK;
+}
+
+cx_err_t cx_ripemd160_final(cx_ripemd160_t *hash, uint8_t *out) {
+    uint64_t bitlen = ((uint64_t) hash->header.counter * 64 + hash->blen) * 8;
+
+    hash->block[hash->blen++] = 0x80;
+    if (hash->blen > 56) {
+        memset(hash->block + hash->blen, 0, 64 - hash->blen);
+        ripemd160_compress(hash->acc, hash->block);
+        hash->blen = 0;
+    }
+    memset(hash->block + hash->blen, 0, 56 - hash->blen);
+    for (int i = 0; i < 8; i++) {
+        hash->block[56 + i] = (uint8_t) (bitlen >> (8 * i));
+    }
+    ripemd160_compress(hash->acc, hash->block);
+
+    for (int i = 0; i < 5; i++) {
+        out[4 * i] = (uint8_t) hash->acc[i];
+        out[4 * i + 1] = (uint8_t) (hash->acc[i] >> 8);
+        out[4 * i + 2] = (uint8_t) (hash->acc[i] >> 16);
+        out[4 * i + 3] = (uint8_t) (hash->acc[i] >> 24);
+    }
+    return CX_OK;
+}
+
+int cx_hash(cx_hash_t *hash, int mode, const uint8_t *in, size_t len, uint8_t *out, size_t out_len) {
+    switch (hash->algo) {
+        case CX_SHA256:
+            cx_sha256_update((cx_sha256_t *) hash, in, len);
+            if (mode & CX_LAST) {
+                if (out_len < CX_SHA256_SIZE) abort();
+                cx_sha256_final((cx_sha256_t *) hash, out);
+                return CX_SHA256_SIZE;
+            }
+            return 0;
+        case CX_SHA512:
+            cx_sha512_update((cx_sha512_t *) hash, in, len);
+            if (mode & CX_LAST) {
+                if (out_len < CX_SHA512_SIZE) abort();
+                cx_sha512_final((cx_sha512_t *) hash, out);
+                return CX_SHA512_SIZE;
+            }
+            return 0;
+        case CX_RIPEMD160:
+            cx_ripemd160_update((cx_ripemd160_t *) hash, in, len);
+            if (mode & CX_LAST) {
+                if (out_len < CX_RIPEMD160_SIZE) abort();
+                cx_ripemd160_final((cx_ripemd160_t *) hash, out);
+                return CX_RIPEMD160_SIZE;
+            }
+            return 0;
+        default:
+            abort();
+    }
+}
+
+int cx_hmac_sha256(const uint8_t *key,
+                   size_t key_len,
+                   const uint8_t *in,
+                   size_t len,
+                   uint8_t *mac,
+                   size_t mac_len) {
+    uint8_t k[64] = {0};
+    uint8_t pad[64];
+    uint8_t inner[32];
+    cx_sha256_t ctx;
+
+    if (key_len > 64) {
+        cx_hash_sha256(key, key_len, k, 32);
+    } else {
+        memcpy(k, key, key_len);
+    }
+
+    for (int i = 0; i < 64; i++) pad[i] = k[i] ^ 0x36;
+    cx_sha256_init(&ctx);
+    cx_sha256_update(&ctx, pad, 64);
+    cx_sha256_update(&ctx, in, len);
+    cx_sha256_final(&ctx, inner);
+
+    for (int i = 0; i < 64; i++) pad[i] = k[i] ^ 0x5c;
+    cx_sha256_init(&ctx);
+    cx_sha256_update(&ctx, pad, 64);
+    cx_sha256_update(&ctx, inner, 32);
+    cx_sha256_final(&ctx, inner);
+
+    memcpy(mac, inner, MIN(mac_len, 32));
+    return 32;
+}
+
+int cx_hmac_sha512(const uint8_t *key,
+                   size_t key_len,
+                   const uint8_t *in,
+                   size_t len,
+                   uint8_t *mac,
+                   size_t mac_len) {
+    uint8_t k[128] = {0};
+    uint8_t pad[128];
+    uint8_t inner[64];
+    cx_sha512_t ctx;
+
+    if (key_len > 128) {
+        cx_sha512_init(&ctx);
+        cx_sha512_update(&ctx, key, key_len);
+        cx_sha512_final(&ctx, k);
+    } else {
+        memcpy(k, key, key_len);
+    }
+
+    for (int i = 0; i < 128; i++) pad[i] = k[i] ^ 0x36;
+    cx_sha512_init(&ctx);
+    cx_sha512_update(&ctx, pad, 128);
+    cx_sha512_update(&ctx, in, len);
+    cx_sha512_final(&ctx, inner);
+
+    for (int i = 0; i < 128; i++) pad[i] = k[i] ^ 0x5c;
+    cx_sha512_init(&ctx);
+    cx_sha512_update(&ctx, pad, 128);
+    cx_sha512_update(&ctx, inner, 64);
+    cx_sha512_final(&ctx, inner);
+
+    memcpy(mac, inner, MIN(mac_len, 64));
+    return 64;
+}
+
+/* ---------------------------------------------------------------------------------------------- */
+/* 256-bit modular arithmetic                                                                      */
+/* ---------------------------------------------------------------------------------------------- */
+
+// 256-bit numbers are stored as 8 little-endian 32-bit limbs.
+typedef struct {
+    uint32_t v[8];
+} bn_t;
+
+static void bn_read(bn_t *r, const uint8_t in[32]) {
+    for (int i = 0; i < 8; i++) {
+        const uint8_t *p = in + 28 - 4 * i;
+        r->v[i] = ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+    }
+}
+
+static void bn_write(uint8_t out[32], const bn_t *a) {
+    for (int i = 0; i < 8; i++) {
+        uint8_t *p = out + 28 - 4 * i;
+        p[0] = (uint8_t) (a->v[i] >> 24);
+        p[1] = (uint8_t) (a->v[i] >> 16);
+        p[2] = (uint8_t) (a->v[i] >> 8);
+        p[3] = (uint8_t) a->v[i];
+    }
+}
+
+static int bn_cmp(const bn_t *a, const bn_t *b) {
+    for (int i = 7; i >= 0; i--) {
+        if (a->v[i] != b->v[i]) {
+            return a->v[i] > b->v[i] ? 1 : -1;
+        }
+    }
+    return 0;
+}
+
+static bool bn_is_zero(const bn_t *a) {
+    uint32_t acc = 0;
+    for (int i = 0; i < 8; i++) acc |= a->v[i];
+    return acc == 0;
+}
+
+static uint32_t bn_add(bn_t *r, const bn_t *a, const bn_t *b) {
+    uint64_t carry = 0;
+    for (int i = 0; i < 8; i++) {
+        carry += (uint64_t) a->v[i] + b->v[i];
+        r->v[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+    return (uint32_t) carry;
+}
+
+static uint32_t bn_sub(bn_t *r, const bn_t *a, const bn_t *b) {
+    int64_t borrow = 0;
+    for (int i = 0; i < 8; i++) {
+        int64_t d = (int64_t) a->v[i] - b->v[i] + borrow;
+        r->v[i] = (uint32_t) d;
+        borrow = d < 0 ? -1 : 0;
+    }
+    return borrow != 0;
+}
+
+// A modulus m > 2^255, together with c = 2^256 - m, used for the fast reduction.
+typedef struct {
+    bn_t m;
+    bn_t c;
+} modulus_t;
+
+static void modulus_init(modulus_t *mod, const bn_t *m) {
+    if ((m->v[7] & 0x80000000) == 0) {
+        // only moduli close to 2^256 are supported by the reduction in bn_mod_reduce
+        abort();
+    }
+    mod->m = *m;
+    bn_t zero = {{0}};
+    bn_sub(&mod->c, &zero, m);
+}
+
+// Reduces the 512-bit number t (16 little-endian limbs) modulo m, using 2^256 = c (mod m).
+static void bn_mod_reduce(bn_t *r, uint32_t t[16], const modulus_t *mod) {
+    int c_len = 8;
+    while (c_len > 0 && mod->c.v[c_len - 1] == 0) --c_len;
+
+    for (;;) {
+        bool hi_zero = true;
+        for (int i = 8; i < 16; i++) {
+            if (t[i] != 0) {
+                hi_zero = false;
+                break;
+            }
+        }
+        if (hi_zero) break;
+
+        // t = lo + hi * c
+        uint32_t next[16] = {0};
+        memcpy(next, t, 8 * sizeof(uint32_t));
+        for (int i = 0; i < 8; i++) {
+            uint64_t carry = 0;
+            if (t[8 + i] == 0) continue;
+            for (int j = 0; j < c_len; j++) {
+                uint64_t cur = (uint64_t) t[8 + i] * mod->c.v[j] + next[i + j] + carry;
+                next[i + j] = (uint32_t) cur;
+                carry = cur >> 32;
+            }
+            for (int k = i + c_len; carry != 0 && k < 16; k++) {
+                uint64_t cur = (uint64_t) next[k] + carry;
+                next[k] = (uint32_t) cur;
+                carry = cur >> 32;
+            }
+        }
+        memcpy(t, next, sizeof(next));
+    }
+
+    memcpy(r->v, t, 8 * sizeof(uint32_t));
+    while (bn_cmp(r, &mod->m) >= 0) {
+        bn_sub(r, r, &mod->m);
+    }
+}
+
+static void bn_mulm(bn_t *r, const bn_t *a, const bn_t *b, const modulus_t *mod) {
+    uint32_t t[16] = {0};
+    for (int i = 0; i < 8; i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < 8; j++) {
+            uint64_t cur = (uint64_t) a->v[i] * b->v[j] + t[i + j] + carry;
+            t[i + j] = (uint32_t) cur;
+            carry = cur >> 32;
+        }
+        t[i + 8] = (uint32_t) carry;
+    }
+    bn_mod_reduce(r, t, mod);
+}
+
+static void bn_addm(bn_t *r, const bn_t *a, const bn_t *b, const modulus_t *mod) {
+    uint32_t carry = bn_add(r, a, b);
+    if (carry || bn_cmp(r, &mod->m) >= 0) {
+        bn_sub(r, r, &mod->m);
+    }
+}
+
+static void bn_subm(bn_t *r, const bn_t *a, const bn_t *b, const modulus_t *mod) {
+    if (bn_sub(r, a, b)) {
+        bn_add(r, r, &mod->m);
+    }
+}
+
+// r = a^e mod m, with e given as a big-endian byte string
+static void bn_powm(bn_t *r, const bn_t *a, const uint8_t *e, size_t e_len, const modulus_t *mod) {
+    bn_t result = {{1}};
+    bn_t base = *a;
+    for (size_t i = 0; i < e_len; i++) {
+        for (int bit = 7; bit >= 0; bit--) {
+            bn_mulm(&result, &result, &result, mod);
+            if ((e[i] >> bit) & 1) {
+                bn_mulm(&result, &result, &base, mod);
+            }
+        }
+    }
+    *r = result;
+}
+
+static void bn_invm(bn_t *r, const bn_t *a, const modulus_t *mod) {
+    // Fermat: a^(m-2), as both moduli used by the app are prime
+    bn_t e, two = {{2}};
+    uint8_t e_bytes[32];
+    bn_sub(&e, &mod->m, &two);
+    bn_write(e_bytes, &e);
+    bn_powm(r, a, e_bytes, 32, mod);
+}
+
+static const uint8_t SECP256K1_P[32] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe, 0xff, 0xff, 0xfc, 0x2f};
+
+static const uint8_t SECP256K1_N[32] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+    0xba, 0xae, 0xdc, 0xe6, 0xaf, 0x48, 0xa0, 0x3b, 0xbf, 0xd2, 0x5e, 0x8c, 0xd0, 0x36, 0x41, 0x41};
+
+static const uint8_t SECP256K1_GX[32] = {
+    0x79, 0xBE, 0x66, 0x7E, 0xF9, 0xDC, 0xBB, 0xAC, 0x55, 0xA0, 0x62, 0x95, 0xCE, 0x87, 0x0B, 0x07,
+    0x02, 0x9B, 0xFC, 0xDB, 0x2D, 0xCE, 0x28, 0xD9, 0x59, 0xF2, 0x81, 0x5B, 0x16, 0xF8, 0x17, 0x98};
+
+static const uint8_t SECP256K1_GY[32] = {
+    0x48, 0x3A, 0xDA, 0x77, 0x26, 0xA3, 0xC4, 0x65, 0x5D, 0xA4, 0xFB, 0xFC, 0x0E, 0x11, 0x08, 0xA8,
+    0xFD, 0x17, 0xB4, 0x48, 0xA6, 0x85, 0x54, 0x19, 0x9C, 0x47, 0xD0, 0x8F, 0xFB, 0x10, 0xD4, 0xB8};
+
+static modulus_t G_field, G_order;
+static bool G_moduli_initialized = false;
+
+static void init_moduli(void) {
+    if (!G_moduli_initialized) {
+        bn_t m;
+        bn_read(&m, SECP256K1_P);
+        modulus_init(&G_field, &m);
+        bn_read(&m, SECP256K1_N);
+        modulus_init(&G_order, &m);
+        G_moduli_initialized = true;
+    }
+}
+
+static void read_modulus(modulus_t *mod, const uint8_t *m, size_t len) {
+    if (len != 32) abort();
+    bn_t mm;
+    bn_read(&mm, m);
+    init_moduli();
+    if (bn_cmp(&mm, &G_field.m) == 0) {
+        *mod = G_field;
+    } else if (bn_cmp(&mm, &G_order.m) == 0) {
+        *mod = G_order;
+    } else {
+        modulus_init(mod, &mm);
+    }
+}
+
+int cx_math_cmp(const uint8_t *a, const uint8_t *b, size_t len) {
+    return memcmp(a, b, len);
+}
+
+int cx_math_sub(uint8_t *r, const uint8_t *a, const uint8_t *b, size_t len) {
+    if (len != 32) abort();
+    bn_t x, y;
+    bn_read(&x, a);
+    bn_read(&y, b);
+    int borrow = bn_sub(&x, &x, &y);
+    bn_write(r, &x);
+    return borrow;
+}
+
+void cx_math_addm(uint8_t *r, const uint8_t *a, const uint8_t *b, const uint8_t *m, size_t len) {
+    modulus_t mod;
+    read_modulus(&mod, m, len);
+    bn_t x, y;
+    bn_read(&x, a);
+    bn_read(&y, b);
+    bn_addm(&x, &x, &y, &mod);
+    bn_write(r, &x);
+}
+
+void cx_math_multm(uint8_t *r, const uint8_t *a, const uint8_t *b, const uint8_t *m, size_t len) {
+    modulus_t mod;
+    read_modulus(&mod, m, len);
+    bn_t x, y;
+    bn_read(&x, a);
+    bn_read(&y, b);
+    bn_mulm(&x, &x, &y, &mod);
+    bn_write(r, &x);
+}
+
+void cx_math_powm(uint8_t *r,
+                  const uint8_t *a,
+                  const uint8_t *e,
+                  size_t len_e,
+                  const uint8_t *m,
+                  size_t len) {
+    modulus_t mod;
+    read_modulus(&mod, m, len);
+    bn_t x;
+    bn_read(&x, a);
+    bn_powm(&x, &x, e, len_e, &mod);
+    bn_write(r, &x);
+}
+
+/* ---------------------------------------------------------------------------------------------- */
+/* secp256k1                                                                                       */
+/* ---------------------------------------------------------------------------------------------- */
+
+// Point in Jacobian coordinates; Z == 0 is the point at infinity.
+typedef struct {
+    bn_t X, Y, Z;
+} jpoint_t;
+
+static void jpoint_set_affine(jpoint_t *P, const bn_t *x, const bn_t *y) {
+    P->X = *x;
+    P->Y = *y;
+    memset(&P->Z, 0, sizeof(P->Z));
+    P->Z.v[0] = 1;
+}
+
+static void jpoint_double(jpoint_t *R, const jpoint_t *P) {
+    const modulus_t *f = &G_field;
+    if (bn_is_zero(&P->Z) || bn_is_zero(&P->Y)) {
+        memset(R, 0, sizeof(*R));
+        return;
+    }
+    // dbl-2009-l (a = 0)
+    bn_t A, B, C, D, E, F, t;
+    bn_mulm(&A, &P->X, &P->X, f);
+    bn_mulm(&B, &P->Y, &P->Y, f);
+    bn_mulm(&C, &B, &B, f);
+    bn_addm(&t, &P->X, &B, f);
+    bn_mulm(&t, &t, &t, f);
+    bn_subm(&t, &t, &A, f);
+    bn_subm(&t, &t, &C, f);
+    bn_addm(&D, &t, &t, f);
+    bn_addm(&E, &A, &A, f);
+    bn_addm(&E, &E, &A, f);
+    bn_mulm(&F, &E, &E, f);
+
+    jpoint_t out;
+    bn_subm(&out.X, &F, &D, f);
+    bn_subm(&out.X, &out.X, &D, f);
+    bn_subm(&t, &D, &out.X, f);
+    bn_mulm(&out.Y, &E, &t, f);
+    bn_addm(&C, &C, &C, f);
+    bn_addm(&C, &C, &C, f);
+    bn_addm(&C, &C, &C, f);
+    bn_subm(&out.Y, &out.Y, &C, f);
+    bn_mulm(&out.Z, &P->Y, &P->Z, f);
+    bn_addm(&out.Z, &out.Z, &out.Z, f);
+    *R = out;
+}
+
+static void jpoint_add(jpoint_t *R, const jpoint_t *P, const jpoint_t *Q) {
+    const modulus_t *f = &G_field;
+    if (bn_is_zero(&P->Z)) {
+        *R = *Q;
+        return;
+    }
+    if (bn_is_zero(&Q->Z)) {
+        *R = *P;
+        return;
+    }
+    // add-2007-bl
+    bn_t Z1Z1, Z2Z2, U1, U2, S1, S2, H, I, J, r, V, t;
+    bn_mulm(&Z1Z1, &P->Z, &P->Z, f);
+    bn_mulm(&Z2Z2, &Q->Z, &Q->Z, f);
+    bn_mulm(&U1, &P->X, &Z2Z2, f);
+    bn_mulm(&U2, &Q->X, &Z1Z1, f);
+    bn_mulm(&S1, &P->Y, &Q->Z, f);
+    bn_mulm(&S1, &S1, &Z2Z2, f);
+    bn_mulm(&S2, &Q->Y, &P->Z, f);
+    bn_mulm(&S2, &S2, &Z1Z1, f);
+
+    if (bn_cmp(&U1, &U2) == 0) {
+        if (bn_cmp(&S1, &S2) == 0) {
+            jpoint_double(R, P);
+        } else {
+            memset(R, 0, sizeof(*R));  // P == -Q
+        }
+        return;
+    }
+
+    bn_subm(&H, &U2, &U1, f);
+    bn_addm(&I, &H, &H, f);
+    bn_mulm(&I, &I, &I, f);
+    bn_mulm(&J, &H, &I, f);
+    bn_subm(&r, &S2, &S1, f);
+    bn_addm(&r, &r, &r, f);
+    bn_mulm(&V, &U1, &I, f);
+
+    jpoint_t out;
+    bn_mulm(&out.X, &r, &r, f);
+    bn_subm(&out.X, &out.X, &J, f);
+    bn_subm(&out.X, &out.X, &V, f);
+    bn_subm(&out.X, &out.X, &V, f);
+    bn_subm(&t, &V, &out.X, f);
+    bn_mulm(&out.Y, &r, &t, f);
+    bn_mulm(&t, &S1, &J, f);
+    bn_addm(&t, &t, &t, f);
+    bn_subm(&out.Y, &out.Y, &t, f);
+    bn_addm(&out.Z, &P->Z, &Q->Z, f);
+    bn_mulm(&out.Z, &out.Z, &out.Z, f);
+    bn_subm(&out.Z, &out.Z, &Z1Z1, f);
+    bn_subm(&out.Z, &out.Z, &Z2Z2, f);
+    bn_mulm(&out.Z, &out.Z, &H, f);
+    *R = out;
+}
+
+static void jpoint_mul(jpoint_t *R, const jpoint_t *P, const bn_t *k) {
+    jpoint_t acc;
+    memset(&acc, 0, sizeof(acc));
+    for (int i = 255; i >= 0; i--) {
+        jpoint_double(&acc, &acc);
+        if ((k->v[i / 32] >> (i % 32)) & 1) {
+            jpoint_add(&acc, &acc, P);
+        }
+    }
+    *R = acc;
+}
+
+// Returns false for the point at infinity
+static bool jpoint_to_affine(const jpoint_t *P, bn_t *x, bn_t *y) {
+    if (bn_is_zero(&P->Z)) {
+        return false;
+    }
+    bn_t zinv, zinv2, zinv3;
+    bn_invm(&zinv, &P->Z, &G_field);
+    bn_mulm(&zinv2, &zinv, &zinv, &G_field);
+    bn_mulm(&zinv3, &zinv2, &zinv, &G_field);
+    bn_mulm(x, &P->X, &zinv2, &G_field);
+    bn_mulm(y, &P->Y, &zinv3, &G_field);
+    return true;
+}
+
+static void jpoint_read(jpoint_t *P, const uint8_t in[65]) {
+    if (in[0] != 0x04) abort();
+    bn_t x, y;
+    bn_read(&x, in + 1);
+    bn_read(&y, in + 33);
+    jpoint_set_affine(P, &x, &y);
+}
+
+// Returns 65 (the encoding length), or 0 for the point at infinity
+static int jpoint_write(uint8_t out[65], const jpoint_t *P) {
+    bn_t x, y;
+    if (!jpoint_to_affine(P, &x, &y)) {
+        return 0;
+    }
+    out[0] = 0x04;
+    bn_write(out + 1, &x);
+    bn_write(out + 33, &y);
+    return 65;
+}
+
+static void generator(jpoint_t *G) {
+    bn_t x, y;
+    bn_read(&x, SECP256K1_GX);
+    bn_read(&y, SECP256K1_GY);
+    jpoint_set_affine(G, &x, &y);
+}
+
+// out = k*G, uncompressed; returns false if k*G is the point at infinity
+static bool point_mul_generator(const uint8_t k[32], uint8_t out[65]) {
+    init_moduli();
+    jpoint_t G, R;
+    bn_t kk;
+    generator(&G);
+    bn_read(&kk, k);
+    jpoint_mul(&R, &G, &kk);
+    return jpoint_write(out, &R) != 0;
+}
+
+int cx_ecfp_scalar_mult(cx_curve_t curve, uint8_t *P, size_t P_len, const uint8_t *k, size_t k_len) {
+    if (curve != CX_CURVE_SECP256K1 || P_len != 65 || k_len != 32) abort();
+    init_moduli();
+    jpoint_t Pj, R;
+    bn_t kk;
+    jpoint_read(&Pj, P);
+    bn_read(&kk, k);
+    jpoint_mul(&R, &Pj, &kk);
+    return jpoint_write(P, &R);
+}
+
+int cx_ecfp_add_point(cx_curve_t curve, uint8_t *R, const uint8_t *P, const uint8_t *Q, size_t X_len) {
+    if (curve != CX_CURVE_SECP256K1 || X_len != 65) abort();
+    init_moduli();
+    jpoint_t Pj, Qj, Rj;
+    jpoint_read(&Pj, P);
+    jpoint_read(&Qj, Q);
+    jpoint_add(&Rj, &Pj, &Qj);
+    return jpoint_write(R, &Rj);
+}
+
+int cx_ecfp_init_private_key(cx_curve_t curve,
+                             const uint8_t *raw_key,
+                             size_t key_len,
+                             cx_ecfp_private_key_t *pvkey) {
+    if (key_len != 32) abort();
+    pvkey->curve = curve;
+    pvkey->d_len = key_len;
+    memcpy(pvkey->d, raw_key, key_len);
+    return (int) key_len;
+}
+
+int cx_ecfp_generate_pair(cx_curve_t curve,
+                          cx_ecfp_public_key_t *pubkey,
+                          cx_ecfp_private_key_t *privkey,
+                          int keepprivate) {
+    if (!keepprivate) abort();  // the app never asks for fresh random keys
+    pubkey->curve = curve;
+    pubkey->W_len = 65;
+    if (!point_mul_generator(privkey->d, pubkey->W)) abort();
+    return 0;
+}
+
+// reduces a 32-byte big-endian number modulo n
+static void scalar_reduce(bn_t *r, const uint8_t in[32]) {
+    bn_read(r, in);
+    if (bn_cmp(r, &G_order.m) >= 0) {
+        bn_sub(r, r, &G_order.m);
+    }
+}
+
+// RFC6979 nonce generation for a 256-bit curve order and a 32-byte message hash.
+static void rfc6979_nonce(const uint8_t x[32], const uint8_t h1[32], uint8_t k_out[32]) {
+    uint8_t V[32], K[32];
+    uint8_t buf[32 + 1 + 32 + 32];
+    bn_t h;
+
+    // bits2octets(h1): reduce modulo n
+    scalar_reduce(&h, h1);
+
+    memset(V, 0x01, 32);
+    memset(K, 0x00, 32);
+
+    for (int round = 0; round < 2; round++) {
+        memcpy(buf, V, 32);
+        buf[32] = (uint8_t) round;
+        memcpy(buf + 33, x, 32);
+        bn_write(buf + 65, &h);
+        cx_hmac_sha256(K, 32, buf, sizeof(buf), K, 32);
+        cx_hmac_sha256(K, 32, V, 32, V, 32);
+    }
+
+    for (;;) {
+        cx_hmac_sha256(K, 32, V, 32, V, 32);
+
+        bn_t k;
+        bn_read(&k, V);
+        if (!bn_is_zero(&k) && bn_cmp(&k, &G_order.m) < 0) {
+            memcpy(k_out, V, 32);
+            return;
+        }
+
+        memcpy(buf, V, 32);
+        buf[32] = 0x00;
+        cx_hmac_sha256(K, 32, buf, 33, K, 32);
+        cx_hmac_sha256(K, 32, V, 32, V, 32);
+    }
+}
+
+static size_t der_write_integer(uint8_t *out, const uint8_t in[32]) {
+    int start = 0;
+    while (start < 31 && in[start] == 0) ++start;
+    size_t len = 32 - start;
+    bool pad = (in[start] & 0x80) != 0;
+    out[0] = 0x02;
+    out[1] = (uint8_t) (len + (pad ? 1 : 0));
+    size_t pos = 2;
+    if (pad) out[pos++] = 0x00;
+    memcpy(out + pos, in + start, len);
+    return pos + len;
+}
+
+int cx_ecdsa_sign(const cx_ecfp_private_key_t *pvkey,
+                  int mode,
+                  cx_md_t hashID,
+                  const uint8_t *hash,
+                  unsigned int hash_len,
+                  uint8_t *sig,
+                  unsigned int sig_len,
+                  unsigned int *info) {
+    (void) mode;  // always deterministic on the host
+    if (hashID != CX_SHA256 || hash_len != 32 || pvkey->d_len != 32) abort();
+
+    init_moduli();
+
+    bn_t d, z, k, r, s, t;
+    uint8_t k_bytes[32], R[65];
+
+    bn_read(&d, pvkey->d);
+    scalar_reduce(&z, hash);
+    rfc6979_nonce(pvkey->d, hash, k_bytes);
+    bn_read(&k, k_bytes);
+
+    point_mul_generator(k_bytes, R);
+    unsigned int out_info = (R[64] & 1) ? CX_ECCINFO_PARITY_ODD : 0;
+
+    bn_read(&r, R + 1);
+    if (bn_cmp(&r, &G_order.m) >= 0) {
+        bn_sub(&r, &r, &G_order.m);
+        out_info |= CX_ECCINFO_xGTn;
+    }
+
+    // s = k^-1 (z + r*d) mod n
+    bn_mulm(&t, &r, &d, &G_order);
+    bn_addm(&t, &t, &z, &G_order);
+    bn_invm(&s, &k, &G_order);
+    bn_mulm(&s, &s, &t, &G_order);
+
+    // normalize to low-S, as the BOLOS implementation does
+    bn_t half_n = G_order.m;
+    for (int i = 0; i < 8; i++) {
+        half_n.v[i] = (half_n.v[i] >> 1) | (i < 7 ? (half_n.v[i + 1] << 31) : 0);
+    }
+    if (bn_cmp(&s, &half_n) > 0) {
+        bn_sub(&s, &G_order.m, &s);
+        out_info ^= CX_ECCINFO_PARITY_ODD;
+    }
+
+    uint8_t r_bytes[32], s_bytes[32], der[72];
+    bn_write(r_bytes, &r);
+    bn_write(s_bytes, &s);
+
+    size_t pos = 2;
+    pos += der_write_integer(der + pos, r_bytes);
+    pos += der_write_integer(der + pos, s_bytes);
+    der[0] = 0x30;
+    der[1] = (uint8_t) (pos - 2);
+
+    if (sig_len < pos) abort();
+    memcpy(sig, der, pos);
+
+    if (info != NULL) {
+        *info = out_info;
+    }
+    return (int) pos;
+}
+
+static void bip340_tagged_hash(const char *tag,
+                               const uint8_t *data1,
+                               size_t len1,
+                               const uint8_t *data2,
+                               size_t len2,
+                               const uint8_t *data3,
+                               size_t len3,
+                               uint8_t out[32]) {
+    uint8_t tag_hash[32];
+    cx_sha256_t ctx;
+    cx_hash_sha256((const uint8_t *) tag, strlen(tag), tag_hash, 32);
+    cx_sha256_init(&ctx);
+    cx_sha256_update(&ctx, tag_hash, 32);
+    cx_sha256_update(&ctx, tag_hash, 32);
+    cx_sha256_update(&ctx, data1, len1);
+    cx_sha256_update(&ctx, data2, len2);
+    cx_sha256_update(&ctx, data3, len3);
+    cx_sha256_final(&ctx, out);
+}
+
+cx_err_t cx_ecschnorr_sign_no_throw(const cx_ecfp_private_key_t *pvkey,
+                                    uint32_t mode,
+                                    cx_md_t hashID,
+                                    const uint8_t *msg,
+                                    size_t msg_len,
+                                    uint8_t *sig,
+                                    size_t *sig_len) {
+    (void) mode;  // only BIP-340 is supported; the auxiliary randomness is all zeros on the host
+    if (hashID != CX_SHA256 || msg_len != 32 || pvkey->d_len != 32) {
+        return CX_INVALID_PARAMETER;
+    }
+
+    init_moduli();
+
+    bn_t d, k, e, s;
+    uint8_t P[65], R[65], d_bytes[32], t[32], k_bytes[32], e_bytes[32];
+    const uint8_t aux[32] = {0};
+
+    bn_read(&d, pvkey->d);
+    if (bn_is_zero(&d) || bn_cmp(&d, &G_order.m) >= 0) {
+        return CX_INVALID_PARAMETER;
+    }
+    point_mul_generator(pvkey->d, P);
+    if (P[64] & 1) {
+        bn_sub(&d, &G_order.m, &d);
+    }
+    bn_write(d_bytes, &d);
+
+    uint8_t aux_hash[32];
+    bip340_tagged_hash("BIP0340/aux", aux, 32, NULL, 0, NULL, 0, aux_hash);
+    for (int i = 0; i < 32; i++) t[i] = d_bytes[i] ^ aux_hash[i];
+
+    bip340_tagged_hash("BIP0340/nonce", t, 32, P + 1, 32, msg, 32, k_bytes);
+    scalar_reduce(&k, k_bytes);
+    if (bn_is_zero(&k)) {
+        return CX_INTERNAL_ERROR;
+    }
+    bn_write(k_bytes, &k);
+    point_mul_generator(k_bytes, R);
+    if (R[64] & 1) {
+        bn_sub(&k, &G_order.m, &k);
+    }
+
+    bip340_tagged_hash("BIP0340/challenge", R + 1, 32, P + 1, 32, msg, 32, e_bytes);
+    scalar_reduce(&e, e_bytes);
+
+    bn_mulm(&s, &e, &d, &G_order);
+    bn_addm(&s, &s, &k, &G_order);
+
+    memcpy(sig, R + 1, 32);
+    bn_write(sig + 32, &s);
+    *sig_len = 64;
+
+    explicit_bzero(d_bytes, sizeof(d_bytes));
+    explicit_bzero(t, sizeof(t));
+    return CX_OK;
+}
+
+/* ---------------------------------------------------------------------------------------------- */
+/* Seed-based derivations                                                                          */
+/* ---------------------------------------------------------------------------------------------- */
+
+static uint8_t G_host_seed[64];
+static size_t G_host_seed_len = 0;
+static uint32_t G_host_derivation_count = 0;
+
+void host_crypto_set_seed(const uint8_t *seed, size_t seed_len) {
+    if (seed_len > sizeof(G_host_seed)) abort();
+    memcpy(G_host_seed, seed, seed_len);
+    G_host_seed_len = seed_len;
+}
+
+uint32_t host_crypto_get_derivation_count(void) {
+    return G_host_derivation_count;
+}
+
+void os_perso_derive_node_bip32(cx_curve_t curve,
+                                const unsigned int *path,
+                                unsigned int path_length,
+                                unsigned char *private_key,
+                                unsigned char *chain) {
+    if (curve != CX_CURVE_SECP256K1) abort();
+
+    init_moduli();
+    ++G_host_derivation_count;
+
+    static const uint8_t BITCOIN_SEED[] = {'B', 'i', 't', 'c', 'o', 'i', 'n', ' ', 's', 'e', 'e', 'd'};
+
+    uint8_t I[64];
+    cx_hmac_sha512(BITCOIN_SEED, sizeof(BITCOIN_SEED), G_host_seed, G_host_seed_len, I, 64);
+
+    for (unsigned int i = 0; i < path_length; i++) {
+        uint8_t data[1 + 32 + 4];
+        if (path[i] & 0x80000000) {
+            data[0] = 0x00;
+            memcpy(data + 1, I, 32);
+        } else {
+            uint8_t P[65];
+            point_mul_generator(I, P);
+            data[0] = (P[64] & 1) ? 0x03 : 0x02;
+            memcpy(data + 1, P + 1, 32);
+        }
+        data[33] = (uint8_t) (path[i] >> 24);
+        data[34] = (uint8_t) (path[i] >> 16);
+        data[35] = (uint8_t) (path[i] >> 8);
+        data[36] = (uint8_t) path[i];
+
+        uint8_t child[64];
+        cx_hmac_sha512(I + 32, 32, data, sizeof(data), child, 64);
+
+        bn_t k_par, I_L;
+        bn_read(&k_par, I);
+        bn_read(&I_L, child);
+        bn_addm(&k_par, &k_par, &I_L, &G_order);  // invalid children are ignored on the host
+
+        bn_write(I, &k_par);
+        memcpy(I + 32, child + 32, 32);
+    }
+
+    if (private_key != NULL) {
+        memcpy(private_key, I, 32);
+    }
+    if (chain != NULL) {
+        memcpy(chain, I + 32, 32);
+    }
+    explicit_bzero(I, sizeof(I));
+}
+
+void os_perso_derive_node_with_seed_key(unsigned int mode,
+                                        cx_curve_t curve,
+                                        const unsigned int *path,
+                                        unsigned int path_length,
+                                        unsigned char *private_key,
+                                        unsigned char *chain,
+                                        unsigned char *seed_key,
+                                        unsigned int seed_key_length) {
+    (void) curve, (void) seed_key, (void) seed_key_length;
+
+    if (mode != HDW_SLIP21) {
+        os_perso_derive_node_bip32(curve, path, path_length, private_key, chain);
+        return;
+    }
+
+    // SLIP-21: a single derivation step; `path` is the label, including the leading 0x00 byte
+    static const uint8_t SLIP21_SEED[] = "Symmetric key seed";
+
+    uint8_t node[64];
+    cx_hmac_sha512(SLIP21_SEED, sizeof(SLIP21_SEED) - 1, G_host_seed, G_host_seed_len, node, 64);
+    cx_hmac_sha512(node, 32, (const uint8_t *) path, path_length, node, 64);
+
+    memcpy(private_key, node + 32, 32);
+    explicit_bzero(node, sizeof(node));
+}
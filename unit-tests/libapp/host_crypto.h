@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Sets the BIP-39 seed used by the software implementations of os_perso_derive_node_bip32 and
+ * os_perso_derive_node_with_seed_key.
+ *
+ * @param[in] seed
+ *   Pointer to the seed.
+ * @param[in] seed_len
+ *   Length of the seed; at most 64 bytes.
+ */
+void host_crypto_set_seed(const uint8_t *seed, size_t seed_len);
+
+/**
+ * Returns the number of calls to os_perso_derive_node_bip32 since the start of the program.
+ */
+uint32_t host_crypto_get_derivation_count(void);
@@ -0,0 +1,198 @@
+/*****************************************************************************
+ *   Ledger App Bitcoin.
+ *   (c) 2021 Ledger SAS.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Host replacement for src/boilerplate/io.c and for the SDK's io_exchange.
+ *
+ * The response logic (io_add_to_response and friends) is the same as on device. io_exchange is
+ * synchronous: a final response (IO_RETURN_AFTER_TX) is stored for libapp_exchange, while a
+ * response sent from process_interruption is handed to the responder callback, whose answer is
+ * returned to the app as a CONTINUE_INTERRUPTED APDU.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "os.h"
+
+#include "boilerplate/io.h"
+#include "boilerplate/constants.h"
+#include "boilerplate/sw.h"
+#include "common/read.h"
+#include "common/write.h"
+
+#include "host_io.h"
+
+uint8_t G_io_apdu_buffer[IO_APDU_BUFFER_SIZE];
+io_app_t G_io_app;
+
+uint16_t G_output_len = 0;
+
+bool G_was_processing_screen_shown;
+
+host_io_session_t G_host_io_session;
+
+void *pic(void *linked_address) {
+    return linked_address;
+}
+
+void os_sched_exit(int exit_code) {
+    (void) exit_code;
+}
+
+void nvm_write(void *dst_adr, void *src_adr, unsigned int src_len) {
+    if (src_adr == NULL) {
+        memset(dst_adr, 0, src_len);
+    } else {
+        memmove(dst_adr, src_adr, src_len);
+    }
+}
+
+char os_secure_memcmp(const void *src1, const void *src2, size_t length) {
+    const uint8_t *a = src1, *b = src2;
+    uint8_t acc = 0;
+    for (size_t i = 0; i < length; i++) {
+        acc |= a[i] ^ b[i];
+    }
+    return acc != 0;
+}
+
+bolos_bool_t os_global_pin_is_validated(void) {
+    return G_host_io_session.locked ? BOLOS_FALSE : BOLOS_UX_OK;
+}
+
+// There are no tick events on the host, therefore the timeouts never expire.
+
+void io_start_interruption_timeout() {
+}
+
+void io_clear_interruption_timeout() {
+}
+
+void io_start_processing_timeout() {
+}
+
+void io_clear_processing_timeout() {
+}
+
+void io_reset_timeouts() {
+    G_was_processing_screen_shown = false;
+}
+
+void io_add_to_response(const void *rdata, size_t rdata_len) {
+    if (G_output_len >= IO_APDU_BUFFER_SIZE - 2) {
+        G_output_len = IO_APDU_BUFFER_SIZE;
+        write_u16_be(G_io_apdu_buffer, IO_APDU_BUFFER_SIZE - 2, SW_WRONG_RESPONSE_LENGTH);
+    } else if (G_output_len + rdata_len > IO_APDU_BUFFER_SIZE - 2) {
+        io_add_to_response(rdata, IO_APDU_BUFFER_SIZE - 2 - rdata_len);
+        io_finalize_response(SW_WRONG_RESPONSE_LENGTH);
+    } else {
+        memmove(G_io_apdu_buffer + G_output_len, rdata, rdata_len);
+        G_output_len += rdata_len;
+    }
+}
+
+void io_finalize_response(uint16_t sw) {
+    if (G_output_len >= IO_APDU_BUFFER_SIZE - 2) {
+        G_output_len = IO_APDU_BUFFER_SIZE;
+        write_u16_be(G_io_apdu_buffer, IO_APDU_BUFFER_SIZE - 2, SW_WRONG_RESPONSE_LENGTH);
+    } else {
+        write_u16_be(G_io_apdu_buffer, G_output_len, sw);
+        G_output_len += 2;
+    }
+}
+
+void io_reset_response() {
+    G_output_len = 0;
+}
+
+void io_set_response(const void *rdata, size_t rdata_len, uint16_t sw) {
+    io_reset_response();
+    if (rdata != NULL) {
+        io_add_to_response(rdata, rdata_len);
+    }
+    io_finalize_response(sw);
+}
+
+int io_confirm_response() {
+    int ret;
+
+    ret = io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, G_output_len);
+    G_output_len = 0;
+
+    return ret;
+}
+
+int io_send_response(void *rdata, size_t rdata_len, uint16_t sw) {
+    io_set_response(rdata, rdata_len, sw);
+    return io_confirm_response();
+}
+
+int io_send_sw(uint16_t sw) {
+    return io_send_response(NULL, 0, sw);
+}
+
+/**
+ * Builds an APDU that the dispatcher rejects, used to abort the current command when the
+ * responder cannot answer a client command.
+ */
+static unsigned short make_invalid_apdu(void) {
+    memset(G_io_apdu_buffer, 0, 5);
+    return 5;
+}
+
+unsigned short io_exchange(unsigned char channel_and_flags, unsigned short tx_len) {
+    host_io_session_t *s = &G_host_io_session;
+
+    if (channel_and_flags & IO_RETURN_AFTER_TX) {
+        // final response of the current command
+        memcpy(s->response, G_io_apdu_buffer, tx_len);
+        s->response_len = tx_len;
+        s->has_response = true;
+        return 0;
+    }
+
+    // response to an interruption; the client command is in the data of the response
+    if (tx_len < 2 || read_u16_be(G_io_apdu_buffer, tx_len - 2) != SW_INTERRUPTED_EXECUTION) {
+        s->error = HOST_IO_ERR_UNEXPECTED_EXCHANGE;
+        return make_invalid_apdu();
+    }
+
+    if (s->responder == NULL) {
+        s->error = HOST_IO_ERR_NO_RESPONDER;
+        return make_invalid_apdu();
+    }
+
+    uint8_t request[IO_APDU_BUFFER_SIZE];
+    size_t request_len = tx_len - 2;
+    memcpy(request, G_io_apdu_buffer, request_len);
+
+    int data_len = s->responder(s->responder_ctx, request, request_len, G_io_apdu_buffer + 5);
+    if (data_len < 0 || data_len > 255) {
+        s->error = HOST_IO_ERR_RESPONDER_FAILED;
+        return make_invalid_apdu();
+    }
+
+    G_io_apdu_buffer[0] = CLA_FRAMEWORK;
+    G_io_apdu_buffer[1] = INS_CONTINUE;
+    G_io_apdu_buffer[2] = 0;
+    G_io_apdu_buffer[3] = 0;
+    G_io_apdu_buffer[4] = (uint8_t) data_len;
+
+    ++s->apdu_count;
+    return (unsigned short) (5 + data_len);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "os.h"
+
+#include "libapp.h"
+
+#define HOST_IO_ERR_UNEXPECTED_EXCHANGE -1
+#define HOST_IO_ERR_NO_RESPONDER        -2
+#define HOST_IO_ERR_RESPONDER_FAILED    -3
+
+/**
+ * State of the APDU exchange currently processed by libapp_exchange.
+ */
+typedef struct {
+    libapp_responder_t responder;
+    void *responder_ctx;
+
+    uint8_t response[IO_APDU_BUFFER_SIZE];
+    uint16_t response_len;
+    bool has_response;
+
+    int error;  // 0, or one of the HOST_IO_ERR_* codes
+
+    uint32_t apdu_count;
+    bool locked;
+} host_io_session_t;
+
+extern host_io_session_t G_host_io_session;
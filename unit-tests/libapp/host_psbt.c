@@ -0,0 +1,188 @@
+/*****************************************************************************
+ *   Ledger App Bitcoin.
+ *   (c) 2021 Ledger SAS.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/psbt.h"
+#include "common/varint.h"
+#include "common/write.h"
+
+#include "host_psbt.h"
+
+typedef struct {
+    uint8_t **keys;
+    size_t *key_lengths;
+    uint8_t **values;
+    size_t *value_lengths;
+    size_t n_pairs;
+} map_t;
+
+struct host_psbt_s {
+    map_t global;
+    map_t *inputs;
+    size_t n_inputs;
+    map_t *outputs;
+    size_t n_outputs;
+};
+
+static void *xrealloc(void *ptr, size_t size) {
+    void *res = realloc(ptr, size);
+    if (res == NULL) abort();
+    return res;
+}
+
+static void map_add(map_t *map,
+                    const uint8_t *key,
+                    size_t key_len,
+                    const uint8_t *value,
+                    size_t value_len) {
+    size_t n = map->n_pairs + 1;
+    map->keys = xrealloc(map->keys, n * sizeof(map->keys[0]));
+    map->key_lengths = xrealloc(map->key_lengths, n * sizeof(map->key_lengths[0]));
+    map->values = xrealloc(map->values, n * sizeof(map->values[0]));
+    map->value_lengths = xrealloc(map->value_lengths, n * sizeof(map->value_lengths[0]));
+
+    // allocate at least one byte, so that empty values are not NULL
+    map->keys[map->n_pairs] = memcpy(xrealloc(NULL, key_len + 1), key, key_len);
+    map->key_lengths[map->n_pairs] = key_len;
+    map->values[map->n_pairs] = memcpy(xrealloc(NULL, value_len + 1), value, value_len);
+    map->value_lengths[map->n_pairs] = value_len;
+    map->n_pairs = n;
+}
+
+static void map_free(map_t *map) {
+    for (size_t i = 0; i < map->n_pairs; i++) {
+        free(map->keys[i]);
+        free(map->values[i]);
+    }
+    free(map->keys);
+    free(map->key_lengths);
+    free(map->values);
+    free(map->value_lengths);
+}
+
+static size_t map_commit(const map_t *map, host_client_t *client, uint8_t *commitment) {
+    return host_client_add_known_mapping(client,
+                                         (const uint8_t *const *) map->keys,
+                                         map->key_lengths,
+                                         (const uint8_t *const *) map->values,
+                                         map->value_lengths,
+                                         map->n_pairs,
+                                         commitment);
+}
+
+// Adds the list of the commitments of the given maps, and writes its size and root to out
+static size_t maps_list_commit(const map_t *maps,
+                               size_t n_maps,
+                               host_client_t *client,
+                               uint8_t *out) {
+    uint8_t(*commitments)[9 + 32 + 32] = xrealloc(NULL, (n_maps + 1) * sizeof(*commitments));
+    const uint8_t **elements = xrealloc(NULL, (n_maps + 1) * sizeof(elements[0]));
+    size_t *lengths = xrealloc(NULL, (n_maps + 1) * sizeof(lengths[0]));
+
+    for (size_t i = 0; i < n_maps; i++) {
+        lengths[i] = map_commit(&maps[i], client, commitments[i]);
+        elements[i] = commitments[i];
+    }
+
+    size_t len = varint_write(out, 0, n_maps);
+    host_client_add_known_list(client, elements, lengths, n_maps, out + len);
+
+    free(commitments);
+    free(elements);
+    free(lengths);
+    return len + 32;
+}
+
+host_psbt_t *host_psbt_new(uint32_t tx_version,
+                           uint32_t locktime,
+                           size_t n_inputs,
+                           size_t n_outputs) {
+    host_psbt_t *psbt = calloc(1, sizeof(host_psbt_t));
+    if (psbt == NULL) abort();
+
+    psbt->n_inputs = n_inputs;
+    psbt->inputs = calloc(n_inputs + 1, sizeof(map_t));
+    psbt->n_outputs = n_outputs;
+    psbt->outputs = calloc(n_outputs + 1, sizeof(map_t));
+    if (psbt->inputs == NULL || psbt->outputs == NULL) abort();
+
+    uint8_t value[9];
+
+    write_u32_le(value, 0, tx_version);
+    map_add(&psbt->global, (uint8_t[]){PSBT_GLOBAL_TX_VERSION}, 1, value, 4);
+
+    write_u32_le(value, 0, locktime);
+    map_add(&psbt->global, (uint8_t[]){PSBT_GLOBAL_FALLBACK_LOCKTIME}, 1, value, 4);
+
+    map_add(&psbt->global,
+            (uint8_t[]){PSBT_GLOBAL_INPUT_COUNT},
+            1,
+            value,
+            varint_write(value, 0, n_inputs));
+
+    map_add(&psbt->global,
+            (uint8_t[]){PSBT_GLOBAL_OUTPUT_COUNT},
+            1,
+            value,
+            varint_write(value, 0, n_outputs));
+
+    write_u32_le(value, 0, 2);
+    map_add(&psbt->global, (uint8_t[]){PSBT_GLOBAL_VERSION}, 1, value, 4);
+
+    return psbt;
+}
+
+void host_psbt_free(host_psbt_t *psbt) {
+    if (psbt == NULL) return;
+
+    map_free(&psbt->global);
+    for (size_t i = 0; i < psbt->n_inputs; i++) map_free(&psbt->inputs[i]);
+    free(psbt->inputs);
+    for (size_t i = 0; i < psbt->n_outputs; i++) map_free(&psbt->outputs[i]);
+    free(psbt->outputs);
+    free(psbt);
+}
+
+void host_psbt_add_input_value(host_psbt_t *psbt,
+                               size_t input_index,
+                               const uint8_t *key,
+                               size_t key_len,
+                               const uint8_t *value,
+                               size_t value_len) {
+    if (input_index >= psbt->n_inputs) abort();
+    map_add(&psbt->inputs[input_index], key, key_len, value, value_len);
+}
+
+void host_psbt_add_output_value(host_psbt_t *psbt,
+                                size_t output_index,
+                                const uint8_t *key,
+                                size_t key_len,
+                                const uint8_t *value,
+                                size_t value_len) {
+    if (output_index >= psbt->n_outputs) abort();
+    map_add(&psbt->outputs[output_index], key, key_len, value, value_len);
+}
+
+size_t host_psbt_commit(const host_psbt_t *psbt, host_client_t *client, uint8_t *out) {
+    size_t len = map_commit(&psbt->global, client, out);
+    len += maps_list_commit(psbt->inputs, psbt->n_inputs, client, out + len);
+    len += maps_list_commit(psbt->outputs, psbt->n_outputs, client, out + len);
+    return len;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+/*
+ * Builder of Merkleized PSBTv2, the C equivalent of the PSBT handling in the sign_psbt method of
+ * the Python client (bitcoin_client/ledger_bitcoin/client.py).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "host_client.h"
+
+// Maximum length of the data written by host_psbt_commit
+#define HOST_PSBT_MAX_COMMITMENT_LENGTH ((9 + 32 + 32) + (9 + 32) + (9 + 32))
+
+typedef struct host_psbt_s host_psbt_t;
+
+/**
+ * Allocates a new PSBTv2 with the given number of inputs and outputs, all with empty maps. The
+ * global map contains the transaction version, the fallback locktime, the input and output counts
+ * and PSBT_GLOBAL_VERSION.
+ */
+host_psbt_t *host_psbt_new(uint32_t tx_version,
+                           uint32_t locktime,
+                           size_t n_inputs,
+                           size_t n_outputs);
+
+/**
+ * Frees a PSBT allocated with host_psbt_new.
+ */
+void host_psbt_free(host_psbt_t *psbt);
+
+/**
+ * Adds a key-value pair to the map of the input with the given index. Key and value are copied.
+ */
+void host_psbt_add_input_value(host_psbt_t *psbt,
+                               size_t input_index,
+                               const uint8_t *key,
+                               size_t key_len,
+                               const uint8_t *value,
+                               size_t value_len);
+
+/**
+ * Adds a key-value pair to the map of the output with the given index. Key and value are copied.
+ */
+void host_psbt_add_output_value(host_psbt_t *psbt,
+                                size_t output_index,
+                                const uint8_t *key,
+                                size_t key_len,
+                                const uint8_t *value,
+                                size_t value_len);
+
+/**
+ * Adds all the maps of the PSBT to the client, and the Merkleized lists of the input and output map
+ * commitments.
+ *
+ * @param[out] out
+ *   Receives the first part of the data of the SIGN_PSBT APDU: the global map commitment, the
+ *   number of inputs and the root of the input commitments, the number of outputs and the root of
+ *   the output commitments. Must be at least HOST_PSBT_MAX_COMMITMENT_LENGTH bytes long.
+ *
+ * @return the length of the data written to out.
+ */
+size_t host_psbt_commit(const host_psbt_t *psbt, host_client_t *client, uint8_t *out);
@@ -0,0 +1,139 @@
+/*****************************************************************************
+ *   Ledger App Bitcoin.
+ *   (c) 2021 Ledger SAS.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Host replacement for src/ui/display.c and src/ui/menu.c.
+ *
+ * There is no screen: every UX flow is answered immediately, according to libapp_set_ui_approve.
+ * As the answer is known synchronously, the dispatcher is never paused; the next processor is set
+ * exactly as continue_after_approval does on device.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "boilerplate/dispatcher.h"
+#include "boilerplate/sw.h"
+#include "ui/display.h"
+#include "ui/menu.h"
+
+#include "host_ui.h"
+
+host_ui_state_t G_host_ui_state = {.approve = true};
+
+void send_deny_sw(dispatcher_context_t *dc) {
+    SEND_SW(dc, SW_DENY);
+}
+
+static void answer_flow(dispatcher_context_t *dc, command_processor_t on_success) {
+    ++G_host_ui_state.n_flows;
+    dc->next(G_host_ui_state.approve ? on_success : send_deny_sw);
+}
+
+void ui_menu_main(void) {
+}
+
+void ui_menu_about(void) {
+}
+
+void ui_display_pubkey(dispatcher_context_t *context,
+                       const char *bip32_path_str,
+                       bool is_path_suspicious,
+                       const char *pubkey,
+                       command_processor_t on_success) {
+    (void) bip32_path_str, (void) is_path_suspicious, (void) pubkey;
+    answer_flow(context, on_success);
+}
+
+void ui_display_message_hash(dispatcher_context_t *context,
+                             const char *bip32_path_str,
+                             const char *message_hash,
+                             command_processor_t on_success) {
+    (void) bip32_path_str, (void) message_hash;
+    answer_flow(context, on_success);
+}
+
+void ui_display_address(dispatcher_context_t *context,
+                        const char *address,
+                        bool is_path_suspicious,
+                        const char *bip32_path_str,
+                        command_processor_t on_success) {
+    (void) address, (void) is_path_suspicious, (void) bip32_path_str;
+    answer_flow(context, on_success);
+}
+
+void ui_display_wallet_header(dispatcher_context_t *context,
+                              const policy_map_wallet_header_t *wallet_header,
+                              command_processor_t on_success) {
+    (void) wallet_header;
+    answer_flow(context, on_success);
+}
+
+void ui_display_policy_map_cosigner_pubkey(dispatcher_context_t *context,
+                                           const char *pubkey,
+                                           uint8_t cosigner_index,
+                                           uint8_t n_keys,
+                                           bool is_internal,
+                                           command_processor_t on_success) {
+    (void) cosigner_index, (void) n_keys, (void) is_internal;
+    strncpy(G_host_ui_state.cosigner_pubkey, pubkey, sizeof(G_host_ui_state.cosigner_pubkey) - 1);
+    answer_flow(context, on_success);
+}
+
+void ui_display_wallet_address(dispatcher_context_t *context,
+                               const char *wallet_name,
+                               const char *address,
+                               command_processor_t on_success) {
+    (void) wallet_name, (void) address;
+    answer_flow(context, on_success);
+}
+
+void ui_display_unusual_path(dispatcher_context_t *context,
+                             const char *bip32_path_str,
+                             command_processor_t on_success) {
+    (void) bip32_path_str;
+    answer_flow(context, on_success);
+}
+
+void ui_authorize_wallet_spend(dispatcher_context_t *context,
+                               const char *wallet_name,
+                               command_processor_t on_success) {
+    (void) wallet_name;
+    answer_flow(context, on_success);
+}
+
+void ui_warn_external_inputs(dispatcher_context_t *context, command_processor_t on_success) {
+    answer_flow(context, on_success);
+}
+
+void ui_validate_output(dispatcher_context_t *context,
+                        int index,
+                        const char *address_or_description,
+                        const char *coin_name,
+                        uint64_t amount,
+                        command_processor_t on_success) {
+    (void) index, (void) address_or_description, (void) coin_name, (void) amount;
+    answer_flow(context, on_success);
+}
+
+void ui_validate_transaction(dispatcher_context_t *context,
+                             const char *coin_name,
+                             uint64_t fee,
+                             command_processor_t on_success) {
+    (void) coin_name, (void) fee;
+    answer_flow(context, on_success);
+}
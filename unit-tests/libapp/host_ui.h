@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * State of the simulated user.
+ */
+typedef struct {
+    bool approve;       // answer given to every UX flow
+    uint32_t n_flows;   // number of UX flows shown
+    char cosigner_pubkey[256];  // last key information shown when registering a wallet
+} host_ui_state_t;
+
+extern host_ui_state_t G_host_ui_state;
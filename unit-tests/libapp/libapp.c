@@ -0,0 +1,247 @@
+/*****************************************************************************
+ *   Ledger App Bitcoin.
+ *   (c) 2021 Ledger SAS.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Host replacement for the new-app part of src/main.c.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "os.h"
+
+#include "globals.h"
+#include "commands.h"
+#include "crypto.h"
+#include "boilerplate/apdu_parser.h"
+#include "boilerplate/constants.h"
+#include "boilerplate/dispatcher.h"
+#include "boilerplate/sw.h"
+#include "handler/lib/wallet_cache.h"
+#include "swap/swap_globals.h"
+#include "ui/menu.h"
+
+#include "host_crypto.h"
+#include "host_io.h"
+#include "host_ui.h"
+#include "libapp.h"
+
+command_state_t G_command_state;
+dispatcher_context_t G_dispatcher_context;
+
+global_context_t *G_coin_config;
+
+static global_context_t G_host_coin_config;
+
+// Same as in src/main.c; keep in sync.
+// clang-format off
+static const command_descriptor_t COMMAND_DESCRIPTORS[] = {
+    {
+        .cla = CLA_APP,
+        .ins = GET_EXTENDED_PUBKEY,
+        .handler = (command_handler_t)handler_get_extended_pubkey
+    },
+    {
+        .cla = CLA_APP,
+        .ins = GET_WALLET_ADDRESS,
+        .handler = (command_handler_t)handler_get_wallet_address
+    },
+    {
+        .cla = CLA_APP,
+        .ins = REGISTER_WALLET,
+        .handler = (command_handler_t)handler_register_wallet
+    },
+    {
+        .cla = CLA_APP,
+        .ins = SIGN_PSBT,
+        .handler = (command_handler_t)handler_sign_psbt
+    },
+    {
+        .cla = CLA_APP,
+        .ins = SIGN_PSBT_BATCHED,
+        .handler = (command_handler_t)handler_sign_psbt_batched
+    },
+    {
+        .cla = CLA_APP,
+        .ins = RESUME_SIGN_PSBT,
+        .handler = (command_handler_t)handler_resume_sign_psbt
+    },
+    {
+        .cla = CLA_APP,
+        .ins = GET_MASTER_FINGERPRINT,
+        .handler = (command_handler_t)handler_get_master_fingerprint
+    },
+    {
+        .cla = CLA_APP,
+        .ins = GET_EXTENDED_PUBKEYS,
+        .handler = (command_handler_t)handler_get_extended_pubkeys
+    },
+    {
+        .cla = CLA_APP,
+        .ins = SIGN_MESSAGE,
+        .handler = (command_handler_t)handler_sign_message
+    },
+    {
+        .cla = CLA_APP,
+        .ins = SIGN_MESSAGE_STREAMED,
+        .handler = (command_handler_t)handler_sign_message_streamed
+    },
+};
+// clang-format on
+
+// Subset of init_coin_config in src/main.c that is relevant for the new app
+static void init_coin_config(global_context_t *coin_config) {
+    memset(coin_config, 0, sizeof(global_context_t));
+
+    coin_config->bip32_pubkey_version = BIP32_PUBKEY_VERSION;
+
+    coin_config->bip44_coin_type = BIP44_COIN_TYPE;
+    coin_config->bip44_coin_type2 = BIP44_COIN_TYPE_2;
+    coin_config->p2pkh_version = COIN_P2PKH_VERSION;
+    coin_config->p2sh_version = COIN_P2SH_VERSION;
+
+    strcpy(coin_config->name_short, COIN_COINID_SHORT);
+
+    strcpy(coin_config->native_segwit_prefix_val, COIN_NATIVE_SEGWIT_PREFIX);
+    coin_config->native_segwit_prefix = coin_config->native_segwit_prefix_val;
+}
+
+void libapp_init(const uint8_t *seed, size_t seed_len) {
+    host_crypto_set_seed(seed, seed_len);
+    crypto_clear_cache();
+    sign_psbt_clear_session();
+
+    init_coin_config(&G_host_coin_config);
+    G_coin_config = &G_host_coin_config;
+
+    memset(&G_swap_state, 0, sizeof(G_swap_state));
+    wallet_cache_clear();
+    explicit_bzero(&G_command_state, sizeof(G_command_state));
+    explicit_bzero(&G_dispatcher_context, sizeof(G_dispatcher_context));
+
+    memset(&G_host_io_session, 0, sizeof(G_host_io_session));
+    G_host_ui_state.approve = true;
+    G_host_ui_state.n_flows = 0;
+    memset(G_host_ui_state.cosigner_pubkey, 0, sizeof(G_host_ui_state.cosigner_pubkey));
+
+    io_reset_timeouts();
+}
+
+void libapp_init_from_mnemonic(const char *mnemonic) {
+    // BIP-39: PBKDF2-HMAC-SHA512 with salt "mnemonic" (empty passphrase) and 2048 iterations
+    static const uint8_t salt[] = {'m', 'n', 'e', 'm', 'o', 'n', 'i', 'c', 0, 0, 0, 1};
+
+    const uint8_t *password = (const uint8_t *) mnemonic;
+    size_t password_len = strlen(mnemonic);
+
+    uint8_t u[64], seed[64];
+    cx_hmac_sha512(password, password_len, salt, sizeof(salt), u, sizeof(u));
+    memcpy(seed, u, sizeof(seed));
+    for (int i = 1; i < 2048; i++) {
+        cx_hmac_sha512(password, password_len, u, sizeof(u), u, sizeof(u));
+        for (int j = 0; j < 64; j++) {
+            seed[j] ^= u[j];
+        }
+    }
+
+    libapp_init(seed, sizeof(seed));
+    explicit_bzero(seed, sizeof(seed));
+}
+
+int libapp_exchange(const uint8_t *apdu,
+                    size_t apdu_len,
+                    libapp_responder_t responder,
+                    void *responder_ctx,
+                    uint8_t *out,
+                    size_t out_len) {
+    if (apdu_len < 5 || apdu_len > IO_APDU_BUFFER_SIZE) {
+        return LIBAPP_ERR_INVALID_APDU;
+    }
+
+    host_io_session_t *s = &G_host_io_session;
+    s->responder = responder;
+    s->responder_ctx = responder_ctx;
+    s->has_response = false;
+    s->response_len = 0;
+    s->error = 0;
+    ++s->apdu_count;
+
+    G_output_len = 0;
+    memcpy(G_io_apdu_buffer, apdu, apdu_len);
+
+    command_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    if (!apdu_parser(&cmd, G_io_apdu_buffer, apdu_len)) {
+        io_send_sw(SW_WRONG_DATA_LENGTH);
+    } else {
+        apdu_dispatcher(COMMAND_DESCRIPTORS,
+                        sizeof(COMMAND_DESCRIPTORS) / sizeof(COMMAND_DESCRIPTORS[0]),
+                        (machine_context_t *) &G_command_state,
+                        sizeof(G_command_state),
+                        ui_menu_main,
+                        &cmd);
+    }
+
+    s->responder = NULL;
+    s->responder_ctx = NULL;
+
+    switch (s->error) {
+        case HOST_IO_ERR_NO_RESPONDER:
+            return LIBAPP_ERR_NO_RESPONDER;
+        case HOST_IO_ERR_RESPONDER_FAILED:
+            return LIBAPP_ERR_RESPONDER_FAILED;
+        case HOST_IO_ERR_UNEXPECTED_EXCHANGE:
+            return LIBAPP_ERR_NO_RESPONSE;
+        default:
+            break;
+    }
+
+    if (!s->has_response) {
+        return LIBAPP_ERR_NO_RESPONSE;
+    }
+    if (s->response_len > out_len) {
+        return LIBAPP_ERR_BUFFER_TOO_SMALL;
+    }
+    memcpy(out, s->response, s->response_len);
+    return s->response_len;
+}
+
+uint32_t libapp_get_apdu_count(void) {
+    return G_host_io_session.apdu_count;
+}
+
+void libapp_set_locked(bool locked) {
+    G_host_io_session.locked = locked;
+
+    // like the ticker handler of the device
+    if (locked) {
+        crypto_clear_cache();
+        sign_psbt_clear_session();
+    }
+}
+
+void libapp_set_ui_approve(bool approve) {
+    G_host_ui_state.approve = approve;
+}
+
+uint32_t libapp_get_ui_flow_count(void) {
+    return G_host_ui_state.n_flows;
+}
+
+const char *libapp_get_ui_cosigner_pubkey(void) {
+    return G_host_ui_state.cosigner_pubkey;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+/*
+ * Host-native build of the app's APDU dispatcher and command handlers.
+ *
+ * The library exposes the app as a plain function taking an APDU and returning the response. Client
+ * commands (responses with SW_INTERRUPTED_EXECUTION) are answered synchronously by a responder
+ * callback, which makes it possible to run the full command handlers (including SIGN_PSBT) without
+ * Speculos. See README.md in this directory.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LIBAPP_MAX_APDU_LENGTH (5 + 255)
+
+#define LIBAPP_ERR_INVALID_APDU     -1
+#define LIBAPP_ERR_NO_RESPONDER     -2
+#define LIBAPP_ERR_RESPONDER_FAILED -3
+#define LIBAPP_ERR_BUFFER_TOO_SMALL -4
+#define LIBAPP_ERR_NO_RESPONSE      -5
+
+/**
+ * Callback that answers a client command sent by the app.
+ *
+ * @param[in] ctx
+ *   The opaque pointer given to libapp_exchange.
+ * @param[in] request
+ *   Data of the SW_INTERRUPTED_EXECUTION response (without the status word).
+ * @param[in] request_len
+ *   Length of request.
+ * @param[out] response
+ *   Buffer of LIBAPP_MAX_APDU_LENGTH bytes that receives the data of the CONTINUE_INTERRUPTED APDU.
+ *
+ * @return the length of the response data (at most 255), or a negative number on error.
+ */
+typedef int (*libapp_responder_t)(void *ctx,
+                                  const uint8_t *request,
+                                  size_t request_len,
+                                  uint8_t *response);
+
+/**
+ * Resets the app state, including the NVRAM wallet cache, and sets the seed used for all the key
+ * derivations.
+ *
+ * @param[in] seed
+ *   The BIP-39 seed (typically 64 bytes).
+ * @param[in] seed_len
+ *   Length of the seed; at most 64 bytes.
+ */
+void libapp_init(const uint8_t *seed, size_t seed_len);
+
+/**
+ * Computes the BIP-39 seed for a mnemonic with an empty passphrase, and calls libapp_init.
+ *
+ * @param[in] mnemonic
+ *   The mnemonic, as a space-separated string of words.
+ */
+void libapp_init_from_mnemonic(const char *mnemonic);
+
+/**
+ * Processes an APDU, answering any client command with the given responder.
+ *
+ * @param[in] apdu
+ *   The APDU (CLA, INS, P1, P2, Lc and command data).
+ * @param[in] apdu_len
+ *   Length of apdu.
+ * @param[in] responder
+ *   Callback used to answer client commands; can be NULL for commands that never interrupt.
+ * @param[in] responder_ctx
+ *   Opaque pointer passed to responder.
+ * @param[out] out
+ *   Buffer that receives the final response, including the 2-byte status word.
+ * @param[in] out_len
+ *   Size of out.
+ *
+ * @return the length of the response written to out, or a negative LIBAPP_ERR_* code.
+ */
+int libapp_exchange(const uint8_t *apdu,
+                    size_t apdu_len,
+                    libapp_responder_t responder,
+                    void *responder_ctx,
+                    uint8_t *out,
+                    size_t out_len);
+
+/**
+ * Returns the number of APDUs exchanged (including the CONTINUE_INTERRUPTED ones) since the last
+ * call to libapp_init.
+ */
+uint32_t libapp_get_apdu_count(void);
+
+/**
+ * Simulates a locked (or unlocked) device; see os_global_pin_is_validated.
+ */
+void libapp_set_locked(bool locked);
+
+/**
+ * Sets whether the simulated user approves (the default) or rejects the UX flows.
+ */
+void libapp_set_ui_approve(bool approve);
+
+/**
+ * Returns the number of UX flows that were shown (and automatically answered) since the last call
+ * to libapp_init.
+ */
+uint32_t libapp_get_ui_flow_count(void);
+
+/**
+ * Returns the key information shown in the last cosigner screen of REGISTER_WALLET.
+ */
+const char *libapp_get_ui_cosigner_pubkey(void);
@@ -0,0 +1,176 @@
+#pragma once
+
+/*
+ * Minimal host replacement for the subset of the BOLOS cryptographic API (cx.h) used by the app.
+ * All the primitives are implemented in software in unit-tests/libapp/host_crypto.c.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t cx_err_t;
+
+#define CX_OK            0x00000000
+#define CX_INTERNAL_ERROR 0xFFFFFF85
+#define CX_INVALID_PARAMETER 0xFFFFFF84
+
+typedef enum cx_curve_e {
+    CX_CURVE_NONE = 0,
+    CX_CURVE_SECP256K1 = 0x21,
+    CX_CURVE_256K1 = CX_CURVE_SECP256K1,
+} cx_curve_t;
+
+typedef enum cx_md_e {
+    CX_NONE = 0,
+    CX_RIPEMD160 = 1,
+    CX_SHA256 = 3,
+    CX_SHA512 = 5,
+} cx_md_t;
+
+#define CX_LAST (1 << 0)
+
+#define CX_RND_TRNG   (2 << 9)
+#define CX_RND_RFC6979 (3 << 9)
+
+#define CX_ECSCHNORR_BIP0340 (0 << 12)
+
+#define CX_ECCINFO_PARITY_ODD 1
+#define CX_ECCINFO_xGTn       2
+
+#define CX_SHA256_SIZE    32
+#define CX_SHA512_SIZE    64
+#define CX_RIPEMD160_SIZE 20
+
+typedef struct cx_hash_header_s {
+    cx_md_t algo;
+    uint32_t counter;
+} cx_hash_t;
+
+typedef struct cx_sha256_s {
+    cx_hash_t header;
+    size_t blen;
+    uint8_t block[64];
+    uint32_t acc[8];
+} cx_sha256_t;
+
+typedef struct cx_sha512_s {
+    cx_hash_t header;
+    size_t blen;
+    uint8_t block[128];
+    uint64_t acc[8];
+} cx_sha512_t;
+
+typedef struct cx_ripemd160_s {
+    cx_hash_t header;
+    size_t blen;
+    uint8_t block[64];
+    uint32_t acc[5];
+} cx_ripemd160_t;
+
+// Only needed for the layout of the legacy context; never used by the host build.
+typedef struct cx_blake2b_s {
+    cx_hash_t header;
+    uint8_t state[232];
+} cx_blake2b_t;
+
+union cx_u {
+    cx_sha256_t sha256;
+    cx_sha512_t sha512;
+    cx_ripemd160_t ripemd160;
+};
+
+typedef struct cx_ecfp_private_key_s {
+    cx_curve_t curve;
+    size_t d_len;
+    uint8_t d[32];
+} cx_ecfp_private_key_t;
+
+typedef struct cx_ecfp_public_key_s {
+    cx_curve_t curve;
+    size_t W_len;
+    uint8_t W[65];
+} cx_ecfp_public_key_t;
+
+// Hashes
+
+int cx_hash(cx_hash_t *hash,
+            int mode,
+            const uint8_t *in,
+            size_t len,
+            uint8_t *out,
+            size_t out_len);
+
+int cx_sha256_init(cx_sha256_t *hash);
+cx_err_t cx_sha256_init_no_throw(cx_sha256_t *hash);
+cx_err_t cx_sha256_update(cx_sha256_t *hash, const uint8_t *in, size_t in_len);
+cx_err_t cx_sha256_final(cx_sha256_t *hash, uint8_t *out);
+size_t cx_hash_sha256(const uint8_t *in, size_t len, uint8_t *out, size_t out_len);
+
+int cx_sha512_init(cx_sha512_t *hash);
+cx_err_t cx_sha512_update(cx_sha512_t *hash, const uint8_t *in, size_t in_len);
+cx_err_t cx_sha512_final(cx_sha512_t *hash, uint8_t *out);
+
+cx_err_t cx_ripemd160_init_no_throw(cx_ripemd160_t *hash);
+cx_err_t cx_ripemd160_update(cx_ripemd160_t *hash, const uint8_t *in, size_t in_len);
+cx_err_t cx_ripemd160_final(cx_ripemd160_t *hash, uint8_t *out);
+
+int cx_hmac_sha256(const uint8_t *key,
+                   size_t key_len,
+                   const uint8_t *in,
+                   size_t len,
+                   uint8_t *mac,
+                   size_t mac_len);
+
+int cx_hmac_sha512(const uint8_t *key,
+                   size_t key_len,
+                   const uint8_t *in,
+                   size_t len,
+                   uint8_t *mac,
+                   size_t mac_len);
+
+// Modular arithmetic on big-endian numbers.
+// The host backend only supports moduli larger than 2^255 (the secp256k1 field and group order).
+
+int cx_math_cmp(const uint8_t *a, const uint8_t *b, size_t len);
+int cx_math_sub(uint8_t *r, const uint8_t *a, const uint8_t *b, size_t len);
+void cx_math_addm(uint8_t *r, const uint8_t *a, const uint8_t *b, const uint8_t *m, size_t len);
+void cx_math_multm(uint8_t *r, const uint8_t *a, const uint8_t *b, const uint8_t *m, size_t len);
+void cx_math_powm(uint8_t *r,
+                  const uint8_t *a,
+                  const uint8_t *e,
+                  size_t len_e,
+                  const uint8_t *m,
+                  size_t len);
+
+// Elliptic curves (only secp256k1 is supported)
+
+int cx_ecfp_init_private_key(cx_curve_t curve,
+                             const uint8_t *raw_key,
+                             size_t key_len,
+                             cx_ecfp_private_key_t *pvkey);
+
+int cx_ecfp_generate_pair(cx_curve_t curve,
+                          cx_ecfp_public_key_t *pubkey,
+                          cx_ecfp_private_key_t *privkey,
+                          int keepprivate);
+
+int cx_ecfp_scalar_mult(cx_curve_t curve, uint8_t *P, size_t P_len, const uint8_t *k, size_t k_len);
+
+int cx_ecfp_add_point(cx_curve_t curve, uint8_t *R, const uint8_t *P, const uint8_t *Q, size_t X_len);
+
+int cx_ecdsa_sign(const cx_ecfp_private_key_t *pvkey,
+                  int mode,
+                  cx_md_t hashID,
+                  const uint8_t *hash,
+                  unsigned int hash_len,
+                  uint8_t *sig,
+                  unsigned int sig_len,
+                  unsigned int *info);
+
+cx_err_t cx_ecschnorr_sign_no_throw(const cx_ecfp_private_key_t *pvkey,
+                                    uint32_t mode,
+                                    cx_md_t hashID,
+                                    const uint8_t *msg,
+                                    size_t msg_len,
+                                    uint8_t *sig,
+                                    size_t *sig_len);
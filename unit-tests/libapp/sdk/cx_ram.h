@@ -0,0 +1,6 @@
+#pragma once
+
+#include "cx.h"
+
+// On the host, G_cx is just a regular global (defined in src/cxram_stash.c).
+extern union cx_u G_cx;
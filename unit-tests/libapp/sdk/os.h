@@ -0,0 +1,122 @@
+#pragma once
+
+/*
+ * Minimal host replacement for the subset of the BOLOS SDK os.h that is used by the dispatcher,
+ * the command handlers and src/common. It is only meant for the host-native libapp build; see
+ * unit-tests/libapp/README.md.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "cx.h"
+
+#ifndef MIN
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#endif
+
+#ifndef MAX
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+#endif
+
+#define U2BE(buf, off) ((((buf)[off] & 0xFF) << 8) | ((buf)[off + 1] & 0xFF))
+#define U4BE(buf, off) \
+    ((((uint32_t) U2BE(buf, off)) << 16) | ((uint32_t) U2BE(buf, off + 2) & 0xFFFF))
+
+// Debug output is disabled in the host build.
+#ifndef PRINTF
+#define PRINTF(...)
+#endif
+
+#define PIC(x) (x)
+
+// No position-independent code on the host.
+void *pic(void *linked_address);
+
+#define SYSCALL
+
+typedef unsigned short exception_t;
+
+#define EXCEPTION          1
+#define INVALID_PARAMETER  2
+#define EXCEPTION_IO_RESET 0x10
+
+// There are no exceptions on the host: the software crypto backend never throws, so TRY blocks
+// always run to completion, CATCH blocks are dead code and FINALLY always executes.
+#define BEGIN_TRY {
+#define TRY       if (1)
+#define CATCH(x)  else if (0)
+#define CATCH_ALL else
+#define FINALLY
+#define END_TRY }
+#define CLOSE_TRY
+#define THROW(x) abort()
+
+typedef uint8_t bolos_bool_t;
+
+#define BOLOS_TRUE   0xAA
+#define BOLOS_FALSE  0x55
+#define BOLOS_UX_OK  0xAA
+#define BOLOS_UX_NOK 0x55
+
+/**
+ * Returns BOLOS_UX_OK unless the host harness simulates a locked device (see libapp_set_locked).
+ */
+bolos_bool_t os_global_pin_is_validated(void);
+
+char os_secure_memcmp(const void *src1, const void *src2, size_t length);
+
+#define HDW_NORMAL 0
+#define HDW_SLIP21 2
+
+void os_perso_derive_node_bip32(cx_curve_t curve,
+                                const unsigned int *path,
+                                unsigned int path_length,
+                                unsigned char *private_key,
+                                unsigned char *chain);
+
+void os_perso_derive_node_with_seed_key(unsigned int mode,
+                                        cx_curve_t curve,
+                                        const unsigned int *path,
+                                        unsigned int path_length,
+                                        unsigned char *private_key,
+                                        unsigned char *chain,
+                                        unsigned char *seed_key,
+                                        unsigned int seed_key_length);
+
+void os_sched_exit(int exit_code);
+
+// NVRAM
+
+/**
+ * Copies src_len bytes from src_adr to dst_adr, or zeroes them if src_adr is NULL. On the host,
+ * NVRAM variables are ordinary memory (see NVM_CONST in CMakeLists.txt).
+ */
+void nvm_write(void *dst_adr, void *src_adr, unsigned int src_len);
+
+// IO
+
+#define IO_APDU_BUFFER_SIZE (5 + 255)
+
+#define CHANNEL_APDU        0
+#define CHANNEL_KEYBOARD    1
+#define CHANNEL_SPI         2
+#define IO_RESET_AFTER_REPLIED 0x80
+#define IO_RECEIVE_DATA        0x40
+#define IO_RETURN_AFTER_TX     0x20
+#define IO_ASYNCH_REPLY        0x10
+#define IO_FLAGS               0xF8
+
+extern uint8_t G_io_apdu_buffer[IO_APDU_BUFFER_SIZE];
+
+typedef struct {
+    unsigned short apdu_length;
+} io_app_t;
+
+extern io_app_t G_io_app;
+
+unsigned short io_exchange(unsigned char channel_and_flags, unsigned short tx_len);
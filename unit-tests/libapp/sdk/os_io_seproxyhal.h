@@ -0,0 +1,7 @@
+#pragma once
+
+#include "os.h"
+
+#ifndef IO_SEPROXYHAL_BUFFER_SIZE_B
+#define IO_SEPROXYHAL_BUFFER_SIZE_B 300
+#endif
@@ -0,0 +1,4 @@
+#pragma once
+
+// Everything is declared in the host cx.h.
+#include "cx.h"
@@ -0,0 +1,15 @@
+#pragma once
+
+// There is no UX on the host: the ui_* functions are replaced by unit-tests/libapp/host_ui.c.
+
+typedef struct {
+    int unused;
+} ux_state_t;
+
+typedef struct {
+    int unused;
+} bolos_ux_params_t;
+
+typedef struct {
+    int unused;
+} bagl_element_t;
@@ -3,6 +3,7 @@
 #include <setjmp.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
 
 #include <cmocka.h>
@@ -27,8 +28,108 @@ static void test_base58(void **state) {
     assert_string_equal((char *) out2, expected_out2);
 }
 
+static int hex_to_bytes(const char *hex, uint8_t *out) {
+    int len = 0;
+    for (; hex[0] != '\0' && hex[1] != '\0'; hex += 2) {
+        unsigned int byte;
+        sscanf(hex, "%2x", &byte);
+        out[len++] = (uint8_t) byte;
+    }
+    return len;
+}
+
+static void test_base58_vectors(void **state) {
+    (void) state;
+
+    // test vectors from Bitcoin Core (src/test/data/base58_encode_decode.json)
+    const char *vectors[][2] = {
+        {"61", "2g"},
+        {"626262", "a3gV"},
+        {"636363", "aPEr"},
+        {"73696d706c792061206c6f6e6720737472696e67", "2cFupjhnEsSn59qHXstmK2ffpLv2"},
+        {"00eb15231dfceb60925886b67d065299925915aeb172c06647",
+         "1NS17iag9jJgTHD1VXjvLCEnZuQ3rJDE9L"},
+        {"516b6fcd0f", "ABnLTmg"},
+        {"bf4f89001e670274dd", "3SEo3LWLoPntC"},
+        {"572e4794", "3EFU7m"},
+        {"ecac89cad93923c02321", "EJDM8drfXA6uyA"},
+        {"10c8511e", "Rt5zm"},
+        {"00000000000000000000", "1111111111"},
+        {"000111d38e5fc9071ffcd20b4a763cc9ae4f252bb4e48fd66a835e252ada93ff480d6dd43dc62a641155a5",
+         "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz"},
+    };
+
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        uint8_t bytes[100];
+        int bytes_len = hex_to_bytes(vectors[i][0], bytes);
+
+        char encoded[200];
+        int encoded_len = base58_encode(bytes, bytes_len, encoded, sizeof(encoded));
+        assert_int_equal(encoded_len, strlen(vectors[i][1]));
+        assert_memory_equal(encoded, vectors[i][1], encoded_len);
+
+        if (encoded_len >= 2) {
+            uint8_t decoded[100];
+            int decoded_len = base58_decode(vectors[i][1], encoded_len, decoded, sizeof(decoded));
+            assert_int_equal(decoded_len, bytes_len);
+            assert_memory_equal(decoded, bytes, bytes_len);
+        }
+    }
+}
+
+static void test_base58_roundtrip(void **state) {
+    (void) state;
+
+    uint32_t seed = 1;
+    for (size_t len = 2; len <= MAX_ENC_INPUT_SIZE; len++) {
+        for (size_t leading_zeros = 0; leading_zeros < 3 && leading_zeros < len; leading_zeros++) {
+            uint8_t bytes[MAX_ENC_INPUT_SIZE];
+            for (size_t i = 0; i < len; i++) {
+                seed = seed * 1103515245 + 12345;
+                bytes[i] = i < leading_zeros ? 0 : (uint8_t) (seed >> 16);
+            }
+
+            char encoded[MAX_DEC_INPUT_SIZE];
+            int encoded_len = base58_encode(bytes, len, encoded, sizeof(encoded));
+            assert_true(encoded_len >= 2);
+
+            // the output buffer must be large enough
+            assert_int_equal(base58_encode(bytes, len, encoded, encoded_len - 1), -1);
+
+            uint8_t decoded[MAX_ENC_INPUT_SIZE];
+            assert_int_equal(base58_decode(encoded, encoded_len, decoded, sizeof(decoded)), len);
+            assert_memory_equal(decoded, bytes, len);
+            assert_int_equal(base58_decode(encoded, encoded_len, decoded, len - 1), -1);
+        }
+    }
+}
+
+static void test_base58_failures(void **state) {
+    (void) state;
+
+    uint8_t out[MAX_DEC_INPUT_SIZE];
+
+    // invalid characters
+    assert_int_equal(base58_decode("1O", 2, out, sizeof(out)), -1);
+    assert_int_equal(base58_decode("10", 2, out, sizeof(out)), -1);
+    assert_int_equal(base58_decode("Il", 2, out, sizeof(out)), -1);
+    assert_int_equal(base58_decode("2g ", 3, out, sizeof(out)), -1);
+
+    // too short or too long
+    assert_int_equal(base58_decode("2", 1, out, sizeof(out)), -1);
+    char long_in[MAX_DEC_INPUT_SIZE + 1];
+    memset(long_in, 'z', sizeof(long_in));
+    assert_int_equal(base58_decode(long_in, sizeof(long_in), out, sizeof(out)), -1);
+
+    char encoded[200];
+    assert_int_equal(base58_encode(out, MAX_ENC_INPUT_SIZE + 1, encoded, sizeof(encoded)), -1);
+}
+
 int main() {
-    const struct CMUnitTest tests[] = {cmocka_unit_test(test_base58)};
+    const struct CMUnitTest tests[] = {cmocka_unit_test(test_base58),
+                                       cmocka_unit_test(test_base58_vectors),
+                                       cmocka_unit_test(test_base58_roundtrip),
+                                       cmocka_unit_test(test_base58_failures)};
 
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -0,0 +1,1839 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include "common/base58.h"
+#include "common/buffer.h"
+#include "common/psbt.h"
+#include "common/segwit_addr.h"
+#include "common/varint.h"
+#include "common/wallet.h"
+#include "common/write.h"
+#include "crypto.h"
+#include "handler/lib/psbt_parse_rawtx.h"
+#include "handler/lib/wallet_cache.h"
+#include "handler/client_commands.h"
+#include "handler/sign_psbt.h"
+#include "handler/sign_psbt/compare_wallet_script_at_path.h"
+
+#include "libapp/libapp.h"
+#include "libapp/host_client.h"
+#include "libapp/host_crypto.h"
+#include "libapp/host_psbt.h"
+
+#define CLA_APP 0xE1
+
+#define INS_GET_EXTENDED_PUBKEY    0x00
+#define INS_REGISTER_WALLET        0x02
+#define INS_GET_WALLET_ADDRESS     0x03
+#define INS_SIGN_PSBT              0x04
+#define INS_GET_MASTER_FINGERPRINT 0x05
+#define INS_GET_EXTENDED_PUBKEYS   0x06
+#define INS_SIGN_PSBT_BATCHED      0x07
+#define INS_RESUME_SIGN_PSBT       0x08
+#define INS_SIGN_MESSAGE           0x10
+#define INS_SIGN_MESSAGE_STREAMED  0x11
+
+#define SW_OK       0x9000
+#define SW_DENY     0x6985
+#define SW_NOT_SUPPORTED 0x6A82
+#define SW_INCORRECT_DATA 0x6A80
+#define SW_SECURITY_STATUS_NOT_SATISFIED 0x6982
+#define SW_SIGNATURE_FAIL 0xB008
+#define SW_BAD_STATE 0xB007
+
+// Same seed as the functional tests in the tests folder
+static const char TEST_MNEMONIC[] =
+    "glory promote mansion idle axis finger extra february uncover one trip resource lawn turtle "
+    "enact monster seven myth punch hobby comfort wild raise skin";
+
+static int setup(void **state) {
+    (void) state;
+
+    static bool initialized = false;
+
+    if (!initialized) {
+        // computing the seed is slow, therefore it is only done once
+        libapp_init_from_mnemonic(TEST_MNEMONIC);
+        initialized = true;
+    }
+    libapp_set_ui_approve(true);
+    libapp_set_locked(false);
+    return 0;
+}
+
+static size_t make_apdu(uint8_t *out, uint8_t ins, const uint8_t *data, size_t data_len) {
+    out[0] = CLA_APP;
+    out[1] = ins;
+    out[2] = 0;
+    out[3] = 0;
+    out[4] = (uint8_t) data_len;
+    memcpy(out + 5, data, data_len);
+    return 5 + data_len;
+}
+
+// Serializes a path like "m/44'/1'/0'" as <length: 1> <step 1: 4> ... <step n: 4>
+static size_t serialize_path(uint8_t *out, const char *path) {
+    size_t pos = 1;
+    const char *p = path + 1;  // skip 'm'
+    out[0] = 0;
+    while (*p == '/') {
+        char *end;
+        uint32_t step = (uint32_t) strtoul(p + 1, &end, 10);
+        if (*end == '\'') {
+            step |= 0x80000000u;
+            ++end;
+        }
+        out[pos++] = (uint8_t) (step >> 24);
+        out[pos++] = (uint8_t) (step >> 16);
+        out[pos++] = (uint8_t) (step >> 8);
+        out[pos++] = (uint8_t) step;
+        ++out[0];
+        p = end;
+    }
+    return pos;
+}
+
+static uint16_t get_sw(const uint8_t *response, int response_len) {
+    return (uint16_t) ((response[response_len - 2] << 8) | response[response_len - 1]);
+}
+
+static void test_get_master_fingerprint(void **state) {
+    (void) state;
+
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH], response[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_GET_MASTER_FINGERPRINT, NULL, 0);
+
+    int res = libapp_exchange(apdu, apdu_len, NULL, NULL, response, sizeof(response));
+    assert_int_equal(res, 4 + 2);
+    assert_int_equal(get_sw(response, res), SW_OK);
+
+    const uint8_t expected[] = {0xf5, 0xac, 0xc2, 0xfd};
+    assert_memory_equal(response, expected, sizeof(expected));
+}
+
+static int get_extended_pubkey(const char *path, bool display, uint8_t *response) {
+    uint8_t data[1 + 1 + 4 * 10];
+    data[0] = display ? 1 : 0;
+    size_t data_len = 1 + serialize_path(data + 1, path);
+
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_GET_EXTENDED_PUBKEY, data, data_len);
+    return libapp_exchange(apdu, apdu_len, NULL, NULL, response, LIBAPP_MAX_APDU_LENGTH);
+}
+
+static void test_get_extended_pubkey(void **state) {
+    (void) state;
+
+    // clang-format off
+    const char *testcases[][2] = {
+        {"m/44'/1'/0'", "tpubDCwYjpDhUdPGP5rS3wgNg13mTrrjBuG8V9VpWbyptX6TRPbNoZVXsoVUSkCjmQ8jJycjuDKBb9eataSymXakTTaGifxR6kmVsfFehH1ZgJT"},
+        {"m/44'/1'/10'", "tpubDCwYjpDhUdPGp21gSpVay2QPJVh6WNySWMXPhbcu1DsxH31dF7mY18oibbu5RxCLBc1Szerjscuc3D5HyvfYqfRvc9mesewnFqGmPjney4d"},
+        {"m/44'/1'/2'/1/42", "tpubDGF9YgHKv6qh777rcqVhpmDrbNzgophJM9ec7nHiSfrbss7fVBXoqhmZfohmJSvhNakDHAspPHjVVNL657tLbmTXvSeGev2vj5kzjMaeupT"},
+        {"m/48'/1'/4'/1'/0/7", "tpubDK8WPFx4WJo1R9mEL7Wq325wBiXvkAe8ipgb9Q1QBDTDUD2YeCfutWtzY88NPokZqJyRPKHLGwTNLT7jBG59aC6VH8q47LDGQitPB6tX2d7"},
+        {"m/49'/1'/1'/1/3", "tpubDGnetmJDCL18TyaaoyRAYbkSE9wbHktSdTS4mfsR6inC8c2r6TjdBt3wkqEQhHYPtXpa46xpxDaCXU2PRNUGVvDzAHPG6hHRavYbwAGfnFr"},
+        {"m/84'/1'/2'/0/10", "tpubDG9YpSUwScWJBBSrhnAT47NcT4NZGLcY18cpkaiWHnkUCi19EtCh8Heeox268NaFF6o56nVeSXuTyK6jpzTvV1h68Kr3edA8AZp27MiLUNt"},
+        {"m/86'/1'/4'/1/12", "tpubDHTZ815MvTaRmo6Qg1rnU6TEU4ZkWyA56jA1UgpmMcBGomnSsyo34EZLoctzZY9MTJ6j7bhccceUeXZZLxZj5vgkVMYfcZ7DNPsyRdFpS3f"},
+    };
+    // clang-format on
+
+    for (size_t i = 0; i < sizeof(testcases) / sizeof(testcases[0]); i++) {
+        uint8_t response[LIBAPP_MAX_APDU_LENGTH];
+        int res = get_extended_pubkey(testcases[i][0], false, response);
+        assert_true(res >= 2);
+        assert_int_equal(get_sw(response, res), SW_OK);
+        assert_int_equal(res - 2, strlen(testcases[i][1]));
+        assert_memory_equal(response, testcases[i][1], res - 2);
+    }
+}
+
+static void test_get_extended_pubkey_nonstandard(void **state) {
+    (void) state;
+
+    uint8_t response[LIBAPP_MAX_APDU_LENGTH];
+
+    // rejected without display
+    int res = get_extended_pubkey("m/44'/1'", false, response);
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_NOT_SUPPORTED);
+
+    // shown to the user, who rejects
+    libapp_set_ui_approve(false);
+    uint32_t n_flows = libapp_get_ui_flow_count();
+    res = get_extended_pubkey("m/44'/1'", true, response);
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_DENY);
+    assert_int_equal(libapp_get_ui_flow_count(), n_flows + 1);
+
+    // shown to the user, who approves
+    libapp_set_ui_approve(true);
+    res = get_extended_pubkey("m/44'/1'", true, response);
+    assert_int_equal(get_sw(response, res), SW_OK);
+}
+
+// Requests the extended pubkeys at the given paths with a single GET_EXTENDED_PUBKEYS command; the
+// pubkeys are yielded to the client
+static int get_extended_pubkeys(host_client_t *client,
+                                const char *const *paths,
+                                size_t n_paths,
+                                bool display,
+                                uint8_t *response) {
+    uint8_t data[LIBAPP_MAX_APDU_LENGTH];
+    data[0] = display ? 1 : 0;
+    data[1] = (uint8_t) n_paths;
+    size_t data_len = 2;
+    for (size_t i = 0; i < n_paths; i++) {
+        data_len += serialize_path(data + data_len, paths[i]);
+    }
+    assert_true(data_len <= 255);
+
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_GET_EXTENDED_PUBKEYS, data, data_len);
+    return libapp_exchange(apdu,
+                           apdu_len,
+                           host_client_respond,
+                           client,
+                           response,
+                           LIBAPP_MAX_APDU_LENGTH);
+}
+
+static void test_get_extended_pubkeys(void **state) {
+    (void) state;
+
+    const char *paths[] = {
+        "m/44'/1'/0'",
+        "m/44'/1'/10'",
+        "m/44'/1'/2'/1/42",
+        "m/48'/1'/4'/1'/0/7",
+        "m/84'/1'/2'/0/10",
+        "m/84'/1'/2'/0/11",
+        "m/84'/1'/2'/1/0",
+        "m/84'/1'/2'/1/1",
+        "m/84'/1'/2'",
+    };
+    const size_t n_paths = sizeof(paths) / sizeof(paths[0]);
+
+    // the expected results, and the number of derivations from the seed with one request per path
+    char expected[sizeof(paths) / sizeof(paths[0])][MAX_SERIALIZED_PUBKEY_LENGTH + 1];
+    uint32_t n_derivations_single = 0;
+    for (size_t i = 0; i < n_paths; i++) {
+        crypto_clear_cache();
+        uint32_t n_derivations = host_crypto_get_derivation_count();
+
+        uint8_t response[LIBAPP_MAX_APDU_LENGTH];
+        int res = get_extended_pubkey(paths[i], false, response);
+        assert_int_equal(get_sw(response, res), SW_OK);
+        memcpy(expected[i], response, res - 2);
+        expected[i][res - 2] = '\0';
+
+        n_derivations_single += host_crypto_get_derivation_count() - n_derivations;
+    }
+
+    host_client_t *client = host_client_new();
+
+    crypto_clear_cache();
+    uint32_t n_derivations = host_crypto_get_derivation_count();
+
+    uint8_t response[LIBAPP_MAX_APDU_LENGTH];
+    int res = get_extended_pubkeys(client, paths, n_paths, false, response);
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_OK);
+
+    uint32_t n_derivations_batch = host_crypto_get_derivation_count() - n_derivations;
+
+    assert_int_equal(host_client_get_yielded_count(client), n_paths);
+    for (size_t i = 0; i < n_paths; i++) {
+        size_t len;
+        const uint8_t *yielded = host_client_get_yielded(client, i, &len);
+        assert_int_equal(len, strlen(expected[i]));
+        assert_memory_equal(yielded, expected[i], len);
+    }
+
+    assert_true(n_derivations_batch < n_derivations_single);
+
+    // the addresses of an account are all computed from the account's pubkey, that is derived from
+    // the seed only once
+    const char *address_paths[] = {
+        "m/84'/1'/3'/0/0",
+        "m/84'/1'/3'/0/1",
+        "m/84'/1'/3'/0/2",
+        "m/84'/1'/3'/1/0",
+        "m/84'/1'/3'/1/1",
+        "m/84'/1'/3'/1/2",
+    };
+    host_client_clear_yielded(client);
+    crypto_clear_cache();
+    n_derivations = host_crypto_get_derivation_count();
+    res = get_extended_pubkeys(client, address_paths, 6, false, response);
+    assert_int_equal(get_sw(response, res), SW_OK);
+    assert_int_equal(host_client_get_yielded_count(client), 6);
+    assert_int_equal(host_crypto_get_derivation_count() - n_derivations, 1);
+
+    size_t len;
+    const uint8_t *yielded = host_client_get_yielded(client, 4, &len);
+    res = get_extended_pubkey(address_paths[4], false, response);
+    assert_int_equal(get_sw(response, res), SW_OK);
+    assert_int_equal(len, res - 2);
+    assert_memory_equal(yielded, response, len);
+
+    // a non-standard path is rejected without display, before returning any pubkey
+    host_client_clear_yielded(client);
+    const char *nonstandard_paths[] = {"m/44'/1'/0'", "m/44'/1'"};
+    res = get_extended_pubkeys(client, nonstandard_paths, 2, false, response);
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_NOT_SUPPORTED);
+    assert_int_equal(host_client_get_yielded_count(client), 0);
+
+    // with display, each pubkey is shown to the user
+    uint32_t n_flows = libapp_get_ui_flow_count();
+    res = get_extended_pubkeys(client, nonstandard_paths, 2, true, response);
+    assert_int_equal(get_sw(response, res), SW_OK);
+    assert_int_equal(libapp_get_ui_flow_count(), n_flows + 2);
+    assert_int_equal(host_client_get_yielded_count(client), 2);
+
+    host_client_free(client);
+}
+
+static void test_bip32_CKDpub_point(void **state) {
+    (void) state;
+
+    // m/84'/1'/0'
+    const uint32_t path[] = {0x80000054, 0x80000001, 0x80000000, 1, 42};
+    serialized_extended_pubkey_t account, expected;
+    assert_int_equal(crypto_get_extended_pubkey_at_path(path, 3, 0x043587CF, &account), 0);
+    assert_int_equal(crypto_get_extended_pubkey_at_path(path, 5, 0x043587CF, &expected), 0);
+
+    // serialized representation
+    serialized_extended_pubkey_t child;
+    assert_int_equal(bip32_CKDpub(&account, 1, &child), 0);
+    assert_int_equal(bip32_CKDpub(&child, 42, &child), 0);
+    assert_memory_equal(&child, &expected, sizeof(expected));
+
+    // point representation
+    extended_pubkey_point_t node;
+    assert_int_equal(crypto_extended_pubkey_to_point(&account, &node), 0);
+    assert_int_equal(bip32_CKDpub_point(&node, 1, &node), 0);
+    assert_int_equal(bip32_CKDpub_point(&node, 42, &node), 0);
+    assert_memory_equal(node.chain_code, expected.chain_code, 32);
+
+    uint8_t compressed_pubkey[33];
+    assert_int_equal(crypto_get_compressed_pubkey(node.uncompressed_pubkey, compressed_pubkey), 0);
+    assert_memory_equal(compressed_pubkey, expected.compressed_pubkey, 33);
+
+    // hardened children can not be derived
+    assert_true(bip32_CKDpub_point(&node, 0x80000000, &node) < 0);
+}
+
+static void test_locked_device(void **state) {
+    (void) state;
+
+    uint8_t response[LIBAPP_MAX_APDU_LENGTH];
+
+    libapp_set_locked(true);
+    int res = get_extended_pubkey("m/44'/1'/0'", false, response);
+    libapp_set_locked(false);
+
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_SECURITY_STATUS_NOT_SATISFIED);
+}
+
+static void test_key_cache_cleared_on_lock(void **state) {
+    (void) state;
+
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH];
+    uint8_t fpr[LIBAPP_MAX_APDU_LENGTH], fpr_2[LIBAPP_MAX_APDU_LENGTH];
+    uint8_t xpub[LIBAPP_MAX_APDU_LENGTH], xpub_2[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_GET_MASTER_FINGERPRINT, NULL, 0);
+
+    // both results are cached
+    assert_int_equal(libapp_exchange(apdu, apdu_len, NULL, NULL, fpr, sizeof(fpr)), 4 + 2);
+    assert_int_equal(get_extended_pubkey("m/44'/1'/0'", false, xpub), 111 + 2);
+
+    // unlocking the device with a different PIN might give access to a different seed
+    uint8_t other_seed[64];
+    memset(other_seed, 0x42, sizeof(other_seed));
+    libapp_set_locked(true);
+    host_crypto_set_seed(other_seed, sizeof(other_seed));
+    libapp_set_locked(false);
+
+    int fpr_2_len = libapp_exchange(apdu, apdu_len, NULL, NULL, fpr_2, sizeof(fpr_2));
+    int xpub_2_len = get_extended_pubkey("m/44'/1'/0'", false, xpub_2);
+
+    // restore the seed used by the other tests
+    libapp_init_from_mnemonic(TEST_MNEMONIC);
+
+    assert_int_equal(fpr_2_len, 4 + 2);
+    assert_int_equal(xpub_2_len, 111 + 2);
+    assert_memory_not_equal(fpr, fpr_2, 4);
+    assert_memory_not_equal(xpub, xpub_2, 111);
+}
+
+static int sign_message(const char *message, const char *path, uint8_t *response) {
+    size_t message_len = strlen(message);
+    size_t n_chunks = (message_len + 63) / 64;
+
+    const uint8_t *chunks[16];
+    size_t chunk_lengths[16];
+    assert_true(n_chunks <= 16);
+    for (size_t i = 0; i < n_chunks; i++) {
+        chunks[i] = (const uint8_t *) message + 64 * i;
+        chunk_lengths[i] = (i + 1 < n_chunks) ? 64 : message_len - 64 * i;
+    }
+
+    host_client_t *client = host_client_new();
+
+    uint8_t data[LIBAPP_MAX_APDU_LENGTH];
+    size_t data_len = serialize_path(data, path);
+    data_len += varint_write(data, data_len, message_len);
+    host_client_add_known_list(client, chunks, chunk_lengths, n_chunks, data + data_len);
+    data_len += 32;
+
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_SIGN_MESSAGE, data, data_len);
+    int res = libapp_exchange(apdu,
+                              apdu_len,
+                              host_client_respond,
+                              client,
+                              response,
+                              LIBAPP_MAX_APDU_LENGTH);
+    host_client_free(client);
+    return res;
+}
+
+// Signs a message with SIGN_MESSAGE_STREAMED
+static int sign_message_streamed(const char *message, const char *path, uint8_t *response) {
+    size_t message_len = strlen(message);
+
+    // the commitment is the root of a Merkle tree with the whole message as the only leaf, that is
+    // the hash of the leaf
+    host_client_t *client = host_client_new();
+
+    uint8_t data[LIBAPP_MAX_APDU_LENGTH];
+    size_t data_len = serialize_path(data, path);
+    const uint8_t *element = (const uint8_t *) message;
+    host_client_add_known_list(client, &element, &message_len, 1, data + data_len);
+    data_len += 32;
+
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_SIGN_MESSAGE_STREAMED, data, data_len);
+    int res = libapp_exchange(apdu,
+                              apdu_len,
+                              host_client_respond,
+                              client,
+                              response,
+                              LIBAPP_MAX_APDU_LENGTH);
+    host_client_free(client);
+    return res;
+}
+
+static void test_sign_message(void **state) {
+    (void) state;
+
+    uint8_t response[LIBAPP_MAX_APDU_LENGTH];
+
+    int res = sign_message("The Times 03/Jan/2009 Chancellor on brink of second bailout for banks.",
+                           "m/44'/1'/0'/0/0",
+                           response);
+    assert_int_equal(res, 65 + 2);
+    assert_int_equal(get_sw(response, res), SW_OK);
+
+    // clang-format off
+    const uint8_t expected[] = {
+        0x20, 0xe4, 0x78, 0x61, 0x15, 0x65, 0x98, 0x91, 0x8c, 0xc7, 0xe1, 0xfb, 0x3e, 0x04, 0x2f, 0x1f,
+        0x35, 0x80, 0x17, 0x41, 0xc0, 0x82, 0xb5, 0x20, 0x81, 0x07, 0x91, 0x76, 0x7a, 0x16, 0x2a, 0x9c,
+        0xa9, 0x7d, 0xa0, 0x1b, 0x7a, 0xba, 0x6f, 0x17, 0xe5, 0xdb, 0x38, 0x23, 0x39, 0x09, 0xdf, 0xe5,
+        0x8e, 0x88, 0x0d, 0xc9, 0x4d, 0xf0, 0xd8, 0xe2, 0x0b, 0xf1, 0xe6, 0x02, 0xc9, 0x9e, 0x91, 0xbb,
+        0x69
+    };
+    // clang-format on
+    assert_memory_equal(response, expected, sizeof(expected));
+}
+
+static void test_sign_message_long(void **state) {
+    (void) state;
+
+    uint8_t response[LIBAPP_MAX_APDU_LENGTH];
+
+    // split in multiple leaves in the Merkle tree
+    int res = sign_message(
+        "The root problem with conventional currency is all the trust that's required to make it "
+        "work. The central bank must be trusted not to debase the currency, but the history of "
+        "fiat currencies is full of breaches of that trust.",
+        "m/84'/1'/0'/0/8",
+        response);
+    assert_int_equal(res, 65 + 2);
+    assert_int_equal(get_sw(response, res), SW_OK);
+}
+
+static void get_wallet_address(const char *policy_map,
+                               const char *key_info,
+                               uint8_t change,
+                               uint32_t address_index,
+                               const char *expected) {
+    host_client_t *client = host_client_new();
+
+    uint8_t data[1 + 32 + 32 + 1 + 4];
+    data[0] = 0;  // no display
+    host_client_add_policy_wallet(client, "", policy_map, &key_info, 1, data + 1, NULL);
+    memset(data + 1 + 32, 0, 32);  // no hmac
+    data[65] = change;
+    data[66] = (uint8_t) (address_index >> 24);
+    data[67] = (uint8_t) (address_index >> 16);
+    data[68] = (uint8_t) (address_index >> 8);
+    data[69] = (uint8_t) address_index;
+
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH], response[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_GET_WALLET_ADDRESS, data, sizeof(data));
+    int res =
+        libapp_exchange(apdu, apdu_len, host_client_respond, client, response, sizeof(response));
+    host_client_free(client);
+
+    assert_true(res >= 2);
+    assert_int_equal(get_sw(response, res), SW_OK);
+    assert_int_equal(res - 2, strlen(expected));
+    assert_memory_equal(response, expected, res - 2);
+}
+
+static void test_sign_message_streamed(void **state) {
+    (void) state;
+
+    const char *messages[] = {
+        "",
+        "The Times 03/Jan/2009 Chancellor on brink of second bailout for banks.",
+        "The root problem with conventional currency is all the trust that's required to make it "
+        "work. The central bank must be trusted not to debase the currency, but the history of "
+        "fiat currencies is full of breaches of that trust. Banks must be trusted to hold our "
+        "money and transfer it electronically, but they lend it out in waves of credit bubbles "
+        "with barely a fraction in reserve. We have to trust them with our privacy, trust them "
+        "not to let identity thieves drain our accounts.",
+    };
+
+    for (size_t i = 0; i < sizeof(messages) / sizeof(messages[0]); i++) {
+        uint8_t expected[LIBAPP_MAX_APDU_LENGTH], response[LIBAPP_MAX_APDU_LENGTH];
+
+        uint32_t n_apdus = libapp_get_apdu_count();
+        int expected_len = sign_message(messages[i], "m/84'/1'/0'/0/8", expected);
+        uint32_t n_apdus_merkle = libapp_get_apdu_count() - n_apdus;
+        assert_int_equal(get_sw(expected, expected_len), SW_OK);
+
+        n_apdus = libapp_get_apdu_count();
+        int res = sign_message_streamed(messages[i], "m/84'/1'/0'/0/8", response);
+        uint32_t n_apdus_streamed = libapp_get_apdu_count() - n_apdus;
+
+        assert_int_equal(res, expected_len);
+        assert_memory_equal(response, expected, res);
+        if (strlen(messages[i]) > 64) {
+            assert_true(2 * n_apdus_streamed < n_apdus_merkle);
+        }
+    }
+}
+
+static void test_get_wallet_address_singlesig(void **state) {
+    (void) state;
+
+    const char *key_pkh =
+        "[f5acc2fd/44'/1'/0']tpubDCwYjpDhUdPGP5rS3wgNg13mTrrjBuG8V9VpWbyptX6TRPbNoZVXsoVUSkCjmQ8jJyc"
+        "juDKBb9eataSymXakTTaGifxR6kmVsfFehH1ZgJT/**";
+    get_wallet_address("pkh(@0)", key_pkh, 0, 0, "mz5vLWdM1wHVGSmXUkhKVvZbJ2g4epMXSm");
+    get_wallet_address("pkh(@0)", key_pkh, 1, 15, "myFCUBRCKFjV7292HnZtiHqMzzHrApobpT");
+
+    const char *key_wpkh =
+        "[f5acc2fd/84'/1'/0']tpubDCtKfsNyRhULjZ9XMS4VKKtVcPdVDi8MKUbcSD9MJDyjRu1A2ND5MiipozyyspBT9bg"
+        "8upEp7a8EAgFxNxXn1d7QkdbL52Ty5jiSLcxPt1P/**";
+    get_wallet_address("wpkh(@0)", key_wpkh, 0, 0, "tb1qzdr7s2sr0dwmkwx033r4nujzk86u0cy6fmzfjk");
+    get_wallet_address("wpkh(@0)", key_wpkh, 1, 15, "tb1qlrvzyx8jcjfj2xuy69du9trtxnsvjuped7e289");
+
+    const char *key_sh_wpkh =
+        "[f5acc2fd/49'/1'/0']tpubDC871vGLAiKPcwAw22EjhKVLk5L98UGXBEcGR8gpcigLQVDDfgcYW24QBEyTHTSFEjg"
+        "JgbaHU8CdRi9vmG4cPm1kPLmZhJEP17FMBdNheh3/**";
+    get_wallet_address("sh(wpkh(@0))", key_sh_wpkh, 0, 0, "2MyHkbusvLomaarGYMqyq7q9pSBYJRwWcsw");
+    get_wallet_address("sh(wpkh(@0))", key_sh_wpkh, 1, 15, "2NAbM4FSeBQG4o85kbXw2YNfKypcnEZS9MR");
+
+    const char *key_tr =
+        "[f5acc2fd/86'/1'/0']tpubDDKYE6BREvDsSWMazgHoyQWiJwYaDDYPbCFjYxN3HFXJP5fokeiK4hwK5tTLBNEDBwr"
+        "DXn8cQ4v9b2xdW62Xr5yxoQdMu1v6c7UDXYVH27U/**";
+    get_wallet_address("tr(@0)",
+                       key_tr,
+                       0,
+                       0,
+                       "tb1pws8wvnj99ca6acf8kq7pjk7vyxknah0d9mexckh5s0vu2ccy68js9am6u7");
+    get_wallet_address("tr(@0)",
+                       key_tr,
+                       1,
+                       9,
+                       "tb1p98d6s9jkf0la8ras4nnm72zme5r03fexn29e3pgz4qksdy84ndpqgjak72");
+}
+
+// Writes the scriptPubKey of a testnet address, and returns its length
+static size_t address_to_script(const char *address, uint8_t out[static 34]) {
+    if (strncmp(address, "tb1", 3) == 0) {
+        int version;
+        size_t program_len;
+        assert_int_equal(segwit_addr_decode(&version, out + 2, &program_len, "tb", address), 1);
+        out[0] = version == 0 ? 0x00 : (uint8_t) (0x50 + version);
+        out[1] = (uint8_t) program_len;
+        return 2 + program_len;
+    }
+
+    uint8_t decoded[1 + 20 + 4];
+    assert_int_equal(base58_decode(address, strlen(address), decoded, sizeof(decoded)),
+                     sizeof(decoded));
+    if (decoded[0] == 0x6f) {
+        // P2PKH
+        out[0] = 0x76;
+        out[1] = 0xa9;
+        out[2] = 0x14;
+        memcpy(out + 3, decoded + 1, 20);
+        out[23] = 0x88;
+        out[24] = 0xac;
+        return 25;
+    } else {
+        // P2SH
+        assert_int_equal(decoded[0], 0xc4);
+        out[0] = 0xa9;
+        out[1] = 0x14;
+        memcpy(out + 2, decoded + 1, 20);
+        out[22] = 0x87;
+        return 23;
+    }
+}
+
+static void test_compare_canonical_script(void **state) {
+    (void) state;
+
+    // same addresses as in test_get_wallet_address_singlesig, at m/<purpose>'/1'/0'/1/15 (or 9)
+    const struct {
+        uint32_t purpose;
+        int address_type;
+        uint32_t address_index;
+        const char *address;
+    } tests[] = {
+        {44, ADDRESS_TYPE_LEGACY, 15, "myFCUBRCKFjV7292HnZtiHqMzzHrApobpT"},
+        {84, ADDRESS_TYPE_WIT, 15, "tb1qlrvzyx8jcjfj2xuy69du9trtxnsvjuped7e289"},
+        {49, ADDRESS_TYPE_SH_WIT, 15, "2NAbM4FSeBQG4o85kbXw2YNfKypcnEZS9MR"},
+        {86,
+         ADDRESS_TYPE_TR,
+         9,
+         "tb1p98d6s9jkf0la8ras4nnm72zme5r03fexn29e3pgz4qksdy84ndpqgjak72"},
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        uint8_t script[34];
+        size_t script_len = address_to_script(tests[i].address, script);
+
+        uint32_t path[] = {tests[i].purpose | 0x80000000u,
+                           1 | 0x80000000u,
+                           0x80000000u,
+                           1,
+                           tests[i].address_index};
+        assert_int_equal(
+            compare_canonical_script_at_path(path, 5, tests[i].address_type, script, script_len),
+            1);
+
+        // different address index, or different script type
+        path[4] += 1;
+        assert_int_equal(
+            compare_canonical_script_at_path(path, 5, tests[i].address_type, script, script_len),
+            0);
+        path[4] -= 1;
+        int other_type = tests[i].address_type == ADDRESS_TYPE_TR ? ADDRESS_TYPE_WIT
+                                                                  : ADDRESS_TYPE_TR;
+        assert_int_equal(compare_canonical_script_at_path(path, 5, other_type, script, script_len),
+                         0);
+    }
+}
+
+// Sends the REGISTER_WALLET command for the given serialized wallet; returns the status word, and
+// on success writes the wallet id and its hmac to id_and_hmac
+static int register_serialized_wallet(host_client_t *client,
+                                      const uint8_t *wallet,
+                                      size_t wallet_len,
+                                      uint8_t id_and_hmac[static 64]) {
+    uint8_t data[LIBAPP_MAX_APDU_LENGTH];
+    assert_true(wallet_len < 0xFD);
+    data[0] = (uint8_t) wallet_len;
+    memcpy(data + 1, wallet, wallet_len);
+
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH], response[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_REGISTER_WALLET, data, 1 + wallet_len);
+    int res =
+        libapp_exchange(apdu, apdu_len, host_client_respond, client, response, sizeof(response));
+    assert_true(res >= 2);
+    if (res == 32 + 32 + 2) {
+        memcpy(id_and_hmac, response, 64);
+    }
+    return get_sw(response, res);
+}
+
+#define MULTISIG_15_POLICY_MAP \
+    "wsh(sortedmulti(15,@0,@1,@2,@3,@4,@5,@6,@7,@8,@9,@10,@11,@12,@13,@14))"
+
+/**
+ * Registers a wsh(sortedmulti(15, ...)) wallet where the first key is internal, and the others are
+ * in the given order; returns the address at index 0.
+ */
+// Registers the wallet policy wsh(sortedmulti(15,...)) with the given name and key informations,
+// and writes the wallet id and its hmac to id_and_hmac
+static void register_multisig(host_client_t *client,
+                              const char *name,
+                              const char *const keys_info[15],
+                              uint8_t id_and_hmac[static 64]) {
+    uint8_t wallet[LIBAPP_MAX_APDU_LENGTH];
+    uint8_t wallet_id[32];
+    size_t wallet_len = host_client_add_policy_wallet(client,
+                                                      name,
+                                                      MULTISIG_15_POLICY_MAP,
+                                                      keys_info,
+                                                      15,
+                                                      wallet_id,
+                                                      wallet);
+
+    assert_int_equal(register_serialized_wallet(client, wallet, wallet_len, id_and_hmac), SW_OK);
+    assert_memory_equal(id_and_hmac, wallet_id, 32);
+}
+
+// Gets the first receive address of a registered wallet policy; returns the status word
+static int get_registered_wallet_address(host_client_t *client,
+                                         const uint8_t id_and_hmac[static 64],
+                                         char *address) {
+    uint8_t data[70];
+    data[0] = 0;  // no display
+    memcpy(data + 1, id_and_hmac, 64);
+    memset(data + 65, 0, 5);  // change 0, address index 0
+
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH], response[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_GET_WALLET_ADDRESS, data, sizeof(data));
+    int res =
+        libapp_exchange(apdu, apdu_len, host_client_respond, client, response, sizeof(response));
+    assert_true(res >= 2);
+    memcpy(address, response, res - 2);
+    address[res - 2] = '\0';
+    return get_sw(response, res);
+}
+
+static void register_and_get_multisig_address(const char *const keys_info[15], char *address) {
+    host_client_t *client = host_client_new();
+
+    uint8_t id_and_hmac[64];
+    register_multisig(client, "Treasury", keys_info, id_and_hmac);
+    assert_int_equal(get_registered_wallet_address(client, id_and_hmac, address), SW_OK);
+
+    host_client_free(client);
+}
+
+// Makes the key informations of 15 cosigners at m/48'/1'/i'/2'; only the first one is internal
+static void make_multisig_keys_info(char keys_info[15][MAX_POLICY_KEY_INFO_LEN + 1]) {
+    for (int i = 0; i < 15; i++) {
+        char path[32];
+        snprintf(path, sizeof(path), "m/48'/1'/%d'/2'", i);
+
+        uint8_t response[LIBAPP_MAX_APDU_LENGTH];
+        int res = get_extended_pubkey(path, false, response);
+        assert_true(res > 2);
+        assert_int_equal(get_sw(response, res), SW_OK);
+
+        // only the first key has our fingerprint, therefore it is the only internal one
+        snprintf(keys_info[i],
+                 MAX_POLICY_KEY_INFO_LEN + 1,
+                 "[%s/48'/1'/%d'/2']%.*s/**",
+                 i == 0 ? "f5acc2fd" : "12345678",
+                 i,
+                 res - 2,
+                 (const char *) response);
+    }
+}
+
+static void test_multisig_15of15(void **state) {
+    (void) state;
+
+    char keys_info[15][MAX_POLICY_KEY_INFO_LEN + 1];
+    make_multisig_keys_info(keys_info);
+
+    const char *keys_in_order[15], *keys_reversed[15];
+    keys_in_order[0] = keys_reversed[0] = keys_info[0];
+    for (int i = 1; i < 15; i++) {
+        keys_in_order[i] = keys_info[i];
+        keys_reversed[i] = keys_info[15 - i];
+    }
+
+    char address_1[100], address_2[100];
+    register_and_get_multisig_address(keys_in_order, address_1);
+    register_and_get_multisig_address(keys_reversed, address_2);
+
+    // p2wsh address
+    assert_int_equal(strlen(address_1), 62);
+    assert_memory_equal(address_1, "tb1q", 4);
+
+    // the keys are sorted, therefore their order in the policy does not change the address
+    assert_string_equal(address_1, address_2);
+}
+
+static void test_wallet_cache(void **state) {
+    (void) state;
+
+    char keys_info[15][MAX_POLICY_KEY_INFO_LEN + 1];
+    make_multisig_keys_info(keys_info);
+    const char *keys[15];
+    for (int i = 0; i < 15; i++) {
+        keys[i] = keys_info[i];
+    }
+
+    host_client_t *client = host_client_new();
+
+    // registering the wallet adds it to the cache: no round trip is needed to get an address
+    uint8_t id_and_hmac[64];
+    register_multisig(client, "Vault 0", keys, id_and_hmac);
+
+    char address[100], cached_address[100];
+    uint32_t n_apdus = libapp_get_apdu_count();
+    assert_int_equal(get_registered_wallet_address(client, id_and_hmac, cached_address), SW_OK);
+    assert_int_equal(libapp_get_apdu_count() - n_apdus, 1);
+
+    // on a cache miss, the policy and all the keys are fetched; the wallet is only cached again
+    // if it misses a second time
+    wallet_cache_clear();
+    uint32_t miss_apdus = 0;
+    for (int i = 0; i < 2; i++) {
+        n_apdus = libapp_get_apdu_count();
+        assert_int_equal(get_registered_wallet_address(client, id_and_hmac, address), SW_OK);
+        assert_true(libapp_get_apdu_count() - n_apdus > 15);
+        miss_apdus = libapp_get_apdu_count() - n_apdus;
+        assert_string_equal(address, cached_address);
+    }
+
+    n_apdus = libapp_get_apdu_count();
+    assert_int_equal(get_registered_wallet_address(client, id_and_hmac, address), SW_OK);
+    assert_int_equal(libapp_get_apdu_count() - n_apdus, 1);
+    assert_string_equal(address, cached_address);
+
+    // the hmac is still verified on a cache hit
+    uint8_t wrong_hmac[64];
+    memcpy(wrong_hmac, id_and_hmac, 64);
+    wrong_hmac[63] ^= 1;
+    assert_int_equal(get_registered_wallet_address(client, wrong_hmac, address), SW_SIGNATURE_FAIL);
+
+    // filling the cache evicts the least recently used wallet; the keys are cached while they are
+    // processed during the registration, so that it does not fetch them a second time
+    uint8_t other_id_and_hmac[WALLET_CACHE_N_SLOTS][64];
+    for (int i = 0; i < WALLET_CACHE_N_SLOTS; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "Vault %d", i + 1);
+        n_apdus = libapp_get_apdu_count();
+        register_multisig(client, name, keys, other_id_and_hmac[i]);
+        assert_true(libapp_get_apdu_count() - n_apdus <= miss_apdus);
+    }
+
+    // a registration that fails after all the keys were approved (here, as no key is internal)
+    // does not evict any wallet
+    char external_key_info[MAX_POLICY_KEY_INFO_LEN + 1];
+    strcpy(external_key_info, keys_info[0]);
+    memcpy(external_key_info + 1, "12345678", 8);
+    const char *external_keys[15];
+    memcpy(external_keys, keys, sizeof(keys));
+    external_keys[0] = external_key_info;
+
+    uint8_t wallet[LIBAPP_MAX_APDU_LENGTH], wallet_id[32], rejected_id_and_hmac[64];
+    size_t wallet_len = host_client_add_policy_wallet(client,
+                                                      "Vault X",
+                                                      MULTISIG_15_POLICY_MAP,
+                                                      external_keys,
+                                                      15,
+                                                      wallet_id,
+                                                      wallet);
+    assert_int_equal(register_serialized_wallet(client, wallet, wallet_len, rejected_id_and_hmac),
+                     SW_NOT_SUPPORTED);
+
+    for (int i = 0; i < WALLET_CACHE_N_SLOTS; i++) {
+        n_apdus = libapp_get_apdu_count();
+        assert_int_equal(get_registered_wallet_address(client, other_id_and_hmac[i], address),
+                         SW_OK);
+        assert_int_equal(libapp_get_apdu_count() - n_apdus, 1);
+        // same keys, same policy: same address for all the wallets
+        assert_string_equal(address, cached_address);
+    }
+
+    // the first wallet was evicted: its policy is fetched again, but its keys are the ones of the
+    // cached wallets, and are not fetched
+    n_apdus = libapp_get_apdu_count();
+    assert_int_equal(get_registered_wallet_address(client, id_and_hmac, address), SW_OK);
+    assert_true(libapp_get_apdu_count() - n_apdus > 1);
+    assert_true(libapp_get_apdu_count() - n_apdus < 15);
+    assert_string_equal(address, cached_address);
+
+    host_client_free(client);
+}
+
+// Converts a key information to the binary encoding; returns its length
+static size_t key_info_to_binary(const char *key_info,
+                                 uint8_t out[static MAX_POLICY_KEY_INFO_LEN]) {
+    policy_map_key_info_t parsed;
+    buffer_t key_info_buf = buffer_create((void *) key_info, strlen(key_info));
+    assert_int_equal(parse_policy_map_key_info(&key_info_buf, &parsed), 0);
+    assert_false(parsed.is_binary);
+
+    buffer_t out_buf = buffer_create(out, MAX_POLICY_KEY_INFO_LEN);
+    uint8_t flags = (parsed.has_key_origin ? KEY_INFO_BINARY_HAS_KEY_ORIGIN : 0) |
+                    (parsed.has_wildcard ? KEY_INFO_BINARY_HAS_WILDCARD : 0);
+    assert_true(buffer_write_u8(&out_buf, flags));
+    if (parsed.has_key_origin) {
+        assert_true(buffer_write_bytes(&out_buf, parsed.master_key_fingerprint, 4));
+        assert_true(buffer_write_u8(&out_buf, parsed.master_key_derivation_len));
+        for (int i = 0; i < parsed.master_key_derivation_len; i++) {
+            assert_true(buffer_write_u32(&out_buf, parsed.master_key_derivation[i], LE));
+        }
+    }
+
+    serialized_extended_pubkey_t ext_pubkey;
+    assert_int_equal(get_policy_map_key_info_ext_pubkey(&parsed, &ext_pubkey), 0);
+    assert_true(buffer_write_bytes(&out_buf, (uint8_t *) &ext_pubkey, sizeof(ext_pubkey)));
+    return out_buf.offset;
+}
+
+static void test_wallet_binary_keys(void **state) {
+    (void) state;
+
+    char keys_info[15][MAX_POLICY_KEY_INFO_LEN + 1];
+    make_multisig_keys_info(keys_info);
+    const char *keys[15];
+    uint8_t binary_keys_info[15][MAX_POLICY_KEY_INFO_LEN];
+    const uint8_t *binary_keys[15];
+    size_t binary_lengths[15], text_lengths[15];
+    for (int i = 0; i < 15; i++) {
+        keys[i] = keys_info[i];
+        text_lengths[i] = strlen(keys_info[i]);
+        binary_lengths[i] = key_info_to_binary(keys_info[i], binary_keys_info[i]);
+        binary_keys[i] = binary_keys_info[i];
+        assert_true(binary_lengths[i] < text_lengths[i]);
+    }
+
+    host_client_t *client = host_client_new();
+
+    uint8_t id_and_hmac[64];
+    char address[100];
+    register_multisig(client, "Vault", keys, id_and_hmac);
+    assert_int_equal(get_registered_wallet_address(client, id_and_hmac, address), SW_OK);
+
+    uint8_t wallet[LIBAPP_MAX_APDU_LENGTH];
+    uint8_t wallet_id[32], binary_id_and_hmac[64];
+    size_t wallet_len = host_client_add_policy_wallet_binary_keys(client,
+                                                                  "Vault",
+                                                                  MULTISIG_15_POLICY_MAP,
+                                                                  binary_keys,
+                                                                  binary_lengths,
+                                                                  15,
+                                                                  wallet_id,
+                                                                  wallet);
+    assert_int_equal(register_serialized_wallet(client, wallet, wallet_len, binary_id_and_hmac),
+                     SW_OK);
+    assert_memory_equal(binary_id_and_hmac, wallet_id, 32);
+    assert_memory_not_equal(binary_id_and_hmac, id_and_hmac, 32);
+
+    // the keys are shown to the user in the string encoding
+    assert_string_equal(libapp_get_ui_cosigner_pubkey(), keys_info[14]);
+
+    // same address, both from the cache and from the keys fetched from the client
+    char binary_address[100];
+    assert_int_equal(get_registered_wallet_address(client, binary_id_and_hmac, binary_address),
+                     SW_OK);
+    assert_string_equal(binary_address, address);
+
+    wallet_cache_clear();
+    assert_int_equal(get_registered_wallet_address(client, binary_id_and_hmac, binary_address),
+                     SW_OK);
+    assert_string_equal(binary_address, address);
+
+    // the encoding of the key informations must match the wallet type
+    wallet_len = host_client_add_policy_wallet_binary_keys(client,
+                                                           "Vault",
+                                                           MULTISIG_15_POLICY_MAP,
+                                                           (const uint8_t *const *) keys,
+                                                           text_lengths,
+                                                           15,
+                                                           wallet_id,
+                                                           wallet);
+    assert_int_equal(register_serialized_wallet(client, wallet, wallet_len, binary_id_and_hmac),
+                     SW_INCORRECT_DATA);
+
+    host_client_free(client);
+}
+
+// Writes the P2WPKH scriptPubKey of the given compressed pubkey
+static void p2wpkh_script(const uint8_t pubkey[static 33], uint8_t out[static 22]) {
+    out[0] = 0x00;
+    out[1] = 0x14;
+    crypto_hash160(pubkey, 33, out + 2);
+}
+
+// Maximum length of the transactions written by make_prevtx
+#define PREVTX_MAX_LEN (4 + 1 + (32 + 4 + 1 + 4) + 1 + (8 + 1 + 25) + 4)
+
+/**
+ * Writes a fake transaction with 1 input and 1 output with the given amount and scriptPubKey, and
+ * computes its txid. The index makes the transactions of different inputs different.
+ *
+ * @return the length of the transaction.
+ */
+static size_t make_prevtx(size_t index,
+                          uint64_t amount,
+                          const uint8_t *script,
+                          size_t script_len,
+                          uint8_t prevtx[static PREVTX_MAX_LEN],
+                          uint8_t txid[static 32]) {
+    assert_true(script_len <= 25);
+    memset(prevtx, 0, PREVTX_MAX_LEN);
+
+    size_t pos = 0;
+    write_u32_le(prevtx, pos, 2);  // version
+    pos += 4;
+    prevtx[pos++] = 1;  // input count
+    // prevout hash (different for each input, so that all the txids are different), prevout index
+    // and empty scriptSig
+    write_u32_le(prevtx, pos, (uint32_t) index);
+    pos += 32 + 4 + 1;
+    write_u32_le(prevtx, pos, 0xFFFFFFFF);  // sequence
+    pos += 4;
+    prevtx[pos++] = 1;  // output count
+    write_u64_le(prevtx, pos, amount);
+    pos += 8;
+    prevtx[pos++] = (uint8_t) script_len;
+    memcpy(prevtx + pos, script, script_len);
+    pos += script_len;
+    pos += 4;  // locktime
+
+    cx_hash_sha256(prevtx, pos, txid, 32);
+    cx_hash_sha256(txid, 32, txid, 32);
+    return pos;
+}
+
+/**
+ * Adds an input spending the output 0 of a fake transaction with the given scriptPubKey.
+ * If pubkey is not NULL, the input is internal: it has the BIP32 derivation of pubkey at
+ * m/84'/1'/0'/0/address_index, and the non-witness utxo.
+ */
+static void add_wpkh_input(host_psbt_t *psbt,
+                           size_t index,
+                           uint64_t amount,
+                           const uint8_t script[static 22],
+                           const uint8_t *pubkey,
+                           uint32_t address_index) {
+    uint8_t prevtx[PREVTX_MAX_LEN];
+    uint8_t txid[32];
+    size_t prevtx_len = make_prevtx(index, amount, script, 22, prevtx, txid);
+
+    uint8_t witness_utxo[8 + 1 + 22];
+    write_u64_le(witness_utxo, 0, amount);
+    witness_utxo[8] = 22;
+    memcpy(witness_utxo + 9, script, 22);
+
+    uint8_t output_index[4] = {0};
+
+    host_psbt_add_input_value(psbt, index, (uint8_t[]){PSBT_IN_PREVIOUS_TXID}, 1, txid, 32);
+    host_psbt_add_input_value(psbt, index, (uint8_t[]){PSBT_IN_OUTPUT_INDEX}, 1, output_index, 4);
+    host_psbt_add_input_value(psbt,
+                              index,
+                              (uint8_t[]){PSBT_IN_WITNESS_UTXO},
+                              1,
+                              witness_utxo,
+                              sizeof(witness_utxo));
+
+    if (pubkey != NULL) {
+        host_psbt_add_input_value(psbt,
+                                  index,
+                                  (uint8_t[]){PSBT_IN_NON_WITNESS_UTXO},
+                                  1,
+                                  prevtx,
+                                  prevtx_len);
+
+        uint8_t key[1 + 33];
+        key[0] = PSBT_IN_BIP32_DERIVATION;
+        memcpy(key + 1, pubkey, 33);
+
+        const uint32_t path[] = {84 | 0x80000000u, 1 | 0x80000000u, 0x80000000u, 0, address_index};
+        uint8_t value[4 + 4 * 5] = {0xf5, 0xac, 0xc2, 0xfd};
+        for (size_t i = 0; i < 5; i++) {
+            write_u32_le(value, 4 + 4 * i, path[i]);
+        }
+        host_psbt_add_input_value(psbt, index, key, sizeof(key), value, sizeof(value));
+    }
+}
+
+/**
+ * Adds to the client a PSBT for the canonical wpkh wallet at m/84'/1'/0', where one input every
+ * internal_stride is internal, and writes the data of the SIGN_PSBT APDU to data.
+ *
+ * @return the length of the data.
+ */
+static size_t make_wpkh_psbt(host_client_t *client,
+                             size_t n_inputs,
+                             size_t internal_stride,
+                             uint8_t data[static HOST_PSBT_MAX_COMMITMENT_LENGTH + 32 + 32]) {
+    const uint64_t amount = 10000;
+
+    host_psbt_t *psbt = host_psbt_new(2, 0, n_inputs, 1);
+
+    for (size_t i = 0; i < n_inputs; i++) {
+        uint8_t script[22];
+        if (i % internal_stride == 0) {
+            const uint32_t path[] =
+                {84 | 0x80000000u, 1 | 0x80000000u, 0x80000000u, 0, (uint32_t) i};
+            uint8_t pubkey[33];
+            assert_true(crypto_get_compressed_pubkey_at_path(path, 5, pubkey, NULL));
+            p2wpkh_script(pubkey, script);
+            add_wpkh_input(psbt, i, amount, script, pubkey, (uint32_t) i);
+        } else {
+            // an external input, with no BIP32 derivation
+            memset(script, 0, sizeof(script));
+            script[1] = 0x14;
+            write_u32_le(script, 2, (uint32_t) i);
+            add_wpkh_input(psbt, i, amount, script, NULL, 0);
+        }
+    }
+
+    uint8_t out_amount[8];
+    write_u64_le(out_amount, 0, n_inputs * amount - 100000);
+    uint8_t out_script[22] = {0x00, 0x14, 0x42};
+    host_psbt_add_output_value(psbt, 0, (uint8_t[]){PSBT_OUT_AMOUNT}, 1, out_amount, 8);
+    host_psbt_add_output_value(psbt, 0, (uint8_t[]){PSBT_OUT_SCRIPT}, 1, out_script, 22);
+
+    const char *key_info =
+        "[f5acc2fd/84'/1'/0']tpubDCtKfsNyRhULjZ9XMS4VKKtVcPdVDi8MKUbcSD9MJDyjRu1A2ND5MiipozyyspBT9bg"
+        "8upEp7a8EAgFxNxXn1d7QkdbL52Ty5jiSLcxPt1P/**";
+
+    size_t data_len = host_psbt_commit(psbt, client, data);
+    host_client_add_policy_wallet(client, "", "wpkh(@0)", &key_info, 1, data + data_len, NULL);
+    data_len += 32;
+    memset(data + data_len, 0, 32);  // no hmac, canonical wallet
+    data_len += 32;
+    host_psbt_free(psbt);
+
+    return data_len;
+}
+
+static void test_sign_psbt_many_inputs(void **state) {
+    (void) state;
+
+    // More than the 512 inputs that used to be the maximum; only some of them are internal, in
+    // order to keep the running time reasonable.
+    const size_t n_inputs = 5000;
+    const size_t internal_stride = 25;  // one input every internal_stride is internal
+    const size_t n_internal = (n_inputs + internal_stride - 1) / internal_stride;
+
+    host_client_t *client = host_client_new();
+
+    uint8_t data[HOST_PSBT_MAX_COMMITMENT_LENGTH + 32 + 32];
+    size_t data_len = make_wpkh_psbt(client, n_inputs, internal_stride, data);
+
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH], response[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_SIGN_PSBT, data, data_len);
+    int res =
+        libapp_exchange(apdu, apdu_len, host_client_respond, client, response, sizeof(response));
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_OK);
+
+    // exactly one signature for each internal input, in order
+    assert_int_equal(host_client_get_yielded_count(client), n_internal);
+    for (size_t i = 0; i < n_internal; i++) {
+        size_t len;
+        const uint8_t *yielded = host_client_get_yielded(client, i, &len);
+        buffer_t buf = buffer_create((void *) yielded, len);
+        uint64_t input_index;
+        assert_true(buffer_read_varint(&buf, &input_index));
+        assert_int_equal(input_index, internal_stride * i);
+    }
+
+    host_client_free(client);
+}
+
+static void test_sign_psbt_batched(void **state) {
+    (void) state;
+
+    const size_t n_inputs = 40;
+    const size_t internal_stride = 2;
+    const size_t n_internal = n_inputs / internal_stride;
+
+    host_client_t *client = host_client_new();
+
+    uint8_t data[HOST_PSBT_MAX_COMMITMENT_LENGTH + 32 + 32];
+    size_t data_len = make_wpkh_psbt(client, n_inputs, internal_stride, data);
+
+    // one signature per YIELD
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH], response[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_SIGN_PSBT, data, data_len);
+    uint32_t n_apdus = libapp_get_apdu_count();
+    int res =
+        libapp_exchange(apdu, apdu_len, host_client_respond, client, response, sizeof(response));
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_OK);
+    uint32_t n_apdus_single = libapp_get_apdu_count() - n_apdus;
+
+    assert_int_equal(host_client_get_yielded_count(client), n_internal);
+    uint8_t signatures[n_internal][MAX_DER_SIG_LEN + 1];
+    size_t signatures_len[n_internal];
+    for (size_t i = 0; i < n_internal; i++) {
+        size_t len;
+        const uint8_t *yielded = host_client_get_yielded(client, i, &len);
+        assert_int_equal(yielded[0], internal_stride * i);  // 1-byte varint
+        assert_true(len - 1 <= sizeof(signatures[i]));
+        signatures_len[i] = len - 1;
+        memcpy(signatures[i], yielded + 1, len - 1);
+    }
+    host_client_clear_yielded(client);
+
+    // several <input_index> <len> <signature> per YIELD
+    apdu[1] = INS_SIGN_PSBT_BATCHED;
+    n_apdus = libapp_get_apdu_count();
+    res = libapp_exchange(apdu, apdu_len, host_client_respond, client, response, sizeof(response));
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_OK);
+    uint32_t n_apdus_batched = libapp_get_apdu_count() - n_apdus;
+
+    size_t n_yielded = host_client_get_yielded_count(client);
+    assert_true(n_yielded < n_internal);
+
+    size_t n_signatures = 0;
+    for (size_t i = 0; i < n_yielded; i++) {
+        size_t len;
+        const uint8_t *yielded = host_client_get_yielded(client, i, &len);
+        assert_true(len <= SIGNATURES_BATCH_MAX_LEN);
+
+        buffer_t buf = buffer_create((void *) yielded, len);
+        while (buffer_can_read(&buf, 1)) {
+            uint64_t input_index;
+            uint8_t sig_len;
+            assert_true(buffer_read_varint(&buf, &input_index));
+            assert_true(buffer_read_u8(&buf, &sig_len));
+            assert_true(buffer_can_read(&buf, sig_len));
+
+            assert_true(n_signatures < n_internal);
+            assert_int_equal(input_index, internal_stride * n_signatures);
+            // ECDSA signatures are deterministic
+            assert_int_equal(sig_len, signatures_len[n_signatures]);
+            assert_memory_equal(buffer_get_cur(&buf), signatures[n_signatures], sig_len);
+
+            buffer_seek_cur(&buf, sig_len);
+            ++n_signatures;
+        }
+    }
+    assert_int_equal(n_signatures, n_internal);
+
+    // the YIELDs that are saved are full round trips
+    assert_int_equal(n_apdus_single - n_apdus_batched, n_internal - n_yielded);
+
+    host_client_free(client);
+}
+
+typedef struct {
+    host_client_t *client;
+    size_t max_yields;  // the host is disconnected when the app yields once more
+    size_t n_yields;
+} disconnecting_client_t;
+
+static int disconnecting_client_respond(void *ctx,
+                                        const uint8_t *request,
+                                        size_t request_len,
+                                        uint8_t *response) {
+    disconnecting_client_t *c = ctx;
+    if (request_len > 0 && request[0] == CCMD_YIELD && ++c->n_yields > c->max_yields) {
+        return -1;
+    }
+    return host_client_respond(c->client, request, request_len, response);
+}
+
+static void test_sign_psbt_resume(void **state) {
+    (void) state;
+
+    const size_t n_inputs = 40;
+    const size_t internal_stride = 2;
+    const size_t n_internal = n_inputs / internal_stride;
+    const size_t n_received = 5;  // signatures received before the disconnection
+
+    host_client_t *client = host_client_new();
+
+    uint8_t data[HOST_PSBT_MAX_COMMITMENT_LENGTH + 32 + 32];
+    size_t data_len = make_wpkh_psbt(client, n_inputs, internal_stride, data);
+
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH], response[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_SIGN_PSBT, data, data_len);
+
+    // reference signatures
+    int res =
+        libapp_exchange(apdu, apdu_len, host_client_respond, client, response, sizeof(response));
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_OK);
+    assert_int_equal(host_client_get_yielded_count(client), n_internal);
+    uint8_t signatures[n_internal][MAX_DER_SIG_LEN + 1];
+    size_t signatures_len[n_internal];
+    for (size_t i = 0; i < n_internal; i++) {
+        size_t len;
+        const uint8_t *yielded = host_client_get_yielded(client, i, &len);
+        signatures_len[i] = len - 1;
+        memcpy(signatures[i], yielded + 1, len - 1);
+    }
+    host_client_clear_yielded(client);
+
+    // the session is over once all the signatures are received
+    uint8_t resume_apdu[LIBAPP_MAX_APDU_LENGTH];
+    size_t resume_apdu_len = make_apdu(resume_apdu, INS_RESUME_SIGN_PSBT, data, data_len);
+    res = libapp_exchange(resume_apdu,
+                          resume_apdu_len,
+                          host_client_respond,
+                          client,
+                          response,
+                          sizeof(response));
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_BAD_STATE);
+
+    // the host is disconnected after receiving some signatures
+    disconnecting_client_t disconnecting = {.client = client, .max_yields = n_received};
+    res = libapp_exchange(apdu,
+                          apdu_len,
+                          disconnecting_client_respond,
+                          &disconnecting,
+                          response,
+                          sizeof(response));
+    assert_int_equal(res, LIBAPP_ERR_RESPONDER_FAILED);
+    assert_int_equal(host_client_get_yielded_count(client), n_received);
+    host_client_clear_yielded(client);
+
+    // a different psbt can not resume the session
+    uint8_t other_apdu[LIBAPP_MAX_APDU_LENGTH];
+    memcpy(other_apdu, resume_apdu, resume_apdu_len);
+    other_apdu[resume_apdu_len - 1] ^= 1;
+    res = libapp_exchange(other_apdu,
+                          resume_apdu_len,
+                          host_client_respond,
+                          client,
+                          response,
+                          sizeof(response));
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_BAD_STATE);
+
+    // the same psbt resumes without asking the user again, and only the missing signatures are
+    // produced
+    uint32_t n_ui_flows = libapp_get_ui_flow_count();
+    res = libapp_exchange(resume_apdu,
+                          resume_apdu_len,
+                          host_client_respond,
+                          client,
+                          response,
+                          sizeof(response));
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_OK);
+    assert_int_equal(libapp_get_ui_flow_count(), n_ui_flows);
+
+    size_t n_signatures = n_received;
+    for (size_t i = 0; i < host_client_get_yielded_count(client); i++) {
+        size_t len;
+        const uint8_t *yielded = host_client_get_yielded(client, i, &len);
+
+        buffer_t buf = buffer_create((void *) yielded, len);
+        while (buffer_can_read(&buf, 1)) {
+            uint64_t input_index;
+            uint8_t sig_len;
+            assert_true(buffer_read_varint(&buf, &input_index));
+            assert_true(buffer_read_u8(&buf, &sig_len));
+            assert_true(buffer_can_read(&buf, sig_len));
+
+            assert_true(n_signatures < n_internal);
+            assert_int_equal(input_index, internal_stride * n_signatures);
+            assert_int_equal(sig_len, signatures_len[n_signatures]);
+            assert_memory_equal(buffer_get_cur(&buf), signatures[n_signatures], sig_len);
+
+            buffer_seek_cur(&buf, sig_len);
+            ++n_signatures;
+        }
+    }
+    assert_int_equal(n_signatures, n_internal);
+
+    // the session does not survive a lock
+    host_client_clear_yielded(client);
+    disconnecting.n_yields = 0;
+    res = libapp_exchange(apdu,
+                          apdu_len,
+                          disconnecting_client_respond,
+                          &disconnecting,
+                          response,
+                          sizeof(response));
+    assert_int_equal(res, LIBAPP_ERR_RESPONDER_FAILED);
+
+    libapp_set_locked(true);
+    libapp_set_locked(false);
+    res = libapp_exchange(resume_apdu,
+                          resume_apdu_len,
+                          host_client_respond,
+                          client,
+                          response,
+                          sizeof(response));
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_BAD_STATE);
+
+    host_client_free(client);
+}
+
+/**
+ * Signs a PSBT for the canonical pkh wallet at m/44'/1'/0', with n_inputs internal inputs and
+ * n_outputs external outputs, and checks each signature against the sighash computed here.
+ *
+ * @return the number of APDUs exchanged.
+ */
+static uint32_t sign_pkh_psbt(size_t n_inputs, size_t n_outputs) {
+    const uint64_t amount = 100000;
+    const uint64_t out_amount = 1000;
+
+    host_client_t *client = host_client_new();
+    host_psbt_t *psbt = host_psbt_new(2, 0, n_inputs, n_outputs);
+
+    uint8_t txids[n_inputs][32];
+    uint8_t scripts[n_inputs][25];
+    for (size_t i = 0; i < n_inputs; i++) {
+        const uint32_t path[] = {44 | 0x80000000u, 1 | 0x80000000u, 0x80000000u, 0, (uint32_t) i};
+        uint8_t pubkey[33];
+        assert_true(crypto_get_compressed_pubkey_at_path(path, 5, pubkey, NULL));
+
+        scripts[i][0] = 0x76;  // OP_DUP
+        scripts[i][1] = 0xa9;  // OP_HASH160
+        scripts[i][2] = 0x14;
+        crypto_hash160(pubkey, 33, scripts[i] + 3);
+        scripts[i][23] = 0x88;  // OP_EQUALVERIFY
+        scripts[i][24] = 0xac;  // OP_CHECKSIG
+
+        uint8_t prevtx[PREVTX_MAX_LEN];
+        size_t prevtx_len = make_prevtx(i, amount, scripts[i], 25, prevtx, txids[i]);
+
+        uint8_t output_index[4] = {0};
+        host_psbt_add_input_value(psbt, i, (uint8_t[]){PSBT_IN_PREVIOUS_TXID}, 1, txids[i], 32);
+        host_psbt_add_input_value(psbt, i, (uint8_t[]){PSBT_IN_OUTPUT_INDEX}, 1, output_index, 4);
+        host_psbt_add_input_value(psbt,
+                                  i,
+                                  (uint8_t[]){PSBT_IN_NON_WITNESS_UTXO},
+                                  1,
+                                  prevtx,
+                                  prevtx_len);
+
+        uint8_t key[1 + 33];
+        key[0] = PSBT_IN_BIP32_DERIVATION;
+        memcpy(key + 1, pubkey, 33);
+        uint8_t value[4 + 4 * 5] = {0xf5, 0xac, 0xc2, 0xfd};
+        for (size_t j = 0; j < 5; j++) {
+            write_u32_le(value, 4 + 4 * j, path[j]);
+        }
+        host_psbt_add_input_value(psbt, i, key, sizeof(key), value, sizeof(value));
+    }
+
+    for (size_t i = 0; i < n_outputs; i++) {
+        uint8_t out_amount_raw[8];
+        write_u64_le(out_amount_raw, 0, out_amount);
+        uint8_t out_script[22] = {0x00, 0x14};
+        write_u32_le(out_script, 2, (uint32_t) i + 1);
+        host_psbt_add_output_value(psbt, i, (uint8_t[]){PSBT_OUT_AMOUNT}, 1, out_amount_raw, 8);
+        host_psbt_add_output_value(psbt, i, (uint8_t[]){PSBT_OUT_SCRIPT}, 1, out_script, 22);
+    }
+
+    const char *key_info =
+        "[f5acc2fd/44'/1'/0']tpubDCwYjpDhUdPGP5rS3wgNg13mTrrjBuG8V9VpWbyptX6TRPbNoZVXsoVUSkCjmQ8jJyc"
+        "juDKBb9eataSymXakTTaGifxR6kmVsfFehH1ZgJT/**";
+
+    uint8_t data[HOST_PSBT_MAX_COMMITMENT_LENGTH + 32 + 32];
+    size_t data_len = host_psbt_commit(psbt, client, data);
+    host_client_add_policy_wallet(client, "", "pkh(@0)", &key_info, 1, data + data_len, NULL);
+    data_len += 32;
+    memset(data + data_len, 0, 32);  // no hmac, canonical wallet
+    data_len += 32;
+    host_psbt_free(psbt);
+
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH], response[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_SIGN_PSBT, data, data_len);
+    uint32_t n_apdus = libapp_get_apdu_count();
+    int res =
+        libapp_exchange(apdu, apdu_len, host_client_respond, client, response, sizeof(response));
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_OK);
+    n_apdus = libapp_get_apdu_count() - n_apdus;
+
+    assert_int_equal(host_client_get_yielded_count(client), n_inputs);
+    for (size_t i = 0; i < n_inputs; i++) {
+        size_t len;
+        const uint8_t *yielded = host_client_get_yielded(client, i, &len);
+        assert_int_equal(yielded[0], i);  // 1-byte varint
+
+        // legacy sighash for SIGHASH_ALL
+        cx_sha256_t sighash_context;
+        cx_sha256_init(&sighash_context);
+        uint8_t tmp[8];
+        write_u32_le(tmp, 0, 2);
+        crypto_hash_update(&sighash_context.header, tmp, 4);
+        crypto_hash_update_varint(&sighash_context.header, n_inputs);
+        for (size_t j = 0; j < n_inputs; j++) {
+            crypto_hash_update(&sighash_context.header, txids[j], 32);
+            write_u32_le(tmp, 0, 0);
+            crypto_hash_update(&sighash_context.header, tmp, 4);
+            if (j == i) {
+                crypto_hash_update_varint(&sighash_context.header, 25);
+                crypto_hash_update(&sighash_context.header, scripts[j], 25);
+            } else {
+                crypto_hash_update_u8(&sighash_context.header, 0x00);
+            }
+            write_u32_le(tmp, 0, 0xFFFFFFFF);
+            crypto_hash_update(&sighash_context.header, tmp, 4);
+        }
+        crypto_hash_update_varint(&sighash_context.header, n_outputs);
+        for (size_t j = 0; j < n_outputs; j++) {
+            write_u64_le(tmp, 0, out_amount);
+            crypto_hash_update(&sighash_context.header, tmp, 8);
+            uint8_t out_script[22] = {0x00, 0x14};
+            write_u32_le(out_script, 2, (uint32_t) j + 1);
+            crypto_hash_update_varint(&sighash_context.header, 22);
+            crypto_hash_update(&sighash_context.header, out_script, 22);
+        }
+        write_u32_le(tmp, 0, 0);  // locktime
+        crypto_hash_update(&sighash_context.header, tmp, 4);
+        write_u32_le(tmp, 0, SIGHASH_ALL);
+        crypto_hash_update(&sighash_context.header, tmp, 4);
+        uint8_t sighash[32];
+        crypto_hash_digest(&sighash_context.header, sighash, 32);
+        cx_hash_sha256(sighash, 32, sighash, 32);
+
+        // ECDSA signatures are deterministic
+        const uint32_t path[] = {44 | 0x80000000u, 1 | 0x80000000u, 0x80000000u, 0, (uint32_t) i};
+        uint8_t sig[MAX_DER_SIG_LEN + 1];
+        int sig_len = crypto_ecdsa_sign_sha256_hash_with_key(path, 5, sighash, sig, NULL);
+        assert_true(sig_len > 0);
+        sig[sig_len++] = SIGHASH_ALL;
+        assert_int_equal(len - 1, sig_len);
+        assert_memory_equal(yielded + 1, sig, sig_len);
+    }
+
+    host_client_free(client);
+    return n_apdus;
+}
+
+static void test_sign_psbt_legacy_outputs_cache(void **state) {
+    (void) state;
+
+    // The outputs are fetched once while they are verified, and not again for each legacy input:
+    // the cost of the additional outputs does not depend on the number of inputs
+    uint32_t n_apdus_1x4 = sign_pkh_psbt(1, 4);
+    uint32_t n_apdus_1x8 = sign_pkh_psbt(1, 8);
+    uint32_t n_apdus_3x4 = sign_pkh_psbt(3, 4);
+    uint32_t n_apdus_3x8 = sign_pkh_psbt(3, 8);
+    assert_int_equal(n_apdus_3x8 - n_apdus_3x4, n_apdus_1x8 - n_apdus_1x4);
+
+    // If the outputs do not fit in the cache, they are fetched for each input
+    size_t n_outputs = OUTPUTS_CACHE_SIZE / (8 + 1 + 22) + 1;
+    uint32_t n_apdus_1xn = sign_pkh_psbt(1, n_outputs);
+    uint32_t n_apdus_2xn = sign_pkh_psbt(2, n_outputs);
+    assert_true(n_apdus_2xn - n_apdus_1xn > n_outputs);
+}
+
+/**
+ * Adds a P2WPKH output to the pubkey at m/84'/1'/0'/1/address_index, with a BIP32 derivation that
+ * claims that derivation_pubkey is at that path for the given fingerprint.
+ */
+static void add_wpkh_change_output(host_psbt_t *psbt,
+                                   size_t index,
+                                   uint64_t amount,
+                                   uint32_t address_index,
+                                   const uint8_t derivation_pubkey[static 33],
+                                   const uint8_t fingerprint[static 4]) {
+    const uint32_t path[] = {84 | 0x80000000u, 1 | 0x80000000u, 0x80000000u, 1, address_index};
+    uint8_t pubkey[33], script[22];
+    assert_true(crypto_get_compressed_pubkey_at_path(path, 5, pubkey, NULL));
+    p2wpkh_script(pubkey, script);
+
+    uint8_t value[8];
+    write_u64_le(value, 0, amount);
+    host_psbt_add_output_value(psbt, index, (uint8_t[]){PSBT_OUT_AMOUNT}, 1, value, 8);
+    host_psbt_add_output_value(psbt, index, (uint8_t[]){PSBT_OUT_SCRIPT}, 1, script, 22);
+
+    uint8_t key[1 + 33];
+    key[0] = PSBT_OUT_BIP32_DERIVATION;
+    memcpy(key + 1, derivation_pubkey, 33);
+
+    uint8_t derivation[4 + 4 * 5];
+    memcpy(derivation, fingerprint, 4);
+    for (size_t i = 0; i < 5; i++) {
+        write_u32_le(derivation, 4 + 4 * i, path[i]);
+    }
+    host_psbt_add_output_value(psbt, index, key, sizeof(key), derivation, sizeof(derivation));
+}
+
+static void test_sign_psbt_change_precheck(void **state) {
+    (void) state;
+
+    const uint8_t our_fingerprint[4] = {0xf5, 0xac, 0xc2, 0xfd};
+    const uint8_t other_fingerprint[4] = {0x12, 0x34, 0x56, 0x78};
+    const uint64_t amount = 100000;
+
+    host_client_t *client = host_client_new();
+    host_psbt_t *psbt = host_psbt_new(2, 0, 1, 3);
+
+    const uint32_t input_path[] = {84 | 0x80000000u, 1 | 0x80000000u, 0x80000000u, 0, 0};
+    uint8_t input_pubkey[33], input_script[22];
+    assert_true(crypto_get_compressed_pubkey_at_path(input_path, 5, input_pubkey, NULL));
+    p2wpkh_script(input_pubkey, input_script);
+    add_wpkh_input(psbt, 0, amount, input_script, input_pubkey, 0);
+
+    uint8_t pubkeys[3][33];
+    for (uint32_t i = 0; i < 3; i++) {
+        const uint32_t path[] = {84 | 0x80000000u, 1 | 0x80000000u, 0x80000000u, 1, i};
+        assert_true(crypto_get_compressed_pubkey_at_path(path, 5, pubkeys[i], NULL));
+    }
+
+    // All the outputs pay to the wallet's script at the path in their BIP32 derivation, but only
+    // the first one has the correct pubkey: the others are rejected before deriving the wallet's
+    // script, and are shown to the user as external outputs.
+    add_wpkh_change_output(psbt, 0, 30000, 0, pubkeys[0], our_fingerprint);
+    add_wpkh_change_output(psbt, 1, 30000, 1, pubkeys[2], our_fingerprint);
+    add_wpkh_change_output(psbt, 2, 30000, 2, pubkeys[2], other_fingerprint);
+
+    const char *key_info =
+        "[f5acc2fd/84'/1'/0']tpubDCtKfsNyRhULjZ9XMS4VKKtVcPdVDi8MKUbcSD9MJDyjRu1A2ND5MiipozyyspBT9bg"
+        "8upEp7a8EAgFxNxXn1d7QkdbL52Ty5jiSLcxPt1P/**";
+
+    uint8_t data[HOST_PSBT_MAX_COMMITMENT_LENGTH + 32 + 32];
+    size_t data_len = host_psbt_commit(psbt, client, data);
+    host_client_add_policy_wallet(client, "", "wpkh(@0)", &key_info, 1, data + data_len, NULL);
+    data_len += 32;
+    memset(data + data_len, 0, 32);  // no hmac, canonical wallet
+    data_len += 32;
+    host_psbt_free(psbt);
+
+    uint32_t n_ui_flows = libapp_get_ui_flow_count();
+
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH], response[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_SIGN_PSBT, data, data_len);
+    int res =
+        libapp_exchange(apdu, apdu_len, host_client_respond, client, response, sizeof(response));
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_OK);
+
+    // the two external outputs, and the whole transaction
+    assert_int_equal(libapp_get_ui_flow_count() - n_ui_flows, 3);
+    assert_int_equal(host_client_get_yielded_count(client), 1);
+
+    host_client_free(client);
+}
+
+static void test_sign_psbt_unsorted_keys(void **state) {
+    (void) state;
+
+    host_client_t *client = host_client_new();
+
+    uint8_t data[HOST_PSBT_MAX_COMMITMENT_LENGTH + 32 + 32];
+    size_t data_len = make_wpkh_psbt(client, 2, 1, data);
+
+    // replace the keys of the global map with the same keys, with two of them swapped
+    const uint8_t keys[][1] = {{PSBT_GLOBAL_TX_VERSION},
+                               {PSBT_GLOBAL_INPUT_COUNT},
+                               {PSBT_GLOBAL_FALLBACK_LOCKTIME},
+                               {PSBT_GLOBAL_OUTPUT_COUNT},
+                               {PSBT_GLOBAL_VERSION}};
+    const uint8_t *const elements[] = {keys[0], keys[1], keys[2], keys[3], keys[4]};
+    const size_t lengths[] = {1, 1, 1, 1, 1};
+    assert_int_equal(data[0], 5);  // 1-byte varint with the size of the global map
+    host_client_add_known_list(client, elements, lengths, 5, data + 1);
+
+    // the keys are checked one at a time, or streamed if the client supports GET_MERKLE_LEAVES
+    const uint8_t p2_values[] = {0, CLIENT_FEATURE_GET_MERKLE_LEAVES};
+    for (size_t i = 0; i < sizeof(p2_values); i++) {
+        uint8_t apdu[LIBAPP_MAX_APDU_LENGTH], response[LIBAPP_MAX_APDU_LENGTH];
+        size_t apdu_len = make_apdu(apdu, INS_SIGN_PSBT, data, data_len);
+        apdu[3] = p2_values[i];
+        int res = libapp_exchange(apdu,
+                                  apdu_len,
+                                  host_client_respond,
+                                  client,
+                                  response,
+                                  sizeof(response));
+        assert_int_equal(res, 2);
+        assert_int_not_equal(get_sw(response, res), SW_OK);
+        assert_int_equal(host_client_get_yielded_count(client), 0);
+    }
+
+    host_client_free(client);
+}
+
+static void test_sign_psbt_merkle_leaves(void **state) {
+    (void) state;
+
+    const size_t n_inputs = 40;
+
+    host_client_t *client = host_client_new();
+
+    uint8_t data[HOST_PSBT_MAX_COMMITMENT_LENGTH + 32 + 32];
+    size_t data_len = make_wpkh_psbt(client, n_inputs, 1, data);
+
+    // without the feature bit in P2, the app must not send GET_MERKLE_LEAVES to the client
+    uint8_t apdu[LIBAPP_MAX_APDU_LENGTH], response[LIBAPP_MAX_APDU_LENGTH];
+    size_t apdu_len = make_apdu(apdu, INS_SIGN_PSBT, data, data_len);
+    uint32_t n_apdus = libapp_get_apdu_count();
+    int res =
+        libapp_exchange(apdu, apdu_len, host_client_respond, client, response, sizeof(response));
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_OK);
+    uint32_t n_apdus_by_leaf = libapp_get_apdu_count() - n_apdus;
+    assert_int_equal(host_client_get_merkle_leaves_count(client), 0);
+
+    assert_int_equal(host_client_get_yielded_count(client), n_inputs);
+    uint8_t yielded_by_leaf[n_inputs][1 + MAX_DER_SIG_LEN + 1];
+    size_t yielded_by_leaf_len[n_inputs];
+    for (size_t i = 0; i < n_inputs; i++) {
+        const uint8_t *yielded = host_client_get_yielded(client, i, &yielded_by_leaf_len[i]);
+        assert_true(yielded_by_leaf_len[i] <= sizeof(yielded_by_leaf[i]));
+        memcpy(yielded_by_leaf[i], yielded, yielded_by_leaf_len[i]);
+    }
+    host_client_clear_yielded(client);
+
+    apdu[3] = CLIENT_FEATURE_GET_MERKLE_LEAVES;
+    n_apdus = libapp_get_apdu_count();
+    res = libapp_exchange(apdu, apdu_len, host_client_respond, client, response, sizeof(response));
+    assert_int_equal(res, 2);
+    assert_int_equal(get_sw(response, res), SW_OK);
+    uint32_t n_apdus_streamed = libapp_get_apdu_count() - n_apdus;
+    assert_true(host_client_get_merkle_leaves_count(client) > 0);
+
+    // same signatures, with fewer round trips
+    assert_int_equal(host_client_get_yielded_count(client), n_inputs);
+    for (size_t i = 0; i < n_inputs; i++) {
+        size_t len;
+        const uint8_t *yielded = host_client_get_yielded(client, i, &len);
+        assert_int_equal(len, yielded_by_leaf_len[i]);
+        assert_memory_equal(yielded, yielded_by_leaf[i], len);
+    }
+    assert_true(n_apdus_streamed < n_apdus_by_leaf);
+
+    host_client_free(client);
+}
+
+/**
+ * Parses a transaction split in chunks of the given size; returns the result of
+ * psbt_parse_rawtx_finalize.
+ */
+static int parse_rawtx_in_chunks(const uint8_t *rawtx,
+                                 size_t rawtx_len,
+                                 size_t chunk_size,
+                                 int output_index,
+                                 txid_parser_outputs_t *outputs) {
+    cx_sha256_t hash_context;
+    psbt_parse_rawtx_state_t state;
+
+    cx_sha256_init(&hash_context);
+    psbt_parse_rawtx_init(&state, &hash_context, output_index, outputs);
+    for (size_t offset = 0; offset < rawtx_len; offset += chunk_size) {
+        size_t len = rawtx_len - offset < chunk_size ? rawtx_len - offset : chunk_size;
+        buffer_t chunk = buffer_create((uint8_t *) rawtx + offset, len);
+        psbt_parse_rawtx_process(&state, &chunk);
+    }
+    return psbt_parse_rawtx_finalize(&state);
+}
+
+static void test_psbt_parse_rawtx(void **state) {
+    (void) state;
+
+    // A segwit transaction with 2 inputs and 2 outputs; see tests-legacy/test_get_trusted_inputs.py
+    // clang-format off
+    static const uint8_t rawtx[] = {
+        0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0xe7, 0x57, 0x6f, 0x53, 0xb5,
+        0xd9, 0x2f, 0x98, 0x80, 0xb1, 0x25, 0xd0, 0x62, 0x27, 0x82, 0xfe, 0xf4,
+        0x0b, 0x01, 0x21, 0xeb, 0x45, 0x55, 0xc9, 0xd3, 0xa7, 0xbe, 0x54, 0xe6,
+        0x35, 0xcd, 0x6e, 0x00, 0x00, 0x00, 0x00, 0x17, 0x16, 0x00, 0x14, 0x4c,
+        0x9f, 0xca, 0x3f, 0xd2, 0x3a, 0xe5, 0xcc, 0x1f, 0x0d, 0xfe, 0x46, 0xb4,
+        0x46, 0xda, 0x61, 0x12, 0x19, 0xc0, 0x20, 0xfd, 0xff, 0xff, 0xff, 0x4b,
+        0xa9, 0x1d, 0x8e, 0x1c, 0xed, 0xbf, 0xec, 0xdc, 0xed, 0xa7, 0xf3, 0x43,
+        0x2f, 0x61, 0x8a, 0x2f, 0x0e, 0x12, 0x2c, 0x66, 0xa6, 0x3f, 0xe0, 0xc5,
+        0x3a, 0x14, 0xde, 0x63, 0x05, 0xe5, 0xdc, 0x01, 0x00, 0x00, 0x00, 0x17,
+        0x16, 0x00, 0x14, 0x92, 0xa9, 0x15, 0x9a, 0x0a, 0xe4, 0x0a, 0x74, 0x8c,
+        0x18, 0xbd, 0x48, 0x6e, 0xa1, 0x3d, 0xa8, 0x54, 0x22, 0x45, 0x0c, 0xfd,
+        0xff, 0xff, 0xff, 0x02, 0x7f, 0x19, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x17, 0xa9, 0x14, 0x1a, 0x56, 0xde, 0xa1, 0xff, 0x8a, 0x3f, 0x63, 0x39,
+        0x16, 0x56, 0x0f, 0xed, 0x59, 0x42, 0x40, 0x0d, 0x17, 0x08, 0x0b, 0x87,
+        0x60, 0xae, 0x0a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x17, 0xa9, 0x14, 0x7c,
+        0x28, 0xb0, 0x75, 0xf5, 0x06, 0xd8, 0x29, 0xe2, 0xe2, 0xba, 0xcf, 0x89,
+        0x7c, 0x1b, 0x5b, 0x0d, 0x30, 0x9c, 0x1a, 0x87, 0x02, 0x48, 0x30, 0x45,
+        0x02, 0x21, 0x00, 0xc7, 0x91, 0xff, 0x9a, 0x58, 0x86, 0x90, 0x3f, 0xbd,
+        0x3c, 0x12, 0x89, 0xf2, 0x81, 0xe1, 0xd5, 0xa3, 0xe3, 0x30, 0xf1, 0x55,
+        0x8e, 0xa5, 0xdf, 0x72, 0x5b, 0xcd, 0x78, 0x0b, 0x28, 0x56, 0x77, 0x02,
+        0x20, 0x2d, 0x76, 0x34, 0x9a, 0x78, 0x58, 0x5e, 0xa6, 0x6d, 0xf6, 0xee,
+        0xf5, 0xab, 0x48, 0xa0, 0x34, 0x8c, 0xc3, 0x37, 0x99, 0x4a, 0x1d, 0x63,
+        0x57, 0xa6, 0xe4, 0xe4, 0x32, 0x8a, 0x34, 0x3f, 0x6d, 0x01, 0x21, 0x02,
+        0x62, 0x3e, 0xd0, 0x9f, 0x8c, 0x19, 0x29, 0x38, 0xf7, 0xa6, 0x38, 0xfb,
+        0xdd, 0x5d, 0xd7, 0xc2, 0x97, 0xf8, 0x6e, 0x41, 0xbe, 0x8d, 0x7d, 0xff,
+        0x4f, 0x1c, 0x90, 0x4f, 0x06, 0x85, 0xf2, 0x27, 0x02, 0x48, 0x30, 0x45,
+        0x02, 0x21, 0x00, 0x8f, 0x2f, 0x01, 0x7f, 0x5f, 0xa4, 0xfd, 0xd7, 0xdc,
+        0xfe, 0x41, 0xc8, 0x3f, 0x4a, 0x71, 0xa7, 0x26, 0x62, 0x6c, 0xdb, 0x49,
+        0x0d, 0x65, 0x2e, 0xdc, 0xb4, 0x08, 0xb9, 0xa4, 0x63, 0x8b, 0x7a, 0x02,
+        0x20, 0x43, 0x9c, 0x15, 0xa7, 0xf7, 0xa0, 0x3f, 0x28, 0x76, 0xde, 0xc5,
+        0x39, 0x2f, 0x22, 0x47, 0x43, 0x7b, 0x57, 0xb2, 0x27, 0xfe, 0xa2, 0x94,
+        0xf4, 0x01, 0x9d, 0x06, 0x46, 0x2f, 0x93, 0x8b, 0x53, 0x01, 0x21, 0x03,
+        0x47, 0xe9, 0x14, 0x3a, 0xa6, 0x45, 0x7c, 0x72, 0xa4, 0x8d, 0x85, 0xb5,
+        0x06, 0x5e, 0xdc, 0x40, 0xd3, 0xa4, 0x9f, 0x31, 0x9d, 0x54, 0xfc, 0x49,
+        0x79, 0xdc, 0x3b, 0x95, 0xde, 0x94, 0x9a, 0x41, 0xd7, 0x68, 0x19, 0x00,
+    };
+    static const uint8_t expected_txid[32] = {
+        0xfe, 0xfc, 0x08, 0x0f, 0x76, 0x24, 0xf7, 0xac, 0xd3, 0xc0, 0x85, 0x0e,
+        0x21, 0x4d, 0x5d, 0x3e, 0x22, 0x1d, 0x94, 0x85, 0x9d, 0xd3, 0xc8, 0xea,
+        0x92, 0x1a, 0xc9, 0x44, 0xfa, 0x3d, 0xa1, 0x45,
+    };
+    static const uint8_t expected_scriptpubkey[] = {
+        0xa9, 0x14, 0x7c, 0x28, 0xb0, 0x75, 0xf5, 0x06, 0xd8, 0x29, 0xe2, 0xe2,
+        0xba, 0xcf, 0x89, 0x7c, 0x1b, 0x5b, 0x0d, 0x30, 0x9c, 0x1a, 0x87,
+    };
+    // clang-format on
+
+    // the fields span chunk boundaries in all possible ways
+    const size_t chunk_sizes[] = {1, 2, 3, 7, 32, 33, 250, sizeof(rawtx)};
+    for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++) {
+        txid_parser_outputs_t outputs;
+        memset(&outputs, 0, sizeof(outputs));
+
+        assert_int_equal(parse_rawtx_in_chunks(rawtx, sizeof(rawtx), chunk_sizes[i], 1, &outputs),
+                         0);
+        assert_memory_equal(outputs.txid, expected_txid, 32);
+        assert_int_equal(outputs.vout_value, 700000);
+        assert_int_equal(outputs.vout_scriptpubkey_len, sizeof(expected_scriptpubkey));
+        assert_memory_equal(outputs.vout_scriptpubkey,
+                            expected_scriptpubkey,
+                            sizeof(expected_scriptpubkey));
+    }
+
+    // a truncated transaction is rejected
+    txid_parser_outputs_t outputs;
+    assert_int_equal(parse_rawtx_in_chunks(rawtx, sizeof(rawtx) - 1, 32, 1, &outputs), -1);
+}
+
+int main() {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup(test_get_master_fingerprint, setup),
+        cmocka_unit_test_setup(test_get_extended_pubkey, setup),
+        cmocka_unit_test_setup(test_get_extended_pubkey_nonstandard, setup),
+        cmocka_unit_test_setup(test_get_extended_pubkeys, setup),
+        cmocka_unit_test_setup(test_bip32_CKDpub_point, setup),
+        cmocka_unit_test_setup(test_locked_device, setup),
+        cmocka_unit_test_setup(test_key_cache_cleared_on_lock, setup),
+        cmocka_unit_test_setup(test_sign_message, setup),
+        cmocka_unit_test_setup(test_sign_message_long, setup),
+        cmocka_unit_test_setup(test_sign_message_streamed, setup),
+        cmocka_unit_test_setup(test_get_wallet_address_singlesig, setup),
+        cmocka_unit_test_setup(test_compare_canonical_script, setup),
+        cmocka_unit_test_setup(test_multisig_15of15, setup),
+        cmocka_unit_test_setup(test_wallet_cache, setup),
+        cmocka_unit_test_setup(test_wallet_binary_keys, setup),
+        cmocka_unit_test_setup(test_sign_psbt_many_inputs, setup),
+        cmocka_unit_test_setup(test_sign_psbt_batched, setup),
+        cmocka_unit_test_setup(test_sign_psbt_resume, setup),
+        cmocka_unit_test_setup(test_sign_psbt_legacy_outputs_cache, setup),
+        cmocka_unit_test_setup(test_sign_psbt_change_precheck, setup),
+        cmocka_unit_test_setup(test_sign_psbt_unsorted_keys, setup),
+        cmocka_unit_test_setup(test_sign_psbt_merkle_leaves, setup),
+        cmocka_unit_test_setup(test_psbt_parse_rawtx, setup),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -307,6 +307,36 @@ static void test_parser_error(void **state) {
     assert_int_equal(parser_state.a, 0xa0a1a2a3);  // a should have been parsed correctly
 }
 
+static void test_dbuffer_read_chunk(void **state) {
+    (void) state;
+
+    uint8_t store[4] = {0x00, 0xa0, 0xa1, 0xa2};
+    uint8_t stream[8] = {0xb0, 0xb1, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7};
+
+    buffer_t store_buf = buffer_create(store, sizeof(store));
+    buffer_seek_cur(&store_buf, 1);
+    buffer_t stream_buf = buffer_create(stream, sizeof(stream));
+    buffer_t *buffers[2] = {&store_buf, &stream_buf};
+
+    const uint8_t *chunk;
+
+    // the chunks never span the two buffers, and point inside them
+    assert_int_equal(dbuffer_read_chunk(buffers, &chunk, 2), 2);
+    assert_ptr_equal(chunk, store + 1);
+    assert_int_equal(dbuffer_read_chunk(buffers, &chunk, 5), 1);
+    assert_ptr_equal(chunk, store + 3);
+    assert_int_equal(dbuffer_read_chunk(buffers, &chunk, 5), 5);
+    assert_ptr_equal(chunk, stream);
+    assert_int_equal(dbuffer_read_chunk(buffers, &chunk, 0), 0);
+    assert_int_equal(dbuffer_read_chunk(buffers, &chunk, 5), 3);
+    assert_ptr_equal(chunk, stream + 5);
+
+    // both buffers are exhausted
+    assert_int_equal(dbuffer_read_chunk(buffers, &chunk, 5), 0);
+    assert_int_equal(store_buf.offset, sizeof(store));
+    assert_int_equal(stream_buf.offset, sizeof(stream));
+}
+
 int main() {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_parser_init_context),
@@ -316,6 +346,7 @@ int main() {
         cmocka_unit_test(test_parser_stream_ends),
         cmocka_unit_test(test_parser_continue_partial),
         cmocka_unit_test(test_parser_error),
+        cmocka_unit_test(test_dbuffer_read_chunk),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
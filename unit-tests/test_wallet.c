@@ -18,9 +18,8 @@ unsigned int pic(unsigned int linked_address) {
 
 #include "common/wallet.h"
 
-// in unit tests, size_t integers are currently 8 compiled as 8 bytes; therefore, in the app
-// about half of the memory would be needed
-#define MAX_POLICY_MAP_MEMORY_SIZE 256
+// same size as in the app
+#define MAX_POLICY_MAP_MEMORY_SIZE MAX_POLICY_MAP_BYTES
 
 static void test_parse_policy_map_singlesig_1(void **state) {
     (void) state;
@@ -56,7 +55,7 @@ static void test_parse_policy_map_singlesig_2(void **state) {
 
     assert_int_equal(root->type, TOKEN_SH);
 
-    policy_node_with_key_t *inner = (policy_node_with_key_t *) root->script;
+    policy_node_with_key_t *inner = (policy_node_with_key_t *) policy_node_get_script(root);
 
     assert_int_equal(inner->type, TOKEN_WPKH);
     assert_int_equal(inner->key_index, 0);
@@ -78,11 +77,11 @@ static void test_parse_policy_map_singlesig_3(void **state) {
 
     assert_int_equal(root->type, TOKEN_SH);
 
-    policy_node_with_script_t *mid = (policy_node_with_script_t *) root->script;
+    policy_node_with_script_t *mid = (policy_node_with_script_t *) policy_node_get_script(root);
 
     assert_int_equal(mid->type, TOKEN_WSH);
 
-    policy_node_with_key_t *inner = (policy_node_with_key_t *) mid->script;
+    policy_node_with_key_t *inner = (policy_node_with_key_t *) policy_node_get_script(mid);
 
     assert_int_equal(inner->type, TOKEN_PKH);
     assert_int_equal(inner->key_index, 0);
@@ -126,7 +125,7 @@ static void test_parse_policy_map_multisig_2(void **state) {
 
     assert_int_equal(root->type, TOKEN_WSH);
 
-    policy_node_multisig_t *inner = (policy_node_multisig_t *) root->script;
+    policy_node_multisig_t *inner = (policy_node_multisig_t *) policy_node_get_script(root);
     assert_int_equal(inner->type, TOKEN_MULTI);
 
     assert_int_equal(inner->k, 3);
@@ -150,10 +149,10 @@ static void test_parse_policy_map_multisig_3(void **state) {
 
     assert_int_equal(root->type, TOKEN_SH);
 
-    policy_node_with_script_t *mid = (policy_node_with_script_t *) root->script;
+    policy_node_with_script_t *mid = (policy_node_with_script_t *) policy_node_get_script(root);
     assert_int_equal(mid->type, TOKEN_WSH);
 
-    policy_node_multisig_t *inner = (policy_node_multisig_t *) mid->script;
+    policy_node_multisig_t *inner = (policy_node_multisig_t *) policy_node_get_script(mid);
     assert_int_equal(inner->type, TOKEN_SORTEDMULTI);
 
     assert_int_equal(inner->k, 3);
@@ -161,6 +160,40 @@ static void test_parse_policy_map_multisig_3(void **state) {
     for (int i = 0; i < 5; i++) assert_int_equal(inner->key_indexes[i], i);
 }
 
+static void test_parse_policy_map_multisig_15of15(void **state) {
+    (void) state;
+
+    uint8_t out[MAX_POLICY_MAP_MEMORY_SIZE];
+
+    int res;
+
+    char *policy = "sh(wsh(sortedmulti(15,@0,@1,@2,@3,@4,@5,@6,@7,@8,@9,@10,@11,@12,@13,@14)))";
+    buffer_t policy_buf = buffer_create((void *) policy, strlen(policy));
+
+    res = parse_policy_map(&policy_buf, out, sizeof(out));
+    assert_int_equal(res, 0);
+
+    // clang-format off
+    const uint8_t expected[] = {
+        TOKEN_SH, 2,
+        TOKEN_WSH, 2,
+        TOKEN_SORTEDMULTI, 15, 15, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14
+    };
+    // clang-format on
+    assert_memory_equal(out, expected, sizeof(expected));
+
+    // fails if the output buffer is too small
+    policy_buf = buffer_create((void *) policy, strlen(policy));
+    res = parse_policy_map(&policy_buf, out, sizeof(expected) - 1);
+    assert_true(res < 0);
+
+    // at most 15 keys
+    char *policy_16 = "wsh(multi(1,@0,@1,@2,@3,@4,@5,@6,@7,@8,@9,@10,@11,@12,@13,@14,@15))";
+    policy_buf = buffer_create((void *) policy_16, strlen(policy_16));
+    res = parse_policy_map(&policy_buf, out, sizeof(out));
+    assert_true(res < 0);
+}
+
 // convenience function to parse as one liners
 
 static int parse_policy(char *policy, size_t policy_len, uint8_t *out, size_t out_len) {
@@ -209,6 +242,78 @@ static void test_failures(void **state) {
     assert_true(0 > PARSE_POLICY("multi(1,)", out, sizeof(out)));
 }
 
+static int parse_key_info(const uint8_t *key_info,
+                          size_t key_info_len,
+                          policy_map_key_info_t *out) {
+    buffer_t in_buf = buffer_create((void *) key_info, key_info_len);
+    return parse_policy_map_key_info(&in_buf, out);
+}
+
+static void test_parse_key_info_binary(void **state) {
+    (void) state;
+
+    policy_map_key_info_t key_info;
+
+    // [f5acc2fd/48'/1'/0'/2'] followed by the extended pubkey and the wildcard
+    uint8_t key_info_bin[1 + 4 + 1 + 4 * 4 + 78] = {
+        KEY_INFO_BINARY_HAS_KEY_ORIGIN | KEY_INFO_BINARY_HAS_WILDCARD,
+        0xf5, 0xac, 0xc2, 0xfd,
+        4,
+        48, 0, 0, 0x80,
+        1, 0, 0, 0x80,
+        0, 0, 0, 0x80,
+        2, 0, 0, 0x80};
+    for (int i = 0; i < 78; i++) {
+        key_info_bin[1 + 4 + 1 + 4 * 4 + i] = (uint8_t) i;
+    }
+
+    assert_int_equal(parse_key_info(key_info_bin, sizeof(key_info_bin), &key_info), 0);
+    assert_true(key_info.is_binary);
+    assert_true(key_info.has_key_origin);
+    assert_true(key_info.has_wildcard);
+    assert_memory_equal(key_info.master_key_fingerprint, key_info_bin + 1, 4);
+    assert_int_equal(key_info.master_key_derivation_len, 4);
+    assert_int_equal(key_info.master_key_derivation[0], 0x80000030);
+    assert_int_equal(key_info.master_key_derivation[3], 0x80000002);
+    assert_memory_equal(key_info.ext_pubkey_bytes, key_info_bin + 1 + 4 + 1 + 4 * 4, 78);
+
+    // no key origin, no wildcard: only the extended pubkey follows the flags
+    uint8_t *key_only = key_info_bin + 4 + 1 + 4 * 4;
+    key_only[0] = 0;
+    assert_int_equal(parse_key_info(key_only, 1 + 78, &key_info), 0);
+    assert_true(key_info.is_binary);
+    assert_false(key_info.has_key_origin);
+    assert_false(key_info.has_wildcard);
+    assert_memory_equal(key_info.ext_pubkey_bytes, key_only + 1, 78);
+
+    // unknown flags
+    key_only[0] = 0x04;
+    assert_true(0 > parse_key_info(key_only, 1 + 78, &key_info));
+    key_only[0] = 0;
+
+    // truncated or too long extended pubkey
+    assert_true(0 > parse_key_info(key_only, 1 + 77, &key_info));
+    uint8_t too_long[1 + 79] = {0};
+    assert_true(0 > parse_key_info(too_long, sizeof(too_long), &key_info));
+
+    // too many derivation steps
+    uint8_t long_path[1 + 4 + 1 + 4 * (MAX_BIP32_PATH_STEPS + 1) + 78] = {
+        KEY_INFO_BINARY_HAS_KEY_ORIGIN, 0, 0, 0, 0, MAX_BIP32_PATH_STEPS + 1};
+    assert_true(0 > parse_key_info(long_path, sizeof(long_path), &key_info));
+
+    // the string encoding is still detected
+    const char *key_info_str =
+        "[f5acc2fd/48'/1'/0'/2']"
+        "tpubDFAqEGNyad35aBCKUAXbQGDjdVhNueno5ZZVEn3sQbW5ci457gLR7HyTmHBg93"
+        "oourBssgUxuWz1jX5uhc1qaqFo9VsybY1J5FuedLfm4dK/**";
+    assert_int_equal(
+        parse_key_info((const uint8_t *) key_info_str, strlen(key_info_str), &key_info),
+        0);
+    assert_false(key_info.is_binary);
+    assert_true(key_info.has_wildcard);
+    assert_int_equal(key_info.master_key_derivation_len, 4);
+}
+
 int main() {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_parse_policy_map_singlesig_1),
@@ -217,7 +322,9 @@ int main() {
         cmocka_unit_test(test_parse_policy_map_multisig_1),
         cmocka_unit_test(test_parse_policy_map_multisig_2),
         cmocka_unit_test(test_parse_policy_map_multisig_3),
+        cmocka_unit_test(test_parse_policy_map_multisig_15of15),
         cmocka_unit_test(test_failures),
+        cmocka_unit_test(test_parse_key_info_binary),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);